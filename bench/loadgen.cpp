@@ -0,0 +1,557 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   loadgen.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*	---------------------------------------------------------------------------
+	loadgen - small HTTP/1.1 load generator for `make bench`
+
+	Opens C keep-alive connections to one host:port, keeps up to P requests
+	in flight per connection (pipelining) and cycles through a weighted mix
+	of requests for D seconds (or until N requests completed). Prints one
+	JSON object with throughput and latency percentiles, so the numbers can
+	be diffed / gated by scripts.
+
+	Usage:
+		loadgen [-h host] [-p port] [-c conns] [-d seconds] [-n requests]
+		        [-P depth] [-b bodyfile] [-k] [-s name]
+		        -r "METHOD PATH[ WEIGHT]" [-r ...]
+
+		-k      send POST bodies with Transfer-Encoding: chunked
+		PATH    '{n}' is replaced by a unique sequence number (uploads)
+	------------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+	struct RequestSpec {
+		std::string	method;
+		std::string	path;
+		int			weight;
+	};
+
+	struct Options {
+		std::string					host;
+		int							port;
+		int							conns;
+		double						seconds;
+		long						maxRequests;
+		int							depth;
+		std::string					body;
+		bool						chunked;
+		std::string					name;
+		std::vector<RequestSpec>	mix;
+
+		Options()
+		:	host("127.0.0.1"), port(8080), conns(32), seconds(5.0), maxRequests(0)
+		,	depth(1), body(), chunked(false), name("bench"), mix()
+		{}
+	};
+
+	enum ParseState { P_HEAD, P_BODY_LENGTH, P_CHUNK_SIZE, P_CHUNK_DATA, P_CHUNK_CRLF, P_TRAILERS };
+
+	struct Client {
+		int					fd;
+		bool				connecting;
+		std::string			out;
+		std::size_t			outOffset;
+		std::string			in;
+		std::size_t			inOffset;
+		std::deque<long>	sentAtUs;		// one entry per request in flight
+		std::deque<bool>	sentHead;
+		ParseState			state;
+		std::size_t			need;
+		int					status;
+		bool				closeAfter;
+
+		Client()
+		:	fd(-1), connecting(false), out(), outOffset(0), in(), inOffset(0)
+		,	sentAtUs(), sentHead(), state(P_HEAD), need(0), status(0), closeAfter(false)
+		{}
+	};
+
+	struct Stats {
+		std::vector<long>	latencyUs;
+		long				errors;
+		long				non2xx;
+		long				bytes;
+		long				connects;
+
+		Stats() : latencyUs(), errors(0), non2xx(0), bytes(0), connects(0) {}
+	};
+
+	long nowUs() {
+		struct timespec	ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<long>(ts.tv_sec) * 1000000L + ts.tv_nsec / 1000;
+	}
+
+	void usage(const char* argv0) {
+		std::cerr << "usage: " << argv0 << " [-h host] [-p port] [-c conns] [-d seconds] [-n requests]"
+				  << " [-P depth] [-b bodyfile] [-k] [-s name] -r \"METHOD PATH[ WEIGHT]\" ...\n";
+		std::exit(2);
+	}
+
+	bool readFile(const std::string& path, std::string& out) {
+		std::ifstream	in(path.c_str(), std::ios::binary);
+		if (!in)
+			return false;
+		std::ostringstream	oss;
+		oss << in.rdbuf();
+		out = oss.str();
+		return true;
+	}
+
+	bool parseArgs(int argc, char** argv, Options& opt) {
+
+		for (int i = 1; i < argc; ++i) {
+			std::string	a = argv[i];
+			bool		hasValue = (i + 1 < argc);
+
+			if (a == "-k")
+				opt.chunked = true;
+			else if (!hasValue)
+				return false;
+			else if (a == "-h")
+				opt.host = argv[++i];
+			else if (a == "-p")
+				opt.port = std::atoi(argv[++i]);
+			else if (a == "-c")
+				opt.conns = std::atoi(argv[++i]);
+			else if (a == "-d")
+				opt.seconds = std::atof(argv[++i]);
+			else if (a == "-n")
+				opt.maxRequests = std::atol(argv[++i]);
+			else if (a == "-P")
+				opt.depth = std::atoi(argv[++i]);
+			else if (a == "-s")
+				opt.name = argv[++i];
+			else if (a == "-b") {
+				if (!readFile(argv[++i], opt.body)) {
+					std::cerr << "loadgen: cannot read " << argv[i] << "\n";
+					return false;
+				}
+			}
+			else if (a == "-r") {
+				std::istringstream	iss(argv[++i]);
+				RequestSpec			spec;
+				spec.weight = 1;
+				if (!(iss >> spec.method >> spec.path))
+					return false;
+				iss >> spec.weight;
+				if (spec.weight < 1)
+					spec.weight = 1;
+				opt.mix.push_back(spec);
+			}
+			else
+				return false;
+		}
+		return !opt.mix.empty() && opt.conns > 0 && opt.depth > 0 && opt.port > 0;
+	}
+
+	// Deterministic weighted round-robin over the mix.
+	const RequestSpec& pickRequest(const Options& opt, long seq) {
+		long	total = 0;
+		for (std::size_t i = 0; i < opt.mix.size(); ++i)
+			total += opt.mix[i].weight;
+		long	slot = seq % total;
+		for (std::size_t i = 0; i < opt.mix.size(); ++i) {
+			if (slot < opt.mix[i].weight)
+				return opt.mix[i];
+			slot -= opt.mix[i].weight;
+		}
+		return opt.mix[0];
+	}
+
+	std::string buildRequest(const Options& opt, const RequestSpec& spec, long seq) {
+
+		std::string	path = spec.path;
+		std::string::size_type	pos = path.find("{n}");
+		if (pos != std::string::npos) {
+			std::ostringstream	n;
+			n << seq;
+			path.replace(pos, 3, n.str());
+		}
+
+		std::ostringstream	req;
+		req << spec.method << ' ' << path << " HTTP/1.1\r\n"
+			<< "Host: " << opt.host << "\r\n"
+			<< "User-Agent: webserv-loadgen\r\n";
+
+		const bool	withBody = (spec.method == "POST" || spec.method == "PUT");
+		if (!withBody) {
+			req << "\r\n";
+			return req.str();
+		}
+
+		if (!opt.chunked) {
+			req << "Content-Length: " << opt.body.size() << "\r\n\r\n" << opt.body;
+			return req.str();
+		}
+
+		req << "Transfer-Encoding: chunked\r\n\r\n";
+		const std::size_t	CHUNK = 16 * 1024;
+		for (std::size_t off = 0; off < opt.body.size(); off += CHUNK) {
+			std::size_t	len = std::min(CHUNK, opt.body.size() - off);
+			req << std::hex << len << std::dec << "\r\n";
+			req.write(opt.body.data() + off, static_cast<std::streamsize>(len));
+			req << "\r\n";
+		}
+		req << "0\r\n\r\n";
+		return req.str();
+	}
+
+	std::string lowerCopy(const std::string& s) {
+		std::string	out(s);
+		for (std::size_t i = 0; i < out.size(); ++i)
+			out[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(out[i])));
+		return out;
+	}
+
+	bool openClient(const Options& opt, Client& c, Stats& stats) {
+
+		c = Client();
+		c.fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (c.fd < 0)
+			return false;
+		fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL, 0) | O_NONBLOCK);
+		int	one = 1;
+		setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		struct sockaddr_in	addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(static_cast<unsigned short>(opt.port));
+		if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1) {
+			close(c.fd);
+			c.fd = -1;
+			return false;
+		}
+		if (connect(c.fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+			close(c.fd);
+			c.fd = -1;
+			return false;
+		}
+		c.connecting = true;
+		++stats.connects;
+		return true;
+	}
+
+	void dropClient(Client& c, Stats& stats) {
+		stats.errors += static_cast<long>(c.sentAtUs.size());	// requests that never got an answer
+		if (c.fd >= 0)
+			close(c.fd);
+		c = Client();
+	}
+
+	// Consumes as many complete responses as `in` holds. Returns false on a protocol error.
+	bool parseResponses(Client& c, Stats& stats) {
+
+		for (;;) {
+			const std::size_t	avail = c.in.size() - c.inOffset;
+			const char*			p = c.in.data() + c.inOffset;
+
+			if (c.state == P_HEAD) {
+				std::string::size_type	end = c.in.find("\r\n\r\n", c.inOffset);
+				if (end == std::string::npos)
+					break;
+				if (c.sentAtUs.empty())
+					return false;						// response nobody asked for
+
+				std::string	head = c.in.substr(c.inOffset, end - c.inOffset);
+				c.inOffset = end + 4;
+
+				c.status = 0;
+				std::string::size_type	sp = head.find(' ');
+				if (sp != std::string::npos)
+					c.status = std::atoi(head.c_str() + sp + 1);
+
+				long	contentLength = 0;
+				bool	chunked = false;
+				std::istringstream	lines(head);
+				std::string			line;
+				std::getline(lines, line);
+				while (std::getline(lines, line)) {
+					std::string::size_type	colon = line.find(':');
+					if (colon == std::string::npos)
+						continue;
+					std::string	key = lowerCopy(line.substr(0, colon));
+					std::string	value = lowerCopy(line.substr(colon + 1));
+					if (key == "content-length")
+						contentLength = std::atol(value.c_str());
+					else if (key == "transfer-encoding" && value.find("chunked") != std::string::npos)
+						chunked = true;
+					else if (key == "connection" && value.find("close") != std::string::npos)
+						c.closeAfter = true;
+				}
+
+				const bool	noBody = c.sentHead.front() || c.status == 204 || c.status == 304 || c.status / 100 == 1;
+				if (noBody) {
+					c.need = 0;
+					c.state = P_BODY_LENGTH;
+				}
+				else if (chunked)
+					c.state = P_CHUNK_SIZE;
+				else {
+					c.need = static_cast<std::size_t>(contentLength);
+					c.state = P_BODY_LENGTH;
+				}
+				continue;
+			}
+
+			if (c.state == P_BODY_LENGTH) {
+				if (avail < c.need)
+					break;
+				c.inOffset += c.need;
+				stats.bytes += static_cast<long>(c.need);
+			}
+			else if (c.state == P_CHUNK_SIZE) {
+				std::string::size_type	eol = c.in.find("\r\n", c.inOffset);
+				if (eol == std::string::npos)
+					break;
+				c.need = std::strtoul(p, NULL, 16);
+				c.inOffset = eol + 2;
+				c.state = (c.need == 0) ? P_TRAILERS : P_CHUNK_DATA;
+				continue;
+			}
+			else if (c.state == P_CHUNK_DATA) {
+				if (avail < c.need)
+					break;
+				c.inOffset += c.need;
+				stats.bytes += static_cast<long>(c.need);
+				c.state = P_CHUNK_CRLF;
+				continue;
+			}
+			else if (c.state == P_CHUNK_CRLF) {
+				if (avail < 2)
+					break;
+				c.inOffset += 2;
+				c.state = P_CHUNK_SIZE;
+				continue;
+			}
+			else if (c.state == P_TRAILERS) {
+				std::string::size_type	eol = c.in.find("\r\n", c.inOffset);
+				if (eol == std::string::npos)
+					break;
+				bool	blank = (eol == c.inOffset);
+				c.inOffset = eol + 2;
+				if (!blank)
+					continue;
+			}
+
+			// One response complete.
+			stats.latencyUs.push_back(nowUs() - c.sentAtUs.front());
+			if (c.status < 200 || c.status >= 300)
+				++stats.non2xx;
+			c.sentAtUs.pop_front();
+			c.sentHead.pop_front();
+			c.state = P_HEAD;
+		}
+
+		if (c.inOffset > 0 && c.inOffset == c.in.size()) {
+			c.in.clear();
+			c.inOffset = 0;
+		}
+		else if (c.inOffset > 64 * 1024) {
+			c.in.erase(0, c.inOffset);
+			c.inOffset = 0;
+		}
+		return true;
+	}
+
+	double percentileMs(const std::vector<long>& sorted, double q) {
+		if (sorted.empty())
+			return 0.0;
+		std::size_t	idx = static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1) + 0.5);
+		return static_cast<double>(sorted[idx]) / 1000.0;
+	}
+
+} // namespace
+
+int main(int argc, char** argv) {
+
+	Options	opt;
+	if (!parseArgs(argc, argv, opt))
+		usage(argv[0]);
+
+	signal(SIGPIPE, SIG_IGN);
+
+	Stats				stats;
+	std::vector<Client>	clients(static_cast<std::size_t>(opt.conns));
+	long				seq = 0;
+	long				completedTarget = opt.maxRequests;
+
+	for (std::size_t i = 0; i < clients.size(); ++i) {
+		if (!openClient(opt, clients[i], stats))
+			++stats.errors;
+	}
+
+	const long	startUs = nowUs();
+	const long	stopSendingUs = startUs + static_cast<long>(opt.seconds * 1000000.0);
+	const long	hardStopUs = stopSendingUs + 5000000L;			// grace for requests in flight
+	char		buf[64 * 1024];
+
+	for (;;) {
+		const long	now = nowUs();
+		const bool	sending = now < stopSendingUs
+							&& (completedTarget <= 0 || seq < completedTarget);
+
+		bool	inFlight = false;
+		std::vector<struct pollfd>	pfds;
+		std::vector<std::size_t>	owners;
+
+		for (std::size_t i = 0; i < clients.size(); ++i) {
+			Client&	c = clients[i];
+			if (c.fd < 0) {
+				if (sending && openClient(opt, c, stats) == false)
+					++stats.errors;
+				if (c.fd < 0)
+					continue;
+			}
+
+			// Top up the pipeline.
+			while (sending && !c.connecting && !c.closeAfter
+				   && static_cast<int>(c.sentAtUs.size()) < opt.depth
+				   && (completedTarget <= 0 || seq < completedTarget)) {
+				const RequestSpec&	spec = pickRequest(opt, seq);
+				if (c.outOffset == c.out.size()) {
+					c.out.clear();
+					c.outOffset = 0;
+				}
+				c.out += buildRequest(opt, spec, seq);
+				c.sentAtUs.push_back(nowUs());
+				c.sentHead.push_back(spec.method == "HEAD");
+				++seq;
+			}
+
+			if (!c.sentAtUs.empty())
+				inFlight = true;
+			if (c.sentAtUs.empty() && !sending) {
+				close(c.fd);
+				c = Client();
+				continue;
+			}
+
+			struct pollfd	pfd;
+			pfd.fd = c.fd;
+			pfd.events = POLLIN;
+			if (c.connecting || c.outOffset < c.out.size())
+				pfd.events |= POLLOUT;
+			pfd.revents = 0;
+			pfds.push_back(pfd);
+			owners.push_back(i);
+		}
+
+		if (!sending && (!inFlight || now >= hardStopUs))
+			break;
+
+		if (pfds.empty())
+			continue;
+		if (poll(&pfds[0], pfds.size(), 100) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (std::size_t k = 0; k < pfds.size(); ++k) {
+			Client&	c = clients[owners[k]];
+			short	re = pfds[k].revents;
+			if (re == 0)
+				continue;
+
+			if (c.connecting && (re & (POLLOUT | POLLERR | POLLHUP))) {
+				int			err = 0;
+				socklen_t	len = sizeof(err);
+				getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+				if (err != 0) {
+					dropClient(c, stats);
+					continue;
+				}
+				c.connecting = false;
+			}
+
+			if (re & POLLOUT) {
+				while (c.outOffset < c.out.size()) {
+					ssize_t	n = send(c.fd, c.out.data() + c.outOffset, c.out.size() - c.outOffset, 0);
+					if (n <= 0)
+						break;
+					c.outOffset += static_cast<std::size_t>(n);
+				}
+			}
+
+			if (re & (POLLIN | POLLHUP | POLLERR)) {
+				bool	eof = false;
+				for (;;) {
+					ssize_t	n = recv(c.fd, buf, sizeof(buf), 0);
+					if (n > 0) {
+						c.in.append(buf, static_cast<std::size_t>(n));
+						continue;
+					}
+					if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+						eof = true;
+					break;
+				}
+				if (!parseResponses(c, stats)) {
+					dropClient(c, stats);
+					continue;
+				}
+				if (eof || (c.closeAfter && c.sentAtUs.empty())) {
+					dropClient(c, stats);		// reconnect on the next round
+					continue;
+				}
+			}
+		}
+	}
+
+	for (std::size_t i = 0; i < clients.size(); ++i) {
+		if (clients[i].fd >= 0)
+			dropClient(clients[i], stats);
+	}
+
+	const double	elapsed = static_cast<double>(nowUs() - startUs) / 1000000.0;
+	std::vector<long>	sorted(stats.latencyUs);
+	std::sort(sorted.begin(), sorted.end());
+
+	char	line[1024];
+	std::snprintf(line, sizeof(line),
+		"{\"scenario\":\"%s\",\"connections\":%d,\"pipeline\":%d,\"requests\":%lu,"
+		"\"errors\":%ld,\"non_2xx\":%ld,\"connects\":%ld,\"seconds\":%.3f,\"rps\":%.1f,"
+		"\"mb_per_s\":%.2f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}",
+		opt.name.c_str(), opt.conns, opt.depth, static_cast<unsigned long>(sorted.size()),
+		stats.errors, stats.non2xx, stats.connects, elapsed,
+		elapsed > 0 ? static_cast<double>(sorted.size()) / elapsed : 0.0,
+		elapsed > 0 ? static_cast<double>(stats.bytes) / elapsed / (1024.0 * 1024.0) : 0.0,
+		percentileMs(sorted, 0.50), percentileMs(sorted, 0.99), percentileMs(sorted, 0.999),
+		sorted.empty() ? 0.0 : static_cast<double>(sorted.back()) / 1000.0);
+	std::cout << line << std::endl;
+
+	return (sorted.empty() || stats.errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,371 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   microbench.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*	---------------------------------------------------------------------------
+	microbench - in-process benchmarks of the parser / serializer hot paths
+
+	Links the server's objects (everything but main.o) and times the pure
+	functions on inputs from bench/corpus: request heads captured from real
+	clients (requests.http) and a server{} with 40 locations (routes.conf).
+	The global operator new/delete are replaced by counting ones, so every
+	line reports allocations per call next to the time.
+
+	Usage (from the repository root, `make microbench` builds and runs it):
+		microbench [-t seconds-per-case] [-C corpus-dir] [filter]
+
+	One JSON object per case:
+		{"bench":"parse_head","case":"chrome-css","ops":...,"ns_per_op":...,
+		 "allocs_per_op":...,"alloc_bytes_per_op":...,"bytes_per_op":...,"mb_per_s":...}
+	bytes_per_op is the input handled by one call (0 when it isn't a byte stream).
+	------------------------------------------------------------------------- */
+
+#include "../include/Headers.hpp"
+#include "../include/Structs.hpp"
+#include "../include/Config.hpp"
+#include "../include/HttpHeader.hpp"
+#include "../include/HttpBody.hpp"
+#include "../include/HttpSerializer.hpp"
+#include "../include/App.hpp"
+#include "../include/ByteScan.hpp"
+
+#include <new>
+
+// ---- counting allocator ----------------------------------------------------
+
+static unsigned long		g_allocs = 0;
+static unsigned long long	g_allocBytes = 0;
+
+void*	operator new(std::size_t n) throw(std::bad_alloc)	{
+	++g_allocs;
+	g_allocBytes += n;
+	void*	p = std::malloc(n ? n : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void*	operator new[](std::size_t n) throw(std::bad_alloc)	{
+	return operator new(n);
+}
+
+void	operator delete(void* p) throw()	{
+	std::free(p);
+}
+
+void	operator delete[](void* p) throw()	{
+	std::free(p);
+}
+
+namespace {
+
+	// ---- harness -------------------------------------------------------------
+
+	struct Options {
+		double		seconds;
+		std::string	corpus;
+		std::string	filter;
+
+		Options() : seconds(0.2), corpus("bench/corpus"), filter() {}
+	};
+
+	Options				g_opt;
+	unsigned long		g_sink = 0;		// results fold in here: nothing is optimized away
+
+	typedef void	(*OpFn)(std::size_t i);
+
+	double	nowSec()	{
+		struct timespec	ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+	}
+
+	// Warm up (buffers reach their steady capacity), then double the batch until
+	// it runs for the requested time; the last batch is the one reported.
+	void	run(const std::string& bench, const std::string& name, OpFn op, std::size_t bytesPerOp)	{
+
+		const std::string	label = bench + "/" + name;
+		if (!g_opt.filter.empty() && label.find(g_opt.filter) == std::string::npos)
+			return;
+
+		for (std::size_t i = 0; i < 100; ++i)
+			op(i);
+
+		std::size_t		ops = 64;
+		double			elapsed = 0;
+		unsigned long	allocs = 0;
+		unsigned long long	allocBytes = 0;
+		for (;;)	{
+			const unsigned long			a0 = g_allocs;
+			const unsigned long long	b0 = g_allocBytes;
+			const double				t0 = nowSec();
+			for (std::size_t i = 0; i < ops; ++i)
+				op(i);
+			elapsed = nowSec() - t0;
+			allocs = g_allocs - a0;
+			allocBytes = g_allocBytes - b0;
+			if (elapsed >= g_opt.seconds || ops >= (static_cast<std::size_t>(1) << 30))
+				break;
+			ops *= 2;
+		}
+
+		const double	perOp = elapsed / static_cast<double>(ops);
+		char			line[512];
+		std::snprintf(line, sizeof(line),
+			"{\"bench\":\"%s\",\"case\":\"%s\",\"ops\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,"
+			"\"alloc_bytes_per_op\":%.1f,\"bytes_per_op\":%lu,\"mb_per_s\":%.1f,\"scan\":\"%s\"}",
+			bench.c_str(), name.c_str(), static_cast<unsigned long>(ops), perOp * 1e9,
+			static_cast<double>(allocs) / static_cast<double>(ops),
+			static_cast<double>(allocBytes) / static_cast<double>(ops),
+			static_cast<unsigned long>(bytesPerOp),
+			bytesPerOp ? static_cast<double>(bytesPerOp) / perOp / 1e6 : 0.0, bytescan::kernelName());
+		std::cout << line << std::endl;
+	}
+
+	bool	readFile(const std::string& path, std::string& out)	{
+		std::ifstream	in(path.c_str(), std::ios::in | std::ios::binary);
+		if (!in)
+			return false;
+		std::ostringstream	ss;
+		ss << in.rdbuf();
+		out = ss.str();
+		return true;
+	}
+
+	// ---- corpus ----------------------------------------------------------------
+
+	struct CorpusRequest {
+		std::string	name;
+		std::string	raw;		// head including the blank line
+	};
+
+	std::vector<CorpusRequest>	g_requests;
+
+	// Case name from the head: client family + what it asked for.
+	std::string	caseName(const std::string& raw)	{
+		const std::string	target = raw.substr(0, raw.find("\r\n"));
+		std::string	agent = "other";
+		const char* const	agents[] = { "curl", "Chrome", "Firefox", "python-requests", "Wget", "ApacheBench" };
+		const char* const	names[] = { "curl", "chrome", "firefox", "python", "wget", "ab" };
+		for (std::size_t i = 0; i < sizeof(agents) / sizeof(agents[0]); ++i)
+			if (raw.find(agents[i]) != std::string::npos)	{
+				agent = names[i];
+				break;
+			}
+		std::string	method = target.substr(0, target.find(' '));
+		for (std::size_t i = 0; i < method.size(); ++i)
+			method[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(method[i])));
+		return agent + "-" + method;
+	}
+
+	bool	loadRequests(const std::string& path)	{
+		std::string	all;
+		if (!readFile(path, all))
+			return false;
+		std::size_t	pos = 0;
+		while (pos < all.size())	{
+			const std::size_t	end = all.find("\r\n\r\n", pos);
+			if (end == std::string::npos)
+				break;
+			CorpusRequest	r;
+			r.raw = all.substr(pos, end + 4 - pos);
+			r.name = caseName(r.raw);
+			g_requests.push_back(r);
+			pos = end + 4;
+		}
+		return !g_requests.empty();
+	}
+
+	// ---- http::extract_next_head / http::parse_head ----------------------------
+
+	const CorpusRequest*	g_current = NULL;
+	IoBuffer				g_buffer;
+	std::string				g_head;
+	HTTP_Request			g_request;
+
+	void	opExtract(std::size_t)	{
+		std::size_t	scanned = 0;
+		g_buffer.append(g_current->raw.data(), g_current->raw.size());
+		g_sink += http::extract_next_head(g_buffer, g_head, scanned) ? g_head.size() : 0;
+	}
+
+	// As the event loop does it: the previous head's storage is lent back.
+	void	opParse(std::size_t)	{
+		int			status = 0;
+		std::string	reason;
+		g_request.reset();
+		g_head.swap(g_request.headers.raw());
+		g_head.assign(g_current->raw.data(), g_current->raw.size() - 4);	// as extracted: without the blank line
+		g_sink += http::parse_head(g_head, g_request, status, reason) ? 1 : status;
+	}
+
+	// ---- http::consume_body_chunked --------------------------------------------
+
+	Connection*	g_connection = NULL;
+	std::string	g_chunked;
+
+	void	makeChunked(std::size_t total, std::size_t chunk)	{
+		g_chunked.clear();
+		const std::string	payload(chunk, 'x');
+		char				size[32];
+		for (std::size_t sent = 0; sent < total; sent += chunk)	{
+			std::snprintf(size, sizeof(size), "%lx\r\n", static_cast<unsigned long>(chunk));
+			g_chunked += size;
+			g_chunked += payload;
+			g_chunked += "\r\n";
+		}
+		g_chunked += "0\r\n\r\n";
+	}
+
+	void	opChunked(std::size_t)	{
+		int			status = 0;
+		std::string	reason;
+		HTTP_Request&	request = g_connection->request;
+		request.body.clear();
+		request.body_received = 0;
+		request.chunk_bytes_left = 0;
+		request.chunk_state = CS_SIZE;
+		g_connection->readBuffer.append(g_chunked.data(), g_chunked.size());
+		http::BodyResult	r = http::consume_body_chunked(*g_connection, static_cast<std::size_t>(-1), status, reason);
+		g_sink += (r == http::BODY_COMPLETE) ? request.body.size() : 0;
+	}
+
+	// ---- http::serialize_head ----------------------------------------------------
+
+	HTTP_Response	g_response;
+	std::string		g_version = "HTTP/1.1";
+
+	void	opSerialize(std::size_t)	{
+		g_sink += http::serialize_head(g_response, g_version, true, 5000).size();
+	}
+
+	// ---- RouteTable::compile / RouteTable::match ---------------------------------
+
+	std::vector<Server>			g_servers;
+	std::vector<std::string>	g_paths;
+
+	void	opCompile(std::size_t)	{
+		RouteTable	table;
+		table.compile(g_servers[0]);
+		g_sink += table.size();
+	}
+
+	void	opMatch(std::size_t i)	{
+		g_sink += g_servers[0].routes.match(g_paths[i % g_paths.size()]).locationPath.size();
+	}
+
+	// ---- contentTypeOf (getMimeType) ---------------------------------------------
+
+	std::vector<std::string>	g_files;
+
+	void	opMime(std::size_t i)	{
+		g_sink += contentTypeOf(g_files[i % g_files.size()]).size();
+	}
+
+	bool	parseArgs(int argc, char** argv)	{
+		for (int i = 1; i < argc; ++i)	{
+			const std::string	a = argv[i];
+			if (a == "-t" && i + 1 < argc)
+				g_opt.seconds = std::atof(argv[++i]);
+			else if (a == "-C" && i + 1 < argc)
+				g_opt.corpus = argv[++i];
+			else if (!a.empty() && a[0] != '-')
+				g_opt.filter = a;
+			else	{
+				std::cerr << "usage: " << argv[0] << " [-t seconds-per-case] [-C corpus-dir] [filter]\n";
+				return false;
+			}
+		}
+		return g_opt.seconds > 0;
+	}
+
+}
+
+int	main(int argc, char** argv)	{
+
+	if (!parseArgs(argc, argv))
+		return 2;
+	if (!loadRequests(g_opt.corpus + "/requests.http"))	{
+		std::cerr << "microbench: no requests in " << g_opt.corpus << "/requests.http\n";
+		return 1;
+	}
+	http::refresh_date(std::time(NULL));
+
+	try	{
+		Config	config(g_opt.corpus + "/routes.conf");
+		g_servers = config.getServers();
+	}
+	catch (const std::exception& e)	{
+		std::cerr << "microbench: " << g_opt.corpus << "/routes.conf: " << e.what() << "\n";
+		return 1;
+	}
+
+	for (std::size_t r = 0; r < g_requests.size(); ++r)	{
+		g_current = &g_requests[r];
+		run("extract_next_head", g_current->name, opExtract, g_current->raw.size());
+	}
+	for (std::size_t r = 0; r < g_requests.size(); ++r)	{
+		g_current = &g_requests[r];
+		run("parse_head", g_current->name, opParse, g_current->raw.size());
+	}
+
+	g_connection = new Connection();
+	const std::size_t	chunkSizes[] = { 16, 256, 4096, 65536 };
+	for (std::size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++c)	{
+		makeChunked(256 * 1024, chunkSizes[c]);
+		char	name[32];
+		std::snprintf(name, sizeof(name), "256k-in-%lu", static_cast<unsigned long>(chunkSizes[c]));
+		run("consume_body_chunked", name, opChunked, g_chunked.size());
+	}
+	delete g_connection;
+
+	g_response = HTTP_Response();
+	g_response.headers["Content-Type"] = "text/css";
+	g_response.headers["Last-Modified"] = "Mon, 23 Sep 2024 17:32:36 GMT";
+	g_response.headers["ETag"] = "\"66f1a2b4-1c2a\"";
+	g_response.headers["Accept-Ranges"] = "bytes";
+	g_response.headers["Content-Length"] = "7210";
+	run("serialize_head", "static-200", opSerialize, 0);
+	g_response = HTTP_Response();
+	g_response.status = 304;
+	g_response.reason = "Not Modified";
+	g_response.headers["ETag"] = "\"66f1a2b4-1c2a\"";
+	run("serialize_head", "not-modified-304", opSerialize, 0);
+	g_response = HTTP_Response();
+	g_response.body = "{\"id\":42}";
+	g_response.headers["Content-Type"] = "application/json";
+	run("serialize_head", "app-200-body", opSerialize, 0);
+
+	std::ostringstream	routes;
+	routes << g_servers[0].locations.size() << "-locations";
+	run("RouteTable::compile", routes.str(), opCompile, 0);
+
+	for (std::size_t r = 0; r < g_requests.size(); ++r)	{
+		const std::string&	raw = g_requests[r].raw;
+		const std::size_t	sp = raw.find(' ');
+		const std::string	target = raw.substr(sp + 1, raw.find(' ', sp + 1) - sp - 1);
+		g_paths.push_back(target.substr(0, target.find('?')));
+	}
+	g_paths.push_back("/static/js/vendor/app.min.js");
+	g_paths.push_back("/api/v1/items/42");
+	g_paths.push_back("/wiki/edit/Main_Page");
+	g_paths.push_back("/shop/checkout/confirm");
+	g_paths.push_back("/not/configured/anywhere");
+	run("RouteTable::match", routes.str(), opMatch, 0);
+
+	const char* const	files[] = { "index.html", "site.css", "app.min.js", "photo.JPG", "logo.svg", "font.woff2",
+									"report.pdf", "archive.tar.gz", "README", "data.json" };
+	for (std::size_t f = 0; f < sizeof(files) / sizeof(files[0]); ++f)
+		g_files.push_back(std::string("./www/static/") + files[f]);
+	run("contentTypeOf", "10-extensions", opMime, 0);
+
+	return g_sink == 0xdeadbeef ? 3 : 0;
+}
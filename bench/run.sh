@@ -0,0 +1,64 @@
+#!/bin/sh
+# bench/run.sh - start ./webserv on configs/webserv.conf and run the load scenarios.
+#
+# Each scenario prints one JSON line (see bench/loadgen.cpp); the whole run is
+# also written to bench_output.txt so two runs can be compared with diff/jq.
+#
+# Tunables (environment): BENCH_SECONDS, BENCH_CONNS, BENCH_PIPELINE, BENCH_PORT
+
+SECONDS_PER="${BENCH_SECONDS:-5}"
+CONNS="${BENCH_CONNS:-32}"
+PIPELINE="${BENCH_PIPELINE:-1}"
+PORT="${BENCH_PORT:-8080}"
+CONF="configs/webserv.conf"
+LOADGEN="./bench/loadgen"
+OUT="bench_output.txt"
+
+LARGE_SRC="custom_tester/resource/large.bin"
+LARGE_DST="www/files/bench-large.bin"
+UPLOAD_BODY="bench/.upload-body"
+
+cleanup() {
+	[ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+	rm -f "$LARGE_DST" "$UPLOAD_BODY" www/upload/bench-*
+}
+trap cleanup EXIT INT TERM
+
+[ -x ./webserv ] || { echo "bench: ./webserv not built" >&2; exit 1; }
+[ -x "$LOADGEN" ] || { echo "bench: $LOADGEN not built" >&2; exit 1; }
+
+cp "$LARGE_SRC" "$LARGE_DST" || exit 1
+head -c 65536 /dev/urandom > "$UPLOAD_BODY" || exit 1
+
+./webserv "$CONF" > /dev/null 2>&1 &
+SERVER_PID=$!
+
+# Wait for the listener (up to ~5s)
+i=0
+until "$LOADGEN" -p "$PORT" -c 1 -n 1 -s probe -r "GET /" > /dev/null 2>&1; do
+	i=$((i + 1))
+	if [ "$i" -ge 50 ] || ! kill -0 "$SERVER_PID" 2>/dev/null; then
+		echo "bench: webserv did not come up on port $PORT" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+: > "$OUT"
+status=0
+
+run() {
+	name="$1"; shift
+	line=$("$LOADGEN" -p "$PORT" -d "$SECONDS_PER" -s "$name" "$@")
+	rc=$?
+	echo "$line" | tee -a "$OUT"
+	[ "$rc" -eq 0 ] || status=1
+}
+
+run static-small  -c "$CONNS" -P "$PIPELINE" -r "GET /"
+run autoindex     -c "$CONNS" -P "$PIPELINE" -r "GET /files/"
+run large-file    -c 8 -r "GET /files/bench-large.bin"
+run upload-chunked -c 8 -k -b "$UPLOAD_BODY" -r "POST /upload/bench-{n}.bin"
+run cgi           -c 8 -r "GET /cgi-bin/hello.py?name=bench"
+
+exit "$status"
@@ -0,0 +1,69 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef ACCESSLOG_HPP
+# define ACCESSLOG_HPP
+
+# include "Headers.hpp"
+# include "Structs.hpp"
+
+/*
+ Access log of one process ("access_log"). A line is formatted into a reused
+ string and copied into a fixed ring buffer; nothing is written per request.
+ The event loop calls flush() when the oldest line is flushMs old or the ring
+ is half full, so lines leave in one write() per batch. A full ring (the disk
+ is behind) drops lines and counts them rather than stall the loop. The
+ timestamp is re-formatted once per second.
+
+ Line: client, time, request line, status, bytes, total and upstream seconds, Host:
+   127.0.0.1 - - [14/Oct/2026:10:00:00 +0000] "GET /a HTTP/1.1" 200 512 rt=0.001 ut=- "example.com"
+*/
+class AccessLog {
+
+	public:
+		AccessLog();
+		~AccessLog();
+
+		bool			open(const AccessLogSettings& settings);	// false: configured but can't be opened
+		bool			enabled() const;
+
+		void			record(const Connection& connection, long long nowUs, std::time_t wallSec, long nowMs);
+		void			flush(long nowMs);
+		bool			flushDue(long nowMs) const;
+		long			nextFlushMs(long nowMs) const;	// ms until flushDue(), -1 when the ring is empty
+
+		unsigned long	lines() const;
+		unsigned long	dropped() const;
+		unsigned long	flushes() const;
+
+	private:
+		AccessLog(const AccessLog&);
+		AccessLog&	operator=(const AccessLog&);
+
+		AccessLogSettings	_settings;
+		int					_fd;
+		std::vector<char>	_ring;
+		std::size_t			_head;			// oldest unwritten byte
+		std::size_t			_used;
+		long				_oldestMs;		// when the ring went from empty to non-empty
+		std::string			_line;			// formatting scratch, capacity kept
+		std::time_t			_stampSecond;
+		char				_stamp[32];		// "[14/Oct/2026:10:00:00 +0000]"
+		unsigned long		_sampleCount;
+		unsigned long		_lines;
+		unsigned long		_dropped;
+		unsigned long		_flushes;
+
+		void			append(const std::string& line, long nowMs);
+};
+
+#endif
@@ -17,5 +17,12 @@
 # include "Structs.hpp"
 
 HTTP_Response handleRequest(const HTTP_Request& req, const Server& activeServer);
+void          configureFileCache(std::size_t maxBytes, std::size_t validSeconds);
+void          prebuildErrorResponses(Server& srv);
+std::string   contentTypeOf(const std::string& fsPath);
+void          fileCacheStats(unsigned long& hits, unsigned long& misses, std::size_t& bytes, std::size_t& entries);
+std::string   uploadSpillDirectory(const HTTP_Request& req, const Server& activeServer);
+HTTP_Response buildCgiResponse(const HTTP_Request& req, const Server& activeServer, const CgiProcess& cgi);
+bool          buildCgiStreamHead(const HTTP_Request& req, const CgiProcess& cgi, HTTP_Response& head, std::size_t& bodyStart, long long& contentLength);
 
 #endif
\ No newline at end of file
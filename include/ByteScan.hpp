@@ -0,0 +1,33 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ByteScan.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef BYTESCAN_HPP
+#define BYTESCAN_HPP
+
+#include <cstddef>
+
+/*
+ Delimiter search for the parsers: "\r\n" (request lines, chunk sizes,
+ trailers) and "\r\n\r\n" (end of a request head). 16 bytes per step with
+ SSE2 (x86-64) or NEON (AArch64), comparing the '\r' and '\n' positions in
+ parallel so a lone CR costs nothing; plain memchr() otherwise. Build with
+ "make SIMD=off" to force the scalar path.
+*/
+namespace   bytescan    {
+
+    const char* findCrlf(const char* p, const char* end);       // first "\r\n" in [p, end), NULL if none
+    const char* findCrlfCrlf(const char* p, const char* end);   // first "\r\n\r\n" in [p, end), NULL if none
+    const char* kernelName();                                   // "sse2", "neon" or "scalar"
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ClientLimiter.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CLIENTLIMITER_HPP
+# define CLIENTLIMITER_HPP
+
+# include "Headers.hpp"
+
+// Main-context overload limits, per worker process (0 = unlimited).
+struct AdmissionLimits {
+	std::size_t		maxConnections;		// "worker_connections N;": listeners pause at N clients
+	std::size_t		perIpConnections;	// "limit_conn_per_ip N;": more at once get a 503
+	unsigned long	ratePerSec;			// "limit_req_per_ip Nr/s [burst=M];": token refill per second
+	unsigned long	burst;				// bucket size (requests allowed back to back)
+
+	AdmissionLimits()
+	:	maxConnections(1024)
+	,	perIpConnections(0)
+	,	ratePerSec(0)
+	,	burst(0)
+	{}
+};
+
+/*
+ Per-client-IP accounting for AdmissionLimits: open connections and a token
+ bucket for requests. Clients are keyed by a 64-bit value (the IPv4 address
+ itself, a hash of an IPv6 one) in an open-addressing table that only grows on
+ insert; sweep() rebuilds it without the clients that hold nothing, so lookups
+ never allocate and the table stays as large as the active client set.
+*/
+class ClientLimiter {
+
+	public:
+		ClientLimiter();
+
+		void			configure(const AdmissionLimits& limits);
+
+		static uint64_t	keyOf(const struct sockaddr* addr, socklen_t len);	// 0 = unknown peer (never limited)
+		static std::string	addressOf(uint64_t key);					// dotted IPv4, "" for other keys
+
+		bool			openConnection(uint64_t key);				// false: the IP is at perIpConnections
+		void			closeConnection(uint64_t key);
+		bool			admitRequest(uint64_t key, long nowMs);		// false: the IP's bucket is empty
+		void			sweep(long nowMs);							// drop idle clients
+
+		std::size_t		clients() const;
+
+	private:
+		struct Entry {
+			uint64_t		key;			// 0 = free slot
+			unsigned long	connections;
+			unsigned long	tokens;			// in 1/1000 of a request
+			long			refilledMs;
+		};
+
+		AdmissionLimits		_limits;
+		std::vector<Entry>	_table;			// power-of-two size, linear probing
+		std::size_t			_used;
+
+		Entry*			find(uint64_t key, bool create, long nowMs);
+		void			refill(Entry& entry, long nowMs) const;
+		bool			idle(Entry& entry, long nowMs) const;
+		void			rehash(std::size_t capacity, long nowMs);
+};
+
+#endif
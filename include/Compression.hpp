@@ -0,0 +1,43 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Compression.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef COMPRESSION_HPP
+# define COMPRESSION_HPP
+
+# include "Headers.hpp"
+
+/*
+ Content codings the App can produce ("gzip on;" / "gzip_static on;").
+*/
+enum ContentCoding {
+	CODING_IDENTITY,
+	CODING_GZIP,
+	CODING_DEFLATE
+};
+
+/*
+ Picks the coding to send for an Accept-Encoding value: gzip over deflate on
+ equal q-values, "*" standing in for codings not listed, q=0 meaning "not
+ acceptable". Identity when nothing usable was offered.
+*/
+ContentCoding	negotiateCoding(const std::string& acceptEncoding);
+
+const char*		codingName(ContentCoding coding);		// "gzip" / "deflate" (Content-Encoding value)
+
+/*
+ Compresses in with zlib at level 1..9 (gzip or zlib-wrapped deflate).
+ False when the build has no zlib (make GZIP=off) or compression failed;
+ out is only written on success.
+*/
+bool			compressBody(const std::string& in, ContentCoding coding, int level, std::string& out);
+
+#endif
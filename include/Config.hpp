@@ -20,6 +20,7 @@ class Config    {
     
     private:
         std::vector<Server> _servers;
+        GlobalSettings      _globals;
         std::string         _filename;
 
         void	parse();
@@ -30,6 +31,7 @@ class Config    {
         Config(const std::string& filename);
 
         const std::vector<Server>&  getServers() const;
+        const GlobalSettings&       getGlobals() const;
 
 };
 
@@ -0,0 +1,53 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionTable.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CONNECTIONTABLE_HPP
+#define CONNECTIONTABLE_HPP
+
+#include "Headers.hpp"
+#include "Structs.hpp"
+
+/*
+ Client connections, indexed directly by fd (the kernel hands out the lowest
+ free number, so the table stays dense).
+ - One heap Connection per fd number ever used: released slots are recycled,
+   with their I/O buffers' capacity, by the next accept() that gets that fd.
+   Steady state has no allocation per connection or per lookup.
+ - Slots never move, so a Connection& stays valid while others open/close.
+ - The open fds are also kept in a dense list for the loops that walk all
+   connections (shutdown, status page); removal swaps the last one in.
+*/
+class   ConnectionTable {
+
+    public:
+        ConnectionTable();
+        ~ConnectionTable();
+
+        Connection*     find(int fd);           // NULL when fd is not an open client
+        Connection&     open(int fd);           // fresh connection in fd's slot
+        void            release(int fd);
+
+        bool            empty() const;
+        std::size_t     size() const;
+        Connection&     at(std::size_t i);      // i-th open connection (order not stable)
+        const Connection&   at(std::size_t i) const;
+
+    private:
+        ConnectionTable(const ConnectionTable&);
+        ConnectionTable&    operator=(const ConnectionTable&);
+
+        std::vector<Connection*>    _slots;     // indexed by fd, NULL until first used
+        std::vector<int>            _position;  // indexed by fd: index in _open, -1 when closed
+        std::vector<Connection*>    _open;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "Headers.hpp"
+
+// Backend selection (compile time):
+//  - Linux          -> epoll
+//  - BSD / macOS    -> kqueue
+//  - anything else  -> poll()
+// Build with -DWEBSERV_USE_POLL (make EVENT_BACKEND=poll) to force the poll() fallback.
+#if !defined(WEBSERV_USE_POLL) && defined(__linux__)
+# define WEBSERV_USE_EPOLL 1
+#elif !defined(WEBSERV_USE_POLL) && (defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__))
+# define WEBSERV_USE_KQUEUE 1
+#endif
+
+// Interest / readiness bits, independent from the backend.
+enum EventMask  {
+    EV_NONE     = 0,
+    EV_READ     = 1 << 0,
+    EV_WRITE    = 1 << 1,
+    EV_HUP      = 1 << 2,   // reported only, never requested
+    EV_ERROR    = 1 << 3    // reported only, never requested
+};
+
+struct ReadyEvent   {
+    int fd;
+    int events;     // EventMask bits
+};
+
+// Level-triggered readiness list over a set of fds.
+// add/modify/remove are O(1); wait() only returns the fds that are actually ready.
+class EventLoop {
+
+    public:
+        EventLoop();
+        ~EventLoop();
+
+        bool        open();
+        bool        add(int fd, int interest);
+        bool        modify(int fd, int interest);
+        void        remove(int fd);
+        int         wait(int timeoutMs, std::vector<ReadyEvent>& ready);
+
+        bool        isRegistered(int fd) const;
+        const char* backendName() const;
+
+    private:
+        EventLoop(const EventLoop&);
+        EventLoop&  operator=(const EventLoop&);
+
+        int                 _backendFd;     // epoll/kqueue instance (-1 for poll)
+        std::vector<int>    _interest;      // indexed by fd: current interest, -1 when not registered
+
+#if !defined(WEBSERV_USE_EPOLL) && !defined(WEBSERV_USE_KQUEUE)
+        std::vector<struct pollfd>  _pollFds;
+        std::vector<int>            _pollIndex; // indexed by fd: slot in _pollFds, -1 when absent
+#endif
+};
+
+#endif
@@ -0,0 +1,95 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgi.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FASTCGI_HPP
+#define FASTCGI_HPP
+
+#include "Headers.hpp"
+
+/*
+ FastCGI 1.0, web server side ("fastcgi_pass <ext> unix:<socket>;").
+ Instead of forking a CGI child per request, the request goes to a long-lived
+ application process over a Unix socket: same CGI variables (as PARAMS), the
+ body as STDIN, and CGI-style output back as STDOUT, so the App turns it into
+ a response exactly like a script's output.
+ - Responder role only, one request per backend connection at a time;
+   FCGI_KEEP_CONN keeps the connection open for the next request.
+ - Records are encoded/decoded here; the event loop (ServerRunner) owns the
+   sockets, the per-socket pool and its wait queue.
+*/
+namespace fastcgi   {
+
+    // BEGIN_REQUEST + PARAMS ("NAME=VALUE" strings) + STDIN (body, then EOF).
+    void    encodeRequest(const std::vector<std::string>& params, const std::string& body, std::string& out);
+
+    // Non-blocking connect to a Unix stream socket; -1 on immediate failure.
+    int     connectUnix(const std::string& path, bool& inProgress);
+
+    // Incremental decoder for the records of one response.
+    class   ResponseParser  {
+
+        public:
+            ResponseParser();
+
+            void                reset();
+            bool                feed(const char* data, std::size_t len, std::string& stdoutData);  // false: protocol error
+            bool                ended() const;          // END_REQUEST seen
+            bool                idle() const;           // ended with no bytes left over
+            int                 appStatus() const;
+            const std::string&  errors() const;         // STDERR stream
+
+        private:
+            std::string     _pending;       // partial record
+            bool            _ended;
+            int             _appStatus;
+            std::string     _stderr;
+    };
+}
+
+/*
+ One connection to a FastCGI application. clientFd is the connection whose
+ request it carries, -1 while it sits idle in its socket's pool.
+*/
+struct  FastCgiBackend  {
+    int                         fd;
+    std::string                 socketPath;
+    int                         clientFd;
+    bool                        connecting;     // connect() still in progress
+    bool                        reused;         // served a request before (the app may have closed it since)
+    bool                        answered;       // response bytes arrived for the current request
+    std::string                 out;            // encoded request not yet written
+    std::size_t                 outOffset;
+    fastcgi::ResponseParser     parser;
+
+    FastCgiBackend()
+    :   fd(-1), socketPath(), clientFd(-1), connecting(false), reused(false)
+    ,   answered(false), out(), outOffset(0), parser()
+    {}
+};
+
+/*
+ Per-socket pool: at most poolSize open connections; requests beyond that wait
+ in FIFO order, at most queueSize of them (the rest get a 503).
+*/
+struct  FastCgiUpstream {
+    std::size_t         open;
+    std::vector<int>    idle;           // backend fds ready for a request
+    std::deque<int>     waiting;        // client fds
+    std::size_t         poolSize;
+    std::size_t         queueSize;
+
+    FastCgiUpstream()
+    :   open(0), idle(), waiting(), poolSize(0), queueSize(0)
+    {}
+};
+
+#endif
@@ -0,0 +1,80 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileCache.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef FILECACHE_HPP
+# define FILECACHE_HPP
+
+# include "Headers.hpp"
+
+/*
+ One cached static file: the payload plus the precomputed headers, and the
+ stat() identity (inode, size, mtime) used to revalidate it.
+*/
+struct FileCacheEntry	{
+	std::string		path;
+	std::string		body;
+	std::string		contentType;
+	std::string		contentLength;
+	std::string		etag;				// validators, formatted once from the stat() identity
+	std::string		lastModified;
+	std::string		gzipBody;			// compressed variant ("gzip on;"), built on first demand
+	std::string		gzipLength;
+	bool			gzipTried;			// gzipBody computed (empty: compression didn't pay off)
+	ino_t			inode;
+	off_t			size;
+	time_t			mtime;
+	std::time_t		validatedAt;		// last time the entry was checked against the disk
+};
+
+/*
+ Bounded LRU cache of small static files keyed by resolved filesystem path
+ ("open_file_cache <size>;" / "open_file_cache_valid <seconds>;").
+ Inside the validity window a hit costs no syscall at all; after it, one
+ stat() either refreshes the entry or drops it.
+*/
+class FileCache	{
+
+	public:
+		FileCache();
+
+		void					configure(std::size_t maxBytes, std::size_t validSeconds);
+		bool					enabled() const;
+		bool					admits(off_t size) const;
+
+		bool					isFresh(const std::string& path) const;
+		const FileCacheEntry*	lookup(const std::string& path);
+		const FileCacheEntry*	insert(const std::string& path, const struct stat& st, std::string& body, const std::string& contentType,
+									const std::string& etag, const std::string& lastModified);
+		const FileCacheEntry*	storeGzip(const std::string& path, std::string& gzipBody);
+		void					invalidate(const std::string& path);
+
+		unsigned long			hits() const;
+		unsigned long			misses() const;
+		std::size_t				bytes() const;
+		std::size_t				entries() const;
+
+	private:
+		typedef std::list<FileCacheEntry>					EntryList;
+		typedef std::map<std::string, EntryList::iterator>	EntryIndex;
+
+		EntryList		_lru;			// most recently used first
+		EntryIndex		_index;
+		std::size_t		_maxBytes;		// 0 = cache disabled
+		std::size_t		_bytes;
+		std::time_t		_validSeconds;
+		unsigned long	_hits;
+		unsigned long	_misses;
+
+		void			erase(EntryIndex::iterator it);
+};
+
+#endif
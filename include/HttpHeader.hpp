@@ -18,8 +18,10 @@
 
 namespace http  {
 
-    bool        		parse_head(const std::string& head, HTTP_Request& request, int& status, std::string& reason);
-	bool				extract_next_head(std::string& buffer, std::string& out_head);
+    bool        		parse_head(std::string& head, HTTP_Request& request, int& status, std::string& reason);
+	bool				parse_response_head(std::string& head, HTTP_Request& response, int& status, std::string& reason);
+	bool				extract_next_head(IoBuffer& buffer, std::string& out_head, std::size_t& scanned);
+	bool				head_buffered(const IoBuffer& buffer, std::size_t& scanned);
 
 }
 
@@ -17,8 +17,17 @@
 #include "Structs.hpp"
 
 namespace http  {
+    void        prebuild_error_responses(Server& srv);
     std::string build_error_response(const Server& srv, int status, const std::string& reason, bool keep_alive);
-    std::string serialize_response(const HTTP_Response& res, const std::string& version);
+    PrebuiltError prebuild_error(int status, const std::string& reason, const std::string& body,
+                                 const std::string& extra_fields, long keep_alive_ms);
+    std::string build_prebuilt_head(const PrebuiltError& e, bool keep_alive);
+    std::string serialize_head(const HTTP_Response& res, const std::string& version, bool keep_alive, long keep_alive_ms);
+    bool        response_wants_close(const HTTP_Response& res);
+    bool        is_hop_by_hop(const std::string& lower_name);
+    void        serialize_request_head(const HTTP_Request& req, const std::string& client_addr,
+                                       const std::string& upstream, std::string& out);
+    void        refresh_date(std::time_t now);
 } // namespace http
 
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   IoBuffer.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef IOBUFFER_HPP
+#define IOBUFFER_HPP
+
+#include "Headers.hpp"
+
+/*
+ Byte buffer with read/write cursors, used for the connection's input.
+ - consume() only moves the read cursor: no memmove per parsed piece
+   (the old std::string::erase(0, n) made pipelining / chunked bodies O(n^2)).
+ - prepare()/commit() let read() land directly in the free tail space.
+ Unread bytes are compacted to the front only when the tail runs out of room.
+*/
+class   IoBuffer    {
+
+    public:
+        static const std::size_t    npos = static_cast<std::size_t>(-1);
+
+        IoBuffer();
+
+        bool            empty() const;
+        std::size_t     size() const;           // unread bytes
+        const char*     data() const;           // first unread byte
+        char            operator[](std::size_t i) const;
+
+        char*           prepare(std::size_t n); // >= n writable bytes at the tail
+        void            commit(std::size_t n);  // n bytes written at prepare()
+        void            append(const char* p, std::size_t n);
+        void            consume(std::size_t n); // drop n bytes from the front
+        void            clear();
+        void            swap(IoBuffer& other);
+
+        std::size_t     find(const char* needle, std::size_t from = 0) const;
+        std::size_t     findCrlf(std::size_t from = 0) const;       // "\r\n", vectorized (ByteScan)
+        std::size_t     findHeadEnd(std::size_t from = 0) const;    // "\r\n\r\n", vectorized (ByteScan)
+        bool            startsWith(const char* prefix) const;
+        std::string     substr(std::size_t pos, std::size_t n) const;
+
+    private:
+        std::vector<char>   _buf;
+        std::size_t         _rpos;
+        std::size_t         _wpos;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "Headers.hpp"
+#include "Structs.hpp"
+
+// Why a connection was closed (housekeeping() timeouts, peer, errors, ...).
+enum CloseReason	{
+	CLOSE_DONE,				// response finished without keep-alive
+	CLOSE_PEER,				// EOF / hangup from the client
+	CLOSE_ERROR,			// socket error or broken response (file shrank)
+	CLOSE_HEADER_TIMEOUT,
+	CLOSE_BODY_TIMEOUT,
+	CLOSE_KA_IDLE,
+	CLOSE_WRITE_TIMEOUT,
+	CLOSE_SHUTDOWN,
+	CLOSE_REASON_COUNT
+};
+
+/*
+ Fixed-bucket latency histogram (microseconds). observe() is a short linear
+ scan and two additions: nothing is formatted until the status page asks.
+*/
+class LatencyHistogram	{
+
+	public:
+		LatencyHistogram();
+
+		void	observe(long long us);
+		void	render(std::ostream& out, const char* name, const char* help) const;
+
+	private:
+		static const int	BUCKETS = 16;
+		static const long	BOUNDS_US[BUCKETS];
+
+		unsigned long	_counts[BUCKETS + 1];	// last slot is +Inf
+		unsigned long	_count;
+		long long		_sumUs;
+};
+
+/*
+ Per-process counters of the event loop (one instance per ServerRunner, so
+ one per worker). Hot-path updates are plain increments; render() produces the
+ Prometheus text exposition served by "stub_status on;" locations.
+*/
+struct Metrics	{
+
+	unsigned long		accepted;
+	unsigned long		acceptErrors;		// accept() failures other than EAGAIN (EMFILE, ENFILE...)
+	unsigned long		acceptBatchCapped;	// readiness events that hit the per-event accept cap
+	unsigned long		listenerPauses;		// times worker_connections was reached
+	unsigned long		shedConnections;	// refused at accept: limit_conn_per_ip
+	unsigned long		shedRequests;		// answered 503: limit_req_per_ip
+	unsigned long		closed[CLOSE_REASON_COUNT];
+	unsigned long long	bytesRead;
+	unsigned long long	bytesWritten;
+	unsigned long		requests;
+	unsigned long		cgiSpawned;
+	unsigned long		cgiTimedOut;
+	unsigned long		proxyConnects;		// new upstream connections ("proxy_pass")
+	unsigned long		proxyReuses;		// requests sent on a pooled keep-alive connection
+	unsigned long		proxyErrors;		// upstream failures answered 502/504 (or a cut stream)
+
+	LatencyHistogram	headerParse;	// extract + parse of one request head
+	LatencyHistogram	handle;			// ::handleRequest()
+	LatencyHistogram	writeOut;		// response queued -> last byte written
+	LatencyHistogram	cgi;			// spawn -> response built
+	LatencyHistogram	upstream;		// proxied request: head parsed -> upstream response complete
+
+	Metrics();
+
+	static long long	nowUs();		// monotonic clock, microseconds
+
+	void	registerLocations(const std::vector<Server>& servers);
+	void	countRequest(const EffectiveConfig* route);
+	void	render(std::ostream& out) const;
+
+	private:
+		struct LocationCounter	{
+			std::string		server;
+			std::string		path;
+			unsigned long	requests;
+		};
+
+		std::map<const EffectiveConfig*, std::size_t>	_locationIndex;
+		std::vector<LocationCounter>			_locations;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Multipart.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MULTIPART_HPP
+#define MULTIPART_HPP
+
+#include "Headers.hpp"
+
+// One file of a multipart/form-data upload, already on disk under a temp name.
+struct MultipartPart {
+    std::string     name;           // form field name
+    std::string     filename;       // client's file name, directory part stripped (not sanitized)
+    std::string     tmpPath;        // "<upload_store>/.upload-XXXXXX"
+    std::size_t     size;
+
+    MultipartPart() : name(), filename(), tmpPath(), size(0) {}
+};
+
+/*
+ Streaming multipart/form-data parser, fed by the body reader as bytes
+ arrive (HttpBody's store_body). Delimiters are found with Boyer-Moore-
+ Horspool on "\r\n--boundary"; file parts go straight to temp files in the
+ upload directory, so memory stays at one read chunk plus a delimiter,
+ whatever the file sizes. Other fields are skipped. The temp files belong to
+ the parser until discard(): the App publishes them with link().
+*/
+class MultipartParser {
+
+    public:
+        MultipartParser();
+
+        static bool     boundaryOf(const std::string& contentType, std::string& boundary);
+
+        void            start(const std::string& boundary, const std::string& directory);  // empty boundary: every feed() fails
+        bool            active() const;
+        int             feed(const char* data, std::size_t len);    // 0, 400 (malformed) or 500 (temp file)
+        bool            complete() const;                           // closing delimiter seen
+        const std::vector<MultipartPart>&   parts() const;
+        void            discard();                                  // close and unlink the temp files, back to inactive
+
+    private:
+        enum State { MP_OFF, MP_BODY, MP_DELIMITER, MP_HEADERS, MP_DONE, MP_ERROR };
+
+        State                       _state;
+        std::string                 _delimiter;         // "\r\n--" + boundary
+        std::size_t                 _shift[256];        // Horspool bad-character table
+        std::string                 _directory;
+        std::string                 _pending;           // bytes not consumed yet (at most a delimiter or a header block)
+        int                         _fd;                // current file part, -1 when skipping
+        std::vector<MultipartPart>  _parts;
+
+        const char*     search(const char* p, const char* end) const;
+        int             openPart(const char* headers, std::size_t len);
+        int             writePart(const char* p, std::size_t n);
+        void            closePart();
+};
+
+#endif
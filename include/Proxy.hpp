@@ -0,0 +1,104 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Proxy.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef PROXY_HPP
+#define PROXY_HPP
+
+#include "Headers.hpp"
+#include "Structs.hpp"
+
+/*
+ HTTP reverse proxy, client side ("proxy_pass host:port [host:port ...];").
+ The request head goes upstream as soon as it is parsed and the body follows
+ as it arrives; the response is read back with the same readers that parse
+ client requests (extract_next_head, the body consumers), just pointed at the
+ upstream socket. Upstream connections are HTTP/1.1 keep-alive and pooled per
+ server; the event loop (ServerRunner) owns the sockets and the balancing.
+*/
+namespace proxy {
+
+    // "host:port" (an "http://" prefix and a trailing '/' are tolerated); false when malformed.
+    bool    parseUpstream(const std::string& spec, std::string& host, std::string& port);
+
+    // Resolved once at startup: the event loop never waits on a name lookup.
+    bool    resolve(const std::string& spec, struct sockaddr_storage& addr, socklen_t& len, std::string& error);
+
+    // Non-blocking TCP connect; -1 on immediate failure.
+    int     connectTcp(const struct sockaddr_storage& addr, socklen_t len, bool& inProgress);
+}
+
+/*
+ One connection to an upstream server. clientFd is the connection whose
+ request it carries, -1 while it sits idle in its server's pool. `exchange`
+ is the upstream side in client mode: its readBuffer takes the response bytes
+ and its request holds the parsed response head and body framing.
+*/
+struct  ProxyBackend    {
+    int             fd;
+    std::string     peer;           // "host:port" of the upstream server
+    int             clientFd;
+    bool            connecting;     // connect() still in progress: nothing written yet
+    bool            reused;         // served a request before (the server may have closed it since)
+    bool            answered;       // response bytes arrived for the current request
+    bool            holdingClient;  // client reads paused until `out` drains (request body backpressure)
+    bool            headParsed;
+    bool            untilClose;     // no Content-Length, not chunked: the body ends with the connection
+    bool            ended;          // response complete
+    int             status;
+    std::string     reason;
+    std::string     out;            // request bytes not yet written
+    std::size_t     outOffset;
+    Connection      exchange;
+
+    ProxyBackend()
+    :   fd(-1), peer(), clientFd(-1), connecting(false), reused(false), answered(false)
+    ,   holdingClient(false), headParsed(false), untilClose(false), ended(false)
+    ,   status(0), reason(), out(), outOffset(0), exchange()
+    {}
+
+    // Ready for the next request on the same connection (buffers keep their capacity).
+    void    reset() {
+        clientFd = -1;
+        answered = false;
+        holdingClient = false;
+        headParsed = false;
+        untilClose = false;
+        ended = false;
+        status = 0;
+        reason.clear();
+        out.clear();
+        outOffset = 0;
+        exchange.readBuffer.clear();
+        exchange.headScanned = 0;
+        exchange.request.reset();
+    }
+};
+
+/*
+ Per-server state: the resolved address and the keep-alive pool. Connections
+ are opened as requests need them; once a response is complete at most
+ `keepalive` of them stay open, idle, for the next requests.
+*/
+struct  ProxyUpstream   {
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;        // 0: the name did not resolve (requests get a 502)
+    std::size_t             open;           // idle ones included
+    std::vector<int>        idle;           // backend fds ready for a request
+    std::size_t             keepalive;      // largest proxy_keepalive of the locations using it
+    long                    downUntilMs;    // connect failed: the balancer skips it until then
+
+    ProxyUpstream()
+    :   addr(), addrLen(0), open(0), idle(), keepalive(0), downUntilMs(0)
+    {}
+};
+
+#endif
@@ -0,0 +1,91 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestHeaders.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef REQUESTHEADERS_HPP
+#define REQUESTHEADERS_HPP
+
+#include "Headers.hpp"
+
+/*
+ Header fields of one request, stored as slices of the raw head.
+ - The head string is moved in once (no per-line substr()); names are
+   lowercased in place and each field is just four offsets.
+ - Well-known names are classified during the parse scan, so the core's
+   lookups (Host, Connection, Content-Length, ...) are an index, not a map find.
+ - The first INLINE_FIELDS fields live inside the object; only unusually large
+   heads spill into a vector.
+ - asMap() builds the classic lowercase-name -> coalesced-value map on demand
+   (CGI environment) and caches it.
+*/
+class   RequestHeaders  {
+
+    public:
+        enum Known {
+            HOST,
+            CONNECTION,
+            CONTENT_LENGTH,
+            TRANSFER_ENCODING,
+            EXPECT,
+            CONTENT_TYPE,
+            ACCEPT_ENCODING,
+            RANGE,
+            IF_RANGE,
+            IF_NONE_MATCH,
+            IF_MODIFIED_SINCE,
+            KNOWN_COUNT,
+            OTHER = KNOWN_COUNT
+        };
+
+        struct Field {
+            unsigned int    nameOff;
+            unsigned int    nameLen;
+            unsigned int    valueOff;
+            unsigned int    valueLen;
+            Known           id;
+        };
+
+        RequestHeaders();
+
+        void            clear();
+        std::string&    raw();                  // the head; fields point into it
+        void            add(const Field& field);
+        void            extendLast(std::size_t valueEnd);   // obs-fold continuation
+
+        std::size_t     count() const;
+        const Field&    field(std::size_t i) const;
+        const Field*    last() const;
+        bool            has(Known id) const;
+        std::size_t     countOf(Known id) const;
+
+        const char*     valueData(const Field& f) const;
+        std::string     name(const Field& f) const;
+        std::string     value(const Field& f) const;
+        std::string     value(Known id) const;  // coalesced with ", ", "" if absent
+
+        const std::map<std::string, std::string>&   asMap() const;
+
+        static Known    classify(const char* lowerName, std::size_t len);
+
+    private:
+        static const std::size_t    INLINE_FIELDS = 32;
+
+        std::string         _raw;
+        Field               _inline[INLINE_FIELDS];
+        std::vector<Field>  _overflow;
+        std::size_t         _count;
+        unsigned int        _knownMask;         // bit per Known seen at least once
+
+        mutable std::map<std::string, std::string>  _map;
+        mutable bool                                _mapBuilt;
+};
+
+#endif
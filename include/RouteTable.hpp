@@ -0,0 +1,120 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RouteTable.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef ROUTETABLE_HPP
+# define ROUTETABLE_HPP
+
+# include "Headers.hpp"
+
+struct Server;
+
+/*
+ Method bits used by the allowed-methods masks (only methods the App serves).
+*/
+enum MethodBit {
+	METHOD_GET		= 1 << 0,
+	METHOD_POST		= 1 << 1,
+	METHOD_DELETE	= 1 << 2,
+	METHOD_HEAD		= 1 << 3
+};
+
+unsigned	methodBit(const std::string& method);		// 0 for methods outside MethodBit
+
+/*
+ Error response serialized once (HttpSerializer): per server for the core's
+ own statuses, per location for the App's (EffectiveConfig::errorResponses).
+ Status line and fixed headers, the keep-alive lines, and the body; only
+ Date and the Connection choice are added when one is sent.
+*/
+struct PrebuiltError	{
+	std::string							reason;
+	std::string							head;			// status line, Server, Content-Length, Content-Type (+ extra fields)
+	std::string							keepAlive;		// "Connection: keep-alive" + "Keep-Alive: timeout=N"
+	std::string							body;
+	std::string							contentLength;	// body size, formatted once
+};
+
+/*
+ Holds the merged Server and Location directives for handling a request.
+ Provides resolved defaults, limits, CGI options, and redirect configuration.
+ Built once per location when the configuration is loaded; it holds no
+ pointers, so it survives copies of the Server that owns its table.
+*/
+struct EffectiveConfig {
+	bool								hasLocation;			// false - server-level fallback
+	std::string							locationPath;			// matched prefix ("" without location)
+	std::string							listenPort;				// port of the first listen directive (CGI SERVER_PORT)
+
+	std::string							root;
+	bool								autoindex;
+	std::vector<std::string>			indexFiles;
+	std::vector<std::string>			allowedMethods;
+	unsigned							allowedMask;			// MethodBit set of allowedMethods
+	std::string							allowHeader;			// "GET, POST" (405 responses)
+	std::map<int, std::string>			errorPages;
+	std::map<int, std::string>			errorBodies;			// errorPages contents, read once at load time
+	std::map<int, PrebuiltError>		errorResponses;			// App error statuses (404, 405...), see prebuildErrorResponses()
+
+	std::size_t							clientMaxBodySize;		// 0 - no limit
+	std::string							uploadStore;
+	std::map<std::string, std::string>	cgiPass;
+	std::size_t							cgiTimeout;
+	std::vector<std::string>			cgiAllowedMethods;
+	unsigned							cgiAllowedMask;
+	bool								cgiStreaming;			// "cgi_streaming on;" - forward CGI output while it runs
+	std::map<std::string, std::string>	fastcgiPass;			// extension -> FastCGI application socket path
+	std::size_t							fastcgiPoolSize;		// connections per socket (per worker)
+	std::size_t							fastcgiQueueSize;		// requests waiting for one of them
+	std::vector<std::string>			proxyPass;				// "proxy_pass host:port ...;" - upstream servers ("host:port")
+	bool								proxyLeastConn;			// "proxy_balance least_conn;" (default round_robin)
+	std::size_t							proxyKeepalive;			// idle upstream connections kept per server (per worker)
+	std::size_t							proxyTimeout;			// seconds without upstream I/O before a 504
+
+	int									redirectStatus;			// 0 - no redirect
+	std::string							redirectTarget;
+
+	bool								stubStatus;				// "stub_status on;" - answered by the core (metrics)
+
+	bool								gzip;					// "gzip on;" - compress eligible bodies on the fly
+	bool								gzipStatic;				// "gzip_static on;" - serve "<file>.gz" when present
+	std::vector<std::string>			gzipTypes;				// MIME types to compress (text/html always included)
+	std::size_t							gzipMinLength;			// smaller bodies go out as they are
+	int									gzipCompLevel;			// zlib level 1..9
+
+	EffectiveConfig();
+};
+
+/*
+ Frozen per-server routing: one EffectiveConfig per location, sorted by
+ descending prefix length, so the first boundary match is the longest prefix.
+ match() only compares strings; nothing is parsed or allocated per request.
+*/
+class RouteTable {
+
+	public:
+		RouteTable();
+
+		void					compile(const Server& srv);		// throws std::runtime_error on bad directive values
+
+		const EffectiveConfig&	match(const std::string& path) const;
+		const EffectiveConfig&	fallback() const;				// no location matched
+		EffectiveConfig&		fallback();
+		std::size_t				size() const;
+		const EffectiveConfig&	at(std::size_t i) const;
+		EffectiveConfig&		at(std::size_t i);				// load time only (prebuilt error responses)
+
+	private:
+		std::vector<EffectiveConfig>	_routes;
+		EffectiveConfig					_fallback;
+};
+
+#endif
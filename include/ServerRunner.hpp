@@ -15,36 +15,128 @@
 
 #include "Headers.hpp"
 #include "Structs.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "ConnectionTable.hpp"
+#include "FastCgi.hpp"
+#include "Proxy.hpp"
+#include "AccessLog.hpp"
 
 class   ServerRunner  {
     
     public:
-        ServerRunner(const std::vector<Server>& servers);
+        ServerRunner(const std::vector<Server>& servers, bool reusePort = false,
+                     const GlobalSettings& globals = GlobalSettings());
 
-        void    run();
+        bool    run();          // false if nothing could be served (no listener / event loop)
+
+        static void installStopHandlers();  // SIGTERM/SIGINT -> graceful drain, then run() returns
 
     private:
+        struct TimerEntry {
+            long    deadlineMs;
+            int     fd;
+        };
+
         std::vector<Server>         _servers;
         std::vector<Listener>       _listeners;
-        std::vector<struct pollfd> 	_fds;
-        std::map<int, std::size_t>  _fdIndex;
-        std::map<int, Connection>   _connections;
+        EventLoop                       _loop;
+        std::vector<ReadyEvent>         _ready;
+        std::map<int, const Listener*>  _listenerByFd;
+        ConnectionTable                 _connections;   // client fd -> recycled Connection slot
+        std::map<int, int>              _cgiPipeOwner;  // CGI pipe fd -> client fd
+        std::map<pid_t, int>            _cgiPidOwner;   // CGI pid -> client fd
+        int                             _sigchldPipe[2];
+        std::map<int, FastCgiBackend>           _fcgiBackends;  // FastCGI socket fd -> backend connection
+        std::map<std::string, FastCgiUpstream>  _fcgiUpstreams; // application socket path -> pool
+        std::map<int, ProxyBackend>             _proxyBackends;     // upstream socket fd -> connection to an HTTP server
+        std::map<std::string, ProxyUpstream>    _proxyUpstreams;    // "host:port" -> address and keep-alive pool
+        std::map<const EffectiveConfig*, std::size_t>   _proxyCursor;   // round-robin position per proxied location
 
         long                        _nowMs;
+        std::time_t                 _wallSec;       // wall clock of this iteration (log timestamps)
+        bool                        _reusePort;     // one listen socket per worker (SO_REUSEPORT)
+        bool                        _stopping;
+        long                        _stopDeadlineMs;
+        Metrics                     _metrics;
+        AdmissionLimits             _limits;
+        ClientLimiter               _limiter;       // per-IP connections and request buckets
+        bool                        _listenersPaused;   // at worker_connections: not accepting
+        long                        _lastSweepMs;
+        AccessLogSettings           _accessLogSettings;
+        AccessLog                   _accessLog;
+        std::vector<TimerEntry>     _timers;        // min-heap on deadlineMs (lazily re-armed)
 
         void    housekeeping();
-        void    setupPollFds();
+        void    armTimer(Connection& connection);
+        long    connectionDeadline(const Connection& connection, CloseReason& reason) const;
+        int     nextWaitMs() const;
+        void    beginShutdown();
+        void    registerListeners();
+        void    setInterest(int fd, int events);
+        void    logAccess(Connection& connection);
+        void    pauseListeners(bool pause);
+        void    shedConnection(int clientFd, const Listener& listener);
+        bool    shedRequest(Connection& connection);
         void    handleEvents(); 
-        void    acceptNewClient(int listenFd, const Server* srv);
+        void    acceptNewClient(int listenFd, const Listener& listener);
         void    readFromClient(int clientFd);
+        void    processInput(int clientFd);
+        void    parseRequests(Connection& connection);
+        bool    pipelineNext(Connection& connection);
         void    writeToClient(int clientFd);
-        void    closeConnection(int clientFd);
+        void    closeConnection(int clientFd, CloseReason reason = CLOSE_DONE);
         void    dispatchRequest(Connection& connection);
+        void    queueResponse(Connection& connection, HTTP_Response& appRes);
+        void    openBodySpill(Connection& connection);
+        void    queueStatusPage(Connection& connection);
+
+        // Asynchronous CGI
+        void    openSigchldPipe();
+        void    startCgi(Connection& connection, const HTTP_Response& appRes);
+        void    handleCgiEvent(int pipeFd, int events);
+        void    pumpCgiStdin(Connection& connection);
+        void    drainCgiStdout(Connection& connection, int events);
+        void    closeCgiPipe(int& fd);
+        void    finishCgiIfDone(Connection& connection);
+        void    forwardCgiOutput(Connection& connection);
+        void    pauseCgiOutput(Connection& connection, bool pause);
+        void    abortCgi(Connection& connection);
+        void    reapCgiChildren();
+
+        // FastCGI backends ("fastcgi_pass")
+        void    startFastCgi(Connection& connection);
+        bool    assignFastCgiBackend(Connection& connection, FastCgiUpstream& upstream);
+        void    handleFastCgiEvent(int backendFd, int events);
+        void    writeFastCgi(FastCgiBackend& backend, Connection& connection);
+        void    readFastCgi(FastCgiBackend& backend, Connection& connection, int events);
+        void    failFastCgi(int backendFd, Connection& connection);
+        void    releaseFastCgiBackend(int backendFd, bool keep);
+        void    closeFastCgiBackend(int backendFd);
+        void    serveFastCgiQueue(const std::string& socketPath);
+
+        // Reverse proxy ("proxy_pass")
+        void    resolveProxyUpstreams();
+        void    startProxy(Connection& connection);
+        bool    connectProxy(Connection& connection, const std::string& pending);
+        std::string pickProxyUpstream(const EffectiveConfig& route);
+        bool    assignProxyBackend(Connection& connection, const std::string& peer, const std::string& pending);
+        void    forwardProxyBody(Connection& connection, bool complete);
+        void    handleProxyEvent(int backendFd, int events);
+        void    writeProxy(ProxyBackend& backend, Connection& connection);
+        void    readProxy(ProxyBackend& backend, Connection& connection, int events);
+        bool    decodeProxyResponse(ProxyBackend& backend, Connection& connection, bool eof);
+        void    buildProxyHead(const ProxyBackend& backend, const Connection& connection, HTTP_Response& res, bool streamed);
+        bool    startProxyStream(Connection& connection, HTTP_Response& head);
+        void    failProxy(int backendFd, Connection& connection);
+        void    finishProxy(Connection& connection);
+        void    releaseProxyBackend(int backendFd, bool keep);
+        void    closeProxyBackend(int backendFd);
 };
 
 // Listeners
 bool    makeNonBlocking(int fd);
-int     openAndListen(const std::string& spec);
-void    setupListeners(const std::vector<Server>& servers, std::vector<Listener>& outListeners);
+int     openAndListen(const std::string& spec, bool reusePort = false, const ListenOptions& options = ListenOptions());
+void    setupListeners(const std::vector<Server>& servers, std::vector<Listener>& outListeners, bool reusePort = false);
 
 #endif
\ No newline at end of file
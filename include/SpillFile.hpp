@@ -0,0 +1,33 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SpillFile.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef SPILLFILE_HPP
+#define SPILLFILE_HPP
+
+#include "Headers.hpp"
+
+/*
+ Request bodies written to disk as they arrive: simple uploads (the core's
+ body spill) and the files of a multipart/form-data upload.
+*/
+namespace spill {
+
+    // New "<directory>/.upload-XXXXXX", close-on-exec, with the permissions a
+    // plain open() would give. -1 when it can't be created; path gets its name.
+    int     create(const std::string& directory, std::string& path);
+
+    // All of data, or false. Regular files don't return EAGAIN, so a short
+    // write loop is enough.
+    bool    writeAll(int fd, const char* data, std::size_t len);
+}
+
+#endif
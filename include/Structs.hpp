@@ -13,6 +13,13 @@
 #ifndef STRUCTS_HPP
 #define STRUCTS_HPP
 
+#include "IoBuffer.hpp"
+#include "RouteTable.hpp"
+#include "RequestHeaders.hpp"
+#include "VirtualHosts.hpp"
+#include "Multipart.hpp"
+#include "ClientLimiter.hpp"
+
 // ----------------- Core config types -----------------
 
 struct  Location    {
@@ -20,12 +27,84 @@ struct  Location    {
     std::string                         path;
 };
 
+// Per-server connection timeouts, in ms (nginx-style directives in server{}).
+struct ServerTimeouts   {
+    long                                headerMs;       // "client_header_timeout": request head must arrive within
+    long                                bodyMs;         // "client_body_timeout": max gap between body reads
+    long                                keepAliveMs;    // "keepalive_timeout": idle keep-alive connection (0 = no keep-alive)
+    long                                sendMs;         // "send_timeout": max gap between response writes
+
+    ServerTimeouts()
+    :   headerMs(15000)
+    ,   bodyMs(30000)
+    ,   keepAliveMs(5000)
+    ,   sendMs(30000)
+    {}
+};
+
+// Socket options of one "listen" address ("listen 8080 backlog=1024 deferred;").
+// Applied to the listening socket by openAndListen(); accepted sockets inherit
+// the TCP/SO_* ones from it.
+struct ListenOptions    {
+    bool                                defaultServer;  // "default_server": answers unknown Host names
+    int                                 backlog;        // "backlog=N": accept queue length given to listen()
+    int                                 deferAccept;    // "deferred[=secs]": wake up only once data arrived (0 = off)
+    int                                 fastOpen;       // "fastopen=N": TCP Fast Open queue length (0 = off)
+    bool                                noDelay;        // "nodelay" / "nodelay=off": TCP_NODELAY on clients
+    int                                 sndBuf;         // "sndbuf=SIZE": SO_SNDBUF (0 = kernel default)
+    int                                 rcvBuf;         // "rcvbuf=SIZE": SO_RCVBUF (0 = kernel default)
+
+    ListenOptions()
+    :   defaultServer(false)
+    ,   backlog(SOMAXCONN)
+    ,   deferAccept(0)
+    ,   fastOpen(0)
+    ,   noDelay(true)
+    ,   sndBuf(0)
+    ,   rcvBuf(0)
+    {}
+};
+
 struct Server   {
     std::vector<std::string>            listen;
     std::vector<std::string>            server_name;
+    std::map<std::string, ListenOptions>    listen_options; // per listen spec (missing = defaults)
     std::vector<Location>               locations;
     std::map<std::string, std::string>  directives;
     std::map<std::string, std::string>  error_pages;
+    RouteTable                          routes;     // compiled once by Config (locations merged with server directives)
+    ServerTimeouts                      timeouts;
+    std::map<int, PrebuiltError>        error_responses;    // core-generated errors (400, 413, 431...), built by Config
+};
+
+// "access_log <path> [buffer=SIZE] [flush=TIME] [sample=N];" (main context).
+struct AccessLogSettings    {
+    std::string                         path;           // empty = off
+    std::size_t                         bufferBytes;    // in-memory ring, written out in one batch
+    long                                flushMs;        // longest a line waits in the ring
+    std::size_t                         sample;         // log 1 request in N (errors always)
+
+    AccessLogSettings()
+    :   path()
+    ,   bufferBytes(64 * 1024)
+    ,   flushMs(1000)
+    ,   sample(1)
+    {}
+};
+
+// Top-level (main context) settings, outside any server block.
+struct GlobalSettings   {
+    std::size_t                         workerProcesses;    // "worker_processes N|auto;"
+    std::size_t                         openFileCacheBytes; // "open_file_cache <size>;" (0 = off)
+    std::size_t                         openFileCacheValid; // "open_file_cache_valid <seconds>;"
+    AdmissionLimits                     admission;          // "worker_connections", "limit_conn_per_ip", "limit_req_per_ip"
+    AccessLogSettings                   accessLog;          // "access_log"
+
+    GlobalSettings()
+    :   workerProcesses(1)
+    ,   openFileCacheBytes(0)
+    ,   openFileCacheValid(1)
+    {}
 };
 
 // ----------------- HTTP core types -----------------
@@ -34,6 +113,7 @@ enum ConnectionState	{
 	S_HEADERS,
 	S_BODY,
 	S_DRAIN,   // NOVO: drenar body antes de enviar resposta early
+	S_CGI,     // waiting on a CGI child; its pipes live in the event loop
 	S_WRITE,
 	S_CLOSED
 };	// Per-connection state for the HTTP parser
@@ -63,12 +143,15 @@ struct HTTP_Request	{
 	std::string							host;
 	std::string							transfer_encoding;
 	std::string							body;
-	std::map<std::string, std::string>	headers;
+	RequestHeaders						headers;		// slices of the raw head (asMap() for the full set)
 	std::size_t							content_length;
 	std::size_t							body_received;
 	std::size_t							chunk_bytes_left;
 	BodyReaderState						body_reader_state;
 	ChunkState							chunk_state;
+	int									body_file_fd;	// upload spill: body goes to this temp file...
+	std::string							body_file_path;	// ...instead of `body` (core owns and removes it)
+	MultipartParser						multipart;		// multipart/form-data upload: file parts go to upload_store
 
 	HTTP_Request()
 	:	keep_alive(true)
@@ -87,6 +170,108 @@ struct HTTP_Request	{
 	,	chunk_bytes_left(0)
 	,	body_reader_state(BR_NONE)
 	,	chunk_state(CS_SIZE)
+	,	body_file_fd(-1)
+	,	body_file_path()
+	,	multipart()
+	{}
+
+	// Back to a fresh request in place, for the next keep-alive request: the
+	// strings and header storage keep their capacity instead of being freed and
+	// reallocated (a large buffered body is still released).
+	void	reset()	{
+		const std::size_t	KEEP_BODY_CAPACITY = 64 * 1024;
+
+		keep_alive = true;
+		expectContinue = false;
+		method.clear();
+		target.clear();
+		path.clear();
+		query.clear();
+		version.clear();
+		host.clear();
+		transfer_encoding.clear();
+		if (body.capacity() > KEEP_BODY_CAPACITY)
+			std::string().swap(body);
+		else
+			body.clear();
+		headers.clear();
+		content_length = 0;
+		body_received = 0;
+		chunk_bytes_left = 0;
+		body_reader_state = BR_NONE;
+		chunk_state = CS_SIZE;
+		body_file_fd = -1;
+		body_file_path.clear();
+		multipart.discard();
+	}
+};
+
+/*
+ A running CGI child. Started by the App, then driven by the core event loop:
+ the body is pumped into stdinFd, output collected from stdoutFd, and the
+ child reaped on SIGCHLD before the App turns the output into a response.
+ With fastcgiSocket set there is no child: the core sends params and body to
+ a pooled FastCGI backend and collects its STDOUT into output instead.
+ With proxyPeer set ("proxy_pass") the request went to an upstream HTTP
+ server: output collects its decoded response body, exitStatus its status.
+ Streaming ("cgi_streaming on;"): as soon as the header block is in, the head
+ is sent and output only holds body bytes not yet moved to the client.
+*/
+struct CgiProcess	{
+	pid_t			pid;
+	int				stdinFd;		// parent writes the request body here (-1 once closed)
+	int				stdoutFd;		// parent reads the CGI output here (-1 once EOF)
+	std::size_t		stdinWritten;
+	std::string		output;			// everything read from the child's STDOUT
+	std::string		scriptPath;		// filesystem path of the script (403/404 mapping on failure)
+	long			timeoutMs;		// inactivity timeout
+	long			lastIoMs;
+	long long		startedUs;		// spawn time (metrics)
+	bool			exited;
+	bool			timedOut;
+	int				exitStatus;		// exit code (128 + signal), -1 until reaped
+	std::string					fastcgiSocket;	// "fastcgi_pass": application socket, empty for fork/exec CGI
+	std::vector<std::string>	params;			// FastCGI PARAMS ("NAME=VALUE")
+	std::size_t		poolSize;		// fastcgi_pool_size / fastcgi_queue_size of the location
+	std::size_t		queueSize;
+	int				backendFd;		// FastCGI connection carrying the request, -1 while queued
+	bool			rejected;		// FastCGI wait queue full (503)
+	std::string		proxyPeer;		// "proxy_pass": upstream server ("host:port") of the request
+	std::size_t		proxyTries;		// upstream connections tried for it (failover, stale keep-alive)
+	bool			streamEnabled;	// cgi_streaming of the location
+	bool			streaming;		// head sent, body forwarded as it arrives
+	bool			streamChunked;	// no Content-Length from the script: chunked framing
+	long long		streamRemaining;	// Content-Length framing: body bytes still expected
+	bool			streamFinished;	// output complete, last chunk queued
+	bool			outputPaused;	// backpressure: not reading while the client is behind
+
+	CgiProcess()
+	:	pid(-1)
+	,	stdinFd(-1)
+	,	stdoutFd(-1)
+	,	stdinWritten(0)
+	,	output()
+	,	scriptPath()
+	,	timeoutMs(0)
+	,	lastIoMs(0)
+	,	startedUs(0)
+	,	exited(false)
+	,	timedOut(false)
+	,	exitStatus(-1)
+	,	fastcgiSocket()
+	,	params()
+	,	poolSize(0)
+	,	queueSize(0)
+	,	backendFd(-1)
+	,	rejected(false)
+	,	proxyPeer()
+	,	proxyTries(0)
+	,	streamEnabled(false)
+	,	streaming(false)
+	,	streamChunked(false)
+	,	streamRemaining(0)
+	,	streamFinished(false)
+	,	outputPaused(false)
 	{}
 };
 
@@ -96,6 +281,14 @@ struct HTTP_Response	{
 	std::string							reason;
 	std::string							body;
 	std::map<std::string, std::string>	headers;
+	std::string							headerLines;	// "Name: value\r\n" lines sent as they are (repeatable fields: Set-Cookie)
+	int									fileFd;		// file-backed body (sent with sendfile) when >= 0; body stays empty
+	off_t								fileOffset;
+	std::size_t							fileLength;
+	bool								cgiPending;	// CGI spawned: the core finishes it asynchronously
+	CgiProcess							cgi;
+	bool								encoded;	// coding already negotiated (cached gzip variant, gzip_static)
+	const PrebuiltError*				prebuilt;	// App error from its location's template: the core splices that head
 
 	HTTP_Response()
 	:	status(200)
@@ -103,6 +296,14 @@ struct HTTP_Response	{
 	,	reason("OK")
 	,	body()
 	,	headers()
+	,	headerLines()
+	,	fileFd(-1)
+	,	fileOffset(0)
+	,	fileLength(0)
+	,	cgiPending(false)
+	,	cgi()
+	,	encoded(false)
+	,	prebuilt(NULL)
 	{}
 };
 
@@ -110,24 +311,43 @@ struct HTTP_Response	{
 
 struct  Listener    {
     int             fd;
-    const Server*   config;
+    const Server*   config;     // first server{} that opened the socket
+    std::string     spec;       // "host:port" as opened (metrics label)
+    ListenOptions   options;    // as applied by the server{} that opened it
+    VirtualHosts    vhosts;     // every server{} sharing it, selected by Host
 };
 
 struct Connection   {
     int             fd;
     int             listenFd;
-    const Server*   srv;
-    std::string     readBuffer;
-    std::string     writeBuffer;
+    uint64_t        clientKey;	// ClientLimiter key of the peer address (0 = not limited)
+    const VirtualHosts*	vhosts;	// servers of the listening socket (Host selection)
+    const Server*   srv;		// default server until the request head names its host
+    const EffectiveConfig*	route;	// longest-prefix match for the current request
+    IoBuffer        readBuffer;
+    std::string     writeBuffer;	// response head (or a complete prebuilt response)
+    std::string     writeBody;		// in-memory response body, sent after writeBuffer
+    std::string     pipelined;		// responses to earlier pipelined requests, sent before writeBuffer
+    std::size_t     pipelinedOffset;
     bool            headersComplete;
+    std::size_t     headScanned;	// readBuffer bytes already searched for the end of the head
 	bool			sentContinue;
 	ConnectionState	state;
 	HTTP_Request	request;
-	HTTP_Response	response;
+	CgiProcess		cgi;			// active when state == S_CGI
 	std::size_t		writeOffset;
+	int				bodyFd;			// file-backed response body, streamed after writeBuffer
+	off_t			bodyOffset;
+	std::size_t		bodyRemaining;
 	std::size_t		clientMaxBodySize;
 	long			kaIdleStartMs;
 	long			lastActiveMs;
+	long long		writeStartUs;	// response queued (metrics), 0 when not timed
+	long long		requestStartUs;	// head parsed (access log), 0 when no request is being answered
+	long long		upstreamUs;		// CGI / FastCGI time of the current request
+	int				logStatus;		// status of the response being written, 0 until known
+	unsigned long long	logBytes;	// bytes of it written so far
+	long			timerDeadlineMs;	// deadline of the armed timer-heap entry, 0 when none
 
 	bool            draining;        // estamos a drenar body?
 	std::size_t     drainedBytes;    // quantos bytes já drenámos (para limite/diagnóstico)
@@ -137,18 +357,34 @@ struct Connection   {
 	Connection()
 	:	fd(-1)
 	,	listenFd(-1)
+	,	clientKey(0)
+	,	vhosts(NULL)
 	,	srv(NULL)
+	,	route(NULL)
 	,	readBuffer()
 	,	writeBuffer()
+	,	writeBody()
+	,	pipelined()
+	,	pipelinedOffset(0)
 	,	headersComplete(false)
+	,	headScanned(0)
 	,	sentContinue(false)
 	,	state(S_HEADERS)
 	,	request()
-	,	response()
+	,	cgi()
 	,	writeOffset(0)
+	,	bodyFd(-1)
+	,	bodyOffset(0)
+	,	bodyRemaining(0)
 	,	clientMaxBodySize(std::numeric_limits<size_t>::max())	// default: unlimited unless configured
 	,	kaIdleStartMs()
 	,	lastActiveMs()
+	,	writeStartUs(0)
+	,	requestStartUs(0)
+	,	upstreamUs(0)
+	,	logStatus(0)
+	,	logBytes(0)
+	,	timerDeadlineMs(0)
 	,	draining(false)			// <-- NOVO
 	,	drainedBytes(0)			// <-- NOVO
 	,	peerClosedRead(false)        // <-- NOVO
@@ -0,0 +1,59 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHosts.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef VIRTUALHOSTS_HPP
+# define VIRTUALHOSTS_HPP
+
+# include "Headers.hpp"
+
+struct Server;
+
+/*
+ Host header -> server{} for one listening socket. Exact server_names live in
+ a hash table built once at startup; "*.example.com" and "www.example.*" live
+ in two sorted tables probed longest-first with binary search (".example.com"
+ is both an exact name and "*.example.com"). Anything else goes to the
+ default server: the one marked "listen ... default_server;", else the first
+ server{} on that address.
+*/
+class VirtualHosts {
+
+	public:
+		VirtualHosts();
+
+		void			add(const Server* srv, bool isDefault);	// registers srv's server_names (before build())
+		void			build();								// sizes and fills the hash table
+
+		const Server*	select(const std::string& host) const;	// Host header value: port, case, final dot ignored
+		const Server*	defaultServer() const;
+
+	private:
+		struct Entry {
+			std::string		name;
+			const Server*	srv;
+		};
+
+		std::vector<Entry>					_names;			// exact names, in configuration order
+		std::vector<std::vector<Entry> >	_buckets;		// power-of-two hash table over _names
+		std::vector<Entry>					_leading;		// "*.example.com" as ".example.com", sorted
+		std::vector<Entry>					_trailing;		// "www.example.*" as "www.example.", sorted
+		const Server*						_default;
+		bool								_explicitDefault;
+
+		const Server*	findExact(const std::string& name) const;
+		static void		insertSorted(std::vector<Entry>& table, const Entry& entry);
+		static const Server*	findSorted(const std::vector<Entry>& table, const std::string& key);
+};
+
+std::string	normalizeHostName(const std::string& host);	// lowercase, no ":port", no trailing '.'
+
+#endif
@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   WorkerMaster.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef WORKERMASTER_HPP
+#define WORKERMASTER_HPP
+
+#include "Headers.hpp"
+#include "Structs.hpp"
+
+/*
+ Master process for "worker_processes N;" (N > 1). Forks N workers, each
+ running its own ServerRunner event loop on SO_REUSEPORT listeners, respawns
+ the ones that die and forwards SIGTERM/SIGINT so they drain gracefully.
+*/
+class   WorkerMaster  {
+
+    public:
+        WorkerMaster(const std::vector<Server>& servers, std::size_t workerCount,
+                     const GlobalSettings& globals = GlobalSettings());
+
+        int     run();      // master exit status (workers never return from here)
+
+    private:
+        const std::vector<Server>&  _servers;
+        std::size_t                 _workerCount;
+        GlobalSettings              _globals;       // limits and access log, applied by every worker on its own
+        std::vector<pid_t>          _workers;       // slot -> pid, -1 while not running
+        std::vector<std::time_t>    _spawnedAt;     // slot -> last fork time (respawn throttle)
+        int                         _wakePipe[2];   // SIGCHLD/SIGTERM self-pipe
+
+        bool    spawnWorker(std::size_t slot);
+        void    runWorker();
+        bool    reapWorkers();
+        void    stopWorkers();
+        void    waitForWake(int timeoutMs);
+};
+
+#endif
@@ -0,0 +1,225 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AccessLog.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/AccessLog.hpp"
+
+static void	appendUnsigned(std::string& out, unsigned long long n)	{
+	char	digits[24];
+	int		len = 0;
+	do	{
+		digits[len++] = static_cast<char>('0' + n % 10);
+		n /= 10;
+	}	while (n != 0);
+	while (len > 0)
+		out += digits[--len];
+}
+
+// Microseconds as seconds with millisecond precision ("0.004"), like nginx's $request_time.
+static void	appendSeconds(std::string& out, long long us)	{
+	if (us < 0)
+		us = 0;
+	const unsigned long long	ms = static_cast<unsigned long long>(us) / 1000ULL;
+	appendUnsigned(out, ms / 1000ULL);
+	out += '.';
+	const unsigned long long	frac = ms % 1000ULL;
+	out += static_cast<char>('0' + frac / 100);
+	out += static_cast<char>('0' + frac / 10 % 10);
+	out += static_cast<char>('0' + frac % 10);
+}
+
+// Client bytes go into a quoted field: quotes, backslashes and anything not
+// printable ASCII as \xHH, so a line can't be split or forged.
+static void	appendEscaped(std::string& out, const std::string& s)	{
+	static const char	HEX[] = "0123456789ABCDEF";
+	for (std::size_t i = 0; i < s.size(); ++i)	{
+		const unsigned char	c = static_cast<unsigned char>(s[i]);
+		if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\')	{
+			out += "\\x";
+			out += HEX[c >> 4];
+			out += HEX[c & 0x0f];
+		}
+		else
+			out += static_cast<char>(c);
+	}
+}
+
+AccessLog::AccessLog()
+	:	_settings(), _fd(-1), _head(0), _used(0), _oldestMs(0), _stampSecond(static_cast<std::time_t>(-1)),
+		_sampleCount(0), _lines(0), _dropped(0), _flushes(0)
+{
+	_stamp[0] = '\0';
+}
+
+AccessLog::~AccessLog()	{
+	if (_fd >= 0)	{
+		flush(0);
+		close(_fd);
+	}
+}
+
+bool	AccessLog::open(const AccessLogSettings& settings)	{
+
+	_settings = settings;
+	if (_settings.path.empty())
+		return true;
+	_fd = ::open(_settings.path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);	// O_APPEND: workers share the file
+	if (_fd < 0)
+		return false;
+	fcntl(_fd, F_SETFD, FD_CLOEXEC);	// not inherited by CGI children
+	if (_settings.sample == 0)
+		_settings.sample = 1;
+	_ring.assign(_settings.bufferBytes, '\0');
+	_line.reserve(1024);
+	return true;
+}
+
+bool	AccessLog::enabled() const	{
+	return _fd >= 0;
+}
+
+void	AccessLog::record(const Connection& connection, long long nowUs, std::time_t wallSec, long nowMs)	{
+
+	if (_fd < 0)
+		return;
+
+	const int	status = connection.logStatus;
+	if (status < 400 && _settings.sample > 1 && _sampleCount++ % _settings.sample != 0)
+		return;		// sampled out (errors are always kept)
+
+	if (wallSec != _stampSecond)	{
+		std::tm	tm_utc;
+		gmtime_r(&wallSec, &tm_utc);
+		std::strftime(_stamp, sizeof(_stamp), "[%d/%b/%Y:%H:%M:%S +0000]", &tm_utc);
+		_stampSecond = wallSec;
+	}
+
+	// Clients come in on IPv4 listeners: the ClientLimiter key holds the address.
+	_line.clear();
+	const uint64_t	key = connection.clientKey;
+	if ((key >> 32) == 1)	{
+		const unsigned long	a = static_cast<unsigned long>(key & 0xffffffffUL);
+		appendUnsigned(_line, a >> 24);
+		_line += '.';
+		appendUnsigned(_line, (a >> 16) & 0xff);
+		_line += '.';
+		appendUnsigned(_line, (a >> 8) & 0xff);
+		_line += '.';
+		appendUnsigned(_line, a & 0xff);
+	}
+	else
+		_line += '-';
+	_line += " - - ";
+	_line += _stamp;
+
+	const HTTP_Request&	request = connection.request;
+	_line += " \"";
+	appendEscaped(_line, request.method);
+	_line += ' ';
+	appendEscaped(_line, request.target);
+	_line += ' ';
+	appendEscaped(_line, request.version);
+	_line += "\" ";
+	appendUnsigned(_line, static_cast<unsigned long long>(status));
+	_line += ' ';
+	appendUnsigned(_line, connection.logBytes);
+	_line += " rt=";
+	appendSeconds(_line, nowUs - connection.requestStartUs);
+	_line += " ut=";
+	if (connection.upstreamUs > 0)
+		appendSeconds(_line, connection.upstreamUs);
+	else
+		_line += '-';
+	_line += " \"";
+	appendEscaped(_line, request.host);
+	_line += "\"\n";
+
+	append(_line, nowMs);
+}
+
+// Copy into the ring; when it doesn't fit, write the batch out now (one write
+// for half a ring at least) and drop the line only if that didn't make room.
+void	AccessLog::append(const std::string& line, long nowMs)	{
+
+	const std::size_t	capacity = _ring.size();
+	if (_used + line.size() > capacity)
+		flush(nowMs);
+	if (_used + line.size() > capacity)	{
+		++_dropped;
+		return;
+	}
+
+	if (_used == 0)
+		_oldestMs = nowMs;
+	std::size_t	tail = (_head + _used) % capacity;
+	std::size_t	first = capacity - tail;
+	if (first > line.size())
+		first = line.size();
+	std::memcpy(&_ring[tail], line.data(), first);
+	std::memcpy(&_ring[0], line.data() + first, line.size() - first);
+	_used += line.size();
+	++_lines;
+}
+
+bool	AccessLog::flushDue(long nowMs) const	{
+	return _used > 0 && (_used * 2 >= _ring.size() || nowMs - _oldestMs >= _settings.flushMs);
+}
+
+long	AccessLog::nextFlushMs(long nowMs) const	{
+	if (_used == 0)
+		return -1;
+	long	wait = _oldestMs + _settings.flushMs - nowMs;
+	return wait > 0 ? wait : 0;
+}
+
+// Whatever the file accepts leaves the ring; the rest waits for the next call
+// (a short or failed write is not retried in a loop).
+void	AccessLog::flush(long nowMs)	{
+
+	if (_fd < 0 || _used == 0)
+		return;
+
+	const std::size_t	capacity = _ring.size();
+	struct iovec		iov[2];
+	int					count = 1;
+	std::size_t			first = capacity - _head;
+	if (first > _used)
+		first = _used;
+	iov[0].iov_base = &_ring[_head];
+	iov[0].iov_len = first;
+	if (_used > first)	{
+		iov[1].iov_base = &_ring[0];
+		iov[1].iov_len = _used - first;
+		count = 2;
+	}
+
+	ssize_t	n = writev(_fd, iov, count);
+	++_flushes;
+	if (n <= 0)
+		return;
+	_head = (_head + static_cast<std::size_t>(n)) % capacity;
+	_used -= static_cast<std::size_t>(n);
+	_oldestMs = nowMs;
+	if (_used == 0)
+		_head = 0;
+}
+
+unsigned long	AccessLog::lines() const	{
+	return _lines;
+}
+
+unsigned long	AccessLog::dropped() const	{
+	return _dropped;
+}
+
+unsigned long	AccessLog::flushes() const	{
+	return _flushes;
+}
@@ -19,7 +19,7 @@
 	Responsibilities:
 		- Parse and normalise the request target (path + query)
 		- Select the Server block and its matching Location
-		- Build the EffectiveConfig merging server/location directives
+		- Use the EffectiveConfig precompiled for that location (RouteTable)
 		- Apply redirects, method validation and body constraints
 		- Map logical paths to the filesystem and enforce anti-traversal rules
 		- Classify the request (static file, directory, CGI, upload, etc.)
@@ -40,6 +40,10 @@
 	------------------------------------------------------------------------- */
 
 #include "App.hpp"
+#include "FileCache.hpp"
+#include "Compression.hpp"
+#include "SpillFile.hpp"
+#include "HttpSerializer.hpp"
 
 namespace {
 
@@ -104,356 +108,15 @@ namespace {
 	}
 
 
-	// ----------------------------------------------
-	// --- 2. Location selection (longest prefix) ---
-	// ----------------------------------------------
+	// -------------------------------------------------------------
+	// --- 2./3. Location selection + effective config (RouteTable) ---
+	// -------------------------------------------------------------
 
 	/*
-	 Performs longest-prefix matching to find the best location for the request path.
-	 A location matches only if the prefix boundary is valid. Returns NULL if none match.
+	 Both are precompiled per server when the configuration is loaded
+	 (Server::routes, see RouteTable.cpp): handleRequest() only picks the
+	 longest matching prefix and reads the resolved EffectiveConfig.
 	*/
-	const Location* matchLocation(const Server& server, const std::string& requestPath) {
-
-		const Location*	bestMatchLocation = NULL;
-		
-		for (std::vector<Location>::const_iterator it = server.locations.begin(); it != server.locations.end(); ++ it) {
-
-			const std::string& locationPath = it->path;
-			bool match = (requestPath.compare(0, locationPath.size(), locationPath) == 0);										// Is locationPath a prefix of requestPath?
-			bool boundary = (requestPath.size() == locationPath.size() ||														// '/ap' cannot match '/api'.
-							(requestPath.size() > locationPath.size() && requestPath[locationPath.size()] == '/'));
-
-			if (match && boundary && (bestMatchLocation == NULL || bestMatchLocation->path.size() < locationPath.size()))		// Longest prefix match
-				bestMatchLocation = &(*it);																						// Gives the address of the Location object pointed to by the iterator
-		}
-
-		return bestMatchLocation;
-	}
-	
-
-	// -----------------------------------------------------
-	// --- 3. Effective config (merge Server + Location) ---
-	// -----------------------------------------------------
-
-	// --- 3.1. Effective Config Utilities (helper functions and structs) ---
-
-	/*
-	 Default limits for maximum request body size and CGI execution timeout (default configuration constants).
-	*/
-	const std::size_t	kDefaultClientMaxBodySize =	0;				// 0 means no limit / unlimited unless configured
-	const std::size_t	kDefaultCgiTimeout = 		30;				// 30 seconds
-
-	/*
-	 Holds the merged Server and Location directives for handling a request.
-	 Provides resolved defaults, limits, CGI options, and redirect configuration.
-	*/
-	struct EffectiveConfig {
-		const Server*						server;					// never NULL
-		const Location*						location;				// may be NULL
-
-		std::string							root;
-		bool								autoindex;
-		std::vector<std::string>			indexFiles;
-		std::vector<std::string>			allowedMethods;
-		std::map<int, std::string>			errorPages;
-
-		std::size_t							clientMaxBodySize;
-		std::string							uploadStore;
-		std::map<std::string, std::string>	cgiPass;
-		std::size_t							cgiTimeout;
-		std::vector<std::string>			cgiAllowedMethods;
-
-		int									redirectStatus;			// 0 - no redirect
-		std::string							redirectTarget;
-
-		EffectiveConfig()
-			: server(NULL)
-			, location(NULL)
-			, root(".")
-			, autoindex(false)
-			, indexFiles()
-			, allowedMethods()
-			, errorPages()
-			, clientMaxBodySize(kDefaultClientMaxBodySize)
-			, uploadStore()
-			, cgiPass()
-			, cgiTimeout(kDefaultCgiTimeout)
-			, cgiAllowedMethods()
-			, redirectStatus(0)
-			, redirectTarget()
-			{}
-	};
-
-	/*
-	 Splits a string into whitespace-separated words and returns them as a vector.
-	*/
-	std::vector<std::string> splitWords(const std::string& input) {
-
-		std::vector<std::string>	words;
-		std::istringstream			iss(input);
-		std::string					currentWord;
-
-		while (iss >> currentWord)
-			words.push_back(currentWord);
-
-		return words;
-	}
-
-	/*
-	 Comma-aware parsing (methods/index/cgi_allowed_methods):
-	  - Config currently joins multi-values with commas;
-	  - Splitting on comma or space prevents “GET,POST” from being treated as one token
-	    (fixes 405s and missing index files).
-	*/
-	std::vector<std::string> splitWordsAndCommas(const std::string& input) {
-		
-		std::vector<std::string> output;
-		std::string currentWord;
-	
-		for (std::size_t i = 0; i <= input.size(); ++i) {
-			char c = (i == input.size()) ? ' ' : input[i];
-			if (c == ',' || std::isspace(static_cast<unsigned char>(c))) {
-				if (!currentWord.empty()) {
-					output.push_back(currentWord);
-					currentWord.clear();
-				}
-			}
-			else
-				currentWord += c;
-		}
-		return output;
-	}
-
-	/*
-	 Validates and parses an HTTP status code string into an integer (100–599).
-	 Throws on non-digits, overflow, or invalid ranges.
-	*/
-	int parseHttpStatus(const std::string& str) {
-
-		if (str.empty())
-			throw std::runtime_error("Empty HTTP status code");
-
-		for (std::string::size_type i = 0; i < str.size(); ++i) {
-			if (!(std::isdigit(static_cast<unsigned char>(str[i]))))				// static_cast for protection against UB if signed (locale dependent)
-				throw std::runtime_error("Invalid HTTP status code: " + str);
-		}
-
-		errno = 0;
-		unsigned long value = std::strtoul(str.c_str(), NULL, 10);					// Parse into unsigned long first to detect overflow before casting to int.
-
-		if ((value == ULONG_MAX && errno == ERANGE))
-			throw std::runtime_error("HTTP status code overflow: " + str);
-
-		if (value < 100 || value > 599)
-			throw std::runtime_error("HTTP status code out of range: " + str);
-
-		return static_cast<int>(value);
-	}
-
-	/*
-	 Parses a numeric string into size_t, validating digits and overflow conditions.
-	*/
-	size_t parseSizeT(const std::string& str) {
-
-		if (str.empty())
-			throw std::runtime_error("Empty numeric value");
-
-		size_t value = 0;
-		const size_t max = std::numeric_limits<size_t>::max();
-
-		for (size_t i = 0; i < str.size(); ++i) {
-
-			if (!(std::isdigit(static_cast<unsigned char>(str[i]))))
-				throw std::runtime_error("Invalid numeric value: " + str);
-
-			size_t digit = str[i] - '0';
-
-			if (value > max / 10 || (value == max / 10 && digit > max % 10))					// Prevent overflow before multiplication
-				throw std::runtime_error("Numeric value exceeds size_t range: " + str);
-
-			value = value * 10 + digit;
-		}
-
-		return value;
-	}
-
-	/*
-	 Parses a numeric value with an optional binary suffix (k, M, G) and returns
-	 the corresponding size in bytes. Throws on invalid syntax or overflow.
-	*/
-	std::size_t parseSizeWithSuffix(const std::string& str) {
-
-		if (str.empty())
-			throw std::runtime_error("Empty numeric value");
-
-		std::istringstream iss(str);
-
-		unsigned long long value = 0;
-		if (!(iss >> value))
-			throw std::runtime_error("Invalid numeric value: " + str);
-
-		char suffix = 0;
-		if (iss >> suffix) {
-			char extra = 0;
-			if (iss >> extra)
-				throw std::runtime_error("Invalid size suffix in: " + str);
-		}
-
-		unsigned long long multiplier = 1;
-		switch (suffix) {
-			case 0:
-				multiplier = 1;
-				break;
-
-			case 'k':
-			case 'K':
-				multiplier = 1024ULL;
-				break;
-
-			case 'm':
-			case 'M':
-				multiplier = 1024ULL * 1024ULL;									// to avoid intermediate overflow (evaluation as int)
-				break;
-
-			case 'g':
-			case 'G':
-				multiplier = 1024ULL * 1024ULL * 1024ULL;
-				break;
-
-			default:
-				throw std::runtime_error("Invalid size suffix in: " + str);
-		}
-
-		if (multiplier != 0 && value > (std::numeric_limits<unsigned long long>::max)() / multiplier)	// Detect overflow before multiplication
-			throw std::runtime_error("Numeric value overflow: " + str);
-
-		unsigned long long result = value * multiplier;													// unsigned long long to prevent overflow before size_t cast
-		if (result > (std::numeric_limits<std::size_t>::max)())
-			throw std::runtime_error("Numeric value exceeds size_t range: " + str);
-
-		return static_cast<std::size_t>(result);
-	}
-
-	/*
-	 Looks up a directive by key, preferring Location over Server.
-	 Returns true and sets value if found; otherwise returns false.
-	*/
-	bool getDirectiveValue(const Location* loc, const Server& srv, const std::string& key, std::string& value) {
-		
-		std::map<std::string, std::string>::const_iterator	it;
-	
-		if (loc) {
-			it = loc->directives.find(key);
-			if (it != loc->directives.end()) {
-				value = it->second;
-				return true;
-			}
-		}
-
-		it = srv.directives.find(key);
-		if (it != srv.directives.end()) {
-			value = it->second;
-			return true;
-		}
-
-		return false;
-	}
-
-	/*
-	 Merges error_page configuration from Server and Location into EffectiveConfig.
-	 Server-level mappings are loaded first; Location error_page overrides or adds entries.
-	*/
-	void resolveErrorPages(EffectiveConfig& cfg, const Server& srv, const Location* loc) {
-
-		std::map<std::string, std::string>::const_iterator it;
-		
-		for (it = srv.error_pages.begin(); it != srv.error_pages.end(); ++it)
-			cfg.errorPages[parseHttpStatus(it->first)] = it->second;
-		
-		if (!loc)
-			return;
-
-		it = loc->directives.find("error_page");
-		if (it == loc->directives.end())
-			return;
-
-		std::vector<std::string> tokens = splitWords(it->second);
-		if (tokens.size() < 2)
-			throw std::runtime_error("Bad error_page configuration");
-
-		const std::string& uri = tokens.back();						// Follows NGINX-style syntax: multiple status codes followed by a single URI.
-																	// URI - Uniform Resource Identifier - identifies a resource (e.g. page, file, image, etc.)
-		for (std::size_t i = 0; i + 1 < tokens.size(); ++i)
-			cfg.errorPages[parseHttpStatus(tokens[i])] = uri;
-	}
-
-	// --- 3.2. Effective Configuration Construction ---
-
-	/*
-	 Builds the EffectiveConfig by merging Server and Location directives.
-	 Applies defaults for methods, error pages, CGI options, and redirects.
-	*/
-	EffectiveConfig buildEffectiveConfig(const Server& srv, const Location* loc) {
-
-		EffectiveConfig	cfg;
-
-		cfg.server = &srv;
-		cfg.location = loc;
-
-		std::string	value;
-
-		if (getDirectiveValue(loc, srv, "root", value))
-			cfg.root = value;
-
-		if (getDirectiveValue(loc, srv, "autoindex", value))
-			cfg.autoindex = (value == "on");
-
-		if (getDirectiveValue(loc, srv, "index", value))
-			cfg.indexFiles = splitWordsAndCommas(value);
-
-		if (getDirectiveValue(loc, srv, "methods", value))
-			cfg.allowedMethods = splitWordsAndCommas(value);
-		else {
-			cfg.allowedMethods.push_back("GET");						// Default to GET and POST so locations remain functional without explicit method configuration. 
-			cfg.allowedMethods.push_back("POST");
-		}
-
-		resolveErrorPages(cfg, srv, loc);
-
-		if (getDirectiveValue(loc, srv, "client_max_body_size", value))
-			cfg.clientMaxBodySize = parseSizeWithSuffix(value);
-
-		if (getDirectiveValue(loc, srv, "upload_store", value))
-			cfg.uploadStore = value;
-
-		if (getDirectiveValue(loc, srv, "cgi_pass", value)) {
-			std::vector<std::string> tokens = splitWords(value);
-			if (tokens.size() < 2)
-				throw	std::runtime_error("cgi_pass requires 2 arguments: <ext> <bin>");
-			cfg.cgiPass[tokens[0]] = tokens[1];
-		}
-
-		if (getDirectiveValue(loc, srv, "cgi_timeout", value))
-			cfg.cgiTimeout = parseSizeT(value);
-
-		if (getDirectiveValue(loc, srv, "cgi_allowed_methods", value))
-			cfg.cgiAllowedMethods = splitWordsAndCommas(value);
-		else
-			cfg.cgiAllowedMethods = cfg.allowedMethods;					// Default: CGI inherits location methods to ensure consistent behaviour
-
-		if (getDirectiveValue(loc, srv, "return", value)) {				// Handle HTTP 3xx redirects via 'return' directive
-			std::vector<std::string> tokens = splitWords(value);
-			if (tokens.size() == 2) {									// Ignores malformed configurations
-				int status = parseHttpStatus(tokens[0]);
-				if (status >= 300 && status <= 399) {
-					cfg.redirectStatus = status;
-					cfg.redirectTarget = tokens [1];
-				}
-			}
-		}
-
-		return cfg;
-	}
 
 
 	// --------------------------------
@@ -465,11 +128,7 @@ namespace {
 	*/
 	bool isMethodAllowed(const EffectiveConfig& cfg, const std::string& method) {
 		
-		for (std::vector<std::string>::const_iterator it = cfg.allowedMethods.begin(); it != cfg.allowedMethods.end(); ++it)
-			if (*it == method)
-				return true;
-		
-		return false;
+		return (cfg.allowedMask & methodBit(method)) != 0;
 	}
 
 	HTTP_Response makeErrorResponse(int status, const EffectiveConfig* cfg);
@@ -481,15 +140,8 @@ namespace {
 
 		HTTP_Response response = makeErrorResponse(405, &cfg);
 
-		std::string allowed;
-		for (std::vector<std::string>::const_iterator it = cfg.allowedMethods.begin(); it != cfg.allowedMethods.end(); ++it) {
-			if (!allowed.empty())						// Add comma only after the first method
-				allowed += ", ";
-			allowed += *it;
-		}
-
-		if (!allowed.empty())
-			response.headers["Allow"] = allowed;
+		if (!cfg.allowHeader.empty())
+			response.headers["Allow"] = cfg.allowHeader;
 
 		return response;
 	}
@@ -531,7 +183,7 @@ namespace {
 	*/
 	std::string makeFilesystemPath(const EffectiveConfig& cfg, const std::string& reqPath) {
 
-		const std::string locationPrefix = (cfg.location ? cfg.location->path : "");	// ex: "/images" (or "")
+		const std::string& locationPrefix = cfg.locationPath;							// ex: "/images" (or "")
 		std::string reqPathRemainder;
 
 		if (!locationPrefix.empty() &&											// If there is a matched location, strip its prefix from the URI
@@ -664,40 +316,619 @@ namespace {
 	}
 
 	/*
-	 Serves a static file by reading it into memory and returning a 200 response.
-	 Applies basic MIME detection, handles 403/404 errors, and sets Content-Length.
+	 Process-wide cache of small static files (see FileCache.hpp). Workers each
+	 get their own copy after fork().
 	*/
-	HTTP_Response handleStaticFile(const HTTP_Request& req, const EffectiveConfig& cfg, const std::string& fsPath) {
+	FileCache& fileCache() {
+		static FileCache cache;
+		return cache;
+	}
+
+	/*
+	 Returns the MIME type for a filesystem path based on its extension.
+	*/
+	std::string getContentType(const std::string& fsPath) {
+
+		std::string::size_type dotPos = fsPath.rfind('.');
+		if (dotPos != std::string::npos && dotPos + 1 < fsPath.size())
+			return getMimeType(fsPath.substr(dotPos + 1));
+		return "application/octet-stream";
+	}
+
+	// --------------------------------------------
+	// --- Validators, conditionals and ranges ---
+	// --------------------------------------------
+
+	const std::size_t	kMaxRanges = 16;						// more ranges than that: Range is ignored (200)
+	const std::size_t	kMaxByterangesFromFile = 1024 * 1024;	// multipart assembled from a file body, at most
+
+	/*
+	 IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") for Last-Modified.
+	*/
+	std::string formatHttpDate(std::time_t t) {
+
+		char buf[64];
+		std::tm* g = std::gmtime(&t);
+		if (!g || !std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", g))
+			return "";
+		return buf;
+	}
+
+	/*
+	 Parses an IMF-fixdate. Returns -1 for anything else, which makes the
+	 conditional header be ignored, as RFC 9110 asks for invalid dates.
+	*/
+	std::time_t parseHttpDate(const std::string& s) {
+
+		std::tm tm;
+		std::memset(&tm, 0, sizeof(tm));
+		const char* end = strptime(s.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+		if (!end || *end != '\0')
+			return static_cast<std::time_t>(-1);
+		return timegm(&tm);
+	}
+
+	/*
+	 Strong entity tag from the stat() identity: "<mtime>-<size>" in hex, the
+	 same shape nginx uses, so it only changes when the file does.
+	*/
+	std::string makeETag(const struct stat& st) {
+
+		std::ostringstream oss;
+		oss << '"' << std::hex << static_cast<unsigned long>(st.st_mtime)
+			<< '-' << static_cast<unsigned long long>(st.st_size) << '"';
+		return oss.str();
+	}
+
+	/*
+	 Adds the validators of a static representation to a 200 response.
+	*/
+	void setValidators(HTTP_Response& res, const std::string& etag, const std::string& lastModified) {
+
+		res.headers["ETag"] = etag;
+		if (!lastModified.empty())
+			res.headers["Last-Modified"] = lastModified;
+		res.headers["Accept-Ranges"] = "bytes";
+	}
+
+	std::string headerValue(const HTTP_Response& res, const std::string& name) {
+
+		std::map<std::string, std::string>::const_iterator it = res.headers.find(name);
+		return it == res.headers.end() ? "" : it->second;
+	}
+
+	std::string opaqueTag(const std::string& tag) {
+		return tag.compare(0, 2, "W/") == 0 ? tag.substr(2) : tag;
+	}
+
+	/*
+	 If-None-Match list ("*", or comma-separated tags) against our tag, using the
+	 weak comparison RFC 9110 prescribes for this header.
+	*/
+	bool etagListMatches(const std::string& list, const std::string& etag) {
+
+		const std::string ours = opaqueTag(etag);
+		std::string::size_type pos = 0;
+		while (pos < list.size()) {
+			std::string::size_type comma = list.find(',', pos);
+			if (comma == std::string::npos)
+				comma = list.size();
+			std::string tag = list.substr(pos, comma - pos);
+			std::string::size_type b = tag.find_first_not_of(" \t");
+			std::string::size_type e = tag.find_last_not_of(" \t");
+			if (b != std::string::npos) {
+				tag = tag.substr(b, e - b + 1);
+				if (tag == "*" || opaqueTag(tag) == ours)
+					return true;
+			}
+			pos = comma + 1;
+		}
+		return false;
+	}
+
+	/*
+	 True when the client's cached copy is still current: If-None-Match wins over
+	 If-Modified-Since when both are sent. An If-Modified-Since in the future is
+	 invalid (RFC 7232 3.3) and ignored, so a skewed client clock can't pin a
+	 stale copy.
+	*/
+	bool isNotModified(const HTTP_Request& req, const HTTP_Response& res) {
+
+		const std::string etag = headerValue(res, "ETag");
+		if (req.headers.has(RequestHeaders::IF_NONE_MATCH))
+			return !etag.empty() && etagListMatches(req.headers.value(RequestHeaders::IF_NONE_MATCH), etag);
+
+		if (!req.headers.has(RequestHeaders::IF_MODIFIED_SINCE))
+			return false;
+		std::time_t since = parseHttpDate(req.headers.value(RequestHeaders::IF_MODIFIED_SINCE));
+		std::time_t modified = parseHttpDate(headerValue(res, "Last-Modified"));
+		if (since > std::time(NULL))
+			return false;
+		return since != static_cast<std::time_t>(-1) && modified != static_cast<std::time_t>(-1) && modified <= since;
+	}
+
+	/*
+	 Turns a 200 into its 304: validators and Vary stay, the payload (and an
+	 open file body) goes.
+	*/
+	void makeNotModified(HTTP_Response& res) {
+
+		if (res.fileFd >= 0)
+			close(res.fileFd);
+		res.fileFd = -1;
+		res.fileOffset = 0;
+		res.fileLength = 0;
+		res.body.clear();
+
+		res.status = 304;
+		res.reason = getReasonPhrase(304);
+		res.headers.erase("Content-Length");
+		res.headers.erase("Content-Type");
+		res.headers.erase("Accept-Ranges");
+	}
+
+	/*
+	 If-Range: the Range only applies while the client's validator still
+	 names this representation (strong tag comparison, or the exact date).
+	*/
+	bool ifRangeAllows(const HTTP_Request& req, const HTTP_Response& res) {
+
+		if (!req.headers.has(RequestHeaders::IF_RANGE))
+			return true;
+
+		const std::string cond = req.headers.value(RequestHeaders::IF_RANGE);
+		if (!cond.empty() && (cond[0] == '"' || cond.compare(0, 2, "W/") == 0)) {
+			const std::string etag = headerValue(res, "ETag");
+			return !etag.empty() && etag[0] == '"' && cond == etag;
+		}
+		std::time_t date = parseHttpDate(cond);
+		return date != static_cast<std::time_t>(-1) && date == parseHttpDate(headerValue(res, "Last-Modified"));
+	}
+
+	struct ByteRange {
+		std::size_t	first;
+		std::size_t	last;
+	};
+
+	enum RangeResult { RANGE_IGNORE, RANGE_OK, RANGE_UNSATISFIABLE };
+
+	bool parseRangeNumber(const std::string& s, std::size_t& out) {
+
+		if (s.empty() || s.size() > 19)
+			return false;
+		unsigned long long v = 0;
+		for (std::string::size_type i = 0; i < s.size(); ++i) {
+			if (!std::isdigit(static_cast<unsigned char>(s[i])))
+				return false;
+			v = v * 10 + static_cast<unsigned long long>(s[i] - '0');
+		}
+		out = static_cast<std::size_t>(v);
+		return true;
+	}
+
+	/*
+	 Parses "bytes=a-b, c-, -n" against a representation of size bytes.
+	 Syntax errors and unknown units are ignored (full 200, per RFC 9110);
+	 a valid set with no satisfiable range is a 416.
+	*/
+	RangeResult parseRanges(const std::string& spec, std::size_t size, std::vector<ByteRange>& out) {
+
+		if (spec.compare(0, 6, "bytes=") != 0)
+			return RANGE_IGNORE;
+
+		std::string::size_type pos = 6;
+		std::size_t specs = 0;
+		while (pos <= spec.size()) {
+			std::string::size_type comma = spec.find(',', pos);
+			if (comma == std::string::npos)
+				comma = spec.size();
+			std::string item = spec.substr(pos, comma - pos);
+			pos = comma + 1;
+
+			std::string::size_type b = item.find_first_not_of(" \t");
+			if (b == std::string::npos)
+				continue;												// Empty list elements are allowed
+			item = item.substr(b, item.find_last_not_of(" \t") - b + 1);
+			if (++specs > kMaxRanges)
+				return RANGE_IGNORE;
+
+			std::string::size_type dash = item.find('-');
+			if (dash == std::string::npos)
+				return RANGE_IGNORE;
+
+			ByteRange r;
+			std::size_t n;
+			if (dash == 0) {											// "-n": the last n bytes
+				if (!parseRangeNumber(item.substr(1), n))
+					return RANGE_IGNORE;
+				if (n == 0 || size == 0)
+					continue;
+				r.first = n >= size ? 0 : size - n;
+				r.last = size - 1;
+			}
+			else {
+				if (!parseRangeNumber(item.substr(0, dash), r.first))
+					return RANGE_IGNORE;
+				if (dash + 1 == item.size())
+					r.last = size ? size - 1 : 0;
+				else if (!parseRangeNumber(item.substr(dash + 1), r.last) || r.last < r.first)
+					return RANGE_IGNORE;
+				if (r.first >= size)
+					continue;											// Unsatisfiable on its own
+				if (r.last >= size)
+					r.last = size - 1;
+			}
+			out.push_back(r);
+		}
+		if (specs == 0)
+			return RANGE_IGNORE;
+		return out.empty() ? RANGE_UNSATISFIABLE : RANGE_OK;
+	}
+
+	std::string contentRange(const ByteRange& r, std::size_t size) {
+		return "bytes " + toString(r.first) + "-" + toString(r.last) + "/" + toString(size);
+	}
+
+	std::string byterangesBoundary() {
+
+		static unsigned long seq = 0;
+		std::ostringstream oss;
+		oss << "webserv-" << std::hex << static_cast<unsigned long>(std::time(NULL)) << '-' << ++seq;
+		return oss.str();
+	}
+
+	/*
+	 Copies [first, last] of a file body into out with pread(), leaving the
+	 descriptor's offset alone.
+	*/
+	bool readFileRange(int fd, off_t base, const ByteRange& r, std::string& out) {
+
+		std::size_t len = r.last - r.first + 1;
+		std::size_t start = out.size();
+		out.resize(start + len);
+		std::size_t got = 0;
+		while (got < len) {
+			ssize_t n = pread(fd, &out[start + got], len - got, base + static_cast<off_t>(r.first + got));
+			if (n <= 0)
+				return false;
+			got += static_cast<std::size_t>(n);
+		}
+		return true;
+	}
+
+	/*
+	 Range stage for a 200 static response to GET. One range narrows the body in
+	 place: for a file-backed body that is just the sendfile() offset and length,
+	 so the copy stays zero-copy. Several ranges become a multipart/byteranges
+	 body built in memory; a file-backed body is only assembled that way while
+	 the parts fit kMaxByterangesFromFile, beyond that the full 200 is sent.
+	*/
+	void applyRange(const HTTP_Request& req, const EffectiveConfig& cfg, HTTP_Response& res) {
+
+		if (req.method != "GET" || res.status != 200 || !req.headers.has(RequestHeaders::RANGE))
+			return;
+		if (!ifRangeAllows(req, res))
+			return;
+
+		const bool fromFile = res.fileFd >= 0;
+		const std::size_t size = fromFile ? res.fileLength : res.body.size();
+
+		std::vector<ByteRange> ranges;
+		RangeResult result = parseRanges(req.headers.value(RequestHeaders::RANGE), size, ranges);
+		if (result == RANGE_IGNORE)
+			return;
+
+		if (result == RANGE_UNSATISFIABLE) {
+			if (fromFile)
+				close(res.fileFd);
+			res = makeErrorResponse(416, &cfg);
+			res.headers["Content-Range"] = "bytes */" + toString(size);
+			res.prebuilt = NULL;											// The template doesn't carry Content-Range
+			return;
+		}
+
+		if (ranges.size() == 1) {
+			const ByteRange& r = ranges[0];
+			const std::size_t len = r.last - r.first + 1;
+			if (fromFile) {
+				res.fileOffset += static_cast<off_t>(r.first);
+				res.fileLength = len;
+			}
+			else
+				res.body = res.body.substr(r.first, len);
+			res.status = 206;
+			res.reason = getReasonPhrase(206);
+			res.headers["Content-Range"] = contentRange(r, size);
+			res.headers["Content-Length"] = toString(len);
+			return;
+		}
+
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < ranges.size(); ++i)
+			total += ranges[i].last - ranges[i].first + 1;
+		if (fromFile && total > kMaxByterangesFromFile)
+			return;
+
+		const std::string boundary = byterangesBoundary();
+		const std::string type = headerValue(res, "Content-Type");
+		std::string body;
+		for (std::size_t i = 0; i < ranges.size(); ++i) {
+			body += "--" + boundary + "\r\n";
+			if (!type.empty())
+				body += "Content-Type: " + type + "\r\n";
+			body += "Content-Range: " + contentRange(ranges[i], size) + "\r\n\r\n";
+			if (fromFile) {
+				if (!readFileRange(res.fileFd, res.fileOffset, ranges[i], body)) {
+					close(res.fileFd);
+					res = makeErrorResponse(500, &cfg);
+					return;
+				}
+			}
+			else
+				body.append(res.body, ranges[i].first, ranges[i].last - ranges[i].first + 1);
+			body += "\r\n";
+		}
+		body += "--" + boundary + "--\r\n";
+
+		if (fromFile) {
+			close(res.fileFd);
+			res.fileFd = -1;
+			res.fileOffset = 0;
+			res.fileLength = 0;
+		}
+		res.body.swap(body);
+		res.status = 206;
+		res.reason = getReasonPhrase(206);
+		res.headers["Content-Type"] = "multipart/byteranges; boundary=" + boundary;
+		res.headers["Content-Length"] = toString(res.body.size());
+	}
+
+	/*
+	 Conditional GET/HEAD first (304), then Range (206/416), on a static 200.
+	*/
+	void applyPreconditions(const HTTP_Request& req, const EffectiveConfig& cfg, HTTP_Response& res) {
+
+		if (res.status != 200 || (req.method != "GET" && req.method != "HEAD"))
+			return;
+		if (isNotModified(req, res)) {
+			makeNotModified(res);
+			return;
+		}
+		applyRange(req, cfg, res);
+	}
+
+	// -------------------
+	// --- Compression ---
+	// -------------------
+
+	const std::size_t	kMaxOnTheFlyFileSize = 1024 * 1024;	// bigger uncached files keep going through sendfile()
+
+	/*
+	 Media type without parameters, lowercased ("text/html; charset=utf-8" -> "text/html").
+	*/
+	std::string mediaType(const std::string& contentType) {
+
+		std::string type;
+		for (std::string::size_type i = 0; i < contentType.size() && contentType[i] != ';'; ++i) {
+			unsigned char c = static_cast<unsigned char>(contentType[i]);
+			if (!std::isspace(c))
+				type += static_cast<char>(std::tolower(c));
+		}
+		return type;
+	}
+
+	/*
+	 True when "gzip on;" applies to a body of this type and size
+	 (gzip_types, gzip_min_length).
+	*/
+	bool isCompressible(const EffectiveConfig& cfg, const std::string& contentType, std::size_t size) {
+
+		if (!cfg.gzip || size < cfg.gzipMinLength)
+			return false;
+
+		const std::string type = mediaType(contentType);
+		for (std::size_t i = 0; i < cfg.gzipTypes.size(); ++i) {
+			if (cfg.gzipTypes[i] == "*" || cfg.gzipTypes[i] == type)
+				return true;
+		}
+		return false;
+	}
+
+	ContentCoding requestedCoding(const HTTP_Request& req) {
+		return negotiateCoding(req.headers.value(RequestHeaders::ACCEPT_ENCODING));
+	}
+
+	/*
+	 Compression stage: in-memory 200 bodies of a compressible type get the coding
+	 the client prefers. Responses whose handler already negotiated (cached
+	 variants, gzip_static) or that carry their own Content-Encoding (CGI) are
+	 left alone. Runs after headersUppercase(), so header names are Title-Case.
+	*/
+	void compressResponse(const HTTP_Request& req, const EffectiveConfig& cfg, HTTP_Response& res) {
+
+		if (res.status != 200 || res.fileFd >= 0 || res.cgiPending || res.encoded)
+			return;
+		if (res.headers.count("Content-Encoding"))
+			return;
+
+		std::map<std::string, std::string>::const_iterator type = res.headers.find("Content-Type");
+		if (type == res.headers.end() || !isCompressible(cfg, type->second, res.body.size()))
+			return;
+
+		res.headers["Vary"] = "Accept-Encoding";						// Caches must key on the client's encodings
+
+		ContentCoding coding = requestedCoding(req);
+		std::string packed;
+		if (coding == CODING_IDENTITY || !compressBody(res.body, coding, cfg.gzipCompLevel, packed))
+			return;
+		if (packed.size() >= res.body.size())							// Already dense (or tiny): not worth it
+			return;
+
+		res.body.swap(packed);
+		res.headers["Content-Encoding"] = codingName(coding);
+		res.headers["Content-Length"] = toString(res.body.size());
+
+		std::map<std::string, std::string>::iterator etag = res.headers.find("ETag");
+		if (etag != res.headers.end() && etag->second.compare(0, 2, "W/") != 0)
+			etag->second = "W/" + etag->second;						// Same content, different bytes: only weakly equal
+	}
+
+	/*
+	 Builds a 200 response straight from a cache entry (no disk access). With
+	 "gzip on;" the gzip variant is compressed once, on the first client that
+	 accepts it, and kept in the cache next to the plain body.
+	*/
+	HTTP_Response makeCachedFileResponse(const HTTP_Request& req, const EffectiveConfig& cfg, const FileCacheEntry& entry, bool compress) {
+
+		HTTP_Response res;
+
+		res.status = 200;
+		res.reason = getReasonPhrase(200);
+		res.headers["Content-Type"] = entry.contentType;
+		setValidators(res, entry.etag, entry.lastModified);
+
+		if (compress && isCompressible(cfg, entry.contentType, entry.body.size())) {
+
+			res.headers["Vary"] = "Accept-Encoding";
+			res.encoded = true;												// Identity was a decision too (deflate-only client, dense file)
+
+			if (requestedCoding(req) == CODING_GZIP) {
+				if (!entry.gzipTried) {
+					std::string packed;
+					if (!compressBody(entry.body, CODING_GZIP, cfg.gzipCompLevel, packed) || packed.size() >= entry.body.size())
+						packed.clear();											// Remembered as "doesn't pay off"
+					fileCache().storeGzip(entry.path, packed);					// entry stays valid: it is the LRU front
+				}
+				if (!entry.gzipBody.empty()) {
+					res.headers["Content-Encoding"] = "gzip";
+					res.headers["Content-Length"] = entry.gzipLength;
+					res.headers["ETag"] = "W/" + entry.etag;
+					res.body = entry.gzipBody;
+					return res;
+				}
+			}
+		}
+
+		res.headers["Content-Length"] = entry.contentLength;
+		res.body = entry.body;
+
+		return res;
+	}
+
+	/*
+	 Reads a whole (small) file into out. Returns false on a short or failed read.
+	*/
+	bool readWholeFile(int fd, std::size_t size, std::string& out) {
+
+		out.resize(size);
+		std::size_t got = 0;
+		while (got < size) {
+			ssize_t n = read(fd, &out[got], size - got);
+			if (n <= 0)
+				return false;
+			got += static_cast<std::size_t>(n);
+		}
+		return true;
+	}
+
+	/*
+	 Serves one file as a 200. Small files are answered from the file cache (and
+	 loaded into it on a miss); everything else becomes a file-backed body that
+	 the core streams to the socket with sendfile(), without reading it into
+	 memory, unless it is going to be compressed. Handles 403/404 errors and
+	 sets Content-Length.
+	*/
+	HTTP_Response serveFile(const HTTP_Request& req, const EffectiveConfig& cfg, const std::string& fsPath, const std::string& contentType, bool compress) {
 
-		(void)req;														// For now Only GET is supported for static file.
+		if (const FileCacheEntry* cached = fileCache().lookup(fsPath))
+			return makeCachedFileResponse(req, cfg, *cached, compress);
 		
-		std::ifstream staticFile(fsPath.c_str(), std::ios::binary);
-		if (!staticFile) {
+		int fd = open(fsPath.c_str(), O_RDONLY);
+		if (fd < 0) {
 			if (errno == EACCES)
 				return makeErrorResponse(403, &cfg);					// "Forbidden"
 			else
 				return makeErrorResponse(404, &cfg);					// "Not Found"
 		}
-		
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+			close(fd);
+			return makeErrorResponse(500, &cfg);
+		}
+
+		int fdflags = fcntl(fd, F_GETFD);								// CGI children must not inherit open files
+		if (fdflags != -1)
+			fcntl(fd, F_SETFD, fdflags | FD_CLOEXEC);
+
+		if (fileCache().admits(st.st_size)) {							// Small file: load it once, serve it from memory
+			std::string bytes;
+			bool ok = readWholeFile(fd, static_cast<std::size_t>(st.st_size), bytes);
+			close(fd);
+			if (!ok)
+				return makeErrorResponse(500, &cfg);
+			const FileCacheEntry* entry = fileCache().insert(fsPath, st, bytes, contentType, makeETag(st), formatHttpDate(st.st_mtime));
+			if (entry)
+				return makeCachedFileResponse(req, cfg, *entry, compress);
+			return makeErrorResponse(500, &cfg);
+		}
+
 		HTTP_Response res;
 
 		res.status = 200;
 		res.reason = getReasonPhrase(200);
+		res.headers["Content-Type"] = contentType;
+		setValidators(res, makeETag(st), formatHttpDate(st.st_mtime));
+
+		const std::size_t size = static_cast<std::size_t>(st.st_size);
+		if (compress && size <= kMaxOnTheFlyFileSize && isCompressible(cfg, contentType, size)) {
+			bool ok = readWholeFile(fd, size, res.body);				// No cache: compressResponse() packs it per request
+			close(fd);
+			if (!ok)
+				return makeErrorResponse(500, &cfg);
+			res.headers["Content-Length"] = toString(size);
+			return res;
+		}
 
-		std::string::size_type dotPos = fsPath.rfind('.');
-		if (dotPos != std::string::npos && dotPos + 1 < fsPath.size())
-			res.headers["Content-Type"] = getMimeType(fsPath.substr(dotPos + 1));
-		else
-			res.headers["Content-Type"] = "application/octet-stream";
-		
-		std::ostringstream oss;
-		oss << staticFile.rdbuf();
-		if (!staticFile && !staticFile.eof())							// Failbit is OK at EOF; otherwise it's a real read error
-			return makeErrorResponse(500, &cfg);
-		res.body = oss.str();
+		res.fileFd = fd;												// Ownership moves to the core with the response
+		res.fileOffset = 0;
+		res.fileLength = size;
 		
-		res.headers["Content-Length"] = toString(res.body.size());
+		res.headers["Content-Length"] = toString(res.fileLength);
+
+		return res;
+	}
+
+	/*
+	 Serves a static file with basic MIME detection. With "gzip_static on;" a
+	 precompressed "<file>.gz" next to it is sent instead to clients that accept
+	 gzip, so no CPU is spent compressing per request. Conditional and Range
+	 requests are answered from the validators of whichever file was picked.
+	*/
+	HTTP_Response handleStaticFile(const HTTP_Request& req, const EffectiveConfig& cfg, const std::string& fsPath) {
+
+		const std::string contentType = getContentType(fsPath);
 
+		if (cfg.gzipStatic && requestedCoding(req) == CODING_GZIP) {
+
+			const std::string gzPath = fsPath + ".gz";
+			struct stat st;
+			if (fileCache().isFresh(gzPath) || (stat(gzPath.c_str(), &st) == 0 && S_ISREG(st.st_mode))) {
+				HTTP_Response res = serveFile(req, cfg, gzPath, contentType, false);
+				if (res.status == 200) {
+					res.headers["Content-Encoding"] = "gzip";
+					res.headers["Vary"] = "Accept-Encoding";
+					res.encoded = true;
+					applyPreconditions(req, cfg, res);
+					return res;
+				}
+			}
+		}
+
+		HTTP_Response res = serveFile(req, cfg, fsPath, contentType, true);
+		if (cfg.gzipStatic && res.status == 200)
+			res.headers["Vary"] = "Accept-Encoding";					// The .gz variant may exist for other clients
+		applyPreconditions(req, cfg, res);
 		return res;
 	}
 
@@ -736,6 +967,8 @@ namespace {
 		if (status != 0)
 			return makeErrorResponse(status, &cfg);
 
+		fileCache().invalidate(fsPath);
+
 		HTTP_Response res;
 		
 		res.status = 204;
@@ -802,58 +1035,258 @@ namespace {
 		return directory + "/" + entry;
 	}
 
+	const std::size_t	kAutoindexCacheEntries = 32;			// rendered listings kept, least recently used dropped
+	const std::size_t	kAutoindexChunkSize = 64 * 1024;		// a spilled listing is written in chunks this big
+
+	/*
+	 One rendered listing of a directory as reached through one request path
+	 (it is in the title and decides the Parent link; two locations may share a
+	 root), valid while the directory keeps its inode and mtime (adding,
+	 removing or renaming an entry changes the mtime). Listings up to
+	 kMaxOnTheFlyFileSize stay in memory, with their gzip variant built on first
+	 demand; bigger ones live in an unlinked temporary file sent with sendfile()
+	 through a dup() of fd.
+	*/
+	struct AutoindexListing {
+		std::string	fsPath;
+		std::string	reqPath;			// with its trailing slash
+		ino_t		inode;
+		time_t		mtime;
+		std::string	body;
+		std::string	gzipBody;
+		bool		gzipTried;
+		int			fd;
+		std::size_t	length;
+
+		AutoindexListing() : fsPath(), reqPath(), inode(0), mtime(0), body(), gzipBody(), gzipTried(false), fd(-1), length(0) {}
+	};
+
+	typedef std::list<AutoindexListing>	AutoindexCache;		// most recently used first
+
+	AutoindexCache& autoindexCache() {
+		static AutoindexCache cache;
+		return cache;
+	}
+
+	/*
+	 Returns the cached listing of a directory under reqPath (moved to the
+	 front) when it still matches st, NULL otherwise; a stale one is dropped.
+	*/
+	AutoindexListing* findListing(const std::string& fsPath, const std::string& reqPath, const struct stat& st) {
+
+		AutoindexCache& cache = autoindexCache();
+		for (AutoindexCache::iterator it = cache.begin(); it != cache.end(); ++it) {
+			if (it->fsPath != fsPath || it->reqPath != reqPath)
+				continue;
+			if (it->inode != st.st_ino || it->mtime != st.st_mtime) {
+				if (it->fd >= 0)
+					close(it->fd);
+				cache.erase(it);
+				return NULL;
+			}
+			cache.splice(cache.begin(), cache, it);
+			return &cache.front();
+		}
+		return NULL;
+	}
+
+	AutoindexListing& storeListing(AutoindexListing& listing) {
+
+		AutoindexCache& cache = autoindexCache();
+		cache.push_front(AutoindexListing());
+		AutoindexListing& stored = cache.front();						// Swapped in, not copied
+		stored.fsPath.swap(listing.fsPath);
+		stored.reqPath.swap(listing.reqPath);
+		stored.inode = listing.inode;
+		stored.mtime = listing.mtime;
+		stored.body.swap(listing.body);
+		stored.fd = listing.fd;
+		stored.length = listing.length;
+		listing.fd = -1;
+		while (cache.size() > kAutoindexCacheEntries) {
+			if (cache.back().fd >= 0)
+				close(cache.back().fd);
+			cache.pop_back();
+		}
+		return cache.front();
+	}
+
 	/*
-	 Generates a simple HTML autoindex page for a directory, listing files and
-	 subdirectories based on the request path and filesystem path.
+	 Moves the rendered HTML so far to the listing's temporary file, creating
+	 it (already unlinked) on first use. False when the file can't be written.
 	*/
-	std::string generateAutoIndexPage(const std::string& reqPath, const std::string& fsPath) {
+	bool spillListing(AutoindexListing& listing, std::string& html) {
 
-		std::string fixedReqPath = reqPath;
-		if (!fixedReqPath.empty() && fixedReqPath[fixedReqPath.size() - 1] != '/')
-			fixedReqPath += '/';										// Ensure trailing slash
+		if (listing.fd < 0) {
+			const char* tmpdir = std::getenv("TMPDIR");
+			std::string tmpl = (tmpdir && *tmpdir) ? tmpdir : "/tmp";
+			tmpl += "/.autoindex-XXXXXX";
+
+			std::vector<char> name(tmpl.begin(), tmpl.end());
+			name.push_back('\0');
+			listing.fd = mkstemp(&name[0]);
+			if (listing.fd < 0)
+				return false;
+			unlink(&name[0]);											// lives as long as its descriptors
+			fcntl(listing.fd, F_SETFD, FD_CLOEXEC);
+		}
+
+		if (!spill::writeAll(listing.fd, html.data(), html.size()))
+			return false;
+		listing.length += html.size();
+		html.clear();
+		return true;
+	}
+
+	/*
+	 File or directory, from readdir() itself. stat() (which follows symlinks,
+	 as before) is only needed when the filesystem leaves d_type unknown, or
+	 for a link. False for anything else, or an entry that can't be stat()ed.
+	*/
+	bool listedEntryType(const std::string& fsPath, const struct dirent* entry, bool& isDir) {
+
+		if (entry->d_type == DT_REG || entry->d_type == DT_DIR) {
+			isDir = (entry->d_type == DT_DIR);
+			return true;
+		}
+		if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+			return false;
+
+		struct stat st;
+		if (stat(joinPath(fsPath, entry->d_name).c_str(), &st) != 0)
+			return false;
+		isDir = S_ISDIR(st.st_mode);
+		return isDir || S_ISREG(st.st_mode);
+	}
+
+	/*
+	 Renders the HTML autoindex page of a directory, listing files and
+	 subdirectories based on listing.reqPath and the filesystem path. Past
+	 kMaxOnTheFlyFileSize the page goes to a temporary file in
+	 kAutoindexChunkSize pieces instead of growing one string.
+	*/
+	bool renderAutoIndexPage(const std::string& fsPath, AutoindexListing& listing) {
+
+		const std::string& fixedReqPath = listing.reqPath;
 
 		DIR* currentDir = opendir(fsPath.c_str());
 		if (!currentDir)
-			return "";														// Signals an error, handled by the caller
-
-		std::ostringstream oss;
+			return false;													// Signals an error, handled by the caller
 
-		oss << "<!DOCTYPE html>\n"
-			<< "<html><head><meta charset=\"utf-8\">"
-			<< "<title>Index of " << htmlEscape(fixedReqPath) << "</title>"
-			<< "</head><body>"
-			<< "<h1>Index of " << htmlEscape(fixedReqPath) << "</h1>"
-			<< "<ul>";
+		const std::string escapedPath = htmlEscape(fixedReqPath);
+		std::string html;
+		html.reserve(kAutoindexChunkSize + 1024);
+
+		html += "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Index of ";
+		html += escapedPath;
+		html += "</title></head><body><h1>Index of ";
+		html += escapedPath;
+		html += "</h1><ul>";
 
 		if (fixedReqPath != "/")
-			oss << "<li><a href=\"../\">Parent directory</a></li>";			// Navigation link
+			html += "<li><a href=\"../\">Parent directory</a></li>";			// Navigation link
 
 		struct dirent* entry;
+		bool ok = true;
 
-		while ((entry = readdir(currentDir)) != NULL) {
+		while (ok && (entry = readdir(currentDir)) != NULL) {
 
-			std::string	name(entry->d_name);
-			if (name == "." || name == ".." || (!name.empty() && name[0] == '.'))		// Skip hidden/system entries
+			if (entry->d_name[0] == '.')										// Skip hidden/system entries (".", ".." included)
 				continue;
 
-			std::string fullPath = joinPath(fsPath, entry->d_name);
-
-			struct stat st;
-			if (stat(fullPath.c_str(), &st) != 0)							// Skip unreadable entries
+			bool isDir = false;
+			if (!listedEntryType(fsPath, entry, isDir))					// Skip unreadable and special entries
 				continue;
 
-			std::string escapedName = htmlEscape(entry->d_name);
-			if (S_ISREG(st.st_mode))
-				oss << "<li><a href=\"" << escapedName << "\">" << escapedName << "</a></li>";			// File entry
-			else if (S_ISDIR(st.st_mode))
-				oss << "<li><a href=\"" << escapedName << "/\">" << escapedName << "/</a></li>";		// Directory entry
+			const std::string escapedName = htmlEscape(entry->d_name);
+			const char* slash = isDir ? "/" : "";
+			html += "<li><a href=\"";
+			html += escapedName;
+			html += slash;
+			html += "\">";
+			html += escapedName;
+			html += slash;
+			html += "</a></li>";
+
+			if (html.size() >= kAutoindexChunkSize && (listing.fd >= 0 || html.size() > kMaxOnTheFlyFileSize))
+				ok = spillListing(listing, html);							// Big directory: stream it to the file
 		}
-		
+
 		closedir(currentDir);												// Done listing directory
 
-		oss << "</ul></body></html>\n";
-	
-		return oss.str();													// Return final HTML page
+		html += "</ul></body></html>\n";
+		if (ok && listing.fd >= 0)
+			ok = spillListing(listing, html);
+		if (!ok) {
+			if (listing.fd >= 0)
+				close(listing.fd);
+			listing.fd = -1;
+			return false;
+		}
+		if (listing.fd < 0) {
+			listing.length = html.size();
+			listing.body.swap(html);
+		}
+		return true;
+	}
+
+	/*
+	 200 for a rendered listing. A cached one is shared: its file gets a dup()
+	 per response and its body is copied; an uncached one hands both over.
+	 With "gzip on;" the gzip variant of an in-memory listing is compressed
+	 once, on the first client that accepts it.
+	*/
+	HTTP_Response makeListingResponse(const HTTP_Request& req, const EffectiveConfig& cfg, AutoindexListing& listing, bool cached) {
+
+		HTTP_Response res;
+		const std::string contentType = "text/html; charset=utf-8";
+
+		res.status = 200;
+		res.reason = getReasonPhrase(200);
+		res.headers["Content-Type"] = contentType;
+
+		if (listing.fd >= 0) {
+			int fd = cached ? dup(listing.fd) : listing.fd;
+			if (fd < 0)
+				return makeErrorResponse(500, &cfg);
+			if (cached)
+				fcntl(fd, F_SETFD, FD_CLOEXEC);
+			else
+				listing.fd = -1;
+			res.fileFd = fd;												// Ownership moves to the core with the response
+			res.fileOffset = 0;
+			res.fileLength = listing.length;
+			res.headers["Content-Length"] = toString(listing.length);
+			return res;
+		}
+
+		if (cached && isCompressible(cfg, contentType, listing.body.size())) {
+
+			res.headers["Vary"] = "Accept-Encoding";
+			res.encoded = true;
+
+			if (requestedCoding(req) == CODING_GZIP) {
+				if (!listing.gzipTried) {
+					if (!compressBody(listing.body, CODING_GZIP, cfg.gzipCompLevel, listing.gzipBody)
+						|| listing.gzipBody.size() >= listing.body.size())
+						listing.gzipBody.clear();								// Remembered as "doesn't pay off"
+					listing.gzipTried = true;
+				}
+				if (!listing.gzipBody.empty()) {
+					res.headers["Content-Encoding"] = "gzip";
+					res.headers["Content-Length"] = toString(listing.gzipBody.size());
+					res.body = listing.gzipBody;
+					return res;
+				}
+			}
+		}
+
+		res.headers["Content-Length"] = toString(listing.body.size());
+		if (cached)
+			res.body = listing.body;
+		else
+			res.body.swap(listing.body);									// compressResponse() may still pack it
+		return res;
 	}
 
 	// --- 9.2. Directory Request Handler ---
@@ -884,19 +1317,28 @@ namespace {
 			}
 			closedir(testDir);											// Directory is accessible
 
-			std::string html = generateAutoIndexPage(reqPath, fsPath);
+			struct stat dirSt;
+			if (stat(fsPath.c_str(), &dirSt) != 0)
+				return makeErrorResponse(500, &cfg);
 
-			if (html.empty())
-				return makeErrorResponse(500, &cfg);					// Failed to build autoindex HTML
+			std::string listedPath = reqPath;
+			if (!listedPath.empty() && listedPath[listedPath.size() - 1] != '/')
+				listedPath += '/';										// Ensure trailing slash
 
-			HTTP_Response res;
-			res.body = html;
-			res.status = 200;
-			res.reason = getReasonPhrase(200);
-			res.headers["Content-Type"] = "text/html; charset=utf-8";
-			res.headers["Content-Length"] = toString(res.body.size());
+			if (AutoindexListing* cached = findListing(fsPath, listedPath, dirSt))
+				return makeListingResponse(req, cfg, *cached, true);	// Unchanged since it was rendered
 
-			return res;
+			AutoindexListing listing;
+			listing.fsPath = fsPath;
+			listing.reqPath = listedPath;
+			listing.inode = dirSt.st_ino;
+			listing.mtime = dirSt.st_mtime;
+			if (!renderAutoIndexPage(fsPath, listing))
+				return makeErrorResponse(500, &cfg);					// Failed to build autoindex HTML
+
+			if (dirSt.st_mtime >= std::time(NULL))						// Changed this second: a later change could keep the mtime
+				return makeListingResponse(req, cfg, listing, false);
+			return makeListingResponse(req, cfg, storeListing(listing), true);
 		}
 
 		return makeErrorResponse(404, &cfg);							// No index and autoindex is disabled
@@ -909,11 +1351,11 @@ namespace {
 
 	/*
 	 Determines whether the requested path should be handled as CGI based on
-	 the configured cgi_pass extensions.
+	 the configured cgi_pass (or fastcgi_pass) extensions.
 	*/
 	bool isCgiRequest(const EffectiveConfig& cfg, const std::string& path) {
 
-		if (cfg.cgiPass.empty())
+		if (cfg.cgiPass.empty() && cfg.fastcgiPass.empty())
 			return false;
 
 		std::string::size_type	pos = path.rfind('.');
@@ -922,7 +1364,8 @@ namespace {
 
 		std::string fileExtension = path.substr(pos);
 
-		if (cfg.cgiPass.find(fileExtension) == cfg.cgiPass.end())
+		if (cfg.cgiPass.find(fileExtension) == cfg.cgiPass.end()
+			&& cfg.fastcgiPass.find(fileExtension) == cfg.fastcgiPass.end())
 			return false;
 
 		return true;
@@ -934,14 +1377,7 @@ namespace {
 	*/
 	bool isCgiMethodAllowed(const HTTP_Request& req, const EffectiveConfig& cfg) {
 
-		const std::vector<std::string>& effectiveMethods = !cfg.cgiAllowedMethods.empty() ? cfg.cgiAllowedMethods : cfg.allowedMethods;		// Use safe default methods when CGI-specific ones are not configured
-
-		for (std::vector<std::string>::const_iterator it = effectiveMethods.begin(); it != effectiveMethods.end(); ++it) {
-			if (*it == req.method)
-				return true;
-		}
-
-		return false;
+		return (cfg.cgiAllowedMask & methodBit(req.method)) != 0;		// Mask already falls back to the general allowed methods
 	}
 
 	/*
@@ -1069,20 +1505,15 @@ namespace {
 		env.push_back("PATH_TRANSLATED=" + pathTranslated);
 		env.push_back("DOCUMENT_ROOT=" + cfg.root);
 		env.push_back("CONTENT_LENGTH=" + toString(req.content_length));				// Content length should be present even if its 0.
-		std::map<std::string, std::string>::const_iterator itCT = req.headers.find("content-type");
-		if (itCT != req.headers.end())
-			env.push_back("CONTENT_TYPE=" + itCT->second);
+		if (req.headers.has(RequestHeaders::CONTENT_TYPE))
+			env.push_back("CONTENT_TYPE=" + req.headers.value(RequestHeaders::CONTENT_TYPE));
 																						// SERVER_NAME / SERVER_PORT
 		std::string	serverPort;
 		size_t		serverColonPos = req.host.find(':');
 		if (serverColonPos != std::string::npos)
 			serverPort = req.host.substr(serverColonPos + 1);							// Prefer port explicitly given in Host header
-		else if (!cfg.server->listen.empty()) {											// Otherwise try to extract port from first listen directive (host:port, or only port)
-			const std::string&	listenDirective = cfg.server->listen[0];
-			size_t				listenColonPos = listenDirective.find(':');
-			serverPort = (listenColonPos != std::string::npos) ? listenDirective.substr(listenColonPos + 1) : listenDirective;
-		} else
-			serverPort = "80";															// Final fallback: standard HTTP port
+		else
+			serverPort = cfg.listenPort;												// Otherwise the first listen directive's port ("80" without one)
 		
 		std::string	serverName = (serverColonPos == std::string::npos) ? req.host : req.host.substr(0, serverColonPos);
 		if (serverName.empty())
@@ -1092,7 +1523,8 @@ namespace {
 		env.push_back("SERVER_NAME=" + serverName);
 		env.push_back("REMOTE_ADDR=127.0.0.1");											// Default loopback address when real client IP isn't available (common in NGINX/Apache local setups)
 
-		for (std::map<std::string, std::string>::const_iterator it = req.headers.begin(); it != req.headers.end(); ++it)	{
+		const std::map<std::string, std::string>& headers = req.headers.asMap();		// built once, only for CGI
+		for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it)	{
 
 			if (it->first == "content-type" || it->first == "content-length")
 				continue;
@@ -1108,36 +1540,23 @@ namespace {
 	}
 	
 	/*
-	 Internal structure holding the pipe file descriptors used by the CGI process.
-	*/
-	struct CgiPipes {
-		int		stdinParent;		// parent writes here (becomes child's STDIN)
-		int		stdoutParent;  		// parent reads here (comes from child's STDOUT)
-		pid_t	pid;				// PID of the forked CGI child process
-	};
-	
-	/*
-	 Result container for CGI child execution, storing its output and status.
+	 Marks a descriptor close-on-exec so concurrent CGI children never inherit
+	 each other's pipes (a leaked stdin write end would hide EOF from a script).
 	*/
-	struct CgiRawOutput {
-		bool        timedOut;     // true if reading from the child exceeded the timeout
-		int         exitStatus;   // Exit code of the CGI process (or -1 if unavailable)
-		std::string data;         // everything read from the child's STDOUT
+	void setCloseOnExec(int fd) {
 
-		CgiRawOutput()
-			: timedOut(false)
-			, exitStatus(-1)
-			, data()
-		{}
-	};
+		int flags = fcntl(fd, F_GETFD);
+		if (flags != -1)
+			fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+	}
 
 	/*
 	 Spawns a CGI child process, sets up pipes for its STDIN and STDOUT,
 	 and prepares argv/envp before calling execve in the child. On success,
-	 returns the child's PID and the file descriptors the parent uses to
-	 write to the process and read from it.
+	 fills in the child's PID and the non-blocking file descriptors the parent
+	 uses to write to the process and read from it.
 	*/
-	bool spawnCgiProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env, CgiPipes& pipes) {
+	bool spawnCgiProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env, CgiProcess& proc) {
 
 		int pipeStdin[2];
 		int pipeStdout[2];
@@ -1188,170 +1607,24 @@ namespace {
 
 		close(pipeStdin[0]); close(pipeStdout[1]);
 
-		pipes.stdinParent = pipeStdin[1];							// Parent will write request body here
-		pipes.stdoutParent = pipeStdout[0];							// Parent will read CGI output here
-		pipes.pid = pid;
+		proc.stdinFd = pipeStdin[1];								// Parent will write request body here
+		proc.stdoutFd = pipeStdout[0];								// Parent will read CGI output here
+		proc.pid = pid;
 
 		int	flags;
 
-		flags = fcntl(pipes.stdinParent, F_GETFL, 0);					// Make parent-side CGI pipes non-blocking
+		flags = fcntl(proc.stdinFd, F_GETFL, 0);					// Make parent-side CGI pipes non-blocking
 		if (flags != -1)
-			fcntl(pipes.stdinParent, F_SETFL, flags | O_NONBLOCK);
+			fcntl(proc.stdinFd, F_SETFL, flags | O_NONBLOCK);
 
-		flags = fcntl(pipes.stdoutParent, F_GETFL, 0);
+		flags = fcntl(proc.stdoutFd, F_GETFL, 0);
 		if (flags != -1)
-			fcntl(pipes.stdoutParent, F_SETFL, flags | O_NONBLOCK);
-
-		return true;
-	}
-
-	/*
-	 Streams reqBody to the CGI child's stdin while draining its stdout using poll() slices;
-	 enforces an inactivity timeout, closes stdin to signal EOF, and returns collected stdout + exit status.
-	*/
-	CgiRawOutput pumpCgiPipes(const CgiPipes& pipes, std::size_t timeoutSeconds, const std::string& reqBody) {
-
-		CgiRawOutput	cgiOutput;
-
-		// Inactivity timeout implemented via repeated short poll() slices
-		const int		timeoutMs = static_cast<int>(timeoutSeconds * 1000);
-		const int		sliceMs = 200;						// max wait time per poll() call
-		int				idleMs = 0;							// time spent with no I/O activity
-
-		size_t			written = 0;						// how many bytes have already been sent to the CGI
-
-		bool			stdinClosed = false;				// parent closed CGI stdin (EOF sent)
-		bool			eof = false;						// reached EOF on CGI stdout
-
-		if (reqBody.size() == 0) {							// no body: close stdin immediately so CGI sees EOF
-			stdinClosed = true;
-			close(pipes.stdinParent);
-		}
-
-		while (!eof && !cgiOutput.timedOut){
-			
-			struct pollfd	pfds[2];						// stdout always; stdin only while open
-			int				nfds = 0;						// number of fds passed to poll()
-
-			pfds[nfds].fd = pipes.stdoutParent;						// stdout: always poll until EOF
-			pfds[nfds].events = POLLIN | POLLHUP | POLLERR;
-			pfds[nfds].revents = 0;
-			nfds++;
-
-			if (!stdinClosed)	{									// stdin: poll while we still have body to send (or until we close)
-				pfds[nfds].fd = pipes.stdinParent;
-				pfds[nfds].events = POLLOUT | POLLHUP | POLLERR ;
-				pfds[nfds].revents = 0;
-				nfds++;
-			}
-
-			int	pollResult = poll(pfds, nfds, sliceMs);
-
-			if (pollResult < 0)	{
-				if (errno == EINTR)						// interrupted by signal: retry
-					continue;
-				eof = true;								// poll failed: stop I/O loop
-				if (!stdinClosed) {
-					close(pipes.stdinParent);
-					stdinClosed = true;
-				}
-				break;
-			}
-
-			if (pollResult == 0)	{					// slice timed out: no events occurred
-				idleMs += sliceMs;
-				if (idleMs >= timeoutMs) {
-					cgiOutput.timedOut = true;			// inactivity timeout reached
-					if (!stdinClosed) {
-						close(pipes.stdinParent);
-						stdinClosed = true;
-					}
-					break;
-				}
-				continue;
-			}
-
-			bool	progressed = false;							// any I/O progress in this iteration?
-			
-			// 1) Read CGI stdout (fd index 0)
-			{
-				if (pfds[0].revents & POLLERR)											// Fatal error on the file descriptor - no further reads are possible
-					eof = true;
-				
-				if (pfds[0].revents & (POLLIN | POLLHUP))	{
-					char	buf[4096];													// reasonable chunk size for pipe reads
-					for (;;)	{
-						
-						ssize_t	n = read(pipes.stdoutParent, buf, sizeof(buf));			// signed size type (may be -1 on error)
-						
-						if (n > 0)	{
-							cgiOutput.data.append(buf, static_cast<size_t>(n));
-							progressed = true;
-							continue;
-						}
-						
-						if (n == 0)	{
-							eof = true;
-						}
-
-						break;															// no more data to read for now (case, n = -1)
-					}
-
-					if ((pfds[0].revents & POLLHUP) && !(pfds[0].revents & POLLIN))		// hangup with no pending data
-						eof = true;
-				}
-			}
+			fcntl(proc.stdoutFd, F_SETFL, flags | O_NONBLOCK);
 
-			// 2) Write CGI stdin (fd index 1, only if present)
-			if (!stdinClosed)	{
+		setCloseOnExec(proc.stdinFd);
+		setCloseOnExec(proc.stdoutFd);
 
-				if (pfds[1].revents & (POLLERR | POLLHUP))	{							// Child closed stdin or error
-					stdinClosed = true;
-					close(pipes.stdinParent);
-				}
-				else if (pfds[1].revents & POLLOUT)	{									// stdin writable: can send more data to CGI stdin
-					while (written < reqBody.size())	{
-						
-						ssize_t	n = write(pipes.stdinParent, reqBody.data() + written, reqBody.size() - written);
-
-						if (n > 0)	{
-							written += static_cast<size_t>(n);
-							progressed = true;
-							continue;
-						}
-
-						break;
-					}
-
-					if (!stdinClosed && written == reqBody.size())	{
-						stdinClosed = true;
-						close(pipes.stdinParent);							// close parent's write end (send EOF to CGI stdin)
-					}
-				}
-			}
-
-			if (progressed)													// Reset the idle timeout when progress occurs
-				idleMs = 0;
-		}
-
-		if (cgiOutput.timedOut)	{											// timeout: kill CGI
-			kill(pipes.pid, SIGKILL);
-			waitpid(pipes.pid, NULL, 0);									// avoid zombie
-			close(pipes.stdoutParent);
-			return cgiOutput;
-		}
-
-		int	childStatus = 0;												// Retrieve exit status from CGI
-		if (waitpid(pipes.pid, &childStatus, 0) > 0)	{
-			if (WIFEXITED(childStatus))
-				cgiOutput.exitStatus = WEXITSTATUS(childStatus);
-			else if (WIFSIGNALED(childStatus))
-				cgiOutput.exitStatus = 128 + WTERMSIG(childStatus);
-		}
-
-		close(pipes.stdoutParent);											// done with CGI stdout pipe
-
-		return cgiOutput;
+		return true;
 	}
 
 	/*
@@ -1548,15 +1821,58 @@ namespace {
 	}
 	
 	/*
-	 Handles execution of a CGI script: validates the target file and method,
-	 spawns the CGI process, streams the request body, reads its output with
-	 a timeout, validates CGI headers, and converts the result into an HTTP
-	 response or an appropriate 4xx/5xx error.
+	 Returns the FastCGI application socket configured for the script's
+	 extension ("fastcgi_pass"), or "" when it runs as a forked CGI.
+	*/
+	std::string fastcgiSocketFor(const EffectiveConfig& cfg, const std::string& fsPath) {
+
+		std::string ext = getFileExtension(fsPath);
+		if (ext.empty())
+			return "";
+
+		std::map<std::string, std::string>::const_iterator it = cfg.fastcgiPass.find('.' + ext);
+		return it == cfg.fastcgiPass.end() ? "" : it->second;
+	}
+
+	/*
+	 FastCGI variant of handleCgiRequest(): nothing is spawned. The response is
+	 a cgiPending placeholder carrying the CGI variables and the pool limits;
+	 the core hands the request to a persistent backend of that socket and
+	 calls buildCgiResponse() with its output.
+	*/
+	HTTP_Response handleFastCgiRequest(const HTTP_Request& req, const EffectiveConfig& cfg, const std::string& fsPath, const std::string& socketPath) {
+
+		if (access(fsPath.c_str(), F_OK) != 0)							// The application runs SCRIPT_FILENAME: it has to exist
+			return makeErrorResponse(errno == EACCES ? 403 : 404, &cfg);
+
+		HTTP_Response res;
+
+		res.cgiPending = true;
+		res.cgi.fastcgiSocket = socketPath;
+		res.cgi.params = buildCgiEnv(req, cfg, fsPath);
+		res.cgi.poolSize = cfg.fastcgiPoolSize;
+		res.cgi.queueSize = cfg.fastcgiQueueSize;
+		res.cgi.scriptPath = fsPath;
+		res.cgi.timeoutMs = static_cast<long>(cfg.cgiTimeout * 1000);
+		res.cgi.streamEnabled = cfg.cgiStreaming;
+
+		return res;
+	}
+
+	/*
+	 Starts execution of a CGI script: validates the target file and method,
+	 builds argv/envp and spawns the CGI process. The returned response is only
+	 a placeholder marked cgiPending: the core event loop streams the request
+	 body, collects the output and reaps the child, then calls buildCgiResponse().
 	*/
 	HTTP_Response handleCgiRequest(const HTTP_Request& req, const EffectiveConfig& cfg, const std::string& fsPath) {
 		
 		if (!isCgiMethodAllowed(req, cfg))
-			return makeErrorResponse(405, &cfg);
+			return make405(cfg);
+
+		const std::string socketPath = fastcgiSocketFor(cfg, fsPath);
+		if (!socketPath.empty())
+			return handleFastCgiRequest(req, cfg, fsPath, socketPath);
 
 		std::vector<std::string> argv;
 		if (!prepareCgiExecutor(cfg, fsPath, argv))
@@ -1564,18 +1880,36 @@ namespace {
 
 		std::vector<std::string> envp = buildCgiEnv(req, cfg, fsPath);
 
-		CgiPipes pipes;
-		if (!spawnCgiProcess(argv, envp, pipes))
+		HTTP_Response res;
+		if (!spawnCgiProcess(argv, envp, res.cgi))
 			return makeErrorResponse(500, &cfg);
-		
-		CgiRawOutput raw = pumpCgiPipes(pipes, cfg.cgiTimeout, req.body);
 
-		if (raw.timedOut)
+		res.cgiPending = true;
+		res.cgi.scriptPath = fsPath;
+		res.cgi.timeoutMs = static_cast<long>(cfg.cgiTimeout * 1000);
+		res.cgi.streamEnabled = cfg.cgiStreaming;
+
+		return res;
+	}
+
+	/*
+	 Converts a finished CGI child (output + exit status) into an HTTP response
+	 or an appropriate 4xx/5xx error, validating the CGI header block.
+	*/
+	HTTP_Response finishCgiRequest(const HTTP_Request& req, const EffectiveConfig& cfg, const CgiProcess& cgi) {
+
+		if (cgi.timedOut)
 			return makeErrorResponse(504, &cfg);
 
-		if (raw.exitStatus == -1 || (raw.exitStatus != 0 && raw.data.empty())) {	// If the CGI failed or produced no output, try to map the error
+		if (cgi.rejected)
+			return makeErrorResponse(503, &cfg);						// FastCGI pool and its wait queue are full
+
+		if (!cgi.fastcgiSocket.empty() && cgi.exitStatus == -1)
+			return makeErrorResponse(502, &cfg);						// Backend unreachable, or it broke the protocol
 
-			if (access(fsPath.c_str(), F_OK) != 0) {
+		if (cgi.exitStatus == -1 || (cgi.exitStatus != 0 && cgi.output.empty())) {	// If the CGI failed or produced no output, try to map the error
+
+			if (access(cgi.scriptPath.c_str(), F_OK) != 0) {
 				if (errno == ENOENT)
 					return makeErrorResponse(404, &cfg);
 				if (errno == EACCES)
@@ -1584,7 +1918,7 @@ namespace {
 			return makeErrorResponse(500, &cfg);
 		}
 
-		CgiParsedOutput parsedOutput = parseCgiOutput(raw.data);
+		CgiParsedOutput parsedOutput = parseCgiOutput(cgi.output);
 
 		if (!parsedOutput.headersValid)
 			return makeErrorResponse(500, &cfg);
@@ -1654,9 +1988,8 @@ namespace {
 	*/	
 	bool isMultipart(const HTTP_Request& req) {
 
-		std::map<std::string, std::string>::const_iterator it =	req.headers.find("content-type");
-
-		return (it != req.headers.end() && it->second.find("multipart/form-data") != std::string::npos);
+		return req.headers.has(RequestHeaders::CONTENT_TYPE)
+			&& req.headers.value(RequestHeaders::CONTENT_TYPE).find("multipart/form-data") != std::string::npos;
 	}
 
 	/*
@@ -1728,6 +2061,22 @@ namespace {
 		return 0;									// Success
 	}
 
+	/*
+	 Publishes a body the core already spilled to a temp file inside upload_store.
+	 link() is atomic and never clobbers an existing target (409); the core
+	 removes the temp name afterwards.
+	*/
+	int publishSpilledUpload(const std::string& tmpPath, const std::string& path) {
+
+		if (link(tmpPath.c_str(), path.c_str()) == 0)
+			return 0;
+		if (errno == EEXIST)
+			return 409;
+		if (errno == EACCES || errno == EPERM)
+			return 403;
+		return 500;
+	}
+
 	/*
 	 Builds a 201 Created response with a Location header pointing to the target.
 	*/
@@ -1745,7 +2094,63 @@ namespace {
 		return res;
 	}
 
-	// --- 11.2. Upload Request Handler ---
+	// --- 11.2. Upload Request Handlers ---
+
+	/*
+	 Publishes the file parts of a multipart/form-data upload. The core's
+	 parser already wrote each one to a temp file in upload_store while the
+	 body arrived; every name is checked before any is published, and a
+	 failure part-way unpublishes the earlier ones. 201 lists the stored names.
+	*/
+	HTTP_Response handleMultipartUpload(const HTTP_Request& req, const EffectiveConfig& cfg) {
+
+		if (!isValidUploadDirectory(cfg.uploadStore))
+			return makeErrorResponse(500, &cfg);
+		if (!req.multipart.complete())									// No boundary, or the body ended before the closing delimiter
+			return makeErrorResponse(400, &cfg);
+
+		const std::vector<MultipartPart>& parts = req.multipart.parts();
+		if (parts.empty())
+			return makeErrorResponse(400, &cfg);						// No file in the form
+
+		std::vector<std::string> targets;
+		for (std::size_t i = 0; i < parts.size(); ++i) {
+
+			if (!isSanitizedFilename(parts[i].filename))
+				return makeErrorResponse(400, &cfg);
+			std::string dest = joinPath(cfg.uploadStore, parts[i].filename);
+			if (std::find(targets.begin(), targets.end(), dest) != targets.end())
+				return makeErrorResponse(409, &cfg);					// Same name twice in one form
+			int status = getExistingTargetStatus(dest);
+			if (status != 0)
+				return makeErrorResponse(status, &cfg);
+			targets.push_back(dest);
+		}
+
+		for (std::size_t i = 0; i < parts.size(); ++i) {
+
+			int status = publishSpilledUpload(parts[i].tmpPath, targets[i]);
+			if (status != 0) {
+				while (i-- > 0)
+					std::remove(targets[i].c_str());
+				return makeErrorResponse(status, &cfg);
+			}
+			fileCache().invalidate(targets[i]);
+		}
+
+		std::string base = req.target;
+		std::string::size_type query = base.find('?');
+		if (query != std::string::npos)
+			base.erase(query);
+		if (base.empty() || base[base.size() - 1] != '/')
+			base += '/';
+
+		HTTP_Response res = makeResponse201(base + parts[0].filename);
+		for (std::size_t i = 0; i < parts.size(); ++i)
+			res.body += parts[i].filename + "\n";
+		res.headers["Content-Length"] = toString(res.body.size());
+		return res;
+	}
 
 	/*
 	 Handles a simple upload request: validates the filename and upload directory,
@@ -1753,8 +2158,8 @@ namespace {
 	*/
 	HTTP_Response handleUploadRequest(const HTTP_Request& req, const EffectiveConfig& cfg) {
 
-		if (isMultipart(req))                                           // Allow only simple uploads (reject multipart/form-data - requires boundary parsing)
-			return makeErrorResponse(501, &cfg);
+		if (isMultipart(req))											// Form upload: file parts already streamed to upload_store
+			return handleMultipartUpload(req, cfg);
 
 		std::string filename = extractFilename(req.path);
 		if (filename.empty() || !isSanitizedFilename(filename))         // Filename validation
@@ -1769,10 +2174,14 @@ namespace {
 		if (status != 0)
 			return makeErrorResponse(status, &cfg);
 
-		int writeStatus = writeUploadedFile(dest, req.body);
+		int writeStatus = req.body_file_path.empty()
+			? writeUploadedFile(dest, req.body)
+			: publishSpilledUpload(req.body_file_path, dest);
 		if (writeStatus != 0)
 			return makeErrorResponse(writeStatus, &cfg);
 
+		fileCache().invalidate(dest);
+
 		return makeResponse201(req.target);
 	}
 
@@ -1781,30 +2190,6 @@ namespace {
 	// --- 12. Error pages: custom / generic ---
 	// -----------------------------------------
 
-	/*
-	Resolves error_page configured value into a filesystem path.
-
-	Rule:
-	- If the configured value starts with '/', treat it as a URI under cfg.root.
-	- Otherwise, treat it as a filesystem path relative to the current working directory.
-	*/
-	std::string findErrorPagePath(const EffectiveConfig& cfg, int status) {
-
-		std::map<int, std::string>::const_iterator it = cfg.errorPages.find(status);
-		if (it == cfg.errorPages.end())
-			return "";
-
-		std::string path = it->second;
-		if (path.empty())
-			return "";
-
-		if (path[0] == '/') {						// URI under server root (not filesystem absolute) (nginx-like)
-			return joinPath(cfg.root, path);
-		}
-
-		return path;
-	}
-
 	/*
 	 Returns the standard HTTP reason phrase for a given status code, or
 	 "Unknown Status" if not recognized.
@@ -1840,6 +2225,7 @@ namespace {
 			case 413: return "Payload Too Large";
 			case 414: return "URI Too Long";
 			case 415: return "Unsupported Media Type";
+			case 416: return "Range Not Satisfiable";
 			case 431: return "Request Header Fields Too Large";
 
 			case 500: return "Internal Server Error";				// 5xx — Server errors
@@ -1854,45 +2240,60 @@ namespace {
 	}
 
 	/*
-	 Builds an HTTP error response for the given status code. Uses a configured
-	 custom error_page if available; otherwise falls back to a simple HTML body.
+	 Default HTML body for a status, formatted once per status and kept for the
+	 life of the process (errors under a flood are just copies).
 	*/
-	HTTP_Response makeErrorResponse(int status, const EffectiveConfig* cfg) {
-		
-		std::string	body;
+	const std::string& defaultErrorBody(int status) {
+
+		static std::map<int, std::string> bodies;
+
+		std::map<int, std::string>::iterator it = bodies.find(status);
+		if (it != bodies.end())
+			return it->second;
+
 		const std::string reason = getReasonPhrase(status);
-		
-		if (cfg) {																// Try loading a custom error_page
-			const std::string errorPagePath = findErrorPagePath(*cfg, status);
-			if (!errorPagePath.empty()) {
-				std::ifstream file(errorPagePath.c_str(), std::ios::binary);
-				if (file) {
-					std::ostringstream oss;
-					oss << file.rdbuf();
-					body = oss.str();
-				}
-			}
-		}
-		
-		if (body.empty()) {												// Otherwise, generate default HTML (if no error_page or if reading fails)
-			std::ostringstream oss;
-			oss	<< "<!DOCTYPE html>\n"
-				<< "<html><head><meta charset=\"utf-8\">"
-				<< "<title>" << status << ' ' << reason << "</title>"
-				<< "</head><body>"
-				<< "<h1>" << status << ' ' << reason << "</h1>"
-				<< "</body></html>\n";
-			body = oss.str();
-		}
-		
+		std::ostringstream oss;
+		oss	<< "<!DOCTYPE html>\n"
+			<< "<html><head><meta charset=\"utf-8\">"
+			<< "<title>" << status << ' ' << reason << "</title>"
+			<< "</head><body>"
+			<< "<h1>" << status << ' ' << reason << "</h1>"
+			<< "</body></html>\n";
+		return bodies[status] = oss.str();
+	}
+
+	/*
+	 Builds an HTTP error response for the given status code. Uses the configured
+	 error_page (read when the configuration was loaded) if there is one;
+	 otherwise the default HTML body. The common statuses come from the
+	 location's prebuilt template: no formatting at all, the core splices its head.
+	*/
+	HTTP_Response makeErrorResponse(int status, const EffectiveConfig* cfg) {
+
 		HTTP_Response res;
 
 		res.status = status;													// Fill in the response fields
-		res.reason = reason;
-		res.body = body;
+		res.reason = getReasonPhrase(status);
+
+		std::map<int, PrebuiltError>::const_iterator prebuilt;
+		if (cfg && (prebuilt = cfg->errorResponses.find(status)) != cfg->errorResponses.end()
+			&& prebuilt->second.reason == res.reason) {
+			res.body = prebuilt->second.body;
+			res.headers["Content-Type"] = "text/html";
+			res.headers["Content-Length"] = prebuilt->second.contentLength;
+			res.prebuilt = &prebuilt->second;
+			return res;
+		}
+
+		std::map<int, std::string>::const_iterator page;
+		if (cfg && (page = cfg->errorBodies.find(status)) != cfg->errorBodies.end())
+			res.body = page->second;
+		else
+			res.body = defaultErrorBody(status);
+
 		res.headers.clear();
 		res.headers["Content-Type"] = "text/html";
-		res.headers["Content-Length"] = toString(body.size());
+		res.headers["Content-Length"] = toString(res.body.size());
 
 		return res;
 	}
@@ -2016,6 +2417,9 @@ namespace {
 				uppercase_next = false;
 			}
 		}
+
+		if (result == "Etag")
+			return "ETag";											// The one common field that isn't plain Title-Case
 		
 		return result;
 	}
@@ -2054,16 +2458,7 @@ HTTP_Response handleRequest(const HTTP_Request& req, const Server& srv)
 		return res;
 	}
 
-	const Location* loc = matchLocation(srv, path);
-
-	EffectiveConfig cfg;
-	try {
-		cfg = buildEffectiveConfig(srv, loc);
-	} catch (const std::exception&) {
-		HTTP_Response res = makeErrorResponse(500, NULL);
-		applyConnectionHeader(keepAlive, res);
-		return res;
-	}
+	const EffectiveConfig& cfg = srv.routes.match(path);
 
 	if (cfg.redirectStatus != 0) {
 		HTTP_Response res = makeRedirectResponse(cfg.redirectStatus, cfg.redirectTarget);
@@ -2104,7 +2499,12 @@ HTTP_Response handleRequest(const HTTP_Request& req, const Server& srv)
 		return res;
 	}
 
-	RequestKind kind = classifyRequest(cfg, path, fsPath, req);
+	RequestKind kind;
+	if ((req.method == "GET" || req.method == "HEAD")			// Fresh cache entry: skip the stat() in classifyRequest()
+		&& fileCache().isFresh(fsPath) && !isCgiRequest(cfg, path))
+		kind = RK_STATIC_FILE;
+	else
+		kind = classifyRequest(cfg, path, fsPath, req);
 
 	HTTP_Response res;
 	switch (kind) {
@@ -2137,10 +2537,163 @@ HTTP_Response handleRequest(const HTTP_Request& req, const Server& srv)
 			break;
 	}
 
+	if (res.cgiPending)										// Finished later by buildCgiResponse()
+		return res;
+
 	if (res.close)											// Close requested by handler
 		keepAlive = false;
 
 	applyConnectionHeader(keepAlive, res);
 	headersUppercase(res);
+	compressResponse(req, cfg, res);
+	return res;
+}
+
+/*
+ Prebuilds the App's common error responses for every location of a server
+ (after its route table and timeouts are set): error_page or default body,
+ and for 405 the location's Allow field. The statuses are the ones request
+ floods produce; rarer ones keep going through serialize_head().
+*/
+void prebuildErrorResponses(Server& srv)
+{
+	static const int codes[] = { 403, 404, 405, 409, 413, 500, 501 };
+
+	for (std::size_t r = 0; r <= srv.routes.size(); ++r) {
+		EffectiveConfig& cfg = (r < srv.routes.size()) ? srv.routes.at(r) : srv.routes.fallback();
+
+		cfg.errorResponses.clear();
+		for (std::size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i) {
+			const int status = codes[i];
+			std::map<int, std::string>::const_iterator page = cfg.errorBodies.find(status);
+			const std::string& body = (page != cfg.errorBodies.end()) ? page->second : defaultErrorBody(status);
+			const std::string extra = (status == 405 && !cfg.allowHeader.empty()) ? "Allow: " + cfg.allowHeader + "\r\n" : "";
+			cfg.errorResponses[status] = http::prebuild_error(status, getReasonPhrase(status), body, extra, srv.timeouts.keepAliveMs);
+		}
+	}
+}
+
+/*
+ Applies the "open_file_cache" settings (main context) to the static file cache.
+*/
+void configureFileCache(std::size_t maxBytes, std::size_t validSeconds)
+{
+	fileCache().configure(maxBytes, validSeconds);
+}
+
+/*
+ Content-Type the static handler would send for fsPath (by extension).
+*/
+std::string contentTypeOf(const std::string& fsPath)
+{
+	return getContentType(fsPath);
+}
+
+/*
+ Read-only view of the static file cache counters, for the core's status page.
+*/
+void fileCacheStats(unsigned long& hits, unsigned long& misses, std::size_t& bytes, std::size_t& entries)
+{
+	const FileCache& cache = fileCache();
+
+	hits = cache.hits();
+	misses = cache.misses();
+	bytes = cache.bytes();
+	entries = cache.entries();
+}
+
+/*
+ Called by the core once the request head is parsed: if the request will be
+ handled as an upload (simple or multipart/form-data), returns its
+ upload_store directory so the body (or each file part) can be streamed to a
+ temp file there while it arrives. Empty otherwise (the body is then
+ buffered in memory as usual).
+*/
+std::string uploadSpillDirectory(const HTTP_Request& req, const Server& srv)
+{
+	if (req.method != "POST")
+		return "";
+
+	std::string path;
+	std::string query;
+	if (!parseTarget(req, path, query))
+		return "";
+
+	const EffectiveConfig& cfg = srv.routes.match(path);
+
+	if (cfg.redirectStatus != 0 || !isMethodAllowed(cfg, req.method) || isCgiRequest(cfg, path))
+		return "";
+	if (cfg.uploadStore.empty() || !isValidUploadDirectory(cfg.uploadStore))
+		return "";
+
+	return cfg.uploadStore;
+}
+
+/*
+ Completes a CGI request once the core has collected the child's output and
+ exit status: re-resolves the effective configuration (for error pages) and
+ applies the same connection/header post-processing as handleRequest().
+*/
+HTTP_Response buildCgiResponse(const HTTP_Request& req, const Server& srv, const CgiProcess& cgi)
+{
+	bool keepAlive = req.keep_alive;
+
+	std::string path;
+	std::string query;
+	const EffectiveConfig& cfg = parseTarget(req, path, query) ? srv.routes.match(path) : srv.routes.fallback();
+
+	HTTP_Response res = finishCgiRequest(req, cfg, cgi);
+
+	if (res.close)
+		keepAlive = false;
+
+	applyConnectionHeader(keepAlive, res);
+	headersUppercase(res);
+	compressResponse(req, cfg, res);
 	return res;
 }
+
+/*
+ Streaming CGI: called by the core while the script is still running. Once
+ the header block in cgi.output is complete, builds the response head so the
+ body can be forwarded as it is produced: bodyStart is where the body begins
+ in cgi.output, contentLength the script's own Content-Length, or -1 when the
+ core frames the body with chunked encoding. Returns false while the headers
+ are incomplete, and for output that can't be streamed (invalid headers,
+ bodyless statuses): that output is buffered to the end as before.
+ Streamed bodies are not compressed.
+*/
+bool buildCgiStreamHead(const HTTP_Request& req, const CgiProcess& cgi, HTTP_Response& head, std::size_t& bodyStart, long long& contentLength)
+{
+	const std::string& raw = cgi.output;
+	std::string::size_type crlf = raw.find("\r\n\r\n");
+	std::string::size_type lf = raw.find("\n\n");
+	if (crlf == std::string::npos && lf == std::string::npos)
+		return false;
+	bodyStart = (lf == std::string::npos || (crlf != std::string::npos && crlf < lf)) ? crlf + 4 : lf + 2;
+
+	CgiParsedOutput parsed = parseCgiOutput(raw.substr(0, bodyStart));
+	if (!parsed.headersValid
+		|| (!parsed.headers.count("content-type") && !parsed.headers.count("location")))
+		return false;															// finishCgiRequest() turns it into the error
+
+	head = buildCgiHttpResponse(parsed);
+	if (head.status < 200 || head.status == 204 || head.status == 304)
+		return false;
+
+	contentLength = -1;
+	std::map<std::string, std::string>::const_iterator cl = parsed.headers.find("content-length");
+	if (cl != parsed.headers.end() && !cl->second.empty() && cl->second.size() < 19
+		&& cl->second.find_first_not_of("0123456789") == std::string::npos)
+		contentLength = std::atoll(cl->second.c_str());
+
+	head.headers.erase("content-length");
+	if (contentLength < 0)
+		head.headers["transfer-encoding"] = "chunked";
+	else
+		head.headers["content-length"] = toString(contentLength);
+
+	applyConnectionHeader(req.keep_alive, head);
+	headersUppercase(head);
+	return true;
+}
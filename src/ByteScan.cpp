@@ -0,0 +1,122 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ByteScan.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ByteScan.hpp"
+#include <cstring>
+
+#if !defined(WEBSERV_NO_SIMD) && defined(__SSE2__)
+# define BYTESCAN_SSE2
+# include <emmintrin.h>
+#elif !defined(WEBSERV_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+# define BYTESCAN_NEON
+# include <arm_neon.h>
+#endif
+
+namespace   {
+
+    // Scalar search, also the tail of the vector loops (fewer than 16 bytes left).
+    const char* scalarFind(const char* p, const char* end, std::size_t len) {
+        static const char   pattern[] = "\r\n\r\n";
+
+        while (end - p >= static_cast<std::ptrdiff_t>(len)) {
+            const void* cr = std::memchr(p, '\r', static_cast<std::size_t>(end - p) - len + 1);
+            if (!cr)
+                return NULL;
+            p = static_cast<const char*>(cr);
+            if (std::memcmp(p, pattern, len) == 0)
+                return p;
+            ++p;
+        }
+        return NULL;
+    }
+
+#if defined(BYTESCAN_SSE2)
+
+    // Bit i set when "\r\n" (len 2) or "\r\n\r\n" (len 4) starts at p + i.
+    // The loads overlap: p + 1..3 only have to be readable up to p + 18.
+    inline int  matchMask(const char* p, std::size_t len) {
+        const __m128i   cr = _mm_set1_epi8('\r');
+        const __m128i   lf = _mm_set1_epi8('\n');
+        __m128i         m = _mm_and_si128(
+                            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), cr),
+                            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), lf));
+        if (len == 4)
+            m = _mm_and_si128(m, _mm_and_si128(
+                            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2)), cr),
+                            _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3)), lf)));
+        return _mm_movemask_epi8(m);
+    }
+
+    const char* vectorFind(const char* p, const char* end, std::size_t len) {
+        while (end - p >= static_cast<std::ptrdiff_t>(16 + len - 1)) {
+            const int   mask = matchMask(p, len);
+            if (mask)
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            p += 16;
+        }
+        return scalarFind(p, end, len);
+    }
+
+#elif defined(BYTESCAN_NEON)
+
+    const char* vectorFind(const char* p, const char* end, std::size_t len) {
+        const uint8x16_t    cr = vdupq_n_u8('\r');
+        const uint8x16_t    lf = vdupq_n_u8('\n');
+
+        while (end - p >= static_cast<std::ptrdiff_t>(16 + len - 1)) {
+            const uint8_t*  u = reinterpret_cast<const uint8_t*>(p);
+            uint8x16_t      m = vandq_u8(vceqq_u8(vld1q_u8(u), cr), vceqq_u8(vld1q_u8(u + 1), lf));
+            if (len == 4)
+                m = vandq_u8(m, vandq_u8(vceqq_u8(vld1q_u8(u + 2), cr), vceqq_u8(vld1q_u8(u + 3), lf)));
+            if (vmaxvq_u8(m)) {
+                uint8_t lanes[16];
+                vst1q_u8(lanes, m);
+                for (int i = 0; i < 16; ++i)
+                    if (lanes[i])
+                        return p + i;
+            }
+            p += 16;
+        }
+        return scalarFind(p, end, len);
+    }
+
+#else
+
+    const char* vectorFind(const char* p, const char* end, std::size_t len) {
+        return scalarFind(p, end, len);
+    }
+
+#endif
+
+}
+
+namespace   bytescan    {
+
+    const char* findCrlf(const char* p, const char* end) {
+        return vectorFind(p, end, 2);
+    }
+
+    const char* findCrlfCrlf(const char* p, const char* end) {
+        return vectorFind(p, end, 4);
+    }
+
+    const char* kernelName() {
+#if defined(BYTESCAN_SSE2)
+        return "sse2";
+#elif defined(BYTESCAN_NEON)
+        return "neon";
+#else
+        return "scalar";
+#endif
+    }
+
+}
@@ -0,0 +1,201 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ClientLimiter.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/ClientLimiter.hpp"
+
+static const std::size_t	MIN_TABLE = 64;
+static const unsigned long	TOKEN = 1000;	// one request, in bucket units
+
+// IPv4 keys differ in their low bits only: mix them before masking.
+static std::size_t	slotOf(uint64_t key, std::size_t mask)	{
+	return static_cast<std::size_t>((key ^ (key >> 29)) * 0x9E3779B97F4A7C15ULL) & mask;
+}
+
+ClientLimiter::ClientLimiter()
+	:	_used(0)
+{}
+
+void	ClientLimiter::configure(const AdmissionLimits& limits)	{
+	_limits = limits;
+	if (_limits.ratePerSec > 0 && _limits.burst == 0)
+		_limits.burst = 1;
+	_table.clear();
+	_used = 0;
+}
+
+// IPv4 (and v4-mapped IPv6) keys are the address with a tag bit; IPv6 clients
+// are grouped by their /64 (one host usually owns a whole prefix) and hashed
+// with FNV-1a into the upper half of the key space.
+uint64_t	ClientLimiter::keyOf(const struct sockaddr* addr, socklen_t len)	{
+
+	if (!addr)
+		return 0;
+	if (addr->sa_family == AF_INET && len >= static_cast<socklen_t>(sizeof(struct sockaddr_in)))	{
+		const struct sockaddr_in*	in = reinterpret_cast<const struct sockaddr_in*>(addr);
+		return (static_cast<uint64_t>(1) << 32) | ntohl(in->sin_addr.s_addr);
+	}
+	if (addr->sa_family == AF_INET6 && len >= static_cast<socklen_t>(sizeof(struct sockaddr_in6)))	{
+		const unsigned char*	b = reinterpret_cast<const struct sockaddr_in6*>(addr)->sin6_addr.s6_addr;
+		static const unsigned char	V4_MAPPED[12] = { 0,0,0,0, 0,0,0,0, 0,0,0xff,0xff };
+		if (std::memcmp(b, V4_MAPPED, sizeof(V4_MAPPED)) == 0)
+			return (static_cast<uint64_t>(1) << 32)
+				| (static_cast<uint64_t>(b[12]) << 24) | (b[13] << 16) | (b[14] << 8) | b[15];
+		uint64_t	h = 14695981039346656037ULL;
+		for (int i = 0; i < 8; ++i)	{
+			h ^= b[i];
+			h *= 1099511628211ULL;
+		}
+		return h | (static_cast<uint64_t>(1) << 63);
+	}
+	return 0;
+}
+
+// IPv4 keys hold the address itself (X-Forwarded-For); IPv6 ones are hashes.
+std::string	ClientLimiter::addressOf(uint64_t key)	{
+
+	if ((key >> 32) != 1)
+		return "";
+	std::ostringstream	out;
+	out << ((key >> 24) & 0xff) << '.' << ((key >> 16) & 0xff) << '.' << ((key >> 8) & 0xff) << '.' << (key & 0xff);
+	return out.str();
+}
+
+bool	ClientLimiter::openConnection(uint64_t key)	{
+
+	if (_limits.perIpConnections == 0 || key == 0)
+		return true;
+	Entry*	entry = find(key, true, 0);
+	if (entry->connections >= _limits.perIpConnections)
+		return false;
+	++entry->connections;
+	return true;
+}
+
+void	ClientLimiter::closeConnection(uint64_t key)	{
+
+	if (_limits.perIpConnections == 0 || key == 0)
+		return;
+	Entry*	entry = find(key, false, 0);
+	if (entry && entry->connections > 0)
+		--entry->connections;
+}
+
+bool	ClientLimiter::admitRequest(uint64_t key, long nowMs)	{
+
+	if (_limits.ratePerSec == 0 || key == 0)
+		return true;
+	Entry*	entry = find(key, true, nowMs);
+	refill(*entry, nowMs);
+	if (entry->tokens < TOKEN)
+		return false;
+	entry->tokens -= TOKEN;
+	return true;
+}
+
+// Clients that hold no connection and have a full bucket are the same as
+// unknown ones: rebuilding without them keeps the table small after a spike.
+void	ClientLimiter::sweep(long nowMs)	{
+
+	if (_used == 0)
+		return;
+	std::size_t	live = 0;
+	for (std::size_t i = 0; i < _table.size(); ++i)
+		if (_table[i].key != 0 && !idle(_table[i], nowMs))
+			++live;
+	if (live == _used)
+		return;
+	std::size_t	capacity = MIN_TABLE;
+	while (capacity < live * 2)
+		capacity *= 2;
+	rehash(capacity, nowMs);
+}
+
+std::size_t	ClientLimiter::clients() const	{
+	return _used;
+}
+
+ClientLimiter::Entry*	ClientLimiter::find(uint64_t key, bool create, long nowMs)	{
+
+	if (create && (_used + 1) * 2 > _table.size())
+		rehash(_table.empty() ? MIN_TABLE : _table.size() * 2, -1);
+	if (_table.empty())
+		return NULL;
+
+	const std::size_t	mask = _table.size() - 1;
+	std::size_t			i = slotOf(key, mask);
+	while (_table[i].key != 0)	{
+		if (_table[i].key == key)
+			return &_table[i];
+		i = (i + 1) & mask;
+	}
+	if (!create)
+		return NULL;
+
+	Entry&	entry = _table[i];
+	entry.key = key;
+	entry.connections = 0;
+	entry.tokens = _limits.burst * TOKEN;	// a new client starts with a full bucket
+	entry.refilledMs = nowMs;
+	++_used;
+	return &entry;
+}
+
+void	ClientLimiter::refill(Entry& entry, long nowMs) const	{
+
+	const unsigned long	full = _limits.burst * TOKEN;
+	if (nowMs <= entry.refilledMs)
+		return;
+	const unsigned long	elapsed = static_cast<unsigned long>(nowMs - entry.refilledMs);
+	entry.refilledMs = nowMs;
+	// ratePerSec requests a second = ratePerSec units a millisecond
+	if (elapsed >= (full - entry.tokens) / _limits.ratePerSec + 1)
+		entry.tokens = full;
+	else
+		entry.tokens += elapsed * _limits.ratePerSec;
+	if (entry.tokens > full)
+		entry.tokens = full;
+}
+
+bool	ClientLimiter::idle(Entry& entry, long nowMs) const	{
+
+	if (entry.connections > 0)
+		return false;
+	if (_limits.ratePerSec == 0)
+		return true;
+	refill(entry, nowMs);
+	return entry.tokens >= _limits.burst * TOKEN;
+}
+
+// nowMs < 0: grow only (keep every client); otherwise drop the idle ones.
+void	ClientLimiter::rehash(std::size_t capacity, long nowMs)	{
+
+	std::vector<Entry>	old;
+	old.swap(_table);
+	Entry	empty;
+	empty.key = 0;
+	empty.connections = 0;
+	empty.tokens = 0;
+	empty.refilledMs = 0;
+	_table.assign(capacity, empty);
+	_used = 0;
+
+	const std::size_t	mask = capacity - 1;
+	for (std::size_t j = 0; j < old.size(); ++j)	{
+		if (old[j].key == 0 || (nowMs >= 0 && idle(old[j], nowMs)))
+			continue;
+		std::size_t	i = slotOf(old[j].key, mask);
+		while (_table[i].key != 0)
+			i = (i + 1) & mask;
+		_table[i] = old[j];
+		++_used;
+	}
+}
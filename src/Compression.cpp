@@ -0,0 +1,159 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Compression.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*	---------------------------------------------------------------------------
+	Response compression
+
+	Content negotiation for Accept-Encoding and the zlib wrapper used by the
+	App's compression stage. Built without zlib (make GZIP=off), only the
+	negotiation remains, which is all "gzip_static on;" needs.
+	------------------------------------------------------------------------- */
+
+#include "Compression.hpp"
+
+#ifdef WEBSERV_HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+namespace {
+
+	/*
+	 Parses a qvalue ("1", "0.5", "0.000"), returns 1.0 on anything malformed
+	 so a sloppy client still gets the coding it named.
+	*/
+	double parseQValue(const std::string& params) {
+
+		std::string::size_type q = params.find("q=");
+		if (q == std::string::npos)
+			q = params.find("Q=");
+		if (q == std::string::npos)
+			return 1.0;
+
+		const char*	start = params.c_str() + q + 2;
+		char*		end = NULL;
+		double		value = std::strtod(start, &end);
+		if (end == start || value < 0.0 || value > 1.0)
+			return 1.0;
+		return value;
+	}
+
+	/*
+	 Lowercased coding token of one Accept-Encoding element ("GZip ;q=1" -> "gzip").
+	*/
+	std::string codingToken(const std::string& element) {
+
+		std::string token;
+		for (std::string::size_type i = 0; i < element.size() && element[i] != ';'; ++i) {
+			unsigned char c = static_cast<unsigned char>(element[i]);
+			if (!std::isspace(c))
+				token += static_cast<char>(std::tolower(c));
+		}
+		return token;
+	}
+
+} // namespace
+
+ContentCoding negotiateCoding(const std::string& acceptEncoding)
+{
+	double	gzipQ = -1.0;												// -1: not listed
+	double	deflateQ = -1.0;
+	double	starQ = -1.0;
+
+	std::string::size_type start = 0;
+	while (start <= acceptEncoding.size()) {
+
+		std::string::size_type comma = acceptEncoding.find(',', start);
+		if (comma == std::string::npos)
+			comma = acceptEncoding.size();
+
+		const std::string			element = acceptEncoding.substr(start, comma - start);
+		const std::string			token = codingToken(element);
+		const std::string::size_type semi = element.find(';');
+		const double				q = (semi == std::string::npos) ? 1.0 : parseQValue(element.substr(semi + 1));
+
+		if (token == "gzip" || token == "x-gzip")
+			gzipQ = q;
+		else if (token == "deflate")
+			deflateQ = q;
+		else if (token == "*")
+			starQ = q;
+
+		start = comma + 1;
+	}
+
+	if (gzipQ < 0.0)
+		gzipQ = starQ;
+	if (deflateQ < 0.0)
+		deflateQ = starQ;
+
+	if (gzipQ > 0.0 && gzipQ >= deflateQ)
+		return CODING_GZIP;
+	if (deflateQ > 0.0)
+		return CODING_DEFLATE;
+	return CODING_IDENTITY;
+}
+
+const char* codingName(ContentCoding coding)
+{
+	if (coding == CODING_GZIP)
+		return "gzip";
+	if (coding == CODING_DEFLATE)
+		return "deflate";
+	return "identity";
+}
+
+#ifdef WEBSERV_HAVE_ZLIB
+
+bool compressBody(const std::string& in, ContentCoding coding, int level, std::string& out)
+{
+	if (coding == CODING_IDENTITY)
+		return false;
+
+	z_stream	zs;
+	std::memset(&zs, 0, sizeof(zs));
+
+	const int	windowBits = (coding == CODING_GZIP) ? 15 + 16 : 15;	// +16: gzip header/trailer instead of zlib's
+	if (deflateInit2(&zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	std::string	buffer;
+	buffer.resize(deflateBound(&zs, static_cast<uLong>(in.size())) + 32);	// + gzip header/trailer slack
+
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+	zs.avail_in = static_cast<uInt>(in.size());
+	zs.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+	zs.avail_out = static_cast<uInt>(buffer.size());
+
+	const int	rc = deflate(&zs, Z_FINISH);
+	const std::size_t produced = buffer.size() - zs.avail_out;
+	deflateEnd(&zs);
+
+	if (rc != Z_STREAM_END)
+		return false;
+
+	buffer.resize(produced);
+	out.swap(buffer);
+	return true;
+}
+
+#else
+
+bool compressBody(const std::string& in, ContentCoding coding, int level, std::string& out)
+{
+	(void)in;
+	(void)coding;
+	(void)level;
+	(void)out;
+	return false;
+}
+
+#endif
@@ -11,6 +11,8 @@
 /* ************************************************************************** */
 
 #include "../include/Config.hpp"
+#include "../include/HttpSerializer.hpp"
+#include "../include/App.hpp"
 
 // Forward declarations of static functions
 static void parseServerBlock(const std::vector<std::string>& tokens, std::size_t& i, std::vector<Server>& servers);
@@ -20,6 +22,13 @@ static void handleErrorPage(Server& srv, const std::vector<std::string>& tokens,
 static void parseLocationBlock(const std::vector<std::string>& tokens, std::size_t& i, Location& loc);
 static void handleLocation(Server& srv, const std::vector<std::string>& tokens, std::size_t& i);
 static void handleGenericDirective(Server& srv, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleWorkerProcesses(GlobalSettings& globals, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleGlobalSize(std::size_t& out, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleServerTimeout(long& outMs, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleGlobalCount(std::size_t& out, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleRequestLimit(AdmissionLimits& limits, const std::vector<std::string>& tokens, std::size_t& i);
+static void handleAccessLog(AccessLogSettings& log, const std::vector<std::string>& tokens, std::size_t& i);
+static bool parseOptionNumber(const std::string& value, int& out);
 // ****************************************************************************
 
 // Print Tokens Tester Function
@@ -51,6 +60,11 @@ const std::vector<Server>& Config::getServers() const  {
     return _servers;
 }
 
+// Get the main-context settings
+const GlobalSettings& Config::getGlobals() const    {
+    return _globals;
+}
+
 // ****************************************************************************
 
 // Parse the configuration file
@@ -152,8 +166,6 @@ void    Config::tokenize(const std::string& contents, std::vector<std::string>&
 void    Config::parseTokens(const std::vector<std::string>& tokens)   {
 
     std::size_t  i = 0;
-	while (i < tokens.size() && tokens[i] != "server")
-		++i;
     while (i < tokens.size())   {
         if (tokens[i] == "server")  {
             ++i;
@@ -162,8 +174,36 @@ void    Config::parseTokens(const std::vector<std::string>& tokens)   {
             ++i;
             parseServerBlock(tokens, i, _servers);
         }
-        else
+        else if (tokens[i] == "worker_processes")   {
+            ++i;
+            handleWorkerProcesses(_globals, tokens, i);
+        }
+        else if (tokens[i] == "open_file_cache")    {
+            ++i;
+            handleGlobalSize(_globals.openFileCacheBytes, "open_file_cache", tokens, i);
+        }
+        else if (tokens[i] == "open_file_cache_valid")  {
+            ++i;
+            handleGlobalSize(_globals.openFileCacheValid, "open_file_cache_valid", tokens, i);
+        }
+        else if (tokens[i] == "worker_connections")   {
+            ++i;
+            handleGlobalCount(_globals.admission.maxConnections, "worker_connections", tokens, i);
+        }
+        else if (tokens[i] == "limit_conn_per_ip")    {
+            ++i;
+            handleGlobalCount(_globals.admission.perIpConnections, "limit_conn_per_ip", tokens, i);
+        }
+        else if (tokens[i] == "limit_req_per_ip")     {
             ++i;
+            handleRequestLimit(_globals.admission, tokens, i);
+        }
+        else if (tokens[i] == "access_log")   {
+            ++i;
+            handleAccessLog(_globals.accessLog, tokens, i);
+        }
+        else
+            ++i;    // other main-context tokens are ignored
     }
 
 }
@@ -196,11 +236,293 @@ static void parseServerBlock(const std::vector<std::string>& tokens, std::size_t
         throw   std::runtime_error("Missing '}' at the end of server block");
     ++i;
 
+    srv.routes.compile(srv);    // freeze locations + server directives into the route table
+    http::prebuild_error_responses(srv);    // needs the route table (error_page bodies) and the timeouts
+    prebuildErrorResponses(srv);            // the App's, per location
     servers.push_back(srv);
 }
 
 
 
+// Handle the top-level "worker_processes" directive: a count or "auto" (one per online CPU)
+static void handleWorkerProcesses(GlobalSettings& globals, const std::vector<std::string>& tokens, std::size_t& i)  {
+
+	const long	MAX_WORKERS = 64;
+
+	if (i >= tokens.size() || tokens[i] == ";")
+		throw	std::runtime_error("Worker_Processes: Need a value");
+
+	const std::string&	value = tokens[i];
+	long				n;
+
+	if (value == "auto")	{
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+		if (n < 1)
+			n = 1;
+	}
+	else	{
+		char*	endptr = 0;
+		n = std::strtol(value.c_str(), &endptr, 10);
+		if (endptr == value.c_str() || *endptr != '\0' || n < 1)
+			throw	std::runtime_error("Worker_Processes: Invalid value '" + value + "'");
+	}
+	if (n > MAX_WORKERS)
+		n = MAX_WORKERS;
+	globals.workerProcesses = static_cast<std::size_t>(n);
+
+	++i;
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error("Worker_Processes: Missing ';' after worker_processes");
+	++i;
+}
+
+
+
+// Handle a main-context "<key> <number>[k|M|G];" directive ("off" -> 0)
+static void handleGlobalSize(std::size_t& out, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i)	{
+
+	if (i >= tokens.size() || tokens[i] == ";")
+		throw	std::runtime_error(key + ": Need a value");
+
+	const std::string&	value = tokens[i];
+
+	if (value == "off")
+		out = 0;
+	else	{
+		char*			endptr = 0;
+		unsigned long	n = std::strtoul(value.c_str(), &endptr, 10);
+		if (endptr == value.c_str() || value[0] == '-')
+			throw	std::runtime_error(key + ": Invalid value '" + value + "'");
+
+		unsigned long	unit = 1;
+		if (*endptr == 'k' || *endptr == 'K')
+			unit = 1024UL;
+		else if (*endptr == 'm' || *endptr == 'M')
+			unit = 1024UL * 1024UL;
+		else if (*endptr == 'g' || *endptr == 'G')
+			unit = 1024UL * 1024UL * 1024UL;
+		else if (*endptr != '\0')
+			throw	std::runtime_error(key + ": Invalid value '" + value + "'");
+		if (unit != 1 && endptr[1] != '\0')
+			throw	std::runtime_error(key + ": Invalid value '" + value + "'");
+		if (n > static_cast<unsigned long>(-1) / unit)
+			throw	std::runtime_error(key + ": Value too large '" + value + "'");
+		out = static_cast<std::size_t>(n * unit);
+	}
+
+	++i;
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error(key + ": Missing ';' after " + key);
+	++i;
+}
+
+// Handle a main-context "<key> <count>;" directive ("off" -> 0, unlimited)
+static void handleGlobalCount(std::size_t& out, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i)	{
+
+	if (i >= tokens.size() || tokens[i] == ";")
+		throw	std::runtime_error(key + ": Need a value");
+
+	const std::string&	value = tokens[i];
+
+	if (value == "off")
+		out = 0;
+	else	{
+		char*			endptr = 0;
+		unsigned long	n = std::strtoul(value.c_str(), &endptr, 10);
+		if (endptr == value.c_str() || *endptr != '\0' || value[0] == '-' || n == 0)
+			throw	std::runtime_error(key + ": Invalid value '" + value + "'");
+		out = static_cast<std::size_t>(n);
+	}
+
+	++i;
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error(key + ": Missing ';' after " + key);
+	++i;
+}
+
+// Handle "limit_req_per_ip <N>r/s [burst=M];" or "limit_req_per_ip off;"
+// (the burst defaults to one second worth of requests)
+static void handleRequestLimit(AdmissionLimits& limits, const std::vector<std::string>& tokens, std::size_t& i)	{
+
+	if (i >= tokens.size() || tokens[i] == ";")
+		throw	std::runtime_error("limit_req_per_ip: Need a value");
+
+	const std::string&	rate = tokens[i];
+	if (rate == "off")	{
+		limits.ratePerSec = 0;
+		limits.burst = 0;
+	}
+	else	{
+		char*			endptr = 0;
+		unsigned long	n = std::strtoul(rate.c_str(), &endptr, 10);
+		if (endptr == rate.c_str() || rate[0] == '-' || n == 0 || std::string(endptr) != "r/s" || n > 1000000UL)
+			throw	std::runtime_error("limit_req_per_ip: Invalid rate '" + rate + "' (expected <N>r/s)");
+		limits.ratePerSec = n;
+		limits.burst = n;
+
+		if (i + 1 < tokens.size() && tokens[i + 1].compare(0, 6, "burst=") == 0)	{
+			++i;
+			const std::string	value = tokens[i].substr(6);
+			unsigned long		b = std::strtoul(value.c_str(), &endptr, 10);
+			if (value.empty() || value[0] == '-' || *endptr != '\0' || b == 0 || b > 1000000UL)
+				throw	std::runtime_error("limit_req_per_ip: Invalid value '" + tokens[i] + "'");
+			limits.burst = b;
+		}
+	}
+
+	++i;
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error("limit_req_per_ip: Missing ';' after limit_req_per_ip");
+	++i;
+}
+
+// Handle "access_log <path> [buffer=SIZE] [flush=TIME] [sample=N];" or "access_log off;"
+// (TIME: "2s", "500ms"; sample=N logs one request in N, errors always)
+static void handleAccessLog(AccessLogSettings& log, const std::vector<std::string>& tokens, std::size_t& i)	{
+
+	if (i >= tokens.size() || tokens[i] == ";")
+		throw	std::runtime_error("access_log: Need a path or 'off'");
+
+	log = AccessLogSettings();
+	if (tokens[i] != "off")
+		log.path = tokens[i];
+	++i;
+
+	for (; i < tokens.size() && tokens[i] != ";"; ++i)	{
+		const std::string&				arg = tokens[i];
+		const std::string::size_type	eq = arg.find('=');
+		const std::string				key = arg.substr(0, eq);
+		const std::string				value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+		int								n = 0;
+
+		if (log.path.empty() || eq == std::string::npos)
+			throw	std::runtime_error("access_log: Unexpected token '" + arg + "'");
+		if (key == "buffer" && parseOptionNumber(value, n) && n >= 4096)
+			log.bufferBytes = static_cast<std::size_t>(n);
+		else if (key == "sample" && parseOptionNumber(value, n) && n >= 1)
+			log.sample = static_cast<std::size_t>(n);
+		else if (key == "flush")	{
+			const bool	ms = value.size() > 2 && value.compare(value.size() - 2, 2, "ms") == 0;
+			const bool	sec = !ms && !value.empty() && value[value.size() - 1] == 's';
+			const std::string	digits = value.substr(0, value.size() - (ms ? 2 : (sec ? 1 : 0)));
+			if (!parseOptionNumber(digits, n) || n < 1 || digits.find_first_not_of("0123456789") != std::string::npos
+				|| (!ms && n > 3600))
+				throw	std::runtime_error("access_log: Invalid value '" + arg + "'");
+			log.flushMs = ms ? n : n * 1000L;
+		}
+		else
+			throw	std::runtime_error("access_log: Invalid value '" + arg + "' (buffer >= 4k, flush=TIME, sample=N)");
+	}
+
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error("access_log: Missing ';' after access_log");
+	++i;
+}
+
+// Handle a server "<key> <time>;" timeout: "30" / "30s" seconds, "500ms", "2m"
+static void handleServerTimeout(long& outMs, const std::string& key, const std::vector<std::string>& tokens, std::size_t& i)	{
+
+	if (i >= tokens.size() || tokens[i] == ";" || tokens[i] == "{" || tokens[i] == "}")
+		throw	std::runtime_error("Server: " + key + ": Missing value");
+
+	const std::string&	value = tokens[i];
+	char*				endptr = 0;
+	unsigned long		n = std::strtoul(value.c_str(), &endptr, 10);
+	if (endptr == value.c_str() || value[0] == '-')
+		throw	std::runtime_error("Server: " + key + ": Invalid value '" + value + "'");
+
+	const std::string	unit(endptr);
+	unsigned long		scale = 0;
+	if (unit.empty() || unit == "s")
+		scale = 1000UL;
+	else if (unit == "ms")
+		scale = 1UL;
+	else if (unit == "m")
+		scale = 60UL * 1000UL;
+	else
+		throw	std::runtime_error("Server: " + key + ": Invalid value '" + value + "'");
+
+	const unsigned long	maxMs = 24UL * 3600UL * 1000UL;		// a day is plenty for any of these
+	if (n > maxMs / scale)
+		throw	std::runtime_error("Server: " + key + ": Value too large '" + value + "'");
+	if (n == 0 && key != "keepalive_timeout")				// only keep-alive has a meaning for 0 (disabled)
+		throw	std::runtime_error("Server: " + key + ": Must be greater than 0");
+	outMs = static_cast<long>(n * scale);
+
+	++i;
+	if (i >= tokens.size() || tokens[i] != ";")
+		throw	std::runtime_error("Server: " + key + ": Missing ';'");
+	++i;
+}
+
+
+
+// "<number>[k|m]" for a listen / access_log option value; false if malformed or above INT_MAX
+static bool parseOptionNumber(const std::string& value, int& out)	{
+
+	char*			endptr = 0;
+	unsigned long	n = std::strtoul(value.c_str(), &endptr, 10);
+	if (endptr == value.c_str() || value[0] == '-')
+		return false;
+
+	unsigned long	unit = 1;
+	if (*endptr == 'k' || *endptr == 'K')
+		unit = 1024UL;
+	else if (*endptr == 'm' || *endptr == 'M')
+		unit = 1024UL * 1024UL;
+	else if (*endptr != '\0')
+		return false;
+	if (unit != 1 && endptr[1] != '\0')
+		return false;
+	if (n > static_cast<unsigned long>(INT_MAX) / unit)
+		return false;
+	out = static_cast<int>(n * unit);
+	return true;
+}
+
+// One option after a listen address: "default_server", "deferred[=secs]",
+// "nodelay[=on|off]", "backlog=N", "fastopen=N", "sndbuf=SIZE", "rcvbuf=SIZE".
+// False if the token is not an option at all (it is then an address).
+static bool handleListenOption(ListenOptions& opts, const std::string& arg)	{
+
+	const std::string::size_type	eq = arg.find('=');
+	const std::string				key = arg.substr(0, eq);
+	const std::string				value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+	const bool						hasValue = (eq != std::string::npos);
+	int								n = 0;
+
+	if (key == "default_server" && !hasValue)
+		opts.defaultServer = true;
+	else if (key == "deferred")	{
+		if (!hasValue)
+			opts.deferAccept = 1;
+		else if (!parseOptionNumber(value, n) || n < 1)
+			throw	std::runtime_error("Listen: Invalid value '" + arg + "'");
+		else
+			opts.deferAccept = n;
+	}
+	else if (key == "nodelay")	{
+		if (hasValue && value != "on" && value != "off")
+			throw	std::runtime_error("Listen: Invalid value '" + arg + "'");
+		opts.noDelay = (value != "off");
+	}
+	else if (key == "backlog" || key == "fastopen" || key == "sndbuf" || key == "rcvbuf")	{
+		if (!hasValue || !parseOptionNumber(value, n) || (key == "backlog" && n < 1))
+			throw	std::runtime_error("Listen: Invalid value '" + arg + "'");
+		if (key == "backlog")
+			opts.backlog = n;
+		else if (key == "fastopen")
+			opts.fastOpen = n;
+		else if (key == "sndbuf")
+			opts.sndBuf = n;
+		else
+			opts.rcvBuf = n;
+	}
+	else
+		return false;
+	return true;
+}
+
 // Handle the "listen" directive
 static void handleListen(Server& srv, const std::vector<std::string>& tokens, std::size_t& i)  {
 
@@ -209,11 +531,17 @@ static void handleListen(Server& srv, const std::vector<std::string>& tokens, st
 
 	bool	hadAny = false;
 
-	// Collect one or more args until ';' (e.g. "8080", "127.0.0.1:8080", etc.)
+	// Collect one or more args until ';' (e.g. "8080", "127.0.0.1:8080", etc.);
+	// options after an address apply to that address.
 	for (; i < tokens.size() && tokens[i] != ";"; ++i)	{
 		const std::string&	arg = tokens[i];	// avoid unnecessary temp
 		if (arg == "{" || arg == "}")
 			throw	std::runtime_error("Listen: Unexpected token '" + arg + "'");
+		if (hadAny && handleListenOption(srv.listen_options[srv.listen.back()], arg))
+			continue;
+		ListenOptions	scratch;
+		if (!hadAny && handleListenOption(scratch, arg))
+			throw	std::runtime_error("Listen: '" + arg + "' needs an address before it");
 		
 		srv.listen.push_back(arg);
 		hadAny = true;
@@ -522,6 +850,39 @@ static void handleGenericDirective(Server& srv, const std::string& key, const st
 			++i;
 			srv.directives["client_max_body_size"] = value;
 		}
+		else if (key == "client_header_timeout")
+			handleServerTimeout(srv.timeouts.headerMs, key, tokens, i);
+		else if (key == "client_body_timeout")
+			handleServerTimeout(srv.timeouts.bodyMs, key, tokens, i);
+		else if (key == "keepalive_timeout")
+			handleServerTimeout(srv.timeouts.keepAliveMs, key, tokens, i);
+		else if (key == "send_timeout")
+			handleServerTimeout(srv.timeouts.sendMs, key, tokens, i);
+		else if (key == "gzip" || key == "gzip_static" || key == "gzip_types"
+				|| key == "gzip_min_length" || key == "gzip_comp_level"
+				|| key == "fastcgi_pass" || key == "fastcgi_pool_size" || key == "fastcgi_queue_size"
+				|| key == "cgi_streaming"
+				|| key == "proxy_balance" || key == "proxy_keepalive" || key == "proxy_timeout")	{
+			// values are checked when the route table is compiled
+			std::vector<std::string>	vals;
+			for (; i < tokens.size() && tokens[i] != ";"; ++i)	{
+				if (tokens[i] == "{" || tokens[i] == "}")
+					throw	std::runtime_error("Server: " + key + ": Unexpected token '" + tokens[i] + "'");
+				vals.push_back(tokens[i]);
+			}
+			if (vals.empty())
+				throw	std::runtime_error("Server: " + key + ": Missing value");
+			if (i >= tokens.size() || tokens[i] != ";")
+				throw	std::runtime_error("Server: " + key + ": Missing ';'");
+			++i;
+			std::string	joined;
+			for (std::size_t k = 0; k < vals.size(); ++k)	{
+				if (k)
+					joined += " ";
+				joined += vals[k];
+			}
+			srv.directives[key] = joined;
+		}
 		else if (key == "cgi_pass")	{
 			if (i + 1 >= tokens.size() || tokens[i] == ";" || tokens[i] == "{" || tokens[i] == "}")
 				throw	std::runtime_error("Server: cgi_pass: Missing <extension> <executable>");
@@ -0,0 +1,105 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionTable.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/ConnectionTable.hpp"
+
+ConnectionTable::ConnectionTable()
+    :   _slots(), _position(), _open()
+{}
+
+ConnectionTable::~ConnectionTable() {
+    for (std::size_t i = 0; i < _slots.size(); ++i)
+        delete _slots[i];
+}
+
+Connection*     ConnectionTable::find(int fd)   {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= _position.size() || _position[fd] < 0)
+        return NULL;
+    return _slots[fd];
+}
+
+// The slot is reset to a default Connection, except that the big buffers of its
+// previous user are handed over (cleared) so their capacity is reused.
+Connection&     ConnectionTable::open(int fd)   {
+
+    if (static_cast<std::size_t>(fd) >= _slots.size()) {
+        _slots.resize(fd + 1, NULL);
+        _position.resize(fd + 1, -1);
+    }
+    if (!_slots[fd])
+        _slots[fd] = new Connection();
+    else if (_position[fd] < 0) {
+        Connection& slot = *_slots[fd];
+        IoBuffer    readBuffer;
+        std::string writeBuffer;
+        std::string writeBody;
+        std::string pipelined;
+        readBuffer.swap(slot.readBuffer);
+        writeBuffer.swap(slot.writeBuffer);
+        writeBody.swap(slot.writeBody);
+        pipelined.swap(slot.pipelined);
+        slot = Connection();
+        slot.readBuffer.swap(readBuffer);
+        slot.readBuffer.clear();
+        slot.writeBuffer.swap(writeBuffer);
+        slot.writeBuffer.clear();
+        slot.writeBody.swap(writeBody);
+        slot.writeBody.clear();
+        slot.pipelined.swap(pipelined);
+        slot.pipelined.clear();
+    }
+
+    if (_position[fd] < 0) {
+        _position[fd] = static_cast<int>(_open.size());
+        _open.push_back(_slots[fd]);
+    }
+    _slots[fd]->fd = fd;
+    return *_slots[fd];
+}
+
+void    ConnectionTable::release(int fd)    {
+
+    if (!find(fd))
+        return;
+
+    // Big buffers are not parked in an idle slot (IoBuffer::clear() has the same cap).
+    const std::size_t   KEEP_CAPACITY = 64 * 1024;
+    Connection& slot = *_slots[fd];
+    slot.readBuffer.clear();
+    if (slot.writeBody.capacity() > KEEP_CAPACITY)
+        std::string().swap(slot.writeBody);
+    if (slot.pipelined.capacity() > KEEP_CAPACITY)
+        std::string().swap(slot.pipelined);
+
+    std::size_t index = static_cast<std::size_t>(_position[fd]);
+    Connection* last = _open.back();
+    _open[index] = last;
+    _position[last->fd] = static_cast<int>(index);
+    _open.pop_back();
+    _position[fd] = -1;
+}
+
+bool    ConnectionTable::empty() const  {
+    return _open.empty();
+}
+
+std::size_t     ConnectionTable::size() const   {
+    return _open.size();
+}
+
+Connection&     ConnectionTable::at(std::size_t i)  {
+    return *_open[i];
+}
+
+const Connection&   ConnectionTable::at(std::size_t i) const    {
+    return *_open[i];
+}
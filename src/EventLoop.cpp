@@ -0,0 +1,349 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/EventLoop.hpp"
+
+#if defined(WEBSERV_USE_EPOLL)
+# include <sys/epoll.h>
+#elif defined(WEBSERV_USE_KQUEUE)
+# include <sys/event.h>
+#endif
+
+namespace   {
+
+    const std::size_t   MAX_EVENTS_PER_WAIT = 512;
+
+    void    growTo(std::vector<int>& v, int fd)  {
+        if (static_cast<std::size_t>(fd) >= v.size())
+            v.resize(static_cast<std::size_t>(fd) + 1, -1);
+    }
+
+}   // anonymous namespace
+
+EventLoop::EventLoop()
+    :   _backendFd(-1)
+{}
+
+EventLoop::~EventLoop()   {
+    if (_backendFd >= 0)
+        close(_backendFd);
+}
+
+bool    EventLoop::isRegistered(int fd) const {
+    return fd >= 0 && static_cast<std::size_t>(fd) < _interest.size() && _interest[fd] >= 0;
+}
+
+//**************************************************************************************************
+//  epoll (Linux)
+//**************************************************************************************************
+#if defined(WEBSERV_USE_EPOLL)
+
+namespace   {
+
+    uint32_t    toEpoll(int interest)   {
+        uint32_t    ev = 0;
+        if (interest & EV_READ)
+            ev |= EPOLLIN;
+        if (interest & EV_WRITE)
+            ev |= EPOLLOUT;
+        return ev;  // EPOLLERR / EPOLLHUP are always reported
+    }
+
+}   // anonymous namespace
+
+const char* EventLoop::backendName() const    { return "epoll"; }
+
+bool    EventLoop::open()   {
+    if (_backendFd >= 0)
+        return true;
+    _backendFd = epoll_create(1024);    // size hint is ignored by modern kernels
+    if (_backendFd < 0)
+        return false;
+    int fdflags = fcntl(_backendFd, F_GETFD);
+    if (fdflags != -1)
+        fcntl(_backendFd, F_SETFD, fdflags | FD_CLOEXEC);   // CGI children must not inherit it
+    return true;
+}
+
+bool    EventLoop::add(int fd, int interest)  {
+    if (fd < 0)
+        return false;
+    if (isRegistered(fd))
+        return modify(fd, interest);
+
+    struct epoll_event  ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = toEpoll(interest);
+    ev.data.fd = fd;
+    if (epoll_ctl(_backendFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        return false;
+
+    growTo(_interest, fd);
+    _interest[fd] = interest;
+    return true;
+}
+
+bool    EventLoop::modify(int fd, int interest)   {
+    if (!isRegistered(fd))
+        return false;
+    if (_interest[fd] == interest)
+        return true;    // nothing changed: skip the syscall
+
+    struct epoll_event  ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = toEpoll(interest);
+    ev.data.fd = fd;
+    if (epoll_ctl(_backendFd, EPOLL_CTL_MOD, fd, &ev) != 0)
+        return false;
+
+    _interest[fd] = interest;
+    return true;
+}
+
+void    EventLoop::remove(int fd) {
+    if (!isRegistered(fd))
+        return;
+    struct epoll_event  ev;     // non-NULL for kernels < 2.6.9
+    std::memset(&ev, 0, sizeof(ev));
+    epoll_ctl(_backendFd, EPOLL_CTL_DEL, fd, &ev);
+    _interest[fd] = -1;
+}
+
+int     EventLoop::wait(int timeoutMs, std::vector<ReadyEvent>& ready)   {
+    ready.clear();
+
+    struct epoll_event  evs[MAX_EVENTS_PER_WAIT];
+    int n = epoll_wait(_backendFd, evs, static_cast<int>(MAX_EVENTS_PER_WAIT), timeoutMs);
+    if (n <= 0)
+        return n;
+
+    for (int i = 0; i < n; ++i) {
+        ReadyEvent  r;
+        r.fd = evs[i].data.fd;
+        r.events = EV_NONE;
+        if (evs[i].events & EPOLLIN)
+            r.events |= EV_READ;
+        if (evs[i].events & EPOLLOUT)
+            r.events |= EV_WRITE;
+        if (evs[i].events & EPOLLHUP)
+            r.events |= EV_HUP;
+        if (evs[i].events & EPOLLERR)
+            r.events |= EV_ERROR;
+        ready.push_back(r);
+    }
+    return n;
+}
+
+//**************************************************************************************************
+//  kqueue (BSD / macOS)
+//**************************************************************************************************
+#elif defined(WEBSERV_USE_KQUEUE)
+
+namespace   {
+
+    // Apply the read/write filter changes needed to go from `before` to `after`.
+    bool    applyFilters(int kq, int fd, int before, int after)  {
+        struct kevent   changes[2];
+        int             n = 0;
+
+        if ((before & EV_READ) != (after & EV_READ)) {
+            EV_SET(&changes[n], fd, EVFILT_READ, (after & EV_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+            ++n;
+        }
+        if ((before & EV_WRITE) != (after & EV_WRITE)) {
+            EV_SET(&changes[n], fd, EVFILT_WRITE, (after & EV_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+            ++n;
+        }
+        if (n == 0)
+            return true;
+        return kevent(kq, changes, n, NULL, 0, NULL) == 0;
+    }
+
+}   // anonymous namespace
+
+const char* EventLoop::backendName() const    { return "kqueue"; }
+
+bool    EventLoop::open()   {
+    if (_backendFd >= 0)
+        return true;
+    _backendFd = kqueue();
+    if (_backendFd < 0)
+        return false;
+    int fdflags = fcntl(_backendFd, F_GETFD);
+    if (fdflags != -1)
+        fcntl(_backendFd, F_SETFD, fdflags | FD_CLOEXEC);
+    return true;
+}
+
+bool    EventLoop::add(int fd, int interest)  {
+    if (fd < 0)
+        return false;
+    if (isRegistered(fd))
+        return modify(fd, interest);
+    if (!applyFilters(_backendFd, fd, EV_NONE, interest))
+        return false;
+    growTo(_interest, fd);
+    _interest[fd] = interest;
+    return true;
+}
+
+bool    EventLoop::modify(int fd, int interest)   {
+    if (!isRegistered(fd))
+        return false;
+    if (_interest[fd] == interest)
+        return true;
+    if (!applyFilters(_backendFd, fd, _interest[fd], interest))
+        return false;
+    _interest[fd] = interest;
+    return true;
+}
+
+void    EventLoop::remove(int fd) {
+    if (!isRegistered(fd))
+        return;
+    applyFilters(_backendFd, fd, _interest[fd], EV_NONE);
+    _interest[fd] = -1;
+}
+
+int     EventLoop::wait(int timeoutMs, std::vector<ReadyEvent>& ready)   {
+    ready.clear();
+
+    struct timespec     ts;
+    struct timespec*    tsp = NULL;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+        tsp = &ts;
+    }
+
+    struct kevent   evs[MAX_EVENTS_PER_WAIT];
+    int n = kevent(_backendFd, NULL, 0, evs, static_cast<int>(MAX_EVENTS_PER_WAIT), tsp);
+    if (n <= 0)
+        return n;
+
+    for (int i = 0; i < n; ++i) {
+        ReadyEvent  r;
+        r.fd = static_cast<int>(evs[i].ident);
+        r.events = EV_NONE;
+        if (evs[i].flags & EV_ERROR)
+            r.events |= EV_ERROR;
+        else if (evs[i].filter == EVFILT_READ)
+            r.events |= EV_READ;
+        else if (evs[i].filter == EVFILT_WRITE)
+            r.events |= EV_WRITE;
+        if ((evs[i].flags & EV_EOF) && evs[i].filter == EVFILT_WRITE)
+            r.events |= EV_HUP; // peer gone: nothing more can be written
+        ready.push_back(r);
+    }
+    return n;
+}
+
+//**************************************************************************************************
+//  poll() fallback
+//**************************************************************************************************
+#else
+
+namespace   {
+
+    short   toPoll(int interest)    {
+        short   ev = 0;
+        if (interest & EV_READ)
+            ev |= POLLIN;
+        if (interest & EV_WRITE)
+            ev |= POLLOUT;
+        return ev;
+    }
+
+}   // anonymous namespace
+
+const char* EventLoop::backendName() const    { return "poll"; }
+
+bool    EventLoop::open()   {
+    return true;
+}
+
+bool    EventLoop::add(int fd, int interest)  {
+    if (fd < 0)
+        return false;
+    if (isRegistered(fd))
+        return modify(fd, interest);
+
+    struct pollfd   p;
+    p.fd = fd;
+    p.events = toPoll(interest);
+    p.revents = 0;
+    _pollFds.push_back(p);
+
+    growTo(_pollIndex, fd);
+    growTo(_interest, fd);
+    _pollIndex[fd] = static_cast<int>(_pollFds.size() - 1);
+    _interest[fd] = interest;
+    return true;
+}
+
+bool    EventLoop::modify(int fd, int interest)   {
+    if (!isRegistered(fd))
+        return false;
+    _pollFds[_pollIndex[fd]].events = toPoll(interest);
+    _interest[fd] = interest;
+    return true;
+}
+
+void    EventLoop::remove(int fd) {
+    if (!isRegistered(fd))
+        return;
+
+    std::size_t index = static_cast<std::size_t>(_pollIndex[fd]);
+    std::size_t last = _pollFds.size() - 1;
+    if (index != last)  {
+        // Move the last entry into the freed slot so nothing else shifts
+        _pollFds[index] = _pollFds[last];
+        _pollIndex[_pollFds[index].fd] = static_cast<int>(index);
+    }
+    _pollFds.pop_back();
+    _pollIndex[fd] = -1;
+    _interest[fd] = -1;
+}
+
+int     EventLoop::wait(int timeoutMs, std::vector<ReadyEvent>& ready)   {
+    ready.clear();
+    if (_pollFds.empty())   {
+        if (timeoutMs > 0)
+            usleep(static_cast<useconds_t>(timeoutMs) * 1000);
+        return 0;
+    }
+
+    int n = poll(&_pollFds[0], static_cast<nfds_t>(_pollFds.size()), timeoutMs);
+    if (n <= 0)
+        return n;
+
+    for (std::size_t i = 0; i < _pollFds.size() && ready.size() < static_cast<std::size_t>(n); ++i)  {
+        short   re = _pollFds[i].revents;
+        if (re == 0)
+            continue;
+        ReadyEvent  r;
+        r.fd = _pollFds[i].fd;
+        r.events = EV_NONE;
+        if (re & POLLIN)
+            r.events |= EV_READ;
+        if (re & POLLOUT)
+            r.events |= EV_WRITE;
+        if (re & POLLHUP)
+            r.events |= EV_HUP;
+        if (re & (POLLERR | POLLNVAL))
+            r.events |= EV_ERROR;
+        ready.push_back(r);
+    }
+    return static_cast<int>(ready.size());
+}
+
+#endif
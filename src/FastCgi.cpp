@@ -0,0 +1,185 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FastCgi.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/FastCgi.hpp"
+
+namespace   {
+
+    const unsigned char FCGI_VERSION_1 = 1;
+    const unsigned char FCGI_BEGIN_REQUEST = 1;
+    const unsigned char FCGI_END_REQUEST = 3;
+    const unsigned char FCGI_PARAMS = 4;
+    const unsigned char FCGI_STDIN = 5;
+    const unsigned char FCGI_STDOUT = 6;
+    const unsigned char FCGI_STDERR = 7;
+    const unsigned char FCGI_RESPONDER = 1;
+    const unsigned char FCGI_KEEP_CONN = 1;
+    const unsigned char FCGI_REQUEST_COMPLETE = 0;
+
+    const unsigned int  REQUEST_ID = 1;             // one request per connection at a time
+    const std::size_t   HEADER_LEN = 8;
+    const std::size_t   MAX_CONTENT = 65528;        // largest multiple of 8 that fits the 16-bit length
+    const std::size_t   MAX_STDERR = 64 * 1024;
+
+    void    appendHeader(std::string& out, unsigned char type, std::size_t contentLen, std::size_t paddingLen)  {
+        out += static_cast<char>(FCGI_VERSION_1);
+        out += static_cast<char>(type);
+        out += static_cast<char>((REQUEST_ID >> 8) & 0xff);
+        out += static_cast<char>(REQUEST_ID & 0xff);
+        out += static_cast<char>((contentLen >> 8) & 0xff);
+        out += static_cast<char>(contentLen & 0xff);
+        out += static_cast<char>(paddingLen);
+        out += '\0';
+    }
+
+    // Splits a stream into records (padded to 8 bytes), then the empty record that ends it.
+    void    appendStream(std::string& out, unsigned char type, const char* data, std::size_t len)  {
+        for (std::size_t off = 0; off < len; off += MAX_CONTENT) {
+            std::size_t chunk = std::min(MAX_CONTENT, len - off);
+            std::size_t padding = (8 - chunk % 8) % 8;
+            appendHeader(out, type, chunk, padding);
+            out.append(data + off, chunk);
+            out.append(padding, '\0');
+        }
+        appendHeader(out, type, 0, 0);
+    }
+
+    void    appendLength(std::string& out, std::size_t len)  {
+        if (len < 128) {
+            out += static_cast<char>(len);
+            return;
+        }
+        out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+        out += static_cast<char>((len >> 16) & 0xff);
+        out += static_cast<char>((len >> 8) & 0xff);
+        out += static_cast<char>(len & 0xff);
+    }
+}
+
+namespace fastcgi   {
+
+    void    encodeRequest(const std::vector<std::string>& params, const std::string& body, std::string& out)  {
+
+        appendHeader(out, FCGI_BEGIN_REQUEST, 8, 0);
+        out += '\0';
+        out += static_cast<char>(FCGI_RESPONDER);
+        out += static_cast<char>(FCGI_KEEP_CONN);
+        out.append(5, '\0');
+
+        std::string pairs;
+        for (std::size_t i = 0; i < params.size(); ++i) {
+            std::string::size_type eq = params[i].find('=');
+            if (eq == std::string::npos)
+                continue;
+            appendLength(pairs, eq);
+            appendLength(pairs, params[i].size() - eq - 1);
+            pairs.append(params[i], 0, eq);
+            pairs.append(params[i], eq + 1, std::string::npos);
+        }
+        appendStream(out, FCGI_PARAMS, pairs.data(), pairs.size());
+        appendStream(out, FCGI_STDIN, body.data(), body.size());
+    }
+
+    int     connectUnix(const std::string& path, bool& inProgress)  {
+
+        inProgress = false;
+
+        struct sockaddr_un  addr;
+        if (path.size() >= sizeof(addr.sun_path))
+            return -1;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+            close(fd);
+            return -1;
+        }
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0)
+            return fd;
+        if (errno == EINPROGRESS) {
+            inProgress = true;      // writable once connected; a failure shows up as EV_ERROR/EV_HUP
+            return fd;
+        }
+        close(fd);                  // no listener, or its backlog is full
+        return -1;
+    }
+
+    ResponseParser::ResponseParser()
+        :   _pending(), _ended(false), _appStatus(0), _stderr()
+    {}
+
+    void    ResponseParser::reset() {
+        _pending.clear();
+        _ended = false;
+        _appStatus = 0;
+        _stderr.clear();
+    }
+
+    bool    ResponseParser::feed(const char* data, std::size_t len, std::string& stdoutData)  {
+
+        _pending.append(data, len);
+
+        std::size_t pos = 0;
+        while (!_ended && _pending.size() - pos >= HEADER_LEN) {
+            const unsigned char*    h = reinterpret_cast<const unsigned char*>(_pending.data() + pos);
+            if (h[0] != FCGI_VERSION_1)
+                return false;
+            const unsigned int  type = h[1];
+            const unsigned int  requestId = (h[2] << 8) | h[3];
+            const std::size_t   contentLen = (static_cast<std::size_t>(h[4]) << 8) | h[5];
+            const std::size_t   recordLen = HEADER_LEN + contentLen + h[6];
+            if (_pending.size() - pos < recordLen)
+                break;
+
+            const char* content = _pending.data() + pos + HEADER_LEN;
+            if (requestId == REQUEST_ID) {
+                if (type == FCGI_STDOUT)
+                    stdoutData.append(content, contentLen);
+                else if (type == FCGI_STDERR && _stderr.size() < MAX_STDERR)
+                    _stderr.append(content, std::min(contentLen, MAX_STDERR - _stderr.size()));
+                else if (type == FCGI_END_REQUEST) {
+                    if (contentLen < 8)
+                        return false;
+                    const unsigned char*    b = reinterpret_cast<const unsigned char*>(content);
+                    _appStatus = static_cast<int>((static_cast<unsigned long>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3]);
+                    if (b[4] != FCGI_REQUEST_COMPLETE)
+                        return false;   // CANT_MPX_CONN / OVERLOADED / UNKNOWN_ROLE
+                    _ended = true;
+                }
+            }
+            pos += recordLen;           // management records (id 0) are skipped
+        }
+        _pending.erase(0, pos);
+        return true;
+    }
+
+    bool    ResponseParser::ended() const   {
+        return _ended;
+    }
+
+    bool    ResponseParser::idle() const    {
+        return _ended && _pending.empty();
+    }
+
+    int     ResponseParser::appStatus() const   {
+        return _appStatus;
+    }
+
+    const std::string&  ResponseParser::errors() const  {
+        return _stderr;
+    }
+}
@@ -0,0 +1,208 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   FileCache.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "FileCache.hpp"
+
+namespace {
+
+	const std::size_t	kMaxCachedFileSize = 1024 * 1024;	// bigger files keep going through sendfile()
+
+	bool sameFile(const FileCacheEntry& entry, const struct stat& st) {
+		return entry.inode == st.st_ino && entry.size == st.st_size && entry.mtime == st.st_mtime;
+	}
+
+} // namespace
+
+FileCache::FileCache()
+	:	_lru()
+	,	_index()
+	,	_maxBytes(0)
+	,	_bytes(0)
+	,	_validSeconds(1)
+	,	_hits(0)
+	,	_misses(0)
+{}
+
+/*
+ Sets the memory cap (0 disables the cache and drops every entry) and the
+ window during which an entry is trusted without touching the disk.
+*/
+void FileCache::configure(std::size_t maxBytes, std::size_t validSeconds) {
+
+	_maxBytes = maxBytes;
+	_validSeconds = static_cast<std::time_t>(validSeconds);
+
+	while (!_lru.empty() && _bytes > _maxBytes)
+		erase(_index.find(_lru.back().path));
+}
+
+bool FileCache::enabled() const {
+	return _maxBytes > 0;
+}
+
+/*
+ Only small regular files are worth keeping in memory.
+*/
+bool FileCache::admits(off_t size) const {
+
+	if (size < 0 || !enabled())
+		return false;
+	std::size_t	bytes = static_cast<std::size_t>(size);
+	return bytes <= kMaxCachedFileSize && bytes <= _maxBytes;
+}
+
+/*
+ True when the entry exists and is still inside its validity window, so the
+ caller may skip its own filesystem checks. Does not touch the counters.
+*/
+bool FileCache::isFresh(const std::string& path) const {
+
+	EntryIndex::const_iterator	it = _index.find(path);
+	if (it == _index.end())
+		return false;
+	return std::time(NULL) - it->second->validatedAt < _validSeconds;
+}
+
+/*
+ Returns the cached entry for path (moved to the LRU front), revalidating it
+ with stat() once the validity window has elapsed. NULL on a miss.
+*/
+const FileCacheEntry* FileCache::lookup(const std::string& path) {
+
+	if (!enabled())
+		return NULL;
+
+	EntryIndex::iterator	it = _index.find(path);
+	if (it == _index.end()) {
+		++_misses;
+		return NULL;
+	}
+
+	FileCacheEntry&		entry = *it->second;
+	const std::time_t	now = std::time(NULL);
+
+	if (now - entry.validatedAt >= _validSeconds) {
+		struct stat	st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || !sameFile(entry, st)) {
+			erase(it);
+			++_misses;
+			return NULL;
+		}
+		entry.validatedAt = now;
+	}
+
+	_lru.splice(_lru.begin(), _lru, it->second);		// iterators stay valid
+	++_hits;
+	return &entry;
+}
+
+/*
+ Stores a freshly read file (body is swapped in, not copied) and evicts the
+ least recently used entries until the cache fits its cap again.
+*/
+const FileCacheEntry* FileCache::insert(const std::string& path, const struct stat& st, std::string& body, const std::string& contentType,
+										const std::string& etag, const std::string& lastModified) {
+
+	if (!admits(st.st_size) || body.size() != static_cast<std::size_t>(st.st_size))
+		return NULL;
+
+	EntryIndex::iterator	old = _index.find(path);
+	if (old != _index.end())
+		erase(old);
+
+	_lru.push_front(FileCacheEntry());
+	FileCacheEntry&	entry = _lru.front();
+
+	std::ostringstream	oss;
+	oss << body.size();
+
+	entry.path = path;
+	entry.body.swap(body);
+	entry.contentType = contentType;
+	entry.contentLength = oss.str();
+	entry.etag = etag;
+	entry.lastModified = lastModified;
+	entry.gzipTried = false;
+	entry.inode = st.st_ino;
+	entry.size = st.st_size;
+	entry.mtime = st.st_mtime;
+	entry.validatedAt = std::time(NULL);
+
+	_index[path] = _lru.begin();
+	_bytes += entry.body.size();
+
+	while (_bytes > _maxBytes && _lru.size() > 1)
+		erase(_index.find(_lru.back().path));
+
+	return &entry;
+}
+
+/*
+ Attaches the compressed variant to path's entry (swapped in; empty records that
+ compression didn't shrink it). Counts against the cap like the plain body.
+*/
+const FileCacheEntry* FileCache::storeGzip(const std::string& path, std::string& gzipBody) {
+
+	EntryIndex::iterator	it = _index.find(path);
+	if (it == _index.end())
+		return NULL;
+
+	FileCacheEntry&	entry = *it->second;
+	_bytes -= entry.gzipBody.size();
+
+	std::ostringstream	oss;
+	oss << gzipBody.size();
+
+	entry.gzipBody.swap(gzipBody);
+	entry.gzipLength = oss.str();
+	entry.gzipTried = true;
+	_bytes += entry.gzipBody.size();
+
+	_lru.splice(_lru.begin(), _lru, it->second);
+	while (_bytes > _maxBytes && _lru.size() > 1)
+		erase(_index.find(_lru.back().path));
+
+	return &entry;
+}
+
+/*
+ Drops path from the cache (the server itself deleted or rewrote the file).
+*/
+void FileCache::invalidate(const std::string& path) {
+
+	EntryIndex::iterator	it = _index.find(path);
+	if (it != _index.end())
+		erase(it);
+}
+
+unsigned long FileCache::hits() const {
+	return _hits;
+}
+
+unsigned long FileCache::misses() const {
+	return _misses;
+}
+
+std::size_t FileCache::bytes() const {
+	return _bytes;
+}
+
+std::size_t FileCache::entries() const {
+	return _lru.size();
+}
+
+void FileCache::erase(EntryIndex::iterator it) {
+
+	_bytes -= it->second->body.size() + it->second->gzipBody.size();
+	_lru.erase(it->second);
+	_index.erase(it);
+}
@@ -11,6 +11,7 @@
 /* ************************************************************************** */
 
 #include "HttpBody.hpp"
+#include "SpillFile.hpp"
 
 namespace   {
 
@@ -39,6 +40,18 @@ namespace   {
         return http::BODY_ERROR;
     }
     
+    // Body bytes go to the multipart parser or the upload spill file when the
+    // core set one up, else to request.body. Returns 0, or the status to fail with.
+    int     store_body(HTTP_Request& request, const char* data, std::size_t len)    {
+        if (request.multipart.active())
+            return request.multipart.feed(data, len);
+        if (request.body_file_fd < 0)   {
+            request.body.append(data, len);
+            return 0;
+        }
+        return spill::writeAll(request.body_file_fd, data, len) ? 0 : 500;
+    }
+
     bool    parse_hex_size(const std::string& line, std::size_t& out)   {
         // strip chunk extensions: "1A;foo=bar" -> "1A"
         std::size_t semi = line.find(';');
@@ -64,10 +77,10 @@ namespace   {
         return true;
     }
 
-    http::BodyResult	consume_all_trailers(std::string& buffer, std::size_t max_line, int& status, std::string& reason)	{
+    http::BodyResult	consume_all_trailers(IoBuffer& buffer, std::size_t max_line, int& status, std::string& reason)	{
 		for (;;)	{
-			std::size_t	pos = buffer.find("\r\n");
-			if (pos == std::string::npos)   {
+			std::size_t	pos = buffer.findCrlf();
+			if (pos == IoBuffer::npos)   {
                 if (buffer.size() > max_line)
                     return body_fail(413, "Payload Too Large", status, reason);
                 return http::BODY_INCOMPLETE;
@@ -77,12 +90,12 @@ namespace   {
 
 			if (pos == 0)	{
 				// blank line -> end of trailers
-                buffer.erase(0, 2);
+                buffer.consume(2);
                 return http::BODY_COMPLETE;
 			}
 			
 			// Drop one trailer line (line + CRLF)
-            buffer.erase(0, pos + 2);
+            buffer.consume(pos + 2);
 		}
 	}
 
@@ -113,10 +126,12 @@ namespace http  {
         if (have + take > max_body)
             return body_fail(413, "Payload Too Large", status, reason);
 
-        request.body.append(connection.readBuffer.data(), take);
+        const int stored = store_body(request, connection.readBuffer.data(), take);
+        if (stored != 0)
+            return body_fail(stored, stored == 400 ? "Bad Request" : "Internal Server Error", status, reason);
         request.body_received += take;
 
-        connection.readBuffer.erase(0, take);
+        connection.readBuffer.consume(take);
 
         return (request.body_received == request.content_length) ? BODY_COMPLETE : BODY_INCOMPLETE;
     }
@@ -129,8 +144,8 @@ namespace http  {
         for (;;)    {
             switch (request.chunk_state)  {
                 case CS_SIZE:   {
-                    std::size_t  position = connection.readBuffer.find("\r\n");
-                    if (position == std::string::npos)   {
+                    std::size_t  position = connection.readBuffer.findCrlf();
+                    if (position == IoBuffer::npos)   {
                         if (connection.readBuffer.size() > MAX_LINE)
                             return body_fail(413, "Payload Too Large", status, reason);
                         return BODY_INCOMPLETE;
@@ -139,7 +154,7 @@ namespace http  {
                         return body_fail(413, "Payload Too Large", status, reason);
                     
                     std::string line = connection.readBuffer.substr(0, position);
-                    connection.readBuffer.erase(0, position + 2);
+                    connection.readBuffer.consume(position + 2);
 
                     std::size_t size = 0;
                     if (!parse_hex_size(line, size)) // Chunked transfer encoding (RFC 7230 §4.1) sends each chunk size in hexadecimal
@@ -165,11 +180,13 @@ namespace http  {
                     if (take > max_body - request.body_received)
                         return body_fail(413, "Payload Too Large", status, reason);
 
-                    request.body.append(connection.readBuffer.data(), take);
+                    const int stored = store_body(request, connection.readBuffer.data(), take);
+                    if (stored != 0)
+                        return body_fail(stored, stored == 400 ? "Bad Request" : "Internal Server Error", status, reason);
                     request.body_received += take;
                     request.chunk_bytes_left -= take;
 
-                    connection.readBuffer.erase(0, take);
+                    connection.readBuffer.consume(take);
 
                     if (request.chunk_bytes_left == 0)
                         request.chunk_state = CS_DATA_CRLF;
@@ -181,7 +198,7 @@ namespace http  {
                         return BODY_INCOMPLETE;
                     if (!(connection.readBuffer[0] =='\r' && connection.readBuffer[1] == '\n'))
                         return body_fail(400, "Bad Request", status, reason);
-                    connection.readBuffer.erase(0, 2);
+                    connection.readBuffer.consume(2);
                     request.chunk_state = CS_SIZE;
                     break;
                 }
@@ -232,7 +249,7 @@ BodyResult consume_body_content_length_drain(Connection& connection,
     // ✅ telemetria: conta bytes drenados
     connection.drainedBytes += take;
 
-    connection.readBuffer.erase(0, take);
+    connection.readBuffer.consume(take);
 
     return (request.body_received == request.content_length) ? BODY_COMPLETE : BODY_INCOMPLETE;
 }
@@ -259,8 +276,8 @@ BodyResult consume_body_chunked_drain(Connection& connection,
         switch (request.chunk_state) {
 
             case CS_SIZE: {
-                std::size_t position = connection.readBuffer.find("\r\n");
-                if (position == std::string::npos) {
+                std::size_t position = connection.readBuffer.findCrlf();
+                if (position == IoBuffer::npos) {
                     // Proteção anti-DoS de linha interminável (best-effort drain)
                     if (connection.readBuffer.size() > MAX_LINE) {
                         // descarta o que temos para não crescer sem limite
@@ -272,12 +289,12 @@ BodyResult consume_body_chunked_drain(Connection& connection,
                 if (position > MAX_LINE) {
                     // linha gigante: descarta essa "linha" (best-effort)
                     connection.drainedBytes += (position + 2);
-                    connection.readBuffer.erase(0, position + 2);
+                    connection.readBuffer.consume(position + 2);
                     return BODY_INCOMPLETE;
                 }
 
                 std::string line = connection.readBuffer.substr(0, position);
-                connection.readBuffer.erase(0, position + 2);
+                connection.readBuffer.consume(position + 2);
 
                 // ✅ conta bytes drenados da framing line + CRLF
                 connection.drainedBytes += (position + 2);
@@ -309,7 +326,7 @@ BodyResult consume_body_chunked_drain(Connection& connection,
                 // ✅ telemetria: conta bytes drenados
                 connection.drainedBytes += take;
 
-                connection.readBuffer.erase(0, take);
+                connection.readBuffer.consume(take);
 
                 if (request.chunk_bytes_left == 0)
                     request.chunk_state = CS_DATA_CRLF;
@@ -327,7 +344,7 @@ BodyResult consume_body_chunked_drain(Connection& connection,
                     return BODY_INCOMPLETE;
                 }
 
-                connection.readBuffer.erase(0, 2);
+                connection.readBuffer.consume(2);
 
                 // ✅ conta CRLF drenado
                 connection.drainedBytes += 2;
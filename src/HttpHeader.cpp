@@ -11,36 +11,68 @@
 /* ************************************************************************** */
 
 #include "HttpHeader.hpp"
+#include "ByteScan.hpp"
 
 namespace   {
 
-    /* Lowercase a copy of a string (ASCII). */
-    std::string toLowerCopy(const std::string& s)   {
-        std::string out(s);	// copy constructor
-        for (std::size_t i = 0; i < out.size(); ++i)    {
-            unsigned char   c = static_cast<unsigned char>(out[i]);
-            out[i] = static_cast<char>(std::tolower(c));
+    /* Header-value whitespace (ASCII space/tab/CR/LF). */
+    bool    isTrimChar(char c)  {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    /* Shrink [off, off+len) of `s` until it no longer starts/ends with whitespace. */
+    void    trimSlice(const std::string& s, std::size_t& off, std::size_t& len)  {
+        while (len > 0 && isTrimChar(s[off])) {
+            ++off;
+            --len;
         }
-        return out;
+        while (len > 0 && isTrimChar(s[off + len - 1]))
+            --len;
     }
 
-    /* Trim helpers (ASCII space/tab/CR/LF). */
-    std::string trimLeft(const std::string& s)  {
-        std::size_t i = 0;
-        while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n'))
-            ++i;
-        return s.substr(i);
+    char    asciiLower(char c)  {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
     }
-    std::string trimRight(const std::string& s) {
-        if (s.empty())
-            return s;
-        std::size_t i = s.size();
-        while (i > 0 && (s[i - 1] == ' ' || s[i - 1] == '\t' || s[i - 1] == '\r' || s[i - 1] == '\n'))
-            --i;
-        return s.substr(0, i);
+
+    /* Case-insensitive compare of a slice against a lowercase literal. */
+    bool    sliceEquals(const char* p, std::size_t len, const char* lit)    {
+        std::size_t litLen = std::strlen(lit);
+        if (len != litLen)
+            return false;
+        for (std::size_t i = 0; i < len; ++i)
+            if (asciiLower(p[i]) != lit[i])
+                return false;
+        return true;
     }
-    std::string trim(const std::string& s)  {
-        return trimRight(trimLeft(s));
+
+    bool    slicesEqualNoCase(const char* a, std::size_t alen, const char* b, std::size_t blen)  {
+        if (alen != blen)
+            return false;
+        for (std::size_t i = 0; i < alen; ++i)
+            if (asciiLower(a[i]) != asciiLower(b[i]))
+                return false;
+        return true;
+    }
+
+    /*
+     Walks a comma-separated list in place: yields each element trimmed
+     (possibly empty). Returns false once the list is exhausted.
+    */
+    bool    nextListItem(const char* p, std::size_t len, std::size_t& pos, const char*& item, std::size_t& itemLen)   {
+        if (pos > len)
+            return false;
+        std::size_t start = pos;
+        while (pos < len && p[pos] != ',')
+            ++pos;
+        std::size_t end = pos;
+        ++pos;  // skip ',' (or step past the end)
+        while (start < end && isTrimChar(p[start]))
+            ++start;
+        while (end > start && isTrimChar(p[end - 1]))
+            --end;
+        item = p + start;
+        itemLen = end - start;
+        return true;
     }
 
     void    normalize_slashes(std::string& path)    {
@@ -91,9 +123,10 @@ namespace   {
         return c == ' ' || c == '\t';
     }
 
-    bool    parseRequestLine(const std::string& line, HTTP_Request& request, int& outStatus, std::string& outReason) {
-        const std::string&  s = line;
-        std::size_t         n = s.size();
+    // The request line is the first `lineLen` bytes of the head (no copy of it is made).
+    bool    parseRequestLine(const std::string& head, std::size_t lineLen, HTTP_Request& request, int& outStatus, std::string& outReason) {
+        const std::string&  s = head;
+        std::size_t         n = lineLen;
         std::size_t         i = 0;
 
         // --- METHOD ---------------------------------------------------------------------------
@@ -107,7 +140,7 @@ namespace   {
             ++i;
         }
 
-        request.method = s.substr(0, i);
+        request.method.assign(s, 0, i);
 
         // 1+ SP/HTAB between fields
         if (i >= n || !isSpaceTab(static_cast<unsigned char>(s[i])))
@@ -131,7 +164,7 @@ namespace   {
             ++i;
         }
 
-        request.target = s.substr(tStart, i - tStart);
+        request.target.assign(s, tStart, i - tStart);
 
         if (request.target == "*" && request.method != "OPTIONS")
             return fail(400, "Bad Request", outStatus, outReason);
@@ -141,8 +174,8 @@ namespace   {
             if (qpos == std::string::npos)
                 request.path = request.target;
             else    {
-                request.path = request.target.substr(0, qpos);
-                request.query = request.target.substr(qpos + 1);
+                request.path.assign(request.target, 0, qpos);
+                request.query.assign(request.target, qpos + 1, std::string::npos);
             }
         }
 
@@ -161,7 +194,7 @@ namespace   {
         while (i < n && !isSpaceTab(static_cast<unsigned char>(s[i])))
             ++i;
 
-        request.version = s.substr(vStart, i - vStart);
+        request.version.assign(s, vStart, i - vStart);
 
         // Allow trailing SP/HTAB only
         while (i < n && isSpaceTab(static_cast<unsigned char>(s[i])))
@@ -179,17 +212,16 @@ namespace   {
     }
 
     /*
-    * Parse header lines:
-    * - Lowercase header keys.
-    * - Coalesce duplicates with ", ".
-    * - Support obs-fold: a line starting with SP/HTAB continues previous header value (space-joined).
-    * - Validate Host (required by HTTP/1.1).
+    * Parse header lines in a single scan over the raw head (no per-line copies):
+    * - Lowercase header names in place; well-known names get an enum slot.
+    * - Duplicates stay separate fields; readers coalesce them with ", ".
+    * - Support obs-fold: a line starting with SP/HTAB continues the previous
+    *   header value (the fold's CRLF is blanked to spaces, RFC 7230 3.2.4).
+    * - Validate Host (required by HTTP/1.1 requests; `response` heads have none).
     * - Set keep_alive, content_length, transfer_encoding, body_reader_state.
     */
-
-
-
-    bool    parseHeadersBlock(const std::string& block, HTTP_Request& request, int& outStatus, std::string& outReason)  {
+    bool    parseHeadersBlock(std::size_t blockStart, HTTP_Request& request, int& outStatus, std::string& outReason,
+                              bool response = false)  {
 
         // Reset derived fields for this request -> for keep-alive reuse
         request.keep_alive = (request.version == "HTTP/1.1");
@@ -203,167 +235,173 @@ namespace   {
         request.chunk_state = CS_SIZE;
         request.body.clear();
 
-        // Hardening: garantir que headers não “vazam” entre requests
-        request.headers.clear();
+        RequestHeaders& headers = request.headers;
+        std::string&    raw = headers.raw();
+        const char*     base = raw.data();
+        bool            haveField = false;
+
+        for (std::size_t start = blockStart; start <= raw.size(); ) {
+
+            const char* crlf = bytescan::findCrlf(base + start, base + raw.size());
+            std::size_t eol = crlf ? static_cast<std::size_t>(crlf - base) : raw.size();
+
+            if (eol > start)   {
+                if (raw[start] == ' ' || raw[start] == '\t')    {
+                    if (!haveField) // obs-fold without previous header -> 400
+                        return fail(400, "Bad Request", outStatus, outReason);
+
+                    std::size_t off = start;
+                    std::size_t len = eol - start;
+                    trimSlice(raw, off, len);
+                    if (len > 0) {
+                        const RequestHeaders::Field* prev = headers.last();
+                        for (std::size_t k = prev->valueOff + prev->valueLen; k < off; ++k)
+                            raw[k] = ' ';   // join the fold with SP (same bytes, no copy)
+                        headers.extendLast(off + len);
+                    }
+                }
+                else    {
+                    std::size_t colon = raw.find(':', start);
+                    if (colon == std::string::npos || colon > eol)
+                        return fail(400, "Bad Request", outStatus, outReason);
+
+                    std::size_t nameOff = start;
+                    std::size_t nameLen = colon - start;
+                    while (nameLen > 0 && isTrimChar(raw[nameOff + nameLen - 1]))
+                        --nameLen;
+                    if (nameLen == 0)
+                        return fail(400, "Bad Request", outStatus, outReason);
+
+                    // Validate header-name as ASCII token, lowercasing it in place
+                    for (std::size_t j = nameOff; j < nameOff + nameLen; ++j)  {
+                        if (!istokenChar(static_cast<unsigned char>(raw[j])))
+                            return fail(400, "Bad Request", outStatus, outReason);
+                        raw[j] = asciiLower(raw[j]);
+                    }
 
-        std::string lastKey;
-        lastKey.clear();
+                    std::size_t valueOff = colon + 1;
+                    std::size_t valueLen = eol - valueOff;
+                    trimSlice(raw, valueOff, valueLen);
+
+                    RequestHeaders::Field   f;
+                    f.nameOff = static_cast<unsigned int>(nameOff);
+                    f.nameLen = static_cast<unsigned int>(nameLen);
+                    f.valueOff = static_cast<unsigned int>(valueOff);
+                    f.valueLen = static_cast<unsigned int>(valueLen);
+                    f.id = RequestHeaders::classify(base + nameOff, nameLen);
+
+                    // Duplicate Host must have identical values
+                    if (f.id == RequestHeaders::HOST && headers.has(RequestHeaders::HOST))  {
+                        for (std::size_t k = 0; k < headers.count(); ++k) {
+                            const RequestHeaders::Field& h = headers.field(k);
+                            if (h.id == RequestHeaders::HOST
+                                && !slicesEqualNoCase(base + h.valueOff, h.valueLen, base + valueOff, valueLen))
+                                return fail(400, "Bad Request", outStatus, outReason);
+                        }
+                    }
 
-        for (std::size_t i = 0, start = 0; ; )  {
-            bool    at_crlf = (i + 1 < block.size() && block[i] == '\r' && block[i + 1] == '\n');
-            bool    at_end  = (i == block.size());
-            if (at_end || at_crlf)  {
-                std::string current = (at_end ? block.substr(start) : block.substr(start, i - start));
+                    headers.add(f);
+                    haveField = true;
+                }
+            }
 
-                if (!current.empty())   {
-                    if (current[0] == ' ' || current[0] == '\t')    {
-                        if (lastKey.empty()) // obs-fold without previous header -> 400
-                            return fail(400, "Bad Request", outStatus, outReason);
+            start = eol + 2; // skip CRLF (or step past the end)
+        }
 
-                        std::string value = trim(current);
-                        if (!value.empty()) {
-                            if (!request.headers[lastKey].empty())
-                                request.headers[lastKey] += ' ';
-                            request.headers[lastKey] += value;
+        // Single pass over the classified fields; list-valued headers are
+        // walked element by element, straight from the raw head.
+        bool        haveCL = false;
+        std::size_t parsedCL = 0;
+        bool        haveChunked = false;
+        bool        haveTE = false;
+        bool        haveHost = false;
+        bool        sawClose = false;
+
+        for (std::size_t k = 0; k < headers.count(); ++k) {
+
+            const RequestHeaders::Field&    f = headers.field(k);
+            const char*                     v = base + f.valueOff;
+            std::size_t                     pos = 0;
+            const char*                     item;
+            std::size_t                     itemLen;
+
+            switch (f.id) {
+
+                // Connection: default keep-alive in HTTP/1.1, "close" wins
+                case RequestHeaders::CONNECTION:
+                    while (!sawClose && nextListItem(v, f.valueLen, pos, item, itemLen)) {
+                        if (sliceEquals(item, itemLen, "close")) {
+                            request.keep_alive = false;
+                            sawClose = true;
                         }
+                        else if (sliceEquals(item, itemLen, "keep-alive"))
+                            request.keep_alive = true;
                     }
-                    else    {
-                        std::size_t colon = current.find(':');
-                        if (colon == std::string::npos)
-                            return fail(400, "Bad Request", outStatus, outReason);
+                    break;
 
-                        std::string key = toLowerCopy(trimRight(current.substr(0, colon)));
-                        std::string value = trim(current.substr(colon + 1));
-                        if (key.empty())
+                case RequestHeaders::HOST:
+                    if (f.valueLen > 0 && !haveHost) {
+                        request.host.assign(raw, f.valueOff, f.valueLen);
+                        haveHost = true;
+                    }
+                    break;
+
+                // Content-Length (parse, but may be ignored if TE=chunked);
+                // a list ("5, 5") or repeats must all carry the same value.
+                case RequestHeaders::CONTENT_LENGTH:
+                    while (nextListItem(v, f.valueLen, pos, item, itemLen)) {
+                        if (itemLen == 0)
                             return fail(400, "Bad Request", outStatus, outReason);
 
-                        // Validate header-name as ASCII token
-                        for (std::size_t j = 0; j < key.size(); ++j)  {
-                            if (!istokenChar(static_cast<unsigned char>(key[j])))
+                        std::size_t value = 0;
+                        for (std::size_t d = 0; d < itemLen; ++d) {
+                            if (item[d] < '0' || item[d] > '9')
                                 return fail(400, "Bad Request", outStatus, outReason);
+                            std::size_t digit = static_cast<std::size_t>(item[d] - '0');
+                            if (value > (std::numeric_limits<std::size_t>::max() - digit) / 10)
+                                return fail(413, "Payload Too Large", outStatus, outReason);
+                            value = value * 10 + digit;
                         }
+                        if (haveCL && value != parsedCL)
+                            return fail(400, "Bad Request", outStatus, outReason);
+                        parsedCL = value;
+                        haveCL = true;
+                    }
+                    break;
 
-                        // Duplicate Host must have identical values
-                        if (key == "host")    {
-                            std::map<std::string, std::string>::const_iterator  hprev = request.headers.find("host");
-                            if (hprev != request.headers.end()) {
-                                if (toLowerCopy(trim(hprev->second)) != toLowerCopy(value))
-                                    return fail(400, "Bad Request", outStatus, outReason);
-                            }
-                        }
-
-                        std::map<std::string, std::string>::iterator it = request.headers.find(key);
-                        if (it != request.headers.end())   {
-                            if (!it->second.empty())
-                                it->second += ", ";
-                            it->second += value;
-                        }
-                        else
-                            request.headers[key] = value;
-
-                        lastKey = key;
+                // Transfer-Encoding: only "chunked" is implemented
+                case RequestHeaders::TRANSFER_ENCODING:
+                    haveTE = true;
+                    while (nextListItem(v, f.valueLen, pos, item, itemLen)) {
+                        if (itemLen == 0)
+                            continue;
+                        if (!sliceEquals(item, itemLen, "chunked"))
+                            return fail(501, "Not Implemented", outStatus, outReason);
+                        haveChunked = true;
                     }
-                }
+                    break;
 
-                if (at_end)
+                // Expect: 100-continue
+                case RequestHeaders::EXPECT:
+                    if (sliceEquals(v, f.valueLen, "100-continue"))
+                        request.expectContinue = true;
                     break;
-                i += 2; // skip CRLF
-                start = i;
-            }
-            else
-                ++i;
-        }
 
-        // Connection: default keep-alive in HTTP/1.1
-        std::map<std::string, std::string>::const_iterator chit = request.headers.find("connection");
-        if (chit != request.headers.end())  {
-            std::istringstream iss(toLowerCopy(chit->second));
-            std::string token;
-            while (std::getline(iss, token, ',')) {
-                token = trim(token);
-                if (token == "close") {
-                    request.keep_alive = false;
+                default:
                     break;
-                }
-                else if (token == "keep-alive") {
-                    request.keep_alive = true;
-                }
             }
         }
 
         // Host (required in 1.1)
-        std::map<std::string, std::string>::const_iterator hit = request.headers.find("host");
-        if (request.version == "HTTP/1.1")  {
-            if (hit == request.headers.end() || trim(hit->second).empty())
-                return fail(400, "Bad Request", outStatus, outReason);
-        }
-        if (hit != request.headers.end())
-            request.host = trim(hit->second);
-
-        // Content-Length (parse, but may be ignored if TE=chunked)
-        bool haveCL = false;
-        std::size_t parsedCL = 0;
-
-        std::map<std::string, std::string>::const_iterator clit = request.headers.find("content-length");
-        if (clit != request.headers.end())  {
-            std::string raw = clit->second;
-            std::istringstream iss(raw);
-            std::string part;
-            std::string first;
-
-            while (std::getline(iss, part, ','))    {
-                part = trim(part);
-                if (part.empty())
-                    return fail(400, "Bad Request", outStatus, outReason);
-
-                if (first.empty())
-                    first = part;
-                else if (part != first)
-                    return fail(400, "Bad Request", outStatus, outReason);
-            }
-
-            char* endp = 0;
-            errno = 0;
-            unsigned long v = std::strtoul(first.c_str(), &endp, 10);
-            if (errno == ERANGE)
-                return fail(413, "Payload Too Large", outStatus, outReason);
-            if (endp == first.c_str() || *endp != '\0')
-                return fail(400, "Bad Request", outStatus, outReason);
-
-            parsedCL = static_cast<std::size_t>(v);
-            haveCL = true;
-        }
-
-        // Transfer-Encoding
-        bool haveChunked = false;
-        std::map<std::string, std::string>::const_iterator teit = request.headers.find("transfer-encoding");
-        if (teit != request.headers.end())  {
+        if (request.version == "HTTP/1.1" && !haveHost && !response)
+            return fail(400, "Bad Request", outStatus, outReason);
 
-            std::istringstream iss(toLowerCopy(teit->second));
-            std::string token;
-            while (std::getline(iss, token, ',')) {
-                token = trim(token);
-                if (token.empty())
-                    continue;
-                if (token != "chunked")
-                    return fail(501, "Not Implemented", outStatus, outReason);
-                haveChunked = true;
-            }
+        if (haveTE) {
             if (!haveChunked)
                 return fail(400, "Bad Request", outStatus, outReason);
-
             request.transfer_encoding = "chunked";
         }
 
-        // Expect: 100-continue
-        request.expectContinue = false;
-        std::map<std::string, std::string>::const_iterator eit = request.headers.find("expect");
-        if (eit != request.headers.end())    {
-            std::string v = toLowerCopy(trim(eit->second));
-            if (v == "100-continue")
-                request.expectContinue = true;
-        }
-
         // Decide body reader mode
         if (!request.transfer_encoding.empty() && request.transfer_encoding == "chunked") {
             request.body_reader_state = BR_CHUNKED;
@@ -389,7 +427,9 @@ namespace   {
 
 namespace http  {
 
-    bool    parse_head(const std::string& head, HTTP_Request& request, int& status, std::string& reason)    { 
+    // Takes ownership of `head` (swapped into request.headers): header fields are
+    // slices of it, so parsing never copies a line.
+    bool    parse_head(std::string& head, HTTP_Request& request, int& status, std::string& reason)    { 
         
         // size-limits
         static const std::size_t    MAX_HEADER_BYTES = 16 * 1024;   // total head (request-line + headers)
@@ -405,12 +445,13 @@ namespace http  {
         if (eol > MAX_REQUEST_LINE)
             return fail(431, "Request Header Fields Too Large", status, reason);
 
-        const std::string   requestLine     = head.substr(0, eol);
-        const std::string   headersBlock    = head.substr(eol + 2);
-        
-        if (!parseRequestLine(requestLine, request, status, reason))
+        request.headers.clear();
+        request.headers.raw().swap(head);
+        const std::string&  raw = request.headers.raw();
+
+        if (!parseRequestLine(raw, eol, request, status, reason))
             return false;
-        if (!parseHeadersBlock(headersBlock, request, status, reason))
+        if (!parseHeadersBlock(eol + 2, request, status, reason))
             return false;
 
         normalize_slashes(request.path);
@@ -418,23 +459,78 @@ namespace http  {
         return true;
     }
 
-	bool	extract_next_head(std::string& buffer, std::string& out_head)	{
+    // Client mode ("proxy_pass"): an upstream response head, parsed into an
+    // HTTP_Request with the same header scan as client requests. The status
+    // line gives `status` and `reason`; version, fields, keep_alive and the
+    // body framing land in `response`. False when it isn't an HTTP/1.x response.
+    bool    parse_response_head(std::string& head, HTTP_Request& response, int& status, std::string& reason)  {
+
+        static const std::size_t    MAX_HEADER_BYTES = 16 * 1024;
+
+        std::size_t eol = head.find("\r\n");
+        if (eol == std::string::npos)
+            eol = head.size();      // status line only
+        if (head.size() > MAX_HEADER_BYTES || eol < 12 || head.compare(0, 7, "HTTP/1.") != 0
+            || (head[7] != '0' && head[7] != '1') || head[8] != ' ')
+            return false;
+        for (std::size_t i = 9; i < 12; ++i)
+            if (head[i] < '0' || head[i] > '9')
+                return false;
+        if (eol > 12 && head[12] != ' ')
+            return false;
+
+        response.headers.clear();
+        response.headers.raw().swap(head);
+        const std::string&  raw = response.headers.raw();
+
+        response.version.assign(raw, 0, 8);
+        status = std::atoi(raw.c_str() + 9);
+        reason = (eol > 13) ? raw.substr(13, eol - 13) : std::string();
+
+        int         ignored = 0;
+        std::string ignoredReason;
+        return parseHeadersBlock(eol + 2, response, ignored, ignoredReason, true);
+    }
+
+	// Offset of the next "\r\n\r\n". `scanned` remembers how far earlier calls
+	// got, so a head trickling in is searched once overall, not once per read
+	// (the last 3 bytes are searched again: the terminator may straddle reads).
+	static std::size_t	find_head_end(const IoBuffer& buffer, std::size_t& scanned)	{
+		if (scanned > buffer.size())
+			scanned = 0;
+		std::size_t	delim = buffer.findHeadEnd(scanned > 3 ? scanned - 3 : 0);
+		scanned = (delim == IoBuffer::npos) ? buffer.size() : 0;
+		return delim;
+	}
+
+	bool	extract_next_head(IoBuffer& buffer, std::string& out_head, std::size_t& scanned)	{
 		out_head.clear();
 
         // Remove any number of leading empty heads
-        while (buffer.size() >= 4 && buffer.compare(0, 4, "\r\n\r\n") == 0)
-            buffer.erase(0, 4);
+        while (buffer.startsWith("\r\n\r\n"))   {
+            buffer.consume(4);
+            scanned = 0;
+        }
 
         // Find next head terminator
-        std::size_t delim = buffer.find("\r\n\r\n");
-        if (delim == std::string::npos)
+        std::size_t delim = find_head_end(buffer, scanned);
+        if (delim == IoBuffer::npos)
             return false;
         // caller will wait for more bytes
 
-        // Produce head and drop in from buffer
-        out_head.assign(buffer, 0, delim);
-        buffer.erase(0, delim + 4);
+        // Produce head and drop in from buffer (read cursor moves, no memmove)
+        out_head.assign(buffer.data(), delim);
+        buffer.consume(delim + 4);
         return true;
 	}
 
+	// A complete head is waiting (pipelining), without consuming anything.
+	bool	head_buffered(const IoBuffer& buffer, std::size_t& scanned)	{
+		std::size_t	before = scanned;
+		bool		found = find_head_end(buffer, scanned) != IoBuffer::npos;
+		if (found)
+			scanned = before;		// extract_next_head() will find it again from there
+		return found;
+	}
+
 } // namespace http
\ No newline at end of file
@@ -14,18 +14,6 @@
 
 namespace   {
 
-    bool    read_file(const std::string& path, std::string& out)    {
-        std::ifstream   in(path.c_str());
-        if (!in)
-            return false;
-        std::string s;
-        char        buf[4096];  // 4KiB -> common page size
-        while (in.read(buf, sizeof(buf)) || in.gcount() > 0)    // in.gcount() tells how many bytes were actually read into buf, returns a std::streamsize
-            s.append(buf, static_cast<std::size_t>(in.gcount()));
-        out.swap(s);
-        return true;
-    }
-
     std::string default_error_html(int status, const std::string& reason)   {
         std::ostringstream html;
         html << "<!DOCTYPE html><html><head><meta charset=\"utf-8\">"
@@ -42,48 +30,110 @@ namespace   {
 
 namespace http  {
 
-    static std::string  http_date() {
+    // The Date header only changes once a second: the event loop calls
+    // refresh_date() every iteration and strftime runs on a new second only.
+    static std::time_t  g_dateSecond = static_cast<std::time_t>(-1);
+    static std::string  g_date;
+
+    void    refresh_date(std::time_t now) {
+        if (now == g_dateSecond)
+            return;
         char        buf[128];
-        std::time_t t = std::time(NULL);    // time_t is “seconds since 1 Jan 1970 UTC” (UNIX epoch)
-        std::tm*     g = std::gmtime(&t);   // std::gmtime(&t) converts t into a broken-down UTC time
+        std::tm*    g = std::gmtime(&now);    // std::gmtime(&t) converts t into a broken-down UTC time
         std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", g);   // strftime formats a tm into a string according to a format string
-        return std::string(buf);
+        g_date = buf;
+        g_dateSecond = now;
     }
 
-    std::string build_error_response(const Server& srv, int status, const std::string& reason, bool keep_alive) {
-        // 1) decide body (configured file -> fallback default)
-        std::string body;
-
-        // status -> "404" etc.
-        std::ostringstream  code_ss;
-        code_ss << status;
-        const std::string   code_str = code_ss.str();
-        // C++98 method of converting int to string
-
-        std::map<std::string, std::string>::const_iterator  it = srv.error_pages.find(code_str);
-        if (it != srv.error_pages.end())    {
-            if (!read_file(it->second, body))   // switch the body to designated error code message
-                body = default_error_html(status, reason);
-        }
+    static const std::string&   http_date() {
+        if (g_dateSecond == static_cast<std::time_t>(-1))
+            refresh_date(std::time(NULL));  // used before the loop started (startup errors)
+        return g_date;
+    }
+
+    // "Keep-Alive: timeout=N" advertises the server's keepalive_timeout (whole seconds, at least 1).
+    static long keep_alive_seconds(long keep_alive_ms) {
+        long sec = keep_alive_ms / 1000;
+        return sec > 0 ? sec : 1;
+    }
+
+    // Prebuilt head + the per-send fields: one allocation, no formatting.
+    static std::string  splice_error(const PrebuiltError& e, bool keep_alive, bool with_body) {
+        const std::string&  date = http_date();
+        std::string         out;
+        out.reserve(e.head.size() + e.keepAlive.size() + date.size() + (with_body ? e.body.size() : 0) + 32);
+        out += e.head;
+        out += "Date: ";
+        out += date;
+        out += "\r\n";
+        if (keep_alive)
+            out += e.keepAlive;
         else
-            body = default_error_html(status, reason);
+            out += "Connection: close\r\n";
+        out += "\r\n";
+        if (with_body)
+            out += e.body;
+        return out;
+    }
+
+    // Everything of an error response that does not change between sends.
+    PrebuiltError   prebuild_error(int status, const std::string& reason, const std::string& body,
+                                   const std::string& extra_fields, long keep_alive_ms) {
+        PrebuiltError   e;
+        e.reason = reason;
+        e.body = body;
+
+        std::ostringstream  length;
+        length << body.size();
+        e.contentLength = length.str();
 
-        // 2) serialize response (mirrors the simple builder)
         std::ostringstream  oss;
         oss << "HTTP/1.1 " << status << ' ' << reason << "\r\n";
         oss << "Server: webserv\r\n";
-        oss << "Date: " << http_date() << "\r\n";
-        oss << "Content-Length: " << body.size() << "\r\n";
+        oss << "Content-Length: " << e.contentLength << "\r\n";
         oss << "Content-Type: text/html\r\n";
-        if (keep_alive) {
-            oss << "Connection: keep-alive\r\n";
-            oss << "Keep-Alive: timeout=5\r\n";
-        }
-        else
-            oss << "Connection: close\r\n";
-        oss << "\r\n";
-        oss << body;
-        return oss.str();
+        oss << extra_fields;
+        e.head = oss.str();
+
+        std::ostringstream  ka;
+        ka << "Connection: keep-alive\r\n";
+        ka << "Keep-Alive: timeout=" << keep_alive_seconds(keep_alive_ms) << "\r\n";
+        e.keepAlive = ka.str();
+        return e;
+    }
+
+    // The core's errors: the body is the server's error_page (already read by
+    // its RouteTable, resolved like the App does) or the default page.
+    static PrebuiltError    make_error(const Server& srv, int status, const std::string& reason) {
+        const std::map<int, std::string>& pages = srv.routes.fallback().errorBodies;
+        std::map<int, std::string>::const_iterator  it = pages.find(status);
+        return prebuild_error(status, reason, (it != pages.end()) ? it->second : default_error_html(status, reason),
+                              status == 503 ? "Retry-After: 1\r\n" : "",    // shed by the admission limits: capacity is back within a second
+                              srv.timeouts.keepAliveMs);
+    }
+
+    // The statuses the core answers on its own (parse and body errors, limits).
+    void    prebuild_error_responses(Server& srv) {
+        static const int            codes[] = { 400, 408, 413, 414, 431, 500, 501, 503, 505 };
+        static const char* const    reasons[] = { "Bad Request", "Request Timeout", "Payload Too Large", "URI Too Long",
+                                                  "Request Header Fields Too Large", "Internal Server Error",
+                                                  "Not Implemented", "Service Unavailable", "HTTP Version Not Supported" };
+        srv.error_responses.clear();
+        for (std::size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+            srv.error_responses[codes[i]] = make_error(srv, codes[i], reasons[i]);
+    }
+
+    std::string build_error_response(const Server& srv, int status, const std::string& reason, bool keep_alive) {
+        std::map<int, PrebuiltError>::const_iterator    it = srv.error_responses.find(status);
+        if (it == srv.error_responses.end() || it->second.reason != reason)
+            return splice_error(make_error(srv, status, reason), keep_alive, true);     // not prebuilt: same bytes, built now
+        return splice_error(it->second, keep_alive, true);
+    }
+
+    // Head of a prebuilt App error (its location's template); the body goes
+    // out as its own segment, like any other response body.
+    std::string build_prebuilt_head(const PrebuiltError& e, bool keep_alive) {
+        return splice_error(e, keep_alive, false);
     }
 
     // Local helper (C++98)
@@ -95,51 +145,43 @@ namespace http  {
     }
 
 
-    std::string serialize_response(const HTTP_Response& res, const std::string& version) {
+    // Status line + headers only; the body goes out as its own writev() segment.
+    // The core decides keep-alive before calling this, so Connection/Keep-Alive
+    // are emitted exactly once from `keep_alive` (whatever the App put there).
+    std::string serialize_head(const HTTP_Response& res, const std::string& version, bool keep_alive, long keep_alive_ms) {
     std::ostringstream oss;
     oss << version << ' ' << res.status << ' ' << res.reason << "\r\n";
 
     bool hasCL = false;
     bool hasServer = false;
     bool hasDate = false;
-
-    bool hasConnection = false;
     bool hasKeepAlive = false;
-
-    // Guardar o valor de Connection caso venha nos headers (qualquer casing)
-    std::string connectionValue;
+    bool hasTE = false;
 
     for (std::map<std::string, std::string>::const_iterator it = res.headers.begin();
          it != res.headers.end(); ++it)
     {
         const std::string lower = toLowerCopy(it->first);
 
-        if (lower == "content-length") {
-            hasCL = true;
-            oss << it->first << ": " << it->second << "\r\n";
+        if (lower == "connection")
+            continue;   // emitida uma única vez no fim, a partir de keep_alive
+        if (lower == "keep-alive") {
+            if (!keep_alive)
+                continue;
+            hasKeepAlive = true;
         }
-        else if (lower == "server") {
+        else if (lower == "content-length")
+            hasCL = true;
+        else if (lower == "transfer-encoding")
+            hasTE = true;   // chunked (streamed CGI): no Content-Length
+        else if (lower == "server")
             hasServer = true;
-            oss << it->first << ": " << it->second << "\r\n";
-        }
-        else if (lower == "date") {
+        else if (lower == "date")
             hasDate = true;
-            oss << it->first << ": " << it->second << "\r\n";
-        }
-        else if (lower == "connection") {
-            // NÃO imprimir já — vamos emitir uma única vez no fim, normalizado
-            hasConnection = true;
-            connectionValue = it->second; // fica o último que aparecer (se houver duplicados)
-        }
-        else if (lower == "keep-alive") {
-            hasKeepAlive = true;
-            oss << it->first << ": " << it->second << "\r\n";
-        }
-        else {
-            // header "normal"
-            oss << it->first << ": " << it->second << "\r\n";
-        }
+
+        oss << it->first << ": " << it->second << "\r\n";
     }
+    oss << res.headerLines;
 
     // Inject defaults only if missing
     if (!hasServer)
@@ -147,27 +189,103 @@ namespace http  {
     if (!hasDate)
         oss << "Date: " << http_date() << "\r\n";
 
-    // Connection: emitir exactamente UMA vez
-    if (hasConnection) {
-        // Normaliza casing na linha emitida (mantém valor que veio da app)
-        oss << "Connection: " << connectionValue << "\r\n";
-    } else {
-        oss << "Connection: " << (res.close ? "close" : "keep-alive") << "\r\n";
-    }
+    oss << "Connection: " << (keep_alive ? "keep-alive" : "close") << "\r\n";
+    if (keep_alive && !hasKeepAlive)
+        oss << "Keep-Alive: timeout=" << keep_alive_seconds(keep_alive_ms) << "\r\n";   // coerente com build_error_response
 
-    // Se for keep-alive e não houver Keep-Alive definido, injectar (coerente com build_error_response)
-    // Nota: só injectamos quando a ligação deve ficar aberta.
-    // A regra aqui usa res.close, porque é o “source of truth” do core/app.
-    if (!res.close && !hasKeepAlive)
-        oss << "Keep-Alive: timeout=5\r\n";
-
-    if (!hasCL)
+    if (!hasCL && !hasTE && res.status != 304)    // a 304 has no body; a Content-Length would describe the 200's
         oss << "Content-Length: " << res.body.size() << "\r\n";
 
     oss << "\r\n";
-    oss << res.body;
     return oss.str();
 }
 
+    // True when the response itself asks to end the connection (App decision or a
+    // CGI script's own "Connection: close").
+    bool response_wants_close(const HTTP_Response& res) {
+        if (res.close)
+            return true;
+        for (std::map<std::string, std::string>::const_iterator it = res.headers.begin();
+             it != res.headers.end(); ++it) {
+            if (toLowerCopy(it->first) == "connection" && toLowerCopy(it->second) == "close")
+                return true;
+        }
+        return false;
+    }
+
+    // Hop-by-hop fields (RFC 7230 6.1) describe one connection, not the message.
+    bool is_hop_by_hop(const std::string& lower) {
+        return lower == "connection" || lower == "keep-alive" || lower == "proxy-connection"
+            || lower == "te" || lower == "trailer" || lower == "transfer-encoding" || lower == "upgrade";
+    }
+
+    // Client mode ("proxy_pass"): the request head as it goes upstream. Always
+    // HTTP/1.1 keep-alive; hop-by-hop fields (and those the client's Connection
+    // names) are dropped, and the framing is restated for the body the core
+    // forwards: Content-Length as received, a chunked body re-chunked.
+    // Expect is answered by the core itself, so it is not forwarded either.
+    void serialize_request_head(const HTTP_Request& req, const std::string& client_addr,
+                                const std::string& upstream, std::string& out) {
+        const RequestHeaders& headers = req.headers;
+
+        std::vector<std::string> named;     // "Connection: close, X-Foo" -> also drop x-foo
+        std::istringstream connection(toLowerCopy(headers.value(RequestHeaders::CONNECTION)));
+        std::string token;
+        while (std::getline(connection, token, ',')) {
+            std::size_t b = token.find_first_not_of(" \t");
+            std::size_t e = token.find_last_not_of(" \t");
+            if (b != std::string::npos)
+                named.push_back(token.substr(b, e - b + 1));
+        }
+
+        out.clear();
+        out.reserve(req.target.size() + headers.count() * 48 + 256);
+        out += req.method;
+        out += ' ';
+        out += req.target;
+        out += " HTTP/1.1\r\n";
+
+        std::string forwarded_for;
+        for (std::size_t i = 0; i < headers.count(); ++i) {
+            const RequestHeaders::Field& f = headers.field(i);
+            const std::string name = headers.name(f);      // lowercased by the parser
+            if (is_hop_by_hop(name) || name == "content-length" || name == "expect"
+                || name == "x-forwarded-proto"
+                || std::find(named.begin(), named.end(), name) != named.end())
+                continue;
+            if (name == "x-forwarded-for") {
+                if (!forwarded_for.empty())
+                    forwarded_for += ", ";
+                forwarded_for += headers.value(f);
+                continue;
+            }
+            out += name;
+            out += ": ";
+            out.append(headers.valueData(f), f.valueLen);
+            out += "\r\n";
+        }
+
+        if (!headers.has(RequestHeaders::HOST))
+            out += "host: " + upstream + "\r\n";     // HTTP/1.0 client without Host
+        if (!client_addr.empty()) {
+            if (!forwarded_for.empty())
+                forwarded_for += ", ";
+            forwarded_for += client_addr;
+        }
+        if (!forwarded_for.empty())
+            out += "x-forwarded-for: " + forwarded_for + "\r\n";
+        out += "x-forwarded-proto: http\r\n";
+
+        if (req.body_reader_state == BR_CHUNKED)
+            out += "transfer-encoding: chunked\r\n";
+        else if (req.body_reader_state == BR_CONTENT_LENGTH) {
+            std::ostringstream cl;
+            cl << "content-length: " << req.content_length << "\r\n";
+            out += cl.str();
+        }
+        else if (headers.has(RequestHeaders::CONTENT_LENGTH))
+            out += "content-length: 0\r\n";       // an empty POST still says so
+        out += "\r\n";
+    }
 
 }
\ No newline at end of file
@@ -0,0 +1,154 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   IoBuffer.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/IoBuffer.hpp"
+#include "../include/ByteScan.hpp"
+
+// Idle connections give back buffers that grew past this (e.g. after a big body).
+static const std::size_t	KEEP_CAPACITY = 64 * 1024;
+
+IoBuffer::IoBuffer()
+    :   _buf(), _rpos(0), _wpos(0)
+{}
+
+bool	IoBuffer::empty() const	{
+	return _rpos == _wpos;
+}
+
+std::size_t	IoBuffer::size() const	{
+	return _wpos - _rpos;
+}
+
+const char*	IoBuffer::data() const	{
+	return _buf.empty() ? "" : &_buf[0] + _rpos;
+}
+
+char	IoBuffer::operator[](std::size_t i) const	{
+	return _buf[_rpos + i];
+}
+
+char*	IoBuffer::prepare(std::size_t n)	{
+
+	if (_rpos == _wpos)	{						// nothing unread: rewind for free
+		_rpos = 0;
+		_wpos = 0;
+	}
+	if (_buf.size() - _wpos >= n)
+		return &_buf[0] + _wpos;
+
+	const std::size_t	unread = _wpos - _rpos;
+
+	if (_rpos > 0 && _buf.size() - unread >= n)	{	// enough room once compacted
+		std::memmove(&_buf[0], &_buf[0] + _rpos, unread);
+		_rpos = 0;
+		_wpos = unread;
+		return &_buf[0] + _wpos;
+	}
+
+	std::size_t	cap = _buf.empty() ? 4096 : _buf.size() * 2;
+	while (cap - unread < n)
+		cap *= 2;
+
+	std::vector<char>	grown(cap);
+	if (unread > 0)
+		std::memcpy(&grown[0], &_buf[0] + _rpos, unread);
+	_buf.swap(grown);
+	_rpos = 0;
+	_wpos = unread;
+	return &_buf[0] + _wpos;
+}
+
+void	IoBuffer::commit(std::size_t n)	{
+	_wpos += n;
+}
+
+void	IoBuffer::append(const char* p, std::size_t n)	{
+	if (n == 0)
+		return;
+	std::memcpy(prepare(n), p, n);
+	commit(n);
+}
+
+void	IoBuffer::consume(std::size_t n)	{
+	if (n >= size())	{
+		_rpos = 0;
+		_wpos = 0;
+		return;
+	}
+	_rpos += n;
+}
+
+void	IoBuffer::clear()	{
+	_rpos = 0;
+	_wpos = 0;
+	if (_buf.size() > KEEP_CAPACITY)
+		std::vector<char>().swap(_buf);
+}
+
+void	IoBuffer::swap(IoBuffer& other)	{
+	_buf.swap(other._buf);
+	std::swap(_rpos, other._rpos);
+	std::swap(_wpos, other._wpos);
+}
+
+std::size_t	IoBuffer::find(const char* needle, std::size_t from) const	{
+
+	const std::size_t	nlen = std::strlen(needle);
+	const std::size_t	len = size();
+
+	if (nlen == 0 || from > len || len - from < nlen)
+		return npos;
+
+	const char*	base = data();
+	const char*	p = base + from;
+	const char*	last = base + len - nlen;
+
+	while (p <= last)	{
+		const void*	hit = std::memchr(p, needle[0], static_cast<std::size_t>(last - p) + 1);
+		if (!hit)
+			return npos;
+		p = static_cast<const char*>(hit);
+		if (std::memcmp(p, needle, nlen) == 0)
+			return static_cast<std::size_t>(p - base);
+		++p;
+	}
+	return npos;
+}
+
+std::size_t	IoBuffer::findCrlf(std::size_t from) const	{
+
+	if (from >= size())
+		return npos;
+	const char*	hit = bytescan::findCrlf(data() + from, data() + size());
+	return hit ? static_cast<std::size_t>(hit - data()) : npos;
+}
+
+std::size_t	IoBuffer::findHeadEnd(std::size_t from) const	{
+
+	if (from >= size())
+		return npos;
+	const char*	hit = bytescan::findCrlfCrlf(data() + from, data() + size());
+	return hit ? static_cast<std::size_t>(hit - data()) : npos;
+}
+
+bool	IoBuffer::startsWith(const char* prefix) const	{
+	const std::size_t	n = std::strlen(prefix);
+	return size() >= n && std::memcmp(data(), prefix, n) == 0;
+}
+
+std::string	IoBuffer::substr(std::size_t pos, std::size_t n) const	{
+	if (pos >= size())
+		return std::string();
+	if (n > size() - pos)
+		n = size() - pos;
+	return std::string(data() + pos, n);
+}
@@ -0,0 +1,156 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/Metrics.hpp"
+
+// Upper bounds of the histogram buckets: 50us .. 10s.
+const long	LatencyHistogram::BOUNDS_US[LatencyHistogram::BUCKETS] = {
+	50, 100, 250, 500,
+	1000, 2500, 5000, 10000,
+	25000, 50000, 100000, 250000,
+	500000, 1000000, 2500000, 10000000
+};
+
+static const char* const	CLOSE_REASON_NAMES[CLOSE_REASON_COUNT] = {
+	"done", "peer", "error", "header_timeout",
+	"body_timeout", "keepalive_idle", "write_timeout", "shutdown"
+};
+
+LatencyHistogram::LatencyHistogram()
+	:	_count(0), _sumUs(0)
+{
+	for (int i = 0; i <= BUCKETS; ++i)
+		_counts[i] = 0;
+}
+
+void	LatencyHistogram::observe(long long us)	{
+
+	if (us < 0)
+		us = 0;
+	int	i = 0;
+	while (i < BUCKETS && us > BOUNDS_US[i])
+		++i;
+	++_counts[i];
+	++_count;
+	_sumUs += us;
+}
+
+// Prometheus histogram: cumulative buckets in seconds, then _sum and _count.
+void	LatencyHistogram::render(std::ostream& out, const char* name, const char* help) const	{
+
+	out << "# HELP " << name << ' ' << help << "\n"
+		<< "# TYPE " << name << " histogram\n";
+
+	unsigned long	cumulative = 0;
+	for (int i = 0; i < BUCKETS; ++i)	{
+		cumulative += _counts[i];
+		out << name << "_bucket{le=\"" << static_cast<double>(BOUNDS_US[i]) / 1e6 << "\"} " << cumulative << "\n";
+	}
+	out << name << "_bucket{le=\"+Inf\"} " << _count << "\n"
+		<< name << "_sum " << static_cast<double>(_sumUs) / 1e6 << "\n"
+		<< name << "_count " << _count << "\n";
+}
+
+//**************************************************************************************************
+
+Metrics::Metrics()
+	:	accepted(0), acceptErrors(0), acceptBatchCapped(0),
+		listenerPauses(0), shedConnections(0), shedRequests(0), bytesRead(0), bytesWritten(0), requests(0), cgiSpawned(0), cgiTimedOut(0),
+		proxyConnects(0), proxyReuses(0), proxyErrors(0)
+{
+	for (int i = 0; i < CLOSE_REASON_COUNT; ++i)
+		closed[i] = 0;
+}
+
+long long	Metrics::nowUs()	{
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<long long>(ts.tv_sec) * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// One counter slot per route, resolved by pointer at request time (the route
+// tables live in ServerRunner::_servers for the whole run).
+void	Metrics::registerLocations(const std::vector<Server>& servers)	{
+
+	_locationIndex.clear();
+	_locations.clear();
+	for (std::size_t s = 0; s < servers.size(); ++s)	{
+		const Server&	srv = servers[s];
+		std::string		name = srv.server_name.empty() ? std::string("_") : srv.server_name[0];
+		for (std::size_t r = 0; r < srv.routes.size(); ++r)	{
+			LocationCounter	c;
+			c.server = name;
+			c.path = srv.routes.at(r).locationPath;
+			c.requests = 0;
+			_locationIndex[&srv.routes.at(r)] = _locations.size();
+			_locations.push_back(c);
+		}
+	}
+}
+
+void	Metrics::countRequest(const EffectiveConfig* route)	{
+
+	++requests;
+	if (!route)
+		return;
+	std::map<const EffectiveConfig*, std::size_t>::const_iterator	it = _locationIndex.find(route);
+	if (it != _locationIndex.end())
+		++_locations[it->second].requests;
+}
+
+void	Metrics::render(std::ostream& out) const	{
+
+	out << "# TYPE webserv_connections_accepted_total counter\n"
+		<< "webserv_connections_accepted_total " << accepted << "\n"
+		<< "# TYPE webserv_accept_errors_total counter\n"
+		<< "webserv_accept_errors_total " << acceptErrors << "\n"
+		<< "# TYPE webserv_accept_batch_capped_total counter\n"
+		<< "webserv_accept_batch_capped_total " << acceptBatchCapped << "\n"
+		<< "# TYPE webserv_listener_pauses_total counter\n"
+		<< "webserv_listener_pauses_total " << listenerPauses << "\n"
+		<< "# TYPE webserv_shed_total counter\n"
+		<< "webserv_shed_total{limit=\"conn_per_ip\"} " << shedConnections << "\n"
+		<< "webserv_shed_total{limit=\"req_per_ip\"} " << shedRequests << "\n";
+
+	out << "# TYPE webserv_connections_closed_total counter\n";
+	for (int i = 0; i < CLOSE_REASON_COUNT; ++i)
+		out << "webserv_connections_closed_total{reason=\"" << CLOSE_REASON_NAMES[i] << "\"} " << closed[i] << "\n";
+
+	out << "# TYPE webserv_bytes_read_total counter\n"
+		<< "webserv_bytes_read_total " << bytesRead << "\n"
+		<< "# TYPE webserv_bytes_written_total counter\n"
+		<< "webserv_bytes_written_total " << bytesWritten << "\n";
+
+	out << "# TYPE webserv_requests_total counter\n"
+		<< "webserv_requests_total " << requests << "\n"
+		<< "# TYPE webserv_location_requests_total counter\n";
+	for (std::size_t i = 0; i < _locations.size(); ++i)
+		out << "webserv_location_requests_total{server=\"" << _locations[i].server
+			<< "\",location=\"" << _locations[i].path << "\"} " << _locations[i].requests << "\n";
+
+	out << "# TYPE webserv_cgi_spawned_total counter\n"
+		<< "webserv_cgi_spawned_total " << cgiSpawned << "\n"
+		<< "# TYPE webserv_cgi_timeouts_total counter\n"
+		<< "webserv_cgi_timeouts_total " << cgiTimedOut << "\n"
+		<< "# TYPE webserv_proxy_connects_total counter\n"
+		<< "webserv_proxy_connects_total " << proxyConnects << "\n"
+		<< "# TYPE webserv_proxy_reuses_total counter\n"
+		<< "webserv_proxy_reuses_total " << proxyReuses << "\n"
+		<< "# TYPE webserv_proxy_errors_total counter\n"
+		<< "webserv_proxy_errors_total " << proxyErrors << "\n";
+
+	headerParse.render(out, "webserv_header_parse_seconds", "Time to extract and parse one request head.");
+	handle.render(out, "webserv_handle_request_seconds", "Time spent in the application handler.");
+	writeOut.render(out, "webserv_write_seconds", "Time from response queued to last byte written.");
+	cgi.render(out, "webserv_cgi_seconds", "Time from CGI spawn to response built.");
+	upstream.render(out, "webserv_upstream_seconds", "Time from proxied request head to upstream response complete.");
+}
@@ -0,0 +1,269 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Multipart.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Multipart.hpp"
+#include "ByteScan.hpp"
+#include "SpillFile.hpp"
+
+namespace   {
+
+    const std::size_t   MAX_BOUNDARY = 70;          // RFC 2046
+    const std::size_t   MAX_PART_HEADERS = 8 * 1024;
+    const std::size_t   MAX_DELIMITER_PADDING = 256;    // LWSP allowed after a delimiter
+
+    std::string lowerCopy(const std::string& s) {
+        std::string out(s);
+        for (std::size_t i = 0; i < out.size(); ++i)
+            out[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(out[i])));
+        return out;
+    }
+
+    // Value of `key=` in a "; "-separated parameter list, quoted or token.
+    // `key` is lowercase; "filename" does not match "filename*".
+    bool    paramValue(const std::string& header, const std::string& key, std::string& out) {
+        const std::string   lower = lowerCopy(header);
+        std::size_t         pos = 0;
+
+        while ((pos = lower.find(key, pos)) != std::string::npos) {
+            std::size_t before = pos;
+            while (before > 0 && (lower[before - 1] == ' ' || lower[before - 1] == '\t'))
+                --before;
+            std::size_t eq = pos + key.size();
+            while (eq < lower.size() && (lower[eq] == ' ' || lower[eq] == '\t'))
+                ++eq;
+            if ((before == 0 || lower[before - 1] == ';') && eq < lower.size() && lower[eq] == '=') {
+                std::size_t v = eq + 1;
+                while (v < header.size() && (header[v] == ' ' || header[v] == '\t'))
+                    ++v;
+                out.clear();
+                if (v < header.size() && header[v] == '"') {
+                    for (++v; v < header.size() && header[v] != '"'; ++v) {
+                        if (header[v] == '\\' && v + 1 < header.size())
+                            ++v;
+                        out += header[v];
+                    }
+                    return v < header.size();
+                }
+                std::size_t end = header.find(';', v);
+                out = header.substr(v, end == std::string::npos ? std::string::npos : end - v);
+                while (!out.empty() && (out[out.size() - 1] == ' ' || out[out.size() - 1] == '\t'))
+                    out.erase(out.size() - 1);
+                return true;
+            }
+            pos += key.size();
+        }
+        return false;
+    }
+}
+
+MultipartParser::MultipartParser()
+:   _state(MP_OFF)
+,   _delimiter()
+,   _directory()
+,   _pending()
+,   _fd(-1)
+,   _parts()
+{
+    for (std::size_t i = 0; i < 256; ++i)
+        _shift[i] = 1;
+}
+
+// "multipart/form-data; boundary=----abc" (token or quoted, 1..70 chars).
+bool    MultipartParser::boundaryOf(const std::string& contentType, std::string& boundary) {
+    if (paramValue(contentType, "boundary", boundary) && !boundary.empty() && boundary.size() <= MAX_BOUNDARY)
+        return true;
+    boundary.clear();
+    return false;
+}
+
+void    MultipartParser::start(const std::string& boundary, const std::string& directory) {
+    discard();
+    if (boundary.empty()) {
+        _state = MP_ERROR;
+        return;
+    }
+    _delimiter = "\r\n--" + boundary;
+    _directory = directory;
+
+    const std::size_t   n = _delimiter.size();
+    for (std::size_t i = 0; i < 256; ++i)
+        _shift[i] = n;
+    for (std::size_t i = 0; i + 1 < n; ++i)
+        _shift[static_cast<unsigned char>(_delimiter[i])] = n - 1 - i;
+
+    _pending = "\r\n";      // the first delimiter has no CRLF before it: pretend the preamble ended with one
+    _state = MP_BODY;       // with no open part: preamble bytes are skipped
+}
+
+bool    MultipartParser::active() const {
+    return _state != MP_OFF;
+}
+
+bool    MultipartParser::complete() const {
+    return _state == MP_DONE;
+}
+
+const std::vector<MultipartPart>&   MultipartParser::parts() const {
+    return _parts;
+}
+
+void    MultipartParser::discard() {
+    closePart();
+    for (std::size_t i = 0; i < _parts.size(); ++i)
+        unlink(_parts[i].tmpPath.c_str());
+    _parts.clear();
+    std::string().swap(_pending);
+    _state = MP_OFF;
+}
+
+// Horspool: compare the window's last byte first, shift by the table on a miss.
+const char* MultipartParser::search(const char* p, const char* end) const {
+    const std::size_t   n = _delimiter.size();
+    const char* const   d = _delimiter.data();
+
+    while (end - p >= static_cast<std::ptrdiff_t>(n)) {
+        const unsigned char last = static_cast<unsigned char>(p[n - 1]);
+        if (last == static_cast<unsigned char>(d[n - 1]) && std::memcmp(p, d, n - 1) == 0)
+            return p;
+        p += _shift[last];
+    }
+    return NULL;
+}
+
+int     MultipartParser::feed(const char* data, std::size_t len) {
+    if (_state == MP_ERROR)
+        return 400;
+    if (_state == MP_DONE || _state == MP_OFF)
+        return 0;                                   // epilogue: ignored
+
+    _pending.append(data, len);
+    const char* const   base = _pending.data();
+    const char* const   end = base + _pending.size();
+    const char*         p = base;
+    int                 status = 0;
+
+    while (status == 0 && _state != MP_DONE) {
+
+        if (_state == MP_BODY) {
+            const char* hit = search(p, end);
+            if (!hit) {
+                // Keep what could still be the start of a delimiter for the next feed.
+                const std::size_t   keep = _delimiter.size() - 1;
+                if (static_cast<std::size_t>(end - p) > keep) {
+                    status = writePart(p, static_cast<std::size_t>(end - p) - keep);
+                    p = end - keep;
+                }
+                break;
+            }
+            status = writePart(p, static_cast<std::size_t>(hit - p));
+            closePart();
+            p = hit + _delimiter.size();
+            _state = MP_DELIMITER;
+        }
+        else if (_state == MP_DELIMITER) {
+            if (end - p < 2)
+                break;
+            if (p[0] == '-' && p[1] == '-') {       // close-delimiter
+                p = end;
+                _state = MP_DONE;
+                break;
+            }
+            const char* crlf = bytescan::findCrlf(p, end);
+            if (!crlf) {
+                if (static_cast<std::size_t>(end - p) > MAX_DELIMITER_PADDING)
+                    status = 400;
+                break;
+            }
+            for (const char* q = p; q < crlf; ++q)
+                if (*q != ' ' && *q != '\t')
+                    status = 400;
+            p = crlf + 2;
+            _state = MP_HEADERS;
+        }
+        else if (_state == MP_HEADERS) {
+            if (end - p >= 2 && p[0] == '\r' && p[1] == '\n') {     // part without headers
+                status = openPart(p, 0);
+                p += 2;
+                continue;
+            }
+            const char* blank = bytescan::findCrlfCrlf(p, end);
+            if (!blank) {
+                if (static_cast<std::size_t>(end - p) > MAX_PART_HEADERS)
+                    status = 400;
+                break;
+            }
+            status = openPart(p, static_cast<std::size_t>(blank - p) + 2);
+            p = blank + 4;
+        }
+    }
+
+    if (status != 0) {
+        discard();
+        _state = MP_ERROR;
+        return status;
+    }
+    if (_state == MP_DONE)
+        std::string().swap(_pending);
+    else
+        _pending.erase(0, static_cast<std::size_t>(p - base));
+    return 0;
+}
+
+// A part with a Content-Disposition filename gets a temp file; anything else
+// (plain fields, files sent without a name) is read past.
+int     MultipartParser::openPart(const char* headers, std::size_t len) {
+    _state = MP_BODY;
+
+    std::string disposition;
+    std::size_t pos = 0;
+    while (pos < len) {
+        const char* crlf = bytescan::findCrlf(headers + pos, headers + len);
+        std::size_t eol = crlf ? static_cast<std::size_t>(crlf - headers) : len;
+        std::string line(headers + pos, eol - pos);
+        if (lowerCopy(line.substr(0, 20)) == "content-disposition:")
+            disposition = line.substr(20);
+        pos = eol + 2;
+    }
+
+    std::string filename;
+    if (!paramValue(disposition, "filename", filename))
+        return 0;
+    std::size_t slash = filename.find_last_of("/\\");   // some browsers still send a full path
+    if (slash != std::string::npos)
+        filename.erase(0, slash + 1);
+    if (filename.empty())
+        return 0;                                       // <input type=file> left empty
+
+    MultipartPart   part;
+    int fd = spill::create(_directory, part.tmpPath);
+    if (fd < 0)
+        return 500;
+
+    paramValue(disposition, "name", part.name);
+    part.filename = filename;
+    _parts.push_back(part);
+    _fd = fd;
+    return 0;
+}
+
+int     MultipartParser::writePart(const char* p, std::size_t n) {
+    if (_fd < 0 || n == 0)
+        return 0;
+    _parts.back().size += n;
+    return spill::writeAll(_fd, p, n) ? 0 : 500;
+}
+
+void    MultipartParser::closePart() {
+    if (_fd >= 0)
+        close(_fd);
+    _fd = -1;
+}
@@ -0,0 +1,88 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Proxy.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/Proxy.hpp"
+
+namespace proxy {
+
+    bool    parseUpstream(const std::string& spec, std::string& host, std::string& port)  {
+
+        std::string s = spec;
+        if (s.compare(0, 7, "http://") == 0)
+            s.erase(0, 7);
+        if (!s.empty() && s[s.size() - 1] == '/')
+            s.erase(s.size() - 1);
+
+        std::size_t colon = s.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 >= s.size())
+            return false;
+        host = s.substr(0, colon);
+        port = s.substr(colon + 1);
+        if (host.find_first_of("/ ") != std::string::npos || port.size() > 5
+            || port.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        long    n = std::strtol(port.c_str(), NULL, 10);
+        return n >= 1 && n <= 65535;
+    }
+
+    bool    resolve(const std::string& spec, struct sockaddr_storage& addr, socklen_t& len, std::string& error)  {
+
+        std::string host;
+        std::string port;
+        if (!parseUpstream(spec, host, port)) {
+            error = "expected host:port";
+            return false;
+        }
+
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_NUMERICSERV;
+
+        struct addrinfo*    res = NULL;
+        int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+        if (rc != 0) {
+            error = gai_strerror(rc);
+            return false;
+        }
+        std::memcpy(&addr, res->ai_addr, res->ai_addrlen);    // first answer only: one address per upstream
+        len = res->ai_addrlen;
+        freeaddrinfo(res);
+        return true;
+    }
+
+    int     connectTcp(const struct sockaddr_storage& addr, socklen_t len, bool& inProgress)  {
+
+        inProgress = false;
+
+        int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+            close(fd);
+            return -1;
+        }
+        const int   on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));     // request heads are small: don't wait on Nagle
+
+        if (connect(fd, reinterpret_cast<const struct sockaddr*>(&addr), len) == 0)
+            return fd;
+        if (errno == EINPROGRESS) {
+            inProgress = true;      // writable once connected; a failure shows up as EV_ERROR/EV_HUP
+            return fd;
+        }
+        close(fd);
+        return -1;
+    }
+}
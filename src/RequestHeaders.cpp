@@ -0,0 +1,172 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RequestHeaders.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/RequestHeaders.hpp"
+
+RequestHeaders::RequestHeaders()
+    :   _raw(), _overflow(), _count(0), _knownMask(0), _map(), _mapBuilt(false)
+{}
+
+void    RequestHeaders::clear() {
+    _raw.clear();
+    _overflow.clear();
+    _count = 0;
+    _knownMask = 0;
+    _map.clear();
+    _mapBuilt = false;
+}
+
+std::string&    RequestHeaders::raw()   {
+    return _raw;
+}
+
+void    RequestHeaders::add(const Field& field) {
+    if (_count < INLINE_FIELDS)
+        _inline[_count] = field;
+    else
+        _overflow.push_back(field);
+    ++_count;
+    if (field.id != OTHER)
+        _knownMask |= 1u << field.id;
+    _mapBuilt = false;
+}
+
+// The value of the last field now runs up to valueEnd (the caller blanked the
+// CRLF of the folded line, so the slice stays one contiguous run of bytes).
+void    RequestHeaders::extendLast(std::size_t valueEnd) {
+    if (_count == 0)
+        return;
+    Field&  f = (_count <= INLINE_FIELDS) ? _inline[_count - 1] : _overflow.back();
+    if (f.valueLen == 0)
+        f.valueOff = static_cast<unsigned int>(valueEnd);
+    f.valueLen = static_cast<unsigned int>(valueEnd - f.valueOff);
+    _mapBuilt = false;
+}
+
+std::size_t RequestHeaders::count() const   {
+    return _count;
+}
+
+const RequestHeaders::Field&    RequestHeaders::field(std::size_t i) const  {
+    return (i < INLINE_FIELDS) ? _inline[i] : _overflow[i - INLINE_FIELDS];
+}
+
+const RequestHeaders::Field*    RequestHeaders::last() const    {
+    return _count ? &field(_count - 1) : NULL;
+}
+
+bool    RequestHeaders::has(Known id) const {
+    return id != OTHER && (_knownMask & (1u << id)) != 0;
+}
+
+std::size_t RequestHeaders::countOf(Known id) const {
+    if (!has(id))
+        return 0;
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < _count; ++i)
+        if (field(i).id == id)
+            ++n;
+    return n;
+}
+
+const char* RequestHeaders::valueData(const Field& f) const {
+    return _raw.data() + f.valueOff;
+}
+
+std::string RequestHeaders::name(const Field& f) const  {
+    return _raw.substr(f.nameOff, f.nameLen);
+}
+
+std::string RequestHeaders::value(const Field& f) const {
+    return _raw.substr(f.valueOff, f.valueLen);
+}
+
+std::string RequestHeaders::value(Known id) const   {
+    std::string out;
+    if (!has(id))
+        return out;
+    for (std::size_t i = 0; i < _count; ++i) {
+        const Field& f = field(i);
+        if (f.id != id)
+            continue;
+        if (!out.empty() && f.valueLen)
+            out += ", ";
+        out.append(_raw, f.valueOff, f.valueLen);
+    }
+    return out;
+}
+
+// Same shape as the old HTTP_Request::headers: duplicates joined with ", ".
+const std::map<std::string, std::string>&   RequestHeaders::asMap() const   {
+    if (_mapBuilt)
+        return _map;
+    _map.clear();
+    for (std::size_t i = 0; i < _count; ++i) {
+        const Field&    f = field(i);
+        std::string&    slot = _map[name(f)];
+        if (!slot.empty() && f.valueLen)
+            slot += ", ";
+        slot.append(_raw, f.valueOff, f.valueLen);
+    }
+    _mapBuilt = true;
+    return _map;
+}
+
+RequestHeaders::Known   RequestHeaders::classify(const char* s, std::size_t len)   {
+    switch (len) {
+        case 4:
+            if (std::memcmp(s, "host", 4) == 0)
+                return HOST;
+            break;
+        case 5:
+            if (std::memcmp(s, "range", 5) == 0)
+                return RANGE;
+            break;
+        case 6:
+            if (std::memcmp(s, "expect", 6) == 0)
+                return EXPECT;
+            break;
+        case 8:
+            if (std::memcmp(s, "if-range", 8) == 0)
+                return IF_RANGE;
+            break;
+        case 10:
+            if (std::memcmp(s, "connection", 10) == 0)
+                return CONNECTION;
+            break;
+        case 12:
+            if (std::memcmp(s, "content-type", 12) == 0)
+                return CONTENT_TYPE;
+            break;
+        case 13:
+            if (std::memcmp(s, "if-none-match", 13) == 0)
+                return IF_NONE_MATCH;
+            break;
+        case 14:
+            if (std::memcmp(s, "content-length", 14) == 0)
+                return CONTENT_LENGTH;
+            break;
+        case 15:
+            if (std::memcmp(s, "accept-encoding", 15) == 0)
+                return ACCEPT_ENCODING;
+            break;
+        case 17:
+            if (std::memcmp(s, "transfer-encoding", 17) == 0)
+                return TRANSFER_ENCODING;
+            if (std::memcmp(s, "if-modified-since", 17) == 0)
+                return IF_MODIFIED_SINCE;
+            break;
+        default:
+            break;
+    }
+    return OTHER;
+}
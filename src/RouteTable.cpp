@@ -0,0 +1,588 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RouteTable.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hugo-mar <hugo-mar@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by hugo-mar          #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by hugo-mar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*	---------------------------------------------------------------------------
+	Route table
+
+	Compiles each Server block once, when the configuration is loaded, into
+	one EffectiveConfig per location (directives merged with the server's,
+	methods split into masks, sizes and statuses parsed). Requests then only
+	pick the longest matching prefix; the App and the core share the result.
+	------------------------------------------------------------------------- */
+
+#include "RouteTable.hpp"
+#include "Structs.hpp"
+#include "Proxy.hpp"
+
+namespace {
+
+
+	/*
+	 Default limits for maximum request body size and CGI execution timeout (default configuration constants).
+	*/
+	const std::size_t	kDefaultClientMaxBodySize =	0;				// 0 means no limit / unlimited unless configured
+	const std::size_t	kDefaultCgiTimeout = 		30;				// 30 seconds
+	const std::size_t	kDefaultGzipMinLength =		20;				// NGINX defaults for gzip_min_length / gzip_comp_level
+	const int			kDefaultGzipCompLevel =		1;
+	const std::size_t	kDefaultFastcgiPoolSize =	8;				// backend connections per socket, per worker
+	const std::size_t	kDefaultFastcgiQueueSize =	64;				// requests waiting for a free connection
+	const std::size_t	kDefaultProxyKeepalive =	16;				// idle connections per upstream server, per worker
+	const std::size_t	kDefaultProxyTimeout =		60;				// NGINX's proxy_read_timeout
+
+	/*
+	 Splits a string into whitespace-separated words and returns them as a vector.
+	*/
+	std::vector<std::string> splitWords(const std::string& input) {
+
+		std::vector<std::string>	words;
+		std::istringstream			iss(input);
+		std::string					currentWord;
+
+		while (iss >> currentWord)
+			words.push_back(currentWord);
+
+		return words;
+	}
+
+	/*
+	 Comma-aware parsing (methods/index/cgi_allowed_methods):
+	  - Config currently joins multi-values with commas;
+	  - Splitting on comma or space prevents “GET,POST” from being treated as one token
+	    (fixes 405s and missing index files).
+	*/
+	std::vector<std::string> splitWordsAndCommas(const std::string& input) {
+		
+		std::vector<std::string> output;
+		std::string currentWord;
+	
+		for (std::size_t i = 0; i <= input.size(); ++i) {
+			char c = (i == input.size()) ? ' ' : input[i];
+			if (c == ',' || std::isspace(static_cast<unsigned char>(c))) {
+				if (!currentWord.empty()) {
+					output.push_back(currentWord);
+					currentWord.clear();
+				}
+			}
+			else
+				currentWord += c;
+		}
+		return output;
+	}
+
+	/*
+	 Validates and parses an HTTP status code string into an integer (100–599).
+	 Throws on non-digits, overflow, or invalid ranges.
+	*/
+	int parseHttpStatus(const std::string& str) {
+
+		if (str.empty())
+			throw std::runtime_error("Empty HTTP status code");
+
+		for (std::string::size_type i = 0; i < str.size(); ++i) {
+			if (!(std::isdigit(static_cast<unsigned char>(str[i]))))				// static_cast for protection against UB if signed (locale dependent)
+				throw std::runtime_error("Invalid HTTP status code: " + str);
+		}
+
+		errno = 0;
+		unsigned long value = std::strtoul(str.c_str(), NULL, 10);					// Parse into unsigned long first to detect overflow before casting to int.
+
+		if ((value == ULONG_MAX && errno == ERANGE))
+			throw std::runtime_error("HTTP status code overflow: " + str);
+
+		if (value < 100 || value > 599)
+			throw std::runtime_error("HTTP status code out of range: " + str);
+
+		return static_cast<int>(value);
+	}
+
+	/*
+	 Parses a numeric string into size_t, validating digits and overflow conditions.
+	*/
+	size_t parseSizeT(const std::string& str) {
+
+		if (str.empty())
+			throw std::runtime_error("Empty numeric value");
+
+		size_t value = 0;
+		const size_t max = std::numeric_limits<size_t>::max();
+
+		for (size_t i = 0; i < str.size(); ++i) {
+
+			if (!(std::isdigit(static_cast<unsigned char>(str[i]))))
+				throw std::runtime_error("Invalid numeric value: " + str);
+
+			size_t digit = str[i] - '0';
+
+			if (value > max / 10 || (value == max / 10 && digit > max % 10))					// Prevent overflow before multiplication
+				throw std::runtime_error("Numeric value exceeds size_t range: " + str);
+
+			value = value * 10 + digit;
+		}
+
+		return value;
+	}
+
+	/*
+	 Parses a numeric value with an optional binary suffix (k, M, G) and returns
+	 the corresponding size in bytes. Throws on invalid syntax or overflow.
+	*/
+	std::size_t parseSizeWithSuffix(const std::string& str) {
+
+		if (str.empty())
+			throw std::runtime_error("Empty numeric value");
+
+		std::istringstream iss(str);
+
+		unsigned long long value = 0;
+		if (!(iss >> value))
+			throw std::runtime_error("Invalid numeric value: " + str);
+
+		char suffix = 0;
+		if (iss >> suffix) {
+			char extra = 0;
+			if (iss >> extra)
+				throw std::runtime_error("Invalid size suffix in: " + str);
+		}
+
+		unsigned long long multiplier = 1;
+		switch (suffix) {
+			case 0:
+				multiplier = 1;
+				break;
+
+			case 'k':
+			case 'K':
+				multiplier = 1024ULL;
+				break;
+
+			case 'm':
+			case 'M':
+				multiplier = 1024ULL * 1024ULL;									// to avoid intermediate overflow (evaluation as int)
+				break;
+
+			case 'g':
+			case 'G':
+				multiplier = 1024ULL * 1024ULL * 1024ULL;
+				break;
+
+			default:
+				throw std::runtime_error("Invalid size suffix in: " + str);
+		}
+
+		if (multiplier != 0 && value > (std::numeric_limits<unsigned long long>::max)() / multiplier)	// Detect overflow before multiplication
+			throw std::runtime_error("Numeric value overflow: " + str);
+
+		unsigned long long result = value * multiplier;													// unsigned long long to prevent overflow before size_t cast
+		if (result > (std::numeric_limits<std::size_t>::max)())
+			throw std::runtime_error("Numeric value exceeds size_t range: " + str);
+
+		return static_cast<std::size_t>(result);
+	}
+
+	/*
+	 Looks up a directive by key, preferring Location over Server.
+	 Returns true and sets value if found; otherwise returns false.
+	*/
+	bool getDirectiveValue(const Location* loc, const Server& srv, const std::string& key, std::string& value) {
+		
+		std::map<std::string, std::string>::const_iterator	it;
+	
+		if (loc) {
+			it = loc->directives.find(key);
+			if (it != loc->directives.end()) {
+				value = it->second;
+				return true;
+			}
+		}
+
+		it = srv.directives.find(key);
+		if (it != srv.directives.end()) {
+			value = it->second;
+			return true;
+		}
+
+		return false;
+	}
+
+	/*
+	 Parses an on/off flag directive; anything else is a configuration error.
+	*/
+	bool parseOnOff(const std::string& key, const std::string& value) {
+
+		if (value == "on")
+			return true;
+		if (value == "off")
+			return false;
+		throw std::runtime_error(key + ": expected 'on' or 'off', got '" + value + "'");
+	}
+
+	/*
+	 Merges error_page configuration from Server and Location into EffectiveConfig.
+	 Server-level mappings are loaded first; Location error_page overrides or adds entries.
+	*/
+	void resolveErrorPages(EffectiveConfig& cfg, const Server& srv, const Location* loc) {
+
+		std::map<std::string, std::string>::const_iterator it;
+		
+		for (it = srv.error_pages.begin(); it != srv.error_pages.end(); ++it)
+			cfg.errorPages[parseHttpStatus(it->first)] = it->second;
+		
+		if (!loc)
+			return;
+
+		it = loc->directives.find("error_page");
+		if (it == loc->directives.end())
+			return;
+
+		std::vector<std::string> tokens = splitWords(it->second);
+		if (tokens.size() < 2)
+			throw std::runtime_error("Bad error_page configuration");
+
+		const std::string& uri = tokens.back();						// Follows NGINX-style syntax: multiple status codes followed by a single URI.
+																	// URI - Uniform Resource Identifier - identifies a resource (e.g. page, file, image, etc.)
+		for (std::size_t i = 0; i + 1 < tokens.size(); ++i)
+			cfg.errorPages[parseHttpStatus(tokens[i])] = uri;
+	}
+
+	/*
+	 Reads every error_page file once, when the configuration is loaded, so an
+	 error costs no disk I/O. Paths resolve like before: "/x" under root,
+	 anything else relative to the working directory. A page that cannot be
+	 read is left out and the default body is used.
+	*/
+	void loadErrorBodies(EffectiveConfig& cfg) {
+
+		for (std::map<int, std::string>::const_iterator it = cfg.errorPages.begin(); it != cfg.errorPages.end(); ++it) {
+
+			if (it->second.empty())
+				continue;
+			std::string path = it->second;
+			if (path[0] == '/')
+				path = (!cfg.root.empty() && cfg.root[cfg.root.size() - 1] == '/') ? cfg.root + path.substr(1) : cfg.root + path;
+
+			std::ifstream file(path.c_str(), std::ios::binary);
+			if (!file)
+				continue;
+			std::ostringstream oss;
+			oss << file.rdbuf();
+			if (!oss.str().empty())
+				cfg.errorBodies[it->first] = oss.str();
+		}
+	}
+
+	/*
+	 Port part of the server's first listen directive ("host:port" or "port"),
+	 "80" when the server has none.
+	*/
+	std::string firstListenPort(const Server& srv) {
+
+		if (srv.listen.empty())
+			return "80";
+
+		const std::string&	listenDirective = srv.listen[0];
+		size_t				listenColonPos = listenDirective.find(':');
+		return (listenColonPos != std::string::npos) ? listenDirective.substr(listenColonPos + 1) : listenDirective;
+	}
+
+	unsigned methodMask(const std::vector<std::string>& methods) {
+
+		unsigned mask = 0;
+		for (std::vector<std::string>::const_iterator it = methods.begin(); it != methods.end(); ++it)
+			mask |= methodBit(*it);
+		return mask;
+	}
+
+	/*
+	 Allow header value for 405 responses: "GET, POST".
+	*/
+	std::string joinMethods(const std::vector<std::string>& methods) {
+
+		std::string allowed;
+		for (std::vector<std::string>::const_iterator it = methods.begin(); it != methods.end(); ++it) {
+			if (!allowed.empty())						// Add comma only after the first method
+				allowed += ", ";
+			allowed += *it;
+		}
+		return allowed;
+	}
+
+	/*
+	 Longer prefixes first ("/a/b" before "/a"), so the first match wins.
+	*/
+	bool longerPrefixFirst(const EffectiveConfig& a, const EffectiveConfig& b) {
+		return a.locationPath.size() > b.locationPath.size();
+	}
+
+	/*
+	 Builds the EffectiveConfig by merging Server and Location directives.
+	 Applies defaults for methods, error pages, CGI options, and redirects.
+	*/
+	EffectiveConfig buildEffectiveConfig(const Server& srv, const Location* loc) {
+
+		EffectiveConfig	cfg;
+
+		cfg.hasLocation = (loc != NULL);
+		cfg.locationPath = loc ? loc->path : "";
+		cfg.listenPort = firstListenPort(srv);
+
+		std::string	value;
+
+		if (getDirectiveValue(loc, srv, "root", value))
+			cfg.root = value;
+
+		if (getDirectiveValue(loc, srv, "autoindex", value))
+			cfg.autoindex = (value == "on");
+
+		if (getDirectiveValue(loc, srv, "index", value))
+			cfg.indexFiles = splitWordsAndCommas(value);
+
+		if (getDirectiveValue(loc, srv, "methods", value))
+			cfg.allowedMethods = splitWordsAndCommas(value);
+		else {
+			cfg.allowedMethods.push_back("GET");						// Default to GET and POST so locations remain functional without explicit method configuration. 
+			cfg.allowedMethods.push_back("POST");
+		}
+		cfg.allowedMask = methodMask(cfg.allowedMethods);
+		cfg.allowHeader = joinMethods(cfg.allowedMethods);
+
+		resolveErrorPages(cfg, srv, loc);
+		loadErrorBodies(cfg);
+
+		if (getDirectiveValue(loc, srv, "client_max_body_size", value))
+			cfg.clientMaxBodySize = parseSizeWithSuffix(value);
+
+		if (getDirectiveValue(loc, srv, "upload_store", value))
+			cfg.uploadStore = value;
+
+		if (getDirectiveValue(loc, srv, "cgi_pass", value)) {
+			std::vector<std::string> tokens = splitWords(value);
+			if (tokens.size() < 2)
+				throw	std::runtime_error("cgi_pass requires 2 arguments: <ext> <bin>");
+			cfg.cgiPass[tokens[0]] = tokens[1];
+		}
+
+		if (getDirectiveValue(loc, srv, "fastcgi_pass", value)) {		// fastcgi_pass <ext> unix:<path>
+			std::vector<std::string> tokens = splitWords(value);
+			if (tokens.size() != 2)
+				throw	std::runtime_error("fastcgi_pass requires 2 arguments: <ext> unix:<path>");
+			std::string socketPath = tokens[1];
+			if (socketPath.compare(0, 5, "unix:") == 0)
+				socketPath = socketPath.substr(5);
+			struct sockaddr_un addr;
+			if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path))
+				throw	std::runtime_error("fastcgi_pass: invalid socket path '" + tokens[1] + "'");
+			cfg.fastcgiPass[tokens[0]] = socketPath;
+		}
+
+		if (getDirectiveValue(loc, srv, "fastcgi_pool_size", value)) {
+			cfg.fastcgiPoolSize = parseSizeT(value);
+			if (cfg.fastcgiPoolSize == 0)
+				throw	std::runtime_error("fastcgi_pool_size: must be at least 1");
+		}
+
+		if (getDirectiveValue(loc, srv, "fastcgi_queue_size", value))
+			cfg.fastcgiQueueSize = parseSizeT(value);
+
+		if (getDirectiveValue(loc, srv, "proxy_pass", value)) {			// proxy_pass host:port [host:port ...]
+			std::vector<std::string> tokens = splitWords(value);
+			for (std::size_t i = 0; i < tokens.size(); ++i) {
+				std::string host;
+				std::string port;
+				if (!proxy::parseUpstream(tokens[i], host, port))
+					throw	std::runtime_error("proxy_pass: invalid upstream '" + tokens[i] + "' (expected host:port)");
+				const std::string spec = host + ":" + port;
+				if (std::find(cfg.proxyPass.begin(), cfg.proxyPass.end(), spec) == cfg.proxyPass.end())
+					cfg.proxyPass.push_back(spec);
+			}
+		}
+
+		if (getDirectiveValue(loc, srv, "proxy_balance", value)) {
+			if (value != "round_robin" && value != "least_conn")
+				throw	std::runtime_error("proxy_balance: expected 'round_robin' or 'least_conn', got '" + value + "'");
+			cfg.proxyLeastConn = (value == "least_conn");
+		}
+
+		if (getDirectiveValue(loc, srv, "proxy_keepalive", value))
+			cfg.proxyKeepalive = parseSizeT(value);
+
+		if (getDirectiveValue(loc, srv, "proxy_timeout", value)) {
+			cfg.proxyTimeout = parseSizeT(value);
+			if (cfg.proxyTimeout == 0)
+				throw	std::runtime_error("proxy_timeout: must be at least 1");
+		}
+
+		if (getDirectiveValue(loc, srv, "cgi_streaming", value))
+			cfg.cgiStreaming = parseOnOff("cgi_streaming", value);
+
+		if (getDirectiveValue(loc, srv, "cgi_timeout", value))
+			cfg.cgiTimeout = parseSizeT(value);
+
+		if (getDirectiveValue(loc, srv, "cgi_allowed_methods", value))
+			cfg.cgiAllowedMethods = splitWordsAndCommas(value);
+		else
+			cfg.cgiAllowedMethods = cfg.allowedMethods;					// Default: CGI inherits location methods to ensure consistent behaviour
+		cfg.cgiAllowedMask = methodMask(cfg.cgiAllowedMethods.empty() ? cfg.allowedMethods : cfg.cgiAllowedMethods);
+
+		if (getDirectiveValue(loc, srv, "return", value)) {				// Handle HTTP 3xx redirects via 'return' directive
+			std::vector<std::string> tokens = splitWords(value);
+			if (tokens.size() == 2) {									// Ignores malformed configurations
+				int status = parseHttpStatus(tokens[0]);
+				if (status >= 300 && status <= 399) {
+					cfg.redirectStatus = status;
+					cfg.redirectTarget = tokens [1];
+				}
+			}
+		}
+
+		if (loc) {
+			std::map<std::string, std::string>::const_iterator it = loc->directives.find("stub_status");
+			cfg.stubStatus = (it != loc->directives.end() && it->second == "on");
+		}
+
+		if (getDirectiveValue(loc, srv, "gzip", value))
+			cfg.gzip = parseOnOff("gzip", value);
+
+		if (getDirectiveValue(loc, srv, "gzip_static", value))
+			cfg.gzipStatic = parseOnOff("gzip_static", value);
+
+		cfg.gzipTypes.push_back("text/html");							// Like NGINX: HTML is always compressed when gzip is on
+		if (getDirectiveValue(loc, srv, "gzip_types", value)) {
+			std::vector<std::string> types = splitWords(value);
+			cfg.gzipTypes.insert(cfg.gzipTypes.end(), types.begin(), types.end());
+		}
+
+		if (getDirectiveValue(loc, srv, "gzip_min_length", value))
+			cfg.gzipMinLength = parseSizeWithSuffix(value);
+
+		if (getDirectiveValue(loc, srv, "gzip_comp_level", value)) {
+			std::size_t level = parseSizeT(value);
+			if (level < 1 || level > 9)
+				throw std::runtime_error("gzip_comp_level: expected 1..9, got '" + value + "'");
+			cfg.gzipCompLevel = static_cast<int>(level);
+		}
+
+		return cfg;
+	}
+
+} // namespace
+
+unsigned methodBit(const std::string& method)
+{
+	if (method == "GET")
+		return METHOD_GET;
+	if (method == "POST")
+		return METHOD_POST;
+	if (method == "DELETE")
+		return METHOD_DELETE;
+	if (method == "HEAD")
+		return METHOD_HEAD;
+	return 0;
+}
+
+EffectiveConfig::EffectiveConfig()
+	: hasLocation(false)
+	, locationPath()
+	, listenPort("80")
+	, root(".")
+	, autoindex(false)
+	, indexFiles()
+	, allowedMethods()
+	, allowedMask(0)
+	, allowHeader()
+	, errorPages()
+	, errorBodies()
+	, clientMaxBodySize(kDefaultClientMaxBodySize)
+	, uploadStore()
+	, cgiPass()
+	, cgiTimeout(kDefaultCgiTimeout)
+	, cgiAllowedMethods()
+	, cgiAllowedMask(0)
+	, cgiStreaming(true)
+	, fastcgiPass()
+	, fastcgiPoolSize(kDefaultFastcgiPoolSize)
+	, fastcgiQueueSize(kDefaultFastcgiQueueSize)
+	, proxyPass()
+	, proxyLeastConn(false)
+	, proxyKeepalive(kDefaultProxyKeepalive)
+	, proxyTimeout(kDefaultProxyTimeout)
+	, redirectStatus(0)
+	, redirectTarget()
+	, stubStatus(false)
+	, gzip(false)
+	, gzipStatic(false)
+	, gzipTypes()
+	, gzipMinLength(kDefaultGzipMinLength)
+	, gzipCompLevel(kDefaultGzipCompLevel)
+	{}
+
+RouteTable::RouteTable()
+	: _routes()
+	, _fallback()
+	{}
+
+/*
+ Builds the table for one server. Invalid values (sizes, statuses, cgi_pass)
+ are configuration errors and surface here, at load time.
+*/
+void RouteTable::compile(const Server& srv)
+{
+	_routes.clear();
+	_fallback = buildEffectiveConfig(srv, NULL);
+
+	for (std::vector<Location>::const_iterator it = srv.locations.begin(); it != srv.locations.end(); ++it)
+		_routes.push_back(buildEffectiveConfig(srv, &(*it)));
+
+	std::stable_sort(_routes.begin(), _routes.end(), longerPrefixFirst);		// equal prefixes keep config order
+}
+
+/*
+ Longest-prefix match with a valid boundary ('/ap' cannot match '/api').
+ Returns the server-level fallback when no location matches.
+*/
+const EffectiveConfig& RouteTable::match(const std::string& requestPath) const
+{
+	for (std::vector<EffectiveConfig>::const_iterator it = _routes.begin(); it != _routes.end(); ++it) {
+
+		const std::string& locationPath = it->locationPath;
+		if (requestPath.size() < locationPath.size()
+			|| requestPath.compare(0, locationPath.size(), locationPath) != 0)
+			continue;
+		if (requestPath.size() == locationPath.size() || requestPath[locationPath.size()] == '/')
+			return *it;
+	}
+	return _fallback;
+}
+
+const EffectiveConfig& RouteTable::fallback() const
+{
+	return _fallback;
+}
+
+EffectiveConfig& RouteTable::fallback()
+{
+	return _fallback;
+}
+
+std::size_t RouteTable::size() const
+{
+	return _routes.size();
+}
+
+const EffectiveConfig& RouteTable::at(std::size_t i) const
+{
+	return _routes[i];
+}
+
+EffectiveConfig& RouteTable::at(std::size_t i)
+{
+	return _routes[i];
+}
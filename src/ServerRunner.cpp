@@ -14,11 +14,26 @@
 #include "../include/HttpHeader.hpp"
 #include "../include/HttpSerializer.hpp"
 #include "../include/HttpBody.hpp"
+#include "../include/SpillFile.hpp"
+#include "../include/ByteScan.hpp"
 #include "../include/App.hpp"
-
-ServerRunner::ServerRunner(const std::vector<Server>& servers)
-    :   _servers(servers), _nowMs(0)
-{}
+#include "../include/Log.hpp"
+
+#if defined(__linux__)
+# include <sys/sendfile.h>
+#else
+# include <sys/mman.h>
+#endif
+
+ServerRunner::ServerRunner(const std::vector<Server>& servers, bool reusePort, const GlobalSettings& globals)
+    :   _servers(servers), _nowMs(0), _wallSec(0), _reusePort(reusePort), _stopping(false), _stopDeadlineMs(0),
+        _limits(globals.admission), _listenersPaused(false), _lastSweepMs(0), _accessLogSettings(globals.accessLog)
+{
+    _sigchldPipe[0] = -1;
+    _sigchldPipe[1] = -1;
+    _metrics.registerLocations(_servers);
+    _limiter.configure(_limits);
+}
 
 //**************************************************************************************************
 
@@ -28,92 +43,352 @@ static void	printSocketError(const char* msg)	{
 	std::cerr << msg << ": " << std::strerror(errno) << std::endl;
 }
 
+// Bytes still owed to the client: earlier pipelined responses, head, in-memory
+// body, and any file-backed body.
+static bool	hasPendingWrite(const Connection& connection)	{
+	return connection.pipelinedOffset < connection.pipelined.size()
+		|| connection.writeOffset < connection.writeBuffer.size() + connection.writeBody.size()
+		|| connection.bodyRemaining > 0;
+}
+
+// Drop the file-backed body of the current response (sent, HEAD, or connection gone).
+static void	releaseFileBody(Connection& connection)	{
+	if (connection.bodyFd >= 0)
+		close(connection.bodyFd);
+	connection.bodyFd = -1;
+	connection.bodyOffset = 0;
+	connection.bodyRemaining = 0;
+}
+
+// Close and remove the upload spill file of the current request (if any).
+static void	discardBodySpill(HTTP_Request& request)	{
+	if (request.body_file_fd >= 0)
+		close(request.body_file_fd);
+	if (!request.body_file_path.empty())
+		unlink(request.body_file_path.c_str());
+	request.body_file_fd = -1;
+	request.body_file_path.clear();
+	request.multipart.discard();		// file parts not published by the App
+}
+
+// Interest of a busy proxy_pass connection: write while request bytes are
+// owed, read unless the client is behind (CGI streaming backpressure).
+static int	proxyInterest(const ProxyBackend& backend, const CgiProcess& cgi)	{
+	return (backend.outOffset < backend.out.size() ? EV_WRITE : EV_NONE) | (cgi.outputPaused ? EV_NONE : EV_READ);
+}
+
+// Status code of a serialized response head ("HTTP/1.1 200 OK"), 0 if it isn't one.
+static int	responseStatusOf(const std::string& head)	{
+	if (head.size() < 12 || head.compare(0, 5, "HTTP/") != 0)
+		return 0;
+	return std::atoi(head.c_str() + 9);
+}
+
+// Per-request state back to a fresh S_HEADERS; buffered input is kept.
+static void	resetForNextRequest(Connection& connection)	{
+	connection.requestStartUs = 0;
+	connection.upstreamUs = 0;
+	connection.logStatus = 0;
+	connection.logBytes = 0;
+	connection.writeBuffer.clear();
+	connection.writeOffset = 0;
+	connection.headersComplete = false;
+	connection.sentContinue = false;
+	discardBodySpill(connection.request);
+	connection.request.reset();
+	connection.route = NULL;
+	if (connection.vhosts)
+		connection.srv = connection.vhosts->defaultServer();	// the next head picks its own server
+	connection.state = S_HEADERS;
+}
+
+// Push up to `len` bytes of the file at `offset` straight to the socket.
+// Linux: sendfile() (kernel copies page cache -> socket, nothing lands in userspace).
+// Elsewhere: mmap() a window of the file and write() it, still without a heap copy.
+// Returns bytes sent (offset advanced), 0 if the file ended early, -1 if the socket is full.
+static ssize_t	sendFileChunk(int sockFd, int fileFd, off_t& offset, std::size_t len)	{
+#if defined(__linux__)
+	return sendfile(sockFd, fileFd, &offset, len);
+#else
+	static const off_t	pageSize = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+
+	off_t		aligned = offset - (offset % pageSize);		// mmap offsets must be page aligned
+	std::size_t	delta = static_cast<std::size_t>(offset - aligned);
+	void*		map = mmap(NULL, delta + len, PROT_READ, MAP_PRIVATE, fileFd, aligned);
+	if (map == MAP_FAILED)
+		return 0;
+
+	ssize_t	n = write(sockFd, static_cast<char*>(map) + delta, len);
+	munmap(map, delta + len);
+	if (n > 0)
+		offset += n;
+	return n;
+#endif
+}
+
 
 //**************************************************************************************************
 
-void    ServerRunner::housekeeping() {
+// Deadline of the connection's current phase (nginx-style per-server timeouts),
+// -1 when nothing can expire (CGI without cgi_timeout).
+long    ServerRunner::connectionDeadline(const Connection& connection, CloseReason& reason) const {
 
-    const long NOW = _nowMs;
-
-    const long HEADER_TIMEOUT_MS    = 15000;
-    const long BODY_TIMEOUT_MS      = 30000;
-    const long KA_IDLE_MS           = 5000;
-    const long WRITE_TIMEOUT_MS     = 30000;
-
-    for (std::map<int, Connection>::iterator it = _connections.begin();
-         it != _connections.end(); )
-    {
-        int fd = it->first;
-        Connection& connection = it->second;
-        bool closeIt = false;
-
-        switch (connection.state) {
-            case S_HEADERS: {
-                const bool headerTimeOut = (NOW - connection.lastActiveMs > HEADER_TIMEOUT_MS);
-                const bool kaIdleTooLong = (connection.kaIdleStartMs != 0)
-                                        && (NOW - connection.kaIdleStartMs > KA_IDLE_MS);
-                if (headerTimeOut || kaIdleTooLong)
-                    closeIt = true;
-                break;
-            }
-            case S_BODY:
-            case S_DRAIN: { // <-- NOVO: drenar também tem timeout de BODY
-                if (NOW - connection.lastActiveMs > BODY_TIMEOUT_MS)
-                    closeIt = true;
-                break;
-            }
-            case S_WRITE: {
-                if (NOW - connection.lastActiveMs > WRITE_TIMEOUT_MS)
-                    closeIt = true;
-                break;
+    const ServerTimeouts& t = (connection.srv ? *connection.srv : _servers[0]).timeouts;
+
+    switch (connection.state) {
+        case S_HEADERS: {
+            reason = CLOSE_HEADER_TIMEOUT;
+            long deadline = connection.lastActiveMs + t.headerMs;
+            if (connection.kaIdleStartMs != 0 && connection.kaIdleStartMs + t.keepAliveMs < deadline) {
+                reason = CLOSE_KA_IDLE;
+                deadline = connection.kaIdleStartMs + t.keepAliveMs;
             }
-            case S_CLOSED: {
-                closeIt = true;
-                break;
+            return deadline;
+        }
+        case S_BODY:
+        case S_DRAIN:   // <-- NOVO: drenar também tem timeout de BODY
+            reason = CLOSE_BODY_TIMEOUT;
+            return connection.lastActiveMs + t.bodyMs;
+        case S_CGI:
+            // cgi_timeout is an inactivity timeout: any pipe I/O re-arms it.
+            reason = CLOSE_DONE;
+            if (connection.cgi.timeoutMs > 0)
+                return connection.cgi.lastIoMs + connection.cgi.timeoutMs;
+            return -1;
+        case S_WRITE:
+            reason = CLOSE_WRITE_TIMEOUT;
+            if (connection.cgi.streaming && !connection.cgi.streamFinished && !hasPendingWrite(connection)) {
+                // streamed CGI with everything sent: waiting on the script, not the client
+                reason = CLOSE_ERROR;
+                if (connection.cgi.timeoutMs > 0)
+                    return connection.cgi.lastIoMs + connection.cgi.timeoutMs;
+                return -1;
             }
-            default:
-                break;
+            return connection.lastActiveMs + t.sendMs;
+        case S_CLOSED:
+        default:
+            reason = CLOSE_DONE;
+            return _nowMs;
+    }
+}
+
+// Connection timeouts live in a min-heap keyed by deadline, so a tick only
+// touches the connections that are actually due. Entries are re-armed lazily:
+// activity just moves lastActiveMs, and a popped entry whose connection is not
+// really expired goes back in with the recomputed deadline. armTimer() only
+// pushes when the deadline moves earlier (new connection, shorter timeout).
+struct TimerOrder {
+	template <typename Entry>
+	bool	operator()(const Entry& a, const Entry& b) const	{
+		return a.deadlineMs > b.deadlineMs;		// std heap is a max-heap: invert for earliest-first
+	}
+};
+
+void    ServerRunner::armTimer(Connection& connection) {
+
+    CloseReason reason;
+    long deadline = connectionDeadline(connection, reason);
+    if (deadline < 0)
+        return;
+    if (connection.timerDeadlineMs != 0 && connection.timerDeadlineMs <= deadline)
+        return;     // an entry at or before this deadline is already queued
+
+    TimerEntry entry;
+    entry.deadlineMs = deadline;
+    entry.fd = connection.fd;
+    _timers.push_back(entry);
+    std::push_heap(_timers.begin(), _timers.end(), TimerOrder());
+    connection.timerDeadlineMs = deadline;
+}
+
+// How long the event loop may sleep: until the earliest deadline, forever when
+// idle (signals and CGI exits come in through the self-pipe).
+int     ServerRunner::nextWaitMs() const {
+
+    const int SHUTDOWN_TICK_MS  = 250;      // draining: re-check idle sockets / grace period
+    const int FALLBACK_TICK_MS  = 1000;     // no self-pipe: poll for CGI exits and signals
+
+    int limit = -1;
+    if (_stopping)
+        limit = SHUTDOWN_TICK_MS;
+    else if (_sigchldPipe[0] < 0)
+        limit = FALLBACK_TICK_MS;
+
+    // Buffered access log lines leave within flushMs even when nothing happens.
+    const long flushWait = _accessLog.nextFlushMs(_nowMs);
+    if (flushWait >= 0 && (limit < 0 || flushWait < limit))
+        limit = static_cast<int>(flushWait);
+
+    if (_timers.empty())
+        return limit;
+
+    long wait = _timers.front().deadlineMs - _nowMs;
+    if (wait < 0)
+        wait = 0;
+    if (limit >= 0 && wait > limit)
+        wait = limit;
+    if (wait > INT_MAX)
+        wait = INT_MAX;
+    return static_cast<int>(wait);
+}
+
+void    ServerRunner::housekeeping() {
+
+    // Fallback for a lost SIGCHLD wake-up: reaping with WNOHANG is cheap.
+    reapCgiChildren();
+
+    if (_accessLog.flushDue(_nowMs))
+        _accessLog.flush(_nowMs);
+
+    // Forget the clients that hold nothing any more (once a second is plenty).
+    if (_nowMs - _lastSweepMs >= 1000) {
+        _limiter.sweep(_nowMs);
+        _lastSweepMs = _nowMs;
+    }
+
+    // Draining for shutdown: idle keep-alive sockets have nothing left to finish.
+    if (_stopping) {
+        std::vector<int> idle;
+        for (std::size_t i = 0; i < _connections.size(); ++i)
+            if (_connections.at(i).state == S_HEADERS && _connections.at(i).readBuffer.empty())
+                idle.push_back(_connections.at(i).fd);
+        for (std::size_t i = 0; i < idle.size(); ++i)
+            closeConnection(idle[i], CLOSE_SHUTDOWN);
+    }
+
+    while (!_timers.empty() && _timers.front().deadlineMs <= _nowMs) {
+
+        std::pop_heap(_timers.begin(), _timers.end(), TimerOrder());
+        TimerEntry entry = _timers.back();
+        _timers.pop_back();
+
+        Connection* found = _connections.find(entry.fd);
+        if (!found || found->timerDeadlineMs != entry.deadlineMs)
+            continue;   // stale: connection gone, or a newer entry is queued
+
+        Connection& connection = *found;
+        connection.timerDeadlineMs = 0;
+
+        CloseReason reason;
+        long deadline = connectionDeadline(connection, reason);
+        if (deadline < 0)
+            continue;
+        if (deadline > _nowMs) {
+            armTimer(connection);   // activity since it was armed: not due yet
+            continue;
         }
 
-        ++it;
-        if (closeIt)
-            closeConnection(fd);
+        if (connection.state == S_CGI) {
+            abortCgi(connection);
+            connection.cgi.timedOut = true;
+            if (connection.cgi.proxyPeer.empty())
+                ++_metrics.cgiTimedOut;
+            finishCgiIfDone(connection);    // -> 504
+            continue;
+        }
+        if (connection.cgi.streaming && reason == CLOSE_ERROR)
+            ++_metrics.cgiTimedOut;         // head already sent: all that's left is to cut it short
+        closeConnection(entry.fd, reason);
     }
 }
 
 
 
-void ServerRunner::run() {
+static volatile sig_atomic_t	g_stopRequested = 0;
+static int						g_sigchldWriteFd = -1;	// self-pipe, also wakes the loop for stop signals
 
-    setupListeners(_servers, _listeners);
-    setupPollFds();
+static void	onStopSignal(int)	{
+	g_stopRequested = 1;
+	if (g_sigchldWriteFd >= 0)	{
+		char	c = 1;
+		ssize_t	n = write(g_sigchldWriteFd, &c, 1);		// the loop may be sleeping until the next deadline
+		(void)n;
+	}
+}
+
+void    ServerRunner::installStopHandlers() {
+    signal(SIGTERM, onStopSignal);
+    signal(SIGINT, onStopSignal);
+}
+
+// Stop accepting, let in-flight requests finish (answered with Connection: close).
+// housekeeping() closes connections as they go idle; run() returns once all are
+// gone or the grace period ran out.
+void    ServerRunner::beginShutdown() {
+
+    const long SHUTDOWN_GRACE_MS = 10000;
+
+    _stopping = true;
+    _stopDeadlineMs = _nowMs + SHUTDOWN_GRACE_MS;
+
+    std::vector<int> listeners;
+    for (std::map<int, const Listener*>::const_iterator it = _listenerByFd.begin(); it != _listenerByFd.end(); ++it)
+        listeners.push_back(it->first);
+    for (std::size_t i = 0; i < listeners.size(); ++i)
+        closeConnection(listeners[i]);
+}
+
+bool ServerRunner::run() {
+
+    setupListeners(_servers, _listeners, _reusePort);
+
+    if (!_loop.open()) {
+        printSocketError("event loop");
+        return false;
+    }
+    registerListeners();
 
-    if (_fds.empty()) {
+    if (_listenerByFd.empty()) {
         std::cerr << "No listeners configured/opened. \n";
-        return;
+        return false;
     }
+    std::cout << "Event backend: " << _loop.backendName() << "\n"
+              << "Byte scan: " << bytescan::kernelName() << "\n";        // "make SIMD=off" shows here
 
-    const int POLL_TICK_MS = 250;
+    openSigchldPipe();
+    resolveProxyUpstreams();
 
-    const std::time_t   start = std::time(NULL);
+    if (!_accessLog.open(_accessLogSettings))
+        std::cerr << "Warning: access_log \"" << _accessLogSettings.path << "\": " << std::strerror(errno) << "\n";
+
+    // One clock read per iteration: _nowMs is monotonic milliseconds since start
+    // (wall-clock jumps can't fire or stall timeouts), the Date header is
+    // re-formatted only when the wall-clock second changes.
+    const long long     startMs = now_mono_ms();
+    _wallSec = std::time(NULL);
+    http::refresh_date(_wallSec);
 
     while (true) {
-        int n = poll(&_fds[0], static_cast<nfds_t>(_fds.size()), POLL_TICK_MS);
+        if (g_stopRequested && !_stopping)
+            beginShutdown();
+        if (_stopping && (_connections.empty() || _nowMs > _stopDeadlineMs))
+            break;
+
+        // Sleep until the earliest connection deadline; housekeeping() runs on every wake-up.
+        int n = _loop.wait(nextWaitMs(), _ready);
 
         if (n < 0) {
             if (errno == EINTR)
                 continue;
-            printSocketError("poll");
+            printSocketError("event wait");
             break;
         }
 
-        _nowMs = static_cast<long>((std::time(NULL) - start) * 1000);
+        _nowMs = static_cast<long>(now_mono_ms() - startMs);
+        _wallSec = std::time(NULL);
+        http::refresh_date(_wallSec);
 
         if (n > 0)
             handleEvents();
 
         housekeeping();
     }
+
+    // Whatever is still open after the grace period is cut (CGI children killed).
+    while (!_connections.empty())
+        closeConnection(_connections.at(0).fd, CLOSE_SHUTDOWN);
+    _accessLog.flush(_nowMs);
+    return true;
 }
 
 
@@ -180,13 +455,21 @@ static std::string	normalizeListenKey(const std::string& spec)	{
 	return oss.str();
 }
 
+// True when any option besides default_server differs from the defaults.
+static bool	setsSocketOptions(const ListenOptions& o)	{
+	const ListenOptions	d;
+	return o.backlog != d.backlog || o.deferAccept != d.deferAccept || o.fastOpen != d.fastOpen
+		|| o.noDelay != d.noDelay || o.sndBuf != d.sndBuf || o.rcvBuf != d.rcvBuf;
+}
+
 // Setting up Listeners functions
-void	setupListeners(const std::vector<Server>& servers, std::vector<Listener>& outListeners)	{
+void	setupListeners(const std::vector<Server>& servers, std::vector<Listener>& outListeners, bool reusePort)	{
 
 	outListeners.clear();
 
-	std::map<std::string, int> specToFd;
+	std::map<std::string, std::size_t> specToListener;
 	// To prevent opening the same IP:port more than once because Servers can share the same IP:ports.
+	// The servers sharing one are told apart by Host (Listener::vhosts).
 	
 	for (std::size_t s = 0; s < servers.size(); ++s)	{ // server blocks
 		const Server&	srv = servers[s];
@@ -194,35 +477,81 @@ void	setupListeners(const std::vector<Server>& servers, std::vector<Listener>& o
 		for (std::size_t i = 0; i < srv.listen.size(); ++i)	{ // each server's listen entries (server can listen on multiple specifications).
 			const std::string&	spec = srv.listen[i];
 			const std::string	key = normalizeListenKey(spec);
+			std::map<std::string, ListenOptions>::const_iterator	oit = srv.listen_options.find(spec);
+			const bool			hasOptions = (oit != srv.listen_options.end());
+			const ListenOptions	options = hasOptions ? oit->second : ListenOptions();
 			
-            std::map<std::string, int>::iterator it = specToFd.find(key);
-			if (it != specToFd.end())	{
-				// Duplicate listen in another server{} — reuse the same socket, do NOT add another Listener row
-				std::cerr << " Note: Duplicate listen \"" << spec << "\" in server #" << s << " - reusing " << key << std::endl;
+            std::map<std::string, std::size_t>::iterator it = specToListener.find(key);
+			if (it != specToListener.end())	{
+				// Listen shared with another server{} — reuse the same socket, do NOT add another Listener row
+				outListeners[it->second].vhosts.add(&srv, options.defaultServer);
+				if (hasOptions && setsSocketOptions(options))	// the socket is already set up
+					std::cerr << "Note: listen options of \"" << spec << "\" ignored, the socket is opened by an earlier server\n";
 				continue;
 			}
 
-			int	fd = openAndListen(spec); // use the original spec for getaddrinfo
+			int	fd = openAndListen(spec, reusePort, options); // use the original spec for getaddrinfo
             if (fd < 0) {
 				std::cerr << "Warning: Failed to open listen \"" << spec << "\"\n";
 				continue;
 			}
 
-			specToFd[key] = fd;
+			specToListener[key] = outListeners.size();
 
 			//	_listeners array populated
 			Listener	L;
 			L.fd = fd;
 			L.config = &srv;
+			L.spec = key;
+			L.options = options;
+			L.vhosts.add(&srv, options.defaultServer);
 			outListeners.push_back(L);	// Adds to _listeners array
             std::cout	<< "Listening on " << srv.listen[i] << "\n";
 		}
 
 	}
 
+	for (std::size_t l = 0; l < outListeners.size(); ++l)
+		outListeners[l].vhosts.build();
+
+}
+
+// TCP/socket options of a "listen" address. Set on the listening socket: the
+// accepted ones inherit TCP_NODELAY and the buffer sizes, so accepting a client
+// costs no extra setsockopt(). Failures are reported, the listener still opens.
+static void	applyListenOptions(int fd, const ListenOptions& options)	{
+
+	const int	enable = 1;
+	if (options.noDelay && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) < 0)
+		printSocketError("setsockopt TCP_NODELAY");	// small responses no longer wait for the peer's delayed ACK
+	if (options.sndBuf > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &options.sndBuf, sizeof(options.sndBuf)) < 0)
+		printSocketError("setsockopt SO_SNDBUF");
+	if (options.rcvBuf > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &options.rcvBuf, sizeof(options.rcvBuf)) < 0)
+		printSocketError("setsockopt SO_RCVBUF");
+
+	if (options.deferAccept > 0)	{
+#if defined(TCP_DEFER_ACCEPT)
+		// Linux: the listener only turns readable once the client sent data (or
+		// after deferAccept seconds), so idle handshakes never reach accept().
+		if (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &options.deferAccept, sizeof(options.deferAccept)) < 0)
+			printSocketError("setsockopt TCP_DEFER_ACCEPT");
+#else
+		std::cerr << "Note: listen \"deferred\" is not supported on this platform\n";
+#endif
+	}
+
+	if (options.fastOpen > 0)	{
+#if defined(TCP_FASTOPEN)
+		// Data in the SYN of returning clients: the request arrives with the handshake.
+		if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &options.fastOpen, sizeof(options.fastOpen)) < 0)
+			printSocketError("setsockopt TCP_FASTOPEN");
+#else
+		std::cerr << "Note: listen \"fastopen\" is not supported on this platform\n";
+#endif
+	}
 }
 
-int openAndListen(const std::string& spec)  {
+int openAndListen(const std::string& spec, bool reusePort, const ListenOptions& options)  {
 
 	std::size_t		colon = spec.find(':');	// spec.find() returns the index position
 	std::string		host;
@@ -281,14 +610,25 @@ int openAndListen(const std::string& spec)  {
 		// For this socket fd, go to the socket menu (SOL_SOCKET) and turn on (1) the REUSEADDR setting (SO_REUSEADDR).
 		// SO_REUSEADDR, allows immediate re-binding, but without it, binding might fail due to the old connection still being in TIME_WAIT. Is a safety method.
 
+#ifdef SO_REUSEPORT
+		// Worker mode: every worker binds its own socket to the same IP:port and
+		// the kernel spreads incoming connections across them (no shared accept queue).
+		if (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+			printSocketError("setsockopt SO_REUSEPORT");
+#else
+		(void)reusePort;
+#endif
+
 		if (!makeNonBlocking(fd))	{
 			close(fd);
 			continue;
 		}
 
+		applyListenOptions(fd, options);
+
 		if (bind(fd, p->ai_addr, p->ai_addrlen) == 0)	{ // plugging the phone into a specific wall jack: a local (IP, port)
 			// attaches the socket (the fd) to a local endpoint = (local IP:port)
-			if (listen(fd, SOMAXCONN) == 0)	{ // making the phone ready to accept calls; keeping a waiting line, backlog is SOMAXCONN which is the maximum number of connections.
+			if (listen(fd, options.backlog) == 0)	{ // making the phone ready to accept calls; keeping a waiting line of "backlog" connections (SOMAXCONN unless configured; the kernel caps it at net.core.somaxconn).
 				sockfd = fd; // listen makes the fd into a listening TCP socket and associates SYN queue and Accept queue
 				break;
 			}
@@ -334,115 +674,216 @@ bool	makeNonBlocking(int fd)	{
 
 //**************************************************************************************************
 
-// Register one pollfd per unique listening socket (startup only).
-// NOTE: _fds.clear() assumes there are no client pollfds yet.
-// Can never call this after clients have been added to _fds.
-void    ServerRunner::setupPollFds()    { // only for listening sockets. setupPollFds() = listeners only (startup). Clients get added as they connect.
-
-    _fds.clear();                        // to have a clean list on multiple calls
-	_fdIndex.clear();
-    _fds.reserve(_listeners.size());	// save memory before populating _fds
-
-	std::set<int> added;
-	// We can have multiple Listener records pointing to the same underlying fd
-	// (e.g., two server {} blocks both listening on 127.0.0.1:8080).
-	// make sure only deduplicates happen. Deduplicate => having no duplicates of the same fd.
-	// Deduplicate by FD: many _listeners can share the same fd which was populated by setupListeners().
-	// (virtual hosts on the same ip:port), but poll() needs exactly ONE pollfd per unique fd.
+// Register every unique listening socket with the event loop (startup only).
+// We can have multiple Listener records pointing to the same underlying fd
+// (e.g., two server {} blocks both listening on 127.0.0.1:8080): the first one wins,
+// exactly like setupListeners() already decided when it reused the socket.
+// Clients get added as they connect (acceptNewClient).
+void    ServerRunner::registerListeners()    {
+
+    _listenerByFd.clear();
+
     for (std::size_t i = 0; i < _listeners.size(); i++)  {
         int fd = _listeners[i].fd;
-		if (!added.insert(fd).second)	// .second = true if the element was successfully inserted, false when it cannot be inserted
-			continue;
+        if (_listenerByFd.count(fd))
+            continue;
 
-		struct pollfd   p; // tells the kernel which fd and what events we want
-        p.fd = _listeners[i].fd;
-        p.events = POLLIN; // "What to expect"
-        p.revents = 0; // the poll() is the function that fills in the revents to tell what exactly happened.
-        _fds.push_back(p);
-		_fdIndex[p.fd] = _fds.size() - 1;	// - 1 because we should check the index number
+        if (!_loop.add(fd, EV_READ)) {  // "kernel, wake me when this listener is readable (i.e., there's a connection to accept)."
+            printSocketError("event loop add listener");
+            continue;
+        }
+        _listenerByFd[fd] = &_listeners[i];
+    }
+}
 
+void    ServerRunner::setInterest(int fd, int events) {
+    _loop.modify(fd, events);
+}
 
-	}
-	// this process is important after opening the listening socket because this is the part where we are telling the poll()
-	//		what to do and what to expect. setupPollFds() builds _fds with one pollfd per unique listening fd and sets events = POLLIN
-	//		“kernel, wake me when this listener is readable (i.e., there’s a connection to accept).”
-	// Without setupPollFds() => poll() would have nothing (or the wrong things) to watch and the loop would never wake for new connections => accept() would never run.
+// One access log line per answered request, once its response is out (or the
+// connection ended first); requestStartUs marks it as not logged yet.
+void    ServerRunner::logAccess(Connection& connection) {
+    if (connection.requestStartUs == 0)
+        return;
+    _accessLog.record(connection, Metrics::nowUs(), _wallSec, _nowMs);
+    connection.requestStartUs = 0;
+}
+
+// worker_connections reached: stop watching the listeners, new clients wait
+// in the kernel's accept queue (or go to another worker) instead of slowing
+// down the admitted ones. closeConnection() resumes below the cap.
+void    ServerRunner::pauseListeners(bool pause) {
+    if (pause == _listenersPaused)
+        return;
+    _listenersPaused = pause;
+    if (pause)
+        ++_metrics.listenerPauses;
+    for (std::map<int, const Listener*>::const_iterator it = _listenerByFd.begin(); it != _listenerByFd.end(); ++it)
+        _loop.modify(it->first, pause ? EV_NONE : EV_READ);
+}
+
+// limit_conn_per_ip reached: answer the prebuilt 503 right away and close,
+// the client never gets a Connection slot. What already arrived of the request
+// is read first (deferred accept), closing on unread data would reset the
+// connection before the 503 is read.
+void    ServerRunner::shedConnection(int clientFd, const Listener& listener) {
+    char sink[4096];
+    ssize_t n = recv(clientFd, sink, sizeof(sink), 0);
+    (void)n;
+    const Server& active = listener.vhosts.defaultServer() ? *listener.vhosts.defaultServer() : _servers[0];
+    const std::string res = http::build_error_response(active, 503, "Service Unavailable", false);
+    n = send(clientFd, res.data(), res.size(), 0);  // an empty socket buffer always takes it
+    (void)n;
+    close(clientFd);
+    ++_metrics.shedConnections;
+}
+
+// limit_req_per_ip: the client's bucket is empty, the request gets a 503 with
+// Retry-After instead of reaching the App. Like the 413 path, a request body
+// is drained and the connection closed; without one it stays alive.
+bool    ServerRunner::shedRequest(Connection& connection) {
+    if (_limiter.admitRequest(connection.clientKey, _nowMs))
+        return false;
+
+    ++_metrics.shedRequests;
+    const Server& active = connection.srv ? *connection.srv : _servers[0];
+    if (connection.request.body_reader_state != BR_NONE) {
+        connection.request.keep_alive = false;
+        connection.request.expectContinue = false;
+        connection.sentContinue = false;
+        connection.draining = true;
+        connection.drainedBytes = 0;
+    }
+    connection.writeBuffer = http::build_error_response(active, 503, "Service Unavailable", connection.request.keep_alive);
+    connection.writeOffset = 0;
+    connection.state = S_WRITE;
+    setInterest(connection.fd, EV_WRITE);
+    return true;
 }
 
 //**************************************************************************************************
 
 void ServerRunner::handleEvents() {
 
-    for (std::size_t i = _fds.size(); i-- > 0; ) {
+    // Only the fds the kernel reported as ready are visited.
+    for (std::size_t i = 0; i < _ready.size(); ++i) {
 
-        int   fd = _fds[i].fd;
-        short re = _fds[i].revents;
+        int fd = _ready[i].fd;
+        int re = _ready[i].events;
 
-        if (re == 0)
+        if (re == EV_NONE)
             continue;
 
-        // Detecta se é listener
-        bool isListener = false;
-        const Server* srv = NULL;
-        for (size_t j = 0; j < _listeners.size(); ++j) {
-            if (_listeners[j].fd == fd) {
-                isListener = true;
-                srv = _listeners[j].config;
-                break;
-            }
+        // SIGCHLD self-pipe: a CGI child exited, reap it without blocking.
+        if (fd == _sigchldPipe[0]) {
+            char    sink[64];
+            while (read(fd, sink, sizeof(sink)) > 0)
+                ;
+            reapCgiChildren();
+            continue;
+        }
+
+        // CGI pipes are owned by a client connection that is waiting in S_CGI.
+        if (_cgiPipeOwner.count(fd)) {
+            handleCgiEvent(fd, re);
+            continue;
+        }
+
+        // FastCGI backend sockets: busy for a client in S_CGI, or idle in their pool.
+        if (_fcgiBackends.count(fd)) {
+            handleFastCgiEvent(fd, re);
+            continue;
+        }
+
+        // proxy_pass upstream sockets: same life cycle as the FastCGI ones.
+        if (_proxyBackends.count(fd)) {
+            handleProxyEvent(fd, re);
+            continue;
         }
 
+        std::map<int, const Listener*>::const_iterator lit = _listenerByFd.find(fd);
+        bool isListener = (lit != _listenerByFd.end());
+
         // Erros "hard" -> fechar sempre
-        if (re & (POLLERR | POLLNVAL)) {
-            closeConnection(fd);
+        if (re & EV_ERROR) {
+            closeConnection(fd, CLOSE_ERROR);
             continue;
         }
 
-        // Listener: POLLHUP é fatal (não faz sentido manter)
+        // Listener: HUP é fatal (não faz sentido manter)
         if (isListener) {
-            if (re & POLLHUP) {
+            if (re & EV_HUP) {
                 closeConnection(fd);
                 continue;
             }
-            if (re & POLLIN)
-                acceptNewClient(fd, srv);
+            if (re & EV_READ)
+                acceptNewClient(fd, *lit->second);
             continue;
         }
 
-        // Cliente: POLLHUP NÃO é motivo para fechar imediatamente.
+        // Cliente: HUP NÃO é motivo para fechar imediatamente.
         // Pode ser half-close (shutdown(SHUT_WR)) e ainda tens de responder.
-        if (re & POLLHUP) {
-            std::map<int, Connection>::iterator it = _connections.find(fd);
-            if (it != _connections.end())
-                it->second.peerClosedRead = true;
+        if (re & EV_HUP) {
+            Connection* connection = _connections.find(fd);
+            if (connection)
+                connection->peerClosedRead = true;
 
-            // readFromClient(fd); // should not read on POLLHUP.
-            // poll() is a contract with the kernel: read() must be driven by POLLIN and write() by POLLOUT.
-            // POLLHUP is not a “permission to read”; it only signals a hangup/half-close possibility.
-            // We mark peerClosedRead and wait for a real POLLIN event (or finish the response and close).
+            // readFromClient(fd); // should not read on EV_HUP.
+            // The event loop is a contract with the kernel: read() must be driven by EV_READ and write() by EV_WRITE.
+            // EV_HUP is not a “permission to read”; it only signals a hangup/half-close possibility.
+            // We mark peerClosedRead and wait for a real EV_READ event (or finish the response and close).
 
         }
 
-        if (re & POLLIN)
+        if (re & EV_READ)
             readFromClient(fd);
 
-        if (re & POLLOUT)
+        if ((re & EV_WRITE) && _connections.find(fd))
             writeToClient(fd);
+
+        // The request may have moved on (body, keep-alive idle) with an earlier deadline.
+        Connection* connection = _connections.find(fd);
+        if (connection)
+            armTimer(*connection);
     }
 }
 
 
-void ServerRunner::acceptNewClient(int listenFd, const Server* srv) {
+// At most ACCEPT_BATCH clients per readiness event: a connection burst can't
+// starve the clients already being served. The listener is level-triggered,
+// so whatever is left in the accept queue is picked up on the next iteration.
+void ServerRunner::acceptNewClient(int listenFd, const Listener& listener) {
 
-    for (;;) {
-        int clientFd = accept(listenFd, NULL, NULL);
+    const int ACCEPT_BATCH = 64;
+
+    for (int accepted = 0; ; ++accepted) {
+        if (accepted == ACCEPT_BATCH) {
+            ++_metrics.acceptBatchCapped;
+            break;
+        }
+        if (_limits.maxConnections && _connections.size() >= _limits.maxConnections) {
+            pauseListeners(true);
+            break;
+        }
+
+        struct sockaddr_storage peer;
+        socklen_t peerLen = sizeof(peer);
+#ifdef SOCK_NONBLOCK
+        // One syscall instead of accept + 3 fcntl (close-on-exec, non-blocking).
+        int clientFd = accept4(listenFd, reinterpret_cast<struct sockaddr*>(&peer), &peerLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int clientFd = accept(listenFd, reinterpret_cast<struct sockaddr*>(&peer), &peerLen);
+#endif
         if (clientFd < 0) {
             if (errno == EINTR) continue;
             if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == ECONNABORTED) continue;    // reset while still queued
+            ++_metrics.acceptErrors;                // EMFILE, ENFILE, ENOBUFS...
             printSocketError("accept");
             break;
         }
 
+#ifndef SOCK_NONBLOCK
         int fdflags = fcntl(clientFd, F_GETFD);
         if (fdflags != -1) {
             if (fcntl(clientFd, F_SETFD, fdflags | FD_CLOEXEC) == -1)
@@ -453,85 +894,36 @@ void ServerRunner::acceptNewClient(int listenFd, const Server* srv) {
             close(clientFd);
             continue;
         }
+#endif
 
-        Connection connection;
-        connection.fd = clientFd;
-        connection.srv = srv;
-        connection.listenFd = listenFd;
-
-        connection.readBuffer.clear();
-        connection.writeBuffer.clear();
-
-        connection.headersComplete = false;
-        connection.sentContinue = false;
-        connection.state = S_HEADERS;
-
-        connection.request = HTTP_Request();
-        connection.response = HTTP_Response();
+        const uint64_t clientKey = ClientLimiter::keyOf(reinterpret_cast<struct sockaddr*>(&peer), peerLen);
+        if (!_limiter.openConnection(clientKey)) {
+            shedConnection(clientFd, listener);
+            continue;
+        }
 
-        connection.writeOffset = 0;
-        connection.clientMaxBodySize = std::numeric_limits<size_t>::max();
+        if (!_loop.add(clientFd, EV_READ)) {
+            printSocketError("event loop add client");
+            _limiter.closeConnection(clientKey);
+            close(clientFd);
+            continue;
+        }
 
-        connection.kaIdleStartMs = 0;
+        // Recycled slot: everything else starts at the Connection defaults (S_HEADERS).
+        Connection& connection = _connections.open(clientFd);
+        connection.vhosts = &listener.vhosts;
+        connection.srv = listener.vhosts.defaultServer();
+        connection.listenFd = listenFd;
+        connection.clientKey = clientKey;
         connection.lastActiveMs = _nowMs;
 
-        connection.draining = false;
-        connection.drainedBytes = 0;
-
-        connection.peerClosedRead = false; // <-- NOVO
-
-        _connections[clientFd] = connection;
-
-        struct pollfd p;
-        p.fd = clientFd;
-        p.events = POLLIN;
-        p.revents = 0;
-        _fds.push_back(p);
-        _fdIndex[p.fd] = _fds.size() - 1;
+        armTimer(connection);
+        ++_metrics.accepted;
     }
 }
 
 
 
-static size_t	parseSize(const std::string& string)	{
-	unsigned long long	n = 0;
-	char				suf = 0;
-	std::istringstream	iss(string);	// e.g. string = "10k"
-	iss >> n;	// reads number from a string. e.g. "10k" -> n = 10 and iss is now just before 'k'
-	if (iss && !iss.eof())	// means if the reading worked and we haven't reached the end of the string
-		iss >> suf;	// add the last whatever to suf. e.g. suf = "k"
-	
-	unsigned long long	mult = 1;
-	if (suf == 'k' || suf == 'K')
-		mult = 1024ULL;
-	else if (suf == 'm' || suf == 'M')
-		mult = 1024ULL * 1024ULL;
-	else if (suf == 'g' || suf == 'G')
-		mult = 1024ULL * 1024ULL * 1024ULL;
-	return static_cast<size_t>(n * mult);
-}
-
-static const Location* longestPrefixMatch(const Server& srv, const std::string& path) {
-    const Location* best = NULL;
-    size_t          bestLen = 0;
-
-    for (size_t i = 0; i < srv.locations.size(); ++i) {
-        const Location&      L  = srv.locations[i];
-        const std::string&   lp = L.path;
-
-        bool match = (path.compare(0, lp.size(), lp) == 0);
-        bool boundary = (path.size() == lp.size()
-                      || (path.size() > lp.size() && path[lp.size()] == '/'));
-
-        if (match && boundary && lp.size() > bestLen) {
-            best = &L;
-            bestLen = lp.size();
-        }
-    }
-    return best;
-}
-
-
     void    ServerRunner::dispatchRequest(Connection& connection) {
         /*
             Ask the App layer to build the response for this request
@@ -540,92 +932,255 @@ static const Location* longestPrefixMatch(const Server& srv, const std::string&
         */
         const Server& activeServer = connection.srv ? *connection.srv : _servers[0];
 
+        // Spilled upload complete: flush the fd, the App only needs the path.
+        if (connection.request.body_file_fd >= 0) {
+            close(connection.request.body_file_fd);
+            connection.request.body_file_fd = -1;
+        }
+
+        // "stub_status on;" locations are answered by the core itself (runtime metrics).
+        if (connection.route && connection.route->stubStatus
+            && (methodBit(connection.request.method) & (METHOD_GET | METHOD_HEAD))) {
+            discardBodySpill(connection.request);
+            queueStatusPage(connection);
+            return;
+        }
+
+        const long long handleStartUs = Metrics::nowUs();
         HTTP_Response appRes = ::handleRequest(connection.request, activeServer);
-        
+        _metrics.handle.observe(Metrics::nowUs() - handleStartUs);
+        discardBodySpill(connection.request);   // published by link() or rejected: drop the temp name
 
-        // If App says “close”, override keep-alive
-        if (appRes.close)
-            connection.request.keep_alive = false;
-
-        // Serialize to wire format (use request version if present)
-        const std::string httpVersion = connection.request.version;
-        connection.writeBuffer = http::serialize_response(appRes, httpVersion);
-
-        // HEAD method must send headers only (no body bytes)
-        if (connection.request.method == "HEAD") {
-            const std::string crlf = "\r\n\r\n";
-            std::string::size_type position = connection.writeBuffer.find(crlf);
-            if (position != std::string::npos) {
-                // Keep only status line + headers + CRLFCRLF
-                connection.writeBuffer.resize(position + crlf.size());
-            }
+        // CGI: the App only spawned the child, the event loop drives the rest.
+        if (appRes.cgiPending) {
+            startCgi(connection, appRes);
+            return;
         }
 
-        // ---- HALF-CLOSE COHERENCE ----
-        // Se o cliente fez shutdown(SHUT_WR) (half-close), não faz sentido manter keep-alive.
-        // Enviamos a resposta e fechamos a ligação: forçar "Connection: close" no wire.
-        if (connection.peerClosedRead) {
+        queueResponse(connection, appRes);
+    }
 
-            // 1) garante que a nossa lógica não tenta keep-alive depois
-            connection.request.keep_alive = false;
-
-            // 2) patch do header "Connection" na resposta serializada
-            const std::string ka = "Connection: keep-alive\r\n";
-            const std::string cl = "Connection: close\r\n";
-
-            std::string::size_type pos = connection.writeBuffer.find(ka);
-            if (pos != std::string::npos) {
-                connection.writeBuffer.replace(pos, ka.size(), cl);
-            } else {
-                // se não existir header Connection, insere após a status line
-                std::string::size_type eol = connection.writeBuffer.find("\r\n");
-                if (eol != std::string::npos)
-                    connection.writeBuffer.insert(eol + 2, cl);
-            }
+    // Upload bodies are written to "<upload_store>/.upload-XXXXXX" as they arrive
+    // (HttpBody's store_body), so memory per upload stays at one read chunk.
+    // Falls back to buffering in request.body when the temp file can't be created.
+    // multipart/form-data goes through the streaming parser instead: one temp
+    // file per file part (a missing boundary fails the body with a 400).
+    void    ServerRunner::openBodySpill(Connection& connection) {
+
+        const Server& activeServer = connection.srv ? *connection.srv : _servers[0];
+        const std::string dir = ::uploadSpillDirectory(connection.request, activeServer);
+        if (dir.empty())
+            return;
+
+        const std::string type = connection.request.headers.value(RequestHeaders::CONTENT_TYPE);
+        if (type.find("multipart/form-data") != std::string::npos) {
+            std::string boundary;
+            MultipartParser::boundaryOf(type, boundary);
+            connection.request.multipart.start(boundary, dir);
+            return;
+        }
+
+        std::string path;
+        int fd = spill::create(dir, path);
+        if (fd < 0)
+            return;
+
+        connection.request.body_file_fd = fd;
+        connection.request.body_file_path = path;
+    }
+
+    // Serialize a finished App response into the connection and switch to S_WRITE.
+    void    ServerRunner::queueResponse(Connection& connection, HTTP_Response& appRes) {
+
+        // ---- KEEP-ALIVE DECISION (before serializing) ----
+        // App says "close", or the client half-closed (shutdown(SHUT_WR)), or we are
+        // draining for shutdown, or keepalive_timeout is 0: the head goes out with "Connection: close" and
+        // writeToClient() closes after the last byte.
+        const ServerTimeouts& timeouts = (connection.srv ? *connection.srv : _servers[0]).timeouts;
+        const bool keepAlive = connection.request.keep_alive
+                            && !http::response_wants_close(appRes)
+                            && !connection.peerClosedRead
+                            && !_stopping
+                            && timeouts.keepAliveMs > 0;
+        connection.request.keep_alive = keepAlive;
+
+        // Head and body are separate writev() segments: the body is moved, not copied.
+        // HEAD method must send headers only (no body bytes): the segment is just dropped.
+        // App errors from a location template (HTTP/1.1 status line) skip the serializer.
+        if (appRes.prebuilt && connection.request.version == "HTTP/1.1")
+            connection.writeBuffer = http::build_prebuilt_head(*appRes.prebuilt, keepAlive);
+        else
+            connection.writeBuffer = http::serialize_head(appRes, connection.request.version, keepAlive,
+                                                            timeouts.keepAliveMs);
+        connection.writeBody.clear();
+        if (connection.request.method != "HEAD")
+            connection.writeBody.swap(appRes.body);
+
+        // File-backed body: ownership moves from the response to the connection.
+        // HEAD never sends it, so the file is released straight away.
+        releaseFileBody(connection);
+        if (appRes.fileFd >= 0) {
+            connection.bodyFd = appRes.fileFd;
+            connection.bodyOffset = appRes.fileOffset;
+            connection.bodyRemaining = appRes.fileLength;
+            appRes.fileFd = -1;
+            if (connection.request.method == "HEAD")
+                releaseFileBody(connection);
         }
 
         connection.writeOffset = 0;
-        connection.response = appRes;
+        connection.writeStartUs = Metrics::nowUs();
         connection.state = S_WRITE;
+        armTimer(connection);   // CGI responses arrive outside a client event
+
+        // Flip event interest to EV_WRITE for this fd
+        setInterest(connection.fd, EV_WRITE);
+    }
+
 
-        // Flip poll interest to POLLOUT for this fd
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(connection.fd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLOUT;
+
+    // Kernel-wide accept queue counters (Linux "TcpExt:" lines of /proc/net/netstat):
+    // ListenOverflows = handshakes dropped on a full accept queue, ListenDrops = all
+    // SYNs dropped at a listener. False when the file isn't there.
+    static bool readListenDrops(unsigned long& overflows, unsigned long& drops) {
+        std::ifstream in("/proc/net/netstat");
+        std::string names;
+        std::string values;
+        while (std::getline(in, names) && std::getline(in, values)) {
+            if (names.compare(0, 7, "TcpExt:") != 0)
+                continue;
+            std::istringstream n(names);
+            std::istringstream v(values);
+            std::string name;
+            std::string value;
+            int found = 0;
+            while (n >> name && v >> value) {
+                if (name == "ListenOverflows") {
+                    overflows = std::strtoul(value.c_str(), NULL, 10);
+                    ++found;
+                }
+                else if (name == "ListenDrops") {
+                    drops = std::strtoul(value.c_str(), NULL, 10);
+                    ++found;
+                }
+            }
+            return found == 2;
+        }
+        return false;
     }
 
+    // Prometheus-style text page: live gauges collected here, counters and
+    // histograms from _metrics, static file cache counters from the App.
+    void    ServerRunner::queueStatusPage(Connection& connection) {
+
+        static const char* const STATE_NAMES[] = { "headers", "body", "drain", "cgi", "write", "closed" };
+        unsigned long byState[S_CLOSED + 1] = { 0, 0, 0, 0, 0, 0 };
+
+        for (std::size_t i = 0; i < _connections.size(); ++i)
+            ++byState[_connections.at(i).state];
+
+        unsigned long cacheHits = 0;
+        unsigned long cacheMisses = 0;
+        std::size_t cacheBytes = 0;
+        std::size_t cacheEntries = 0;
+        ::fileCacheStats(cacheHits, cacheMisses, cacheBytes, cacheEntries);
+
+        std::ostringstream out;
+        out << "# TYPE webserv_worker_pid gauge\n"
+            << "webserv_worker_pid " << getpid() << "\n"
+            << "# TYPE webserv_connections gauge\n";
+        for (int i = 0; i <= S_CLOSED; ++i)
+            out << "webserv_connections{state=\"" << STATE_NAMES[i] << "\"} " << byState[i] << "\n";
+        out << "# TYPE webserv_file_cache_hits_total counter\n"
+            << "webserv_file_cache_hits_total " << cacheHits << "\n"
+            << "# TYPE webserv_file_cache_misses_total counter\n"
+            << "webserv_file_cache_misses_total " << cacheMisses << "\n"
+            << "# TYPE webserv_file_cache_bytes gauge\n"
+            << "webserv_file_cache_bytes " << cacheBytes << "\n"
+            << "# TYPE webserv_file_cache_entries gauge\n"
+            << "webserv_file_cache_entries " << cacheEntries << "\n"
+            << "# TYPE webserv_listeners_paused gauge\n"
+            << "webserv_listeners_paused " << (_listenersPaused ? 1 : 0) << "\n"
+            << "# TYPE webserv_limited_clients gauge\n"
+            << "webserv_limited_clients " << _limiter.clients() << "\n"
+            << "# TYPE webserv_access_log_lines_total counter\n"
+            << "webserv_access_log_lines_total " << _accessLog.lines() << "\n"
+            << "# TYPE webserv_access_log_dropped_total counter\n"
+            << "webserv_access_log_dropped_total " << _accessLog.dropped() << "\n"
+            << "# TYPE webserv_access_log_writes_total counter\n"
+            << "webserv_access_log_writes_total " << _accessLog.flushes() << "\n";
+        if (!_proxyUpstreams.empty()) {
+            out << "# TYPE webserv_proxy_connections gauge\n";
+            for (std::map<std::string, ProxyUpstream>::const_iterator it = _proxyUpstreams.begin(); it != _proxyUpstreams.end(); ++it)
+                out << "webserv_proxy_connections{upstream=\"" << it->first << "\",state=\"idle\"} " << it->second.idle.size() << "\n"
+                    << "webserv_proxy_connections{upstream=\"" << it->first << "\",state=\"busy\"} "
+                    << it->second.open - it->second.idle.size() << "\n";
+        }
 
+#ifdef TCP_INFO
+        // On a listening socket TCP_INFO reports the accept queue: tcpi_unacked
+        // is its current length, tcpi_sacked the backlog listen() settled on.
+        // Each family's samples stay contiguous under its TYPE line.
+        std::ostringstream queues;
+        std::ostringstream backlogs;
+        for (std::map<int, const Listener*>::const_iterator it = _listenerByFd.begin(); it != _listenerByFd.end(); ++it) {
+            struct tcp_info info;
+            socklen_t len = sizeof(info);
+            if (getsockopt(it->first, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+                continue;
+            queues << "webserv_listen_queue{listen=\"" << it->second->spec << "\"} " << info.tcpi_unacked << "\n";
+            backlogs << "webserv_listen_backlog{listen=\"" << it->second->spec << "\"} " << info.tcpi_sacked << "\n";
+        }
+        out << "# TYPE webserv_listen_queue gauge\n" << queues.str()
+            << "# TYPE webserv_listen_backlog gauge\n" << backlogs.str();
+#endif
+        unsigned long overflows = 0;
+        unsigned long drops = 0;
+        if (readListenDrops(overflows, drops))
+            out << "# TYPE webserv_kernel_listen_overflows_total counter\n"
+                << "webserv_kernel_listen_overflows_total " << overflows << "\n"
+                << "# TYPE webserv_kernel_listen_drops_total counter\n"
+                << "webserv_kernel_listen_drops_total " << drops << "\n";
+        _metrics.render(out);
+
+        HTTP_Response res;
+        res.body = out.str();
+        res.headers["Content-Type"] = "text/plain; version=0.0.4";
+        res.headers["Cache-Control"] = "no-store";
+        queueResponse(connection, res);
+    }
 
 
 void ServerRunner::readFromClient(int clientFd) {
 
-    std::map<int, Connection>::iterator it = _connections.find(clientFd);
-    if (it == _connections.end())
+    Connection* found = _connections.find(clientFd);
+    if (!found)
         return;
 
-    Connection& connection = it->second;
+    Connection& connection = *found;
 
     const std::size_t READ_BUDGET = 256u * 1024u;
 
-    char buffer[4096];
+    const std::size_t READ_CHUNK = 16u * 1024u;
     std::size_t totalRead = 0;
 
-    // 1) Ler bytes (non-blocking) com cap
+    // 1) Ler bytes (non-blocking) com cap, straight into the buffer's free tail
     for (;;) {
 
         if (totalRead >= READ_BUDGET)
             break;
 
-        std::size_t want = sizeof(buffer);
+        std::size_t want = READ_CHUNK;
         std::size_t remainingBudget = READ_BUDGET - totalRead;
         if (remainingBudget < want)
             want = remainingBudget;
 
-        ssize_t n = read(clientFd, buffer, want);
+        ssize_t n = read(clientFd, connection.readBuffer.prepare(want), want);
 
         if (n > 0) {
-            connection.readBuffer.append(buffer, static_cast<std::size_t>(n));
+            connection.readBuffer.commit(static_cast<std::size_t>(n));
             totalRead += static_cast<std::size_t>(n);
+            _metrics.bytesRead += static_cast<std::size_t>(n);
 
             connection.lastActiveMs = _nowMs;
 
@@ -642,15 +1197,11 @@ void ServerRunner::readFromClient(int clientFd) {
             
 
             if (connection.state == S_HEADERS && connection.readBuffer.empty()) {
-                closeConnection(clientFd);
+                closeConnection(clientFd, CLOSE_PEER);
                 return;
             }
 
-            std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-            if (pit != _fdIndex.end()) {
-                bool havePendingWrite = (connection.writeOffset < connection.writeBuffer.size());
-                _fds[pit->second].events = havePendingWrite ? POLLOUT : 0;
-            }
+            setInterest(clientFd, hasPendingWrite(connection) ? EV_WRITE : EV_NONE);
 
             break;
         }
@@ -662,6 +1213,66 @@ void ServerRunner::readFromClient(int clientFd) {
 
     }
 
+    processInput(clientFd);
+}
+
+// Parse and dispatch what is buffered. Also entered from writeToClient() when a
+// keep-alive response is done and the next request is already in readBuffer.
+void ServerRunner::processInput(int clientFd) {
+
+    Connection* connection = _connections.find(clientFd);
+    if (!connection)
+        return;
+
+    parseRequests(*connection);
+
+    // A pipelined batch ended on a request that can't answer yet (body still
+    // arriving, CGI running): flush the earlier responses first.
+    connection = _connections.find(clientFd);     // NULL if parsing closed it
+    if (connection && connection->state != S_WRITE
+        && connection->pipelinedOffset < connection->pipelined.size())
+        setInterest(clientFd, EV_WRITE);
+}
+
+// HTTP/1.1 pipelining: the response just queued is small, in memory and keeps
+// the connection open, and the next request's head is already buffered. Fold
+// the response into `pipelined` and parse on; the batch leaves in one writev(),
+// in request order.
+bool ServerRunner::pipelineNext(Connection& connection) {
+
+    const std::size_t PIPELINE_MAX_BYTES = 64u * 1024u;
+
+    if (connection.state != S_WRITE || !connection.request.keep_alive
+        || connection.sentContinue || connection.draining
+        || connection.bodyFd >= 0 || connection.writeOffset != 0)
+        return false;
+    if (connection.pipelined.size() - connection.pipelinedOffset
+        + connection.writeBuffer.size() + connection.writeBody.size() > PIPELINE_MAX_BYTES)
+        return false;
+    if (!http::head_buffered(connection.readBuffer, connection.headScanned))
+        return false;
+
+    connection.logStatus = responseStatusOf(connection.writeBuffer);
+    connection.logBytes = connection.writeBuffer.size() + connection.writeBody.size();
+    logAccess(connection);
+
+    connection.pipelined.append(connection.writeBuffer);
+    connection.pipelined.append(connection.writeBody);
+    connection.writeBody.clear();
+    if (connection.writeStartUs != 0) {
+        _metrics.writeOut.observe(Metrics::nowUs() - connection.writeStartUs);
+        connection.writeStartUs = 0;
+    }
+
+    resetForNextRequest(connection);
+    connection.kaIdleStartMs = 0;
+    return true;
+}
+
+void ServerRunner::parseRequests(Connection& connection) {
+
+    const int clientFd = connection.fd;
+
     if (connection.state == S_WRITE && !connection.draining) {
         return;
     }
@@ -687,14 +1298,12 @@ void ServerRunner::readFromClient(int clientFd) {
         if (result == http::BODY_COMPLETE) {
             connection.draining = false;
 
-            if (connection.writeOffset >= connection.writeBuffer.size()) {
+            if (!hasPendingWrite(connection)) {
                 closeConnection(clientFd);
                 return;
             }
 
-            std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-            if (pit != _fdIndex.end())
-                _fds[pit->second].events = POLLOUT;
+            setInterest(clientFd, EV_WRITE);
 
             connection.state = S_WRITE;
 
@@ -710,23 +1319,19 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeOffset = 0;
             }
 
-            std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-            if (pit != _fdIndex.end())
-                _fds[pit->second].events = POLLOUT;
+            setInterest(clientFd, EV_WRITE);
 
             connection.state = S_WRITE;
             return;
         }
 
         if (connection.peerClosedRead) {
-            if (connection.writeOffset >= connection.writeBuffer.size()) {
-                closeConnection(clientFd);
+            if (!hasPendingWrite(connection)) {
+                closeConnection(clientFd, CLOSE_PEER);
                 return;
             }
 
-            std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-            if (pit != _fdIndex.end())
-                _fds[pit->second].events = POLLOUT;
+            setInterest(clientFd, EV_WRITE);
             connection.state = S_WRITE;
         }
         return;
@@ -739,8 +1344,17 @@ void ServerRunner::readFromClient(int clientFd) {
         if (connection.state == S_HEADERS) {
 
             static const std::size_t MAX_HEADER_BYTES = 16 * 1024;
-            if (connection.readBuffer.size() > MAX_HEADER_BYTES
-                && connection.readBuffer.find("\r\n\r\n") == std::string::npos) {
+
+            const long long parseStartUs = Metrics::nowUs();
+
+            // The previous head's storage is lent to the extraction and handed
+            // back by parse_head(): no allocation per request once warmed up.
+            // The search resumes where the previous read left it (headScanned).
+            std::string head;
+            head.swap(connection.request.headers.raw());
+            const bool haveHead = http::extract_next_head(connection.readBuffer, head, connection.headScanned);
+
+            if (!haveHead && connection.readBuffer.size() > MAX_HEADER_BYTES) {
 
                 int st = 431;
                 std::string rsn = "Request Header Fields Too Large";
@@ -755,21 +1369,18 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeBuffer = http::build_error_response(active, st, rsn, false);
                 connection.writeOffset = 0;
 
-                std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                if (pit != _fdIndex.end())
-                    _fds[pit->second].events = POLLOUT;
+                setInterest(clientFd, EV_WRITE);
 
                 connection.state = S_WRITE;
                 return;
             }
 
-            std::string head;
-            if (!http::extract_next_head(connection.readBuffer, head)) {
+            if (!haveHead) {
 
                 
 
                 if (connection.peerClosedRead && connection.readBuffer.empty()) {
-                    closeConnection(clientFd);
+                    closeConnection(clientFd, CLOSE_PEER);
                     return;
                 }
 
@@ -779,9 +1390,7 @@ void ServerRunner::readFromClient(int clientFd) {
                     connection.writeBuffer = http::build_error_response(active, 400, "Bad Request", false);
                     connection.writeOffset = 0;
 
-                    std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                    if (pit != _fdIndex.end())
-                        _fds[pit->second].events = POLLOUT;
+                    setInterest(clientFd, EV_WRITE);
 
                     connection.state = S_WRITE;
                 }
@@ -804,34 +1413,30 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeBuffer = http::build_error_response(active, status, reason, connection.request.keep_alive);
                 connection.writeOffset = 0;
 
-                std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                if (pit != _fdIndex.end())
-                    _fds[pit->second].events = POLLOUT;
+                setInterest(clientFd, EV_WRITE);
 
                 connection.state = S_WRITE;
                 return;
             }
 
             connection.headersComplete = true;
+            connection.requestStartUs = parseStartUs;
+            _metrics.headerParse.observe(Metrics::nowUs() - parseStartUs);
 
             
 
-            // ---- client_max_body_size resolution ----
-            size_t limit = std::numeric_limits<size_t>::max();
-            bool fromLoc = false;
-            const Location* loc = NULL;
-
-            if (connection.srv) {
-                if ((loc = longestPrefixMatch(*connection.srv, connection.request.path))) {
-                    if (loc->directives.count("client_max_body_size")) {
-                        limit = parseSize(loc->directives.find("client_max_body_size")->second);
-                        fromLoc = true;
-                    }
-                }
-                if (!fromLoc && connection.srv->directives.count("client_max_body_size"))
-                    limit = parseSize(connection.srv->directives.find("client_max_body_size")->second);
-            }
-            connection.clientMaxBodySize = limit;
+            // ---- virtual host, route + client_max_body_size (precompiled, 0 = unlimited) ----
+            if (connection.vhosts)
+                connection.srv = connection.vhosts->select(connection.request.host);
+            const Server& routed = connection.srv ? *connection.srv : _servers[0];
+            connection.route = &routed.routes.match(connection.request.path);
+            connection.clientMaxBodySize = connection.route->clientMaxBodySize
+                                         ? connection.route->clientMaxBodySize
+                                         : std::numeric_limits<size_t>::max();
+            _metrics.countRequest(connection.route);
+
+            if (shedRequest(connection))
+                return;
 
             // ---- EARLY CHECKS (CL > limit) ----
             {
@@ -854,9 +1459,7 @@ void ServerRunner::readFromClient(int clientFd) {
 
                     connection.state = S_WRITE;
 
-                    std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                    if (pit != _fdIndex.end())
-                        _fds[pit->second].events = POLLOUT;
+                    setInterest(clientFd, EV_WRITE);
 
                     return;
                 }
@@ -864,13 +1467,31 @@ void ServerRunner::readFromClient(int clientFd) {
                 // (resto do teu EARLY-405/others fica igual)
             }
 
+            // ---- proxy_pass: the head goes upstream now, a body follows as it arrives ----
+            if (!connection.route->proxyPass.empty()) {
+                startProxy(connection);
+                if (connection.state == S_WRITE)
+                    return;     // no upstream server could take it (502)
+                if (connection.request.body_reader_state == BR_NONE) {
+                    connection.state = S_CGI;
+                    setInterest(clientFd, EV_NONE);
+                    return;
+                }
+            }
+
             // ---- Transition depending on body presence ----
             if (connection.request.body_reader_state == BR_NONE) {
                 
                 dispatchRequest(connection);
+                if (pipelineNext(connection))
+                    continue;
                 return;
             }
 
+            // Simple uploads stream straight to a temp file in upload_store.
+            if (connection.route->proxyPass.empty())
+                openBodySpill(connection);
+
             if (connection.request.expectContinue == true) {
 
                 
@@ -879,9 +1500,7 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeOffset = 0;
                 connection.sentContinue = true;
 
-                std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                if (pit != _fdIndex.end())
-                    _fds[pit->second].events = POLLOUT;
+                setInterest(clientFd, EV_WRITE);
 
                 connection.state = S_WRITE;
                 return;
@@ -915,11 +1534,21 @@ void ServerRunner::readFromClient(int clientFd) {
                     result = http::BODY_ERROR;
             }
 
-            
+            // proxy_pass: the decoded body goes upstream (re-chunked if it came chunked).
+            if (!connection.route->proxyPass.empty() && connection.cgi.backendFd >= 0) {
+                if (result != http::BODY_ERROR && !(result == http::BODY_INCOMPLETE && connection.peerClosedRead)) {
+                    forwardProxyBody(connection, result == http::BODY_COMPLETE);
+                    return;
+                }
+                abortCgi(connection);       // broken request: the upstream exchange can't finish either
+                connection.cgi = CgiProcess();
+            }
 
             if (result == http::BODY_COMPLETE) {
                 
                 dispatchRequest(connection);
+                if (pipelineNext(connection))
+                    continue;
                 return;
             }
 
@@ -941,9 +1570,7 @@ void ServerRunner::readFromClient(int clientFd) {
 
                     connection.state = S_WRITE;
 
-                    std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                    if (pit != _fdIndex.end())
-                        _fds[pit->second].events = POLLOUT;
+                    setInterest(clientFd, EV_WRITE);
 
                     return;
                 }
@@ -951,9 +1578,7 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeBuffer = http::build_error_response(active, status, reason, connection.request.keep_alive);
                 connection.writeOffset = 0;
 
-                std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                if (pit != _fdIndex.end())
-                    _fds[pit->second].events = POLLOUT;
+                setInterest(clientFd, EV_WRITE);
 
                 connection.state = S_WRITE;
                 return;
@@ -966,9 +1591,7 @@ void ServerRunner::readFromClient(int clientFd) {
                 connection.writeBuffer = http::build_error_response(active, 400, "Bad Request", false);
                 connection.writeOffset = 0;
 
-                std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-                if (pit != _fdIndex.end())
-                    _fds[pit->second].events = POLLOUT;
+                setInterest(clientFd, EV_WRITE);
 
                 connection.state = S_WRITE;
             }
@@ -983,134 +1606,205 @@ void ServerRunner::readFromClient(int clientFd) {
 
 
 
-    static bool containsConnectionClose(const std::string& buf) {
-        // Procura de forma case-insensitive por "\nConnection: close"
-        // (inclui o caso do header vir com \r\n)
-        const std::string needle = "\nconnection: close";
-        std::string lower;
-        lower.reserve(buf.size());
-        for (std::size_t i = 0; i < buf.size(); ++i) {
-            unsigned char c = static_cast<unsigned char>(buf[i]);
-            lower.push_back(static_cast<char>(std::tolower(c)));
-        }
-        return (lower.find(needle) != std::string::npos);
-    }
-
-
-
-
-
 void ServerRunner::writeToClient(int clientFd) {
 
-    std::map<int, Connection>::iterator it = _connections.find(clientFd);
-    if (it == _connections.end())
+    Connection* found = _connections.find(clientFd);
+    if (!found)
         return;
 
-    Connection& connection = it->second;
+    Connection& connection = *found;
 
     const std::size_t WRITE_BUDGET = 256u * 1024u;
 
-    const char* base = connection.writeBuffer.data();
     std::size_t sentThisCall = 0;
 
-    while (connection.writeOffset < connection.writeBuffer.size()) {
+    // In-memory part: [pipelined][head][body] flushed together with writev(), one
+    // syscall per round instead of one per buffer (and no head+body concatenation).
+    // Outside S_WRITE only earlier pipelined responses are owed: the current
+    // request is still reading its body or waiting for its CGI.
+    const bool responseReady = (connection.state == S_WRITE);
+    const std::size_t headSize = connection.writeBuffer.size();
+    const std::size_t memTotal = responseReady ? headSize + connection.writeBody.size() : 0;
+    if (responseReady && connection.logStatus == 0 && !connection.sentContinue)
+        connection.logStatus = responseStatusOf(connection.writeBuffer);
+
+    while (connection.pipelinedOffset < connection.pipelined.size() || connection.writeOffset < memTotal) {
 
         if (sentThisCall >= WRITE_BUDGET)
             break;
 
-        const char* buf = base + connection.writeOffset;
-        std::size_t remaining = connection.writeBuffer.size() - connection.writeOffset;
+        std::size_t budget = WRITE_BUDGET - sentThisCall;
+        struct iovec iov[3];
+        int iovCount = 0;
+
+        const std::size_t earlier = connection.pipelined.size() - connection.pipelinedOffset;
+        if (earlier > 0) {
+            std::size_t len = earlier;
+            if (len > budget)
+                len = budget;
+            iov[iovCount].iov_base = const_cast<char*>(connection.pipelined.data() + connection.pipelinedOffset);
+            iov[iovCount].iov_len = len;
+            ++iovCount;
+            budget -= len;
+        }
 
-        std::size_t remainingBudget = WRITE_BUDGET - sentThisCall;
-        if (remainingBudget < remaining)
-            remaining = remainingBudget;
+        if (budget > 0 && connection.writeOffset < headSize && responseReady) {
+            std::size_t len = headSize - connection.writeOffset;
+            if (len > budget)
+                len = budget;
+            iov[iovCount].iov_base = const_cast<char*>(connection.writeBuffer.data() + connection.writeOffset);
+            iov[iovCount].iov_len = len;
+            ++iovCount;
+            budget -= len;
+        }
+
+        const std::size_t bodyPos = (connection.writeOffset > headSize) ? connection.writeOffset - headSize : 0;
+        if (budget > 0 && responseReady && bodyPos < connection.writeBody.size()) {
+            std::size_t len = connection.writeBody.size() - bodyPos;
+            if (len > budget)
+                len = budget;
+            iov[iovCount].iov_base = const_cast<char*>(connection.writeBody.data() + bodyPos);
+            iov[iovCount].iov_len = len;
+            ++iovCount;
+        }
 
-        ssize_t n = write(clientFd, buf, remaining);
+        ssize_t n = writev(clientFd, iov, iovCount);
 
         if (n > 0) {
-            connection.writeOffset += static_cast<std::size_t>(n);
-            sentThisCall += static_cast<std::size_t>(n);
+            std::size_t done = static_cast<std::size_t>(n);
+            std::size_t fromEarlier = (done < earlier) ? done : earlier;
+            connection.pipelinedOffset += fromEarlier;
+            connection.writeOffset += done - fromEarlier;
+            connection.logBytes += done - fromEarlier;
+            sentThisCall += done;
+            _metrics.bytesWritten += done;
             connection.lastActiveMs = _nowMs;
             continue;
         }
 
         // n <= 0:
-        // Subject-compliant: do not inspect errno after write().
-        // Just stop writing now and rely on poll(POLLOUT) to wake us again.
-        // If the peer is dead, a future poll() will surface it via POLLERR/POLLHUP/POLLNVAL.
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLOUT;
+        // Subject-compliant: do not inspect errno after writev().
+        // Just stop writing now and rely on EV_WRITE to wake us again.
+        // If the peer is dead, the event loop will surface it via EV_ERROR/EV_HUP.
+        setInterest(clientFd, EV_WRITE);
         return;
     }
 
-    if (connection.writeOffset < connection.writeBuffer.size()) {
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLOUT;
-
-        
+    if (connection.pipelinedOffset < connection.pipelined.size() || connection.writeOffset < memTotal) {
+        setInterest(clientFd, EV_WRITE);
         return;
     }
 
+    connection.pipelined.clear();
+    connection.pipelinedOffset = 0;
 
-    // ================== FIM DE RESPOSTA (lógica comum) ==================
-
-    // ⚠️ PATCH IMPORTANTE:
-    // Calcula isto ANTES de mexer/limpar no writeBuffer.
-    const bool responseSaysClose = containsConnectionClose(connection.writeBuffer);
-
-    // Caso especial: 100-continue
-    if (connection.sentContinue) {
-
-        connection.sentContinue = false;
-        connection.writeBuffer.clear();
-        connection.writeOffset = 0;
-
-        connection.state = S_BODY;
-
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLIN;
-
+    if (!responseReady) {
+        setInterest(clientFd, connection.state == S_CGI ? EV_NONE : EV_READ);
         return;
     }
 
-    // Se estamos em DRAIN, NÃO fechar após enviar a resposta.
-    if (connection.draining || connection.state == S_DRAIN) {
-
+    // Streamed CGI: everything produced so far is out. Read the script again
+    // and sleep until it writes more; the response ends with its output.
+    if (connection.cgi.streaming) {
         connection.writeBuffer.clear();
+        connection.writeBody.clear();
         connection.writeOffset = 0;
+        if (!connection.cgi.streamFinished) {
+            pauseCgiOutput(connection, false);
+            setInterest(clientFd, EV_NONE);
+            armTimer(connection);   // now cgi_timeout: waiting on the script
+            return;
+        }
+        connection.cgi = CgiProcess();
+    }
 
-        connection.state = S_DRAIN;
-
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLIN;
+    // File-backed body: stream it after the head, within the same budget.
+    while (connection.bodyRemaining > 0) {
 
-        return;
-    }
+        if (sentThisCall >= WRITE_BUDGET)
+            break;
 
-    const bool keep = connection.request.keep_alive
-                && !connection.peerClosedRead
-                && !responseSaysClose;
+        std::size_t want = connection.bodyRemaining;
+        std::size_t remainingBudget = WRITE_BUDGET - sentThisCall;
+        if (remainingBudget < want)
+            want = remainingBudget;
 
-    if (keep) {
+        ssize_t n = sendFileChunk(clientFd, connection.bodyFd, connection.bodyOffset, want);
 
-        const std::size_t bufferedNext = connection.readBuffer.size();
+        if (n > 0) {
+            connection.bodyRemaining -= static_cast<std::size_t>(n);
+            connection.logBytes += static_cast<std::size_t>(n);
+            sentThisCall += static_cast<std::size_t>(n);
+            _metrics.bytesWritten += static_cast<std::size_t>(n);
+            connection.lastActiveMs = _nowMs;
+            continue;
+        }
 
-        
+        if (n == 0) {
+            // File shrank under us: Content-Length can no longer be honoured.
+            closeConnection(clientFd, CLOSE_ERROR);
+            return;
+        }
+
+        setInterest(clientFd, EV_WRITE);
+        return;
+    }
+
+    if (connection.bodyRemaining > 0) {
+        setInterest(clientFd, EV_WRITE);
+        return;
+    }
+
+    releaseFileBody(connection);
+    std::string().swap(connection.writeBody);   // don't keep a big body's capacity around
+
+    if (connection.writeStartUs != 0) {
+        _metrics.writeOut.observe(Metrics::nowUs() - connection.writeStartUs);
+        connection.writeStartUs = 0;
+    }
+
+
+    // ================== FIM DE RESPOSTA (lógica comum) ==================
+
+    // Caso especial: 100-continue
+    if (connection.sentContinue) {
 
+        connection.sentContinue = false;
         connection.writeBuffer.clear();
         connection.writeOffset = 0;
 
-        connection.headersComplete = false;
-        connection.sentContinue = false;
+        connection.state = S_BODY;
+
+        setInterest(clientFd, EV_READ);
+
+        return;
+    }
+
+    logAccess(connection);  // last byte of the response is out
+
+    // Se estamos em DRAIN, NÃO fechar após enviar a resposta.
+    if (connection.draining || connection.state == S_DRAIN) {
+
+        connection.writeBuffer.clear();
+        connection.writeOffset = 0;
+
+        connection.state = S_DRAIN;
+
+        setInterest(clientFd, EV_READ);
 
-        connection.request = HTTP_Request();
-        connection.response = HTTP_Response();
+        return;
+    }
+
+    // keep_alive already folds in the response's own Connection decision
+    // (queueResponse / build_error_response callers keep them in sync).
+    const bool keep = connection.request.keep_alive
+                && !connection.peerClosedRead;
 
-        connection.state = S_HEADERS;
+    if (keep) {
+
+        const std::size_t bufferedNext = connection.readBuffer.size();
+
+        resetForNextRequest(connection);
 
         connection.peerClosedRead = false;
 
@@ -1121,16 +1815,11 @@ void ServerRunner::writeToClient(int clientFd) {
 
         connection.lastActiveMs = _nowMs;
 
-        std::map<int, std::size_t>::iterator pit = _fdIndex.find(clientFd);
-        if (pit != _fdIndex.end())
-            _fds[pit->second].events = POLLIN;
+        setInterest(clientFd, EV_READ);
 
-        
-
-        // if (!connection.readBuffer.empty()) {
-            
-        //     readFromClient(clientFd);
-        // }
+        // Pipelined requests already buffered: no new EV_READ will come for them.
+        if (bufferedNext != 0)
+            processInput(clientFd);
 
         return;
     }
@@ -1145,26 +1834,1146 @@ void ServerRunner::writeToClient(int clientFd) {
 
 
 
-void	ServerRunner::closeConnection(int clientFd)	{
+void	ServerRunner::closeConnection(int clientFd, CloseReason reason)	{
+
+	// Unregister first so the loop never reports a dead (or reused) fd number.
+	// O(1) in every backend; the poll() fallback swaps the last slot into the hole.
+	_loop.remove(clientFd);
+	_listenerByFd.erase(clientFd);
+
+	Connection*	connection = _connections.find(clientFd);
+	if (connection)	{
+		++_metrics.closed[reason];
+		if (connection->requestStartUs != 0 && connection->logStatus == 0)
+			connection->logStatus = 499;	// nothing sent: client gone or timed out first (nginx's code)
+		logAccess(*connection);
+		_limiter.closeConnection(connection->clientKey);
+		releaseFileBody(*connection);
+		discardBodySpill(connection->request);
+		abortCgi(*connection);
+	}
 
 	close(clientFd);
-	_connections.erase(clientFd);
-
-	// must clean up the poll structures so we dont keep polling a dead fd
-	std::map<int, std::size_t>::iterator it = _fdIndex.find(clientFd);
-    if (it == _fdIndex.end())
-		return ;	// Not present in _fds (already removed or was never added)
-
-	std::size_t	index = it->second;
-	std::size_t	last = _fds.size() - 1;
-
-	if (index != last)	{
-		// Move last entry into the removed slot
-		std::swap(_fds[index], _fds[last]);
-		// Update its index in the map
-		_fdIndex[_fds[index].fd] = index;
-	}	// so that we dont shift all later elements
-
-	_fds.pop_back();	// remove the last index
-	_fdIndex.erase(it);	// remove the index number of where _fds were
-}
\ No newline at end of file
+	_connections.release(clientFd);
+
+	if (_listenersPaused && !_stopping && _connections.size() < _limits.maxConnections)
+		pauseListeners(false);
+}
+
+
+//**************************************************************************************************
+// Asynchronous CGI
+//
+// handleRequest() only forks the script; from then on the client sits in S_CGI
+// and the child's pipes are ordinary fds in the event loop, so a slow script
+// never blocks other clients. Exits are reaped on SIGCHLD (self-pipe) with
+// waitpid(WNOHANG); the response is built once both EOF and exit were seen.
+
+static void	onSigchld(int)	{
+	int	savedErrno = errno;
+	if (g_sigchldWriteFd >= 0)	{
+		char	c = 1;
+		ssize_t	n = write(g_sigchldWriteFd, &c, 1);		// full pipe is fine: a wake-up is already queued
+		(void)n;
+	}
+	errno = savedErrno;
+}
+
+void	ServerRunner::openSigchldPipe()	{
+
+	if (pipe(_sigchldPipe) == -1)	{
+		printSocketError("SIGCHLD pipe");	// housekeeping() still reaps every tick
+		_sigchldPipe[0] = -1;
+		_sigchldPipe[1] = -1;
+		return;
+	}
+	for (int i = 0; i < 2; ++i)	{
+		makeNonBlocking(_sigchldPipe[i]);
+		fcntl(_sigchldPipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	if (!_loop.add(_sigchldPipe[0], EV_READ))
+		printSocketError("event loop add SIGCHLD pipe");
+
+	g_sigchldWriteFd = _sigchldPipe[1];
+	signal(SIGCHLD, onSigchld);
+}
+
+void	ServerRunner::startCgi(Connection& connection, const HTTP_Response& appRes)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	cgi = appRes.cgi;
+	cgi.lastIoMs = _nowMs;
+	cgi.startedUs = Metrics::nowUs();
+
+	if (!cgi.fastcgiSocket.empty())	{
+		connection.state = S_CGI;
+		setInterest(connection.fd, EV_NONE);
+		startFastCgi(connection);
+		return;
+	}
+
+	++_metrics.cgiSpawned;
+	_cgiPidOwner[cgi.pid] = connection.fd;
+
+	connection.state = S_CGI;
+	setInterest(connection.fd, EV_NONE);		// nothing to read or write until the script answers
+
+	if (_loop.add(cgi.stdoutFd, EV_READ))
+		_cgiPipeOwner[cgi.stdoutFd] = connection.fd;
+	else	{
+		printSocketError("event loop add CGI stdout");
+		abortCgi(connection);					// exitStatus stays -1 -> 500
+		finishCgiIfDone(connection);
+		return;
+	}
+
+	if (connection.request.body.empty())
+		closeCgiPipe(cgi.stdinFd);				// EOF right away for bodiless requests
+	else if (_loop.add(cgi.stdinFd, EV_WRITE))
+		_cgiPipeOwner[cgi.stdinFd] = connection.fd;
+	else
+		closeCgiPipe(cgi.stdinFd);
+}
+
+void	ServerRunner::handleCgiEvent(int pipeFd, int events)	{
+
+	Connection*	owner = _connections.find(_cgiPipeOwner[pipeFd]);
+	if (!owner)	{
+		closeCgiPipe(pipeFd);
+		return;
+	}
+
+	Connection&	connection = *owner;
+	CgiProcess&	cgi = connection.cgi;
+
+	if (pipeFd == cgi.stdinFd)	{
+		if (events & (EV_ERROR | EV_HUP))
+			closeCgiPipe(cgi.stdinFd);			// script stopped reading its input
+		else if (events & EV_WRITE)
+			pumpCgiStdin(connection);
+	}
+	else if (pipeFd == cgi.stdoutFd)	{
+		drainCgiStdout(connection, events);
+		forwardCgiOutput(connection);
+	}
+
+	finishCgiIfDone(connection);
+}
+
+void	ServerRunner::pumpCgiStdin(Connection& connection)	{
+
+	CgiProcess&			cgi = connection.cgi;
+	const std::string&	body = connection.request.body;
+
+	if (cgi.stdinWritten < body.size())	{
+		ssize_t	n = write(cgi.stdinFd, body.data() + cgi.stdinWritten, body.size() - cgi.stdinWritten);
+		if (n > 0)	{
+			cgi.stdinWritten += static_cast<std::size_t>(n);
+			cgi.lastIoMs = _nowMs;
+		}
+		// n <= 0: pipe full, wait for the next EV_WRITE (Subject-compliant: no errno check)
+	}
+	if (cgi.stdinWritten >= body.size())
+		closeCgiPipe(cgi.stdinFd);				// signal EOF on the script's STDIN
+}
+
+void	ServerRunner::drainCgiStdout(Connection& connection, int events)	{
+
+	const std::size_t	READ_BUDGET = 64 * 1024;	// don't let one chatty script starve the loop
+	CgiProcess&			cgi = connection.cgi;
+	char				buf[4096];
+	std::size_t			got = 0;
+
+	while (cgi.stdoutFd >= 0 && got < READ_BUDGET)	{
+		ssize_t	n = read(cgi.stdoutFd, buf, sizeof(buf));
+		if (n > 0)	{
+			cgi.output.append(buf, static_cast<std::size_t>(n));
+			cgi.lastIoMs = _nowMs;
+			got += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n == 0 || (events & EV_ERROR))
+			closeCgiPipe(cgi.stdoutFd);			// EOF (or a broken pipe): output is complete
+		break;
+	}
+}
+
+void	ServerRunner::closeCgiPipe(int& fd)	{
+
+	if (fd < 0)
+		return;
+	_loop.remove(fd);
+	_cgiPipeOwner.erase(fd);
+	close(fd);
+	fd = -1;
+}
+
+void	ServerRunner::finishCgiIfDone(Connection& connection)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	if (!cgi.proxyPeer.empty())	{
+		if (cgi.exited)
+			finishProxy(connection);			// proxy_timeout (504)
+		return;
+	}
+
+	if (cgi.streaming)	{
+		if (cgi.streamFinished || cgi.stdoutFd >= 0 || !cgi.exited)
+			return;
+		closeCgiPipe(cgi.stdinFd);
+		if (cgi.streamChunked)
+			connection.writeBody += "0\r\n\r\n";	// last-chunk, no trailers
+		else if (cgi.streamRemaining > 0)
+			connection.request.keep_alive = false;	// shorter than its Content-Length: only a close can end it
+		cgi.streamFinished = true;
+		connection.upstreamUs = Metrics::nowUs() - cgi.startedUs;
+		_metrics.cgi.observe(connection.upstreamUs);
+		setInterest(connection.fd, EV_WRITE);	// flush the tail, then the usual end of response
+		return;
+	}
+
+	if (connection.state != S_CGI || cgi.stdoutFd >= 0 || !cgi.exited)
+		return;
+	closeCgiPipe(cgi.stdinFd);					// the script may exit without reading all of it
+
+	const Server&	activeServer = connection.srv ? *connection.srv : _servers[0];
+	HTTP_Response	appRes = ::buildCgiResponse(connection.request, activeServer, cgi);
+	connection.upstreamUs = Metrics::nowUs() - cgi.startedUs;
+	_metrics.cgi.observe(connection.upstreamUs);
+
+	connection.cgi = CgiProcess();
+	connection.lastActiveMs = _nowMs;
+	queueResponse(connection, appRes);
+}
+
+// Streaming ("cgi_streaming on"): once the script's header block is complete
+// the head goes out and the body follows as it is read, chunked unless the
+// script sent a Content-Length. HTTP/1.0, HEAD, and anything
+// buildCgiStreamHead() refuses (errors, redirects without a type) keep the
+// buffered path. While the client is behind, the pipe is not read.
+void	ServerRunner::forwardCgiOutput(Connection& connection)	{
+
+	const std::size_t	HIGH_WATER = 64 * 1024;
+	CgiProcess&			cgi = connection.cgi;
+
+	if (!cgi.streaming)	{
+		HTTP_Response	head;
+		if (!cgi.proxyPeer.empty())	{
+			if (!startProxyStream(connection, head))
+				return;
+		}
+		else	{
+			const bool	outputOpen = cgi.fastcgiSocket.empty() ? cgi.stdoutFd >= 0 : !cgi.exited;
+			if (connection.state != S_CGI || !cgi.streamEnabled || cgi.output.empty() || !outputOpen
+				|| connection.request.version != "HTTP/1.1" || connection.request.method == "HEAD")
+				return;
+
+			std::size_t		bodyStart = 0;
+			long long		contentLength = -1;
+			if (!::buildCgiStreamHead(connection.request, cgi, head, bodyStart, contentLength))
+				return;
+
+			cgi.output.erase(0, bodyStart);
+			cgi.streamChunked = (contentLength < 0);
+			cgi.streamRemaining = contentLength < 0 ? 0 : contentLength;
+		}
+		connection.lastActiveMs = _nowMs;
+		queueResponse(connection, head);		// S_WRITE with just the head
+		cgi.streaming = true;
+	}
+
+	if (!cgi.output.empty())	{
+		if (cgi.streamChunked)	{
+			std::ostringstream	size;
+			size << std::hex << cgi.output.size() << "\r\n";
+			connection.writeBody += size.str();
+			connection.writeBody += cgi.output;
+			connection.writeBody += "\r\n";
+		}
+		else	{
+			std::size_t	take = cgi.output.size();
+			if (static_cast<long long>(take) > cgi.streamRemaining)
+				take = static_cast<std::size_t>(cgi.streamRemaining);		// past its own Content-Length: dropped
+			connection.writeBody.append(cgi.output, 0, take);
+			cgi.streamRemaining -= static_cast<long long>(take);
+		}
+		cgi.output.clear();
+		setInterest(connection.fd, EV_WRITE);
+		armTimer(connection);					// send_timeout again while bytes are owed
+	}
+
+	const std::size_t	pending = connection.writeBuffer.size() + connection.writeBody.size() - connection.writeOffset;
+	if (pending >= HIGH_WATER)
+		pauseCgiOutput(connection, true);
+}
+
+void	ServerRunner::pauseCgiOutput(Connection& connection, bool pause)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	if (cgi.outputPaused == pause)
+		return;
+	cgi.outputPaused = pause;
+	if (!pause)
+		cgi.lastIoMs = _nowMs;					// the wait was on the client, not the script
+	if (cgi.stdoutFd >= 0)
+		setInterest(cgi.stdoutFd, pause ? EV_NONE : EV_READ);
+	if (cgi.backendFd >= 0 && !cgi.proxyPeer.empty())
+		setInterest(cgi.backendFd, proxyInterest(_proxyBackends[cgi.backendFd], cgi));
+	else if (cgi.backendFd >= 0)	{
+		const FastCgiBackend&	backend = _fcgiBackends[cgi.backendFd];
+		const int				writing = backend.outOffset < backend.out.size() ? EV_WRITE : EV_NONE;
+		setInterest(cgi.backendFd, writing | (pause ? EV_NONE : EV_READ));
+	}
+}
+
+// Kill and forget the child (timeout, client gone, or setup failure).
+// The pid is dropped from the owner map; reapCgiChildren() still collects it.
+// A FastCGI request drops its backend connection, or its place in the queue;
+// a proxied one its upstream connection.
+void	ServerRunner::abortCgi(Connection& connection)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	if (!cgi.proxyPeer.empty())	{
+		if (cgi.backendFd >= 0)
+			closeProxyBackend(cgi.backendFd);		// mid-exchange: the connection can't be reused
+		cgi.backendFd = -1;
+		cgi.exited = true;
+		return;
+	}
+
+	if (!cgi.fastcgiSocket.empty())	{
+		if (cgi.backendFd >= 0)	{
+			const std::string	socketPath = cgi.fastcgiSocket;
+			closeFastCgiBackend(cgi.backendFd);		// mid-request: the connection can't be reused
+			cgi.backendFd = -1;
+			serveFastCgiQueue(socketPath);
+		}
+		else	{
+			std::deque<int>&	waiting = _fcgiUpstreams[cgi.fastcgiSocket].waiting;
+			waiting.erase(std::remove(waiting.begin(), waiting.end(), connection.fd), waiting.end());
+		}
+		cgi.exited = true;
+		return;
+	}
+
+	if (cgi.pid > 0 && !cgi.exited)
+		kill(cgi.pid, SIGKILL);
+	if (cgi.pid > 0)
+		_cgiPidOwner.erase(cgi.pid);
+	closeCgiPipe(cgi.stdinFd);
+	closeCgiPipe(cgi.stdoutFd);
+	cgi.exited = true;
+}
+
+void	ServerRunner::reapCgiChildren()	{
+
+	int		status;
+	pid_t	pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)	{
+
+		std::map<pid_t, int>::iterator	owner = _cgiPidOwner.find(pid);
+		if (owner == _cgiPidOwner.end())
+			continue;								// aborted earlier, nothing waits for it
+
+		int	clientFd = owner->second;
+		_cgiPidOwner.erase(owner);
+
+		Connection*	connection = _connections.find(clientFd);
+		if (!connection || connection->cgi.pid != pid)
+			continue;
+
+		CgiProcess&	cgi = connection->cgi;
+		cgi.exited = true;
+		if (WIFEXITED(status))
+			cgi.exitStatus = WEXITSTATUS(status);
+		else if (WIFSIGNALED(status))
+			cgi.exitStatus = 128 + WTERMSIG(status);
+
+		finishCgiIfDone(*connection);
+	}
+}
+
+
+//**************************************************************************************************
+// FastCGI backends
+//
+// "fastcgi_pass" scripts are not forked: the request is encoded once
+// (BEGIN_REQUEST, PARAMS, STDIN) and written to a persistent connection to the
+// application socket, and its records are read back as ordinary loop events.
+// Each socket has a pool of at most fastcgi_pool_size connections (kept open
+// with FCGI_KEEP_CONN); requests beyond that wait in a FIFO of at most
+// fastcgi_queue_size, the rest are refused with a 503. The collected STDOUT
+// goes through buildCgiResponse() like a forked script's output.
+
+void	ServerRunner::startFastCgi(Connection& connection)	{
+
+	CgiProcess&			cgi = connection.cgi;
+	FastCgiUpstream&	upstream = _fcgiUpstreams[cgi.fastcgiSocket];
+
+	upstream.poolSize = cgi.poolSize;			// limits of the location that sent the request
+	upstream.queueSize = cgi.queueSize;
+
+	if (assignFastCgiBackend(connection, upstream))
+		return;
+
+	if (upstream.waiting.size() >= upstream.queueSize)	{
+		cgi.rejected = true;
+		cgi.exited = true;
+		finishCgiIfDone(connection);			// -> 503
+		return;
+	}
+	upstream.waiting.push_back(connection.fd);	// cgi_timeout keeps running while it waits
+}
+
+// Hands the request to an idle connection, or opens a new one while the pool
+// has room. False when the pool is exhausted (the caller queues the request);
+// a failed connect() completes the request with a 502 and counts as handled.
+bool	ServerRunner::assignFastCgiBackend(Connection& connection, FastCgiUpstream& upstream)	{
+
+	CgiProcess&	cgi = connection.cgi;
+	int			fd = -1;
+	bool		reused = false;
+	bool		connecting = false;
+
+	if (!upstream.idle.empty())	{
+		fd = upstream.idle.back();				// most recently used: least likely to have timed out
+		upstream.idle.pop_back();
+		reused = true;
+	}
+	else	{
+		if (upstream.open >= upstream.poolSize)
+			return false;
+		fd = fastcgi::connectUnix(cgi.fastcgiSocket, connecting);
+		if (fd >= 0 && !_loop.add(fd, EV_NONE))	{
+			close(fd);
+			fd = -1;
+		}
+		if (fd < 0)	{
+			printSocketError(("fastcgi connect " + cgi.fastcgiSocket).c_str());
+			cgi.exited = true;					// exitStatus stays -1 -> 502
+			finishCgiIfDone(connection);
+			return true;
+		}
+		++upstream.open;
+		FastCgiBackend&	fresh = _fcgiBackends[fd];
+		fresh.fd = fd;
+		fresh.socketPath = cgi.fastcgiSocket;
+	}
+
+	FastCgiBackend&	backend = _fcgiBackends[fd];
+	backend.clientFd = connection.fd;
+	backend.connecting = connecting;
+	backend.reused = reused;
+	backend.answered = false;
+	backend.out.clear();
+	backend.outOffset = 0;
+	backend.parser.reset();
+	fastcgi::encodeRequest(cgi.params, connection.request.body, backend.out);
+
+	cgi.backendFd = fd;
+	cgi.lastIoMs = _nowMs;
+	setInterest(fd, EV_READ | EV_WRITE);
+	return true;
+}
+
+void	ServerRunner::handleFastCgiEvent(int backendFd, int events)	{
+
+	FastCgiBackend&	backend = _fcgiBackends[backendFd];
+
+	Connection*	owner = backend.clientFd >= 0 ? _connections.find(backend.clientFd) : NULL;
+	if (!owner || owner->cgi.backendFd != backendFd)	{
+		const std::string	socketPath = backend.socketPath;
+		closeFastCgiBackend(backendFd);			// idle: the application closed it (or sent junk)
+		serveFastCgiQueue(socketPath);
+		return;
+	}
+
+	Connection&	connection = *owner;
+	if ((events & EV_WRITE) && backend.outOffset < backend.out.size())
+		writeFastCgi(backend, connection);
+	if (connection.cgi.backendFd == backendFd && (events & (EV_READ | EV_HUP | EV_ERROR)))
+		readFastCgi(backend, connection, events);
+}
+
+void	ServerRunner::writeFastCgi(FastCgiBackend& backend, Connection& connection)	{
+
+	ssize_t	n = write(backend.fd, backend.out.data() + backend.outOffset, backend.out.size() - backend.outOffset);
+	if (n > 0)	{
+		backend.outOffset += static_cast<std::size_t>(n);
+		backend.connecting = false;
+		connection.cgi.lastIoMs = _nowMs;
+	}
+	// n <= 0: socket buffer full (or still connecting); errors arrive as EV_ERROR/EV_HUP
+	if (backend.outOffset >= backend.out.size())	{
+		backend.out.clear();
+		backend.outOffset = 0;
+		setInterest(backend.fd, connection.cgi.outputPaused ? EV_NONE : EV_READ);
+	}
+}
+
+void	ServerRunner::readFastCgi(FastCgiBackend& backend, Connection& connection, int events)	{
+
+	const std::size_t	READ_BUDGET = 64 * 1024;
+	CgiProcess&			cgi = connection.cgi;
+	char				buf[16384];
+	std::size_t			got = 0;
+
+	while (!backend.parser.ended() && got < READ_BUDGET)	{
+		ssize_t	n = read(backend.fd, buf, sizeof(buf));
+		if (n > 0)	{
+			backend.answered = true;
+			cgi.lastIoMs = _nowMs;
+			got += static_cast<std::size_t>(n);
+			if (!backend.parser.feed(buf, static_cast<std::size_t>(n), cgi.output))	{
+				failFastCgi(backend.fd, connection);
+				return;
+			}
+			continue;
+		}
+		if (n == 0 || (events & EV_ERROR))	{
+			failFastCgi(backend.fd, connection);	// closed before END_REQUEST
+			return;
+		}
+		break;
+	}
+	if (!backend.parser.ended())	{
+		forwardCgiOutput(connection);
+		return;
+	}
+
+	if (!backend.parser.errors().empty())
+		std::cerr << "fastcgi " << backend.socketPath << ": " << backend.parser.errors() << std::endl;
+
+	cgi.exitStatus = backend.parser.appStatus();
+	cgi.exited = true;
+	cgi.backendFd = -1;
+	releaseFastCgiBackend(backend.fd, backend.parser.idle());
+	forwardCgiOutput(connection);				// streamed: the last body bytes
+	finishCgiIfDone(connection);
+}
+
+// The backend broke mid-request. A reused connection that had not answered
+// yet was most likely closed by the application while idle: the request is
+// retried once on another connection. Otherwise the client gets a 502.
+void	ServerRunner::failFastCgi(int backendFd, Connection& connection)	{
+
+	FastCgiBackend&		backend = _fcgiBackends[backendFd];
+	const bool			retry = backend.reused && !backend.answered;
+	const std::string	socketPath = backend.socketPath;
+	CgiProcess&			cgi = connection.cgi;
+
+	closeFastCgiBackend(backendFd);
+	cgi.backendFd = -1;
+	if (retry)	{
+		cgi.output.clear();
+		startFastCgi(connection);
+	}
+	else	{
+		cgi.exited = true;
+		finishCgiIfDone(connection);
+	}
+	serveFastCgiQueue(socketPath);
+}
+
+void	ServerRunner::releaseFastCgiBackend(int backendFd, bool keep)	{
+
+	FastCgiBackend&		backend = _fcgiBackends[backendFd];
+	const std::string	socketPath = backend.socketPath;
+
+	backend.clientFd = -1;
+	backend.out.clear();
+	backend.parser.reset();
+	if (keep && !_stopping)	{
+		_fcgiUpstreams[socketPath].idle.push_back(backendFd);
+		setInterest(backendFd, EV_READ);		// only to notice the application closing it
+	}
+	else
+		closeFastCgiBackend(backendFd);
+	serveFastCgiQueue(socketPath);
+}
+
+void	ServerRunner::closeFastCgiBackend(int backendFd)	{
+
+	std::map<int, FastCgiBackend>::iterator	it = _fcgiBackends.find(backendFd);
+	if (it == _fcgiBackends.end())
+		return;
+
+	FastCgiUpstream&	upstream = _fcgiUpstreams[it->second.socketPath];
+	upstream.idle.erase(std::remove(upstream.idle.begin(), upstream.idle.end(), backendFd), upstream.idle.end());
+	if (upstream.open > 0)
+		--upstream.open;
+
+	_loop.remove(backendFd);
+	close(backendFd);
+	_fcgiBackends.erase(it);
+}
+
+// Gives freed pool capacity to the oldest waiting requests. Entries whose
+// client was answered or closed in the meantime are skipped.
+void	ServerRunner::serveFastCgiQueue(const std::string& socketPath)	{
+
+	FastCgiUpstream&	upstream = _fcgiUpstreams[socketPath];
+
+	while (!upstream.waiting.empty())	{
+		Connection*	connection = _connections.find(upstream.waiting.front());
+		if (!connection || connection->state != S_CGI || connection->cgi.fastcgiSocket != socketPath
+			|| connection->cgi.backendFd >= 0 || connection->cgi.exited)	{
+			upstream.waiting.pop_front();
+			continue;
+		}
+		if (upstream.idle.empty() && upstream.open >= upstream.poolSize)
+			break;
+		upstream.waiting.pop_front();
+		assignFastCgiBackend(*connection, upstream);
+	}
+}
+
+
+//**************************************************************************************************
+// Reverse proxy
+//
+// "proxy_pass" requests go to an upstream HTTP server. The head is serialized
+// in client mode as soon as it is parsed and written to a pooled keep-alive
+// connection; a body follows as the client sends it (the client is not read
+// while the upstream is behind). The response is parsed with the request
+// readers and streamed back through the CGI streaming path, which stops
+// reading the upstream while the client is behind. The location's servers are
+// balanced round-robin or by fewest busy connections; one that refused a
+// connect is skipped for a while.
+
+static const long			PROXY_DOWN_MS = 10000;			// a server that refused a connect sits out this long
+static const std::size_t	PROXY_HIGH_WATER = 64 * 1024;	// request bytes owed upstream before the client is paused
+
+// A body the client is still sending (or about to send) when the exchange ends early.
+static bool	proxyBodyPending(const Connection& connection)	{
+	return connection.state == S_BODY || connection.sentContinue
+		|| (connection.state == S_HEADERS && connection.request.body_reader_state != BR_NONE);
+}
+
+// The response goes out before the request body is in: the rest of it is drained, then the connection closed.
+static void	drainProxyBody(Connection& connection)	{
+	connection.request.keep_alive = false;
+	connection.request.expectContinue = false;
+	connection.sentContinue = false;
+	connection.draining = true;
+	connection.drainedBytes = 0;
+}
+
+// Every upstream named by a location, resolved once; a name that does not
+// resolve only fails the requests sent to it.
+void	ServerRunner::resolveProxyUpstreams()	{
+
+	for (std::size_t s = 0; s < _servers.size(); ++s)	{
+		const RouteTable&	routes = _servers[s].routes;
+		for (std::size_t r = 0; r < routes.size(); ++r)	{
+			const EffectiveConfig&	route = routes.at(r);
+			for (std::size_t i = 0; i < route.proxyPass.size(); ++i)	{
+				const std::string&	spec = route.proxyPass[i];
+				const bool			known = _proxyUpstreams.count(spec) != 0;
+				ProxyUpstream&		upstream = _proxyUpstreams[spec];
+
+				if (route.proxyKeepalive > upstream.keepalive)
+					upstream.keepalive = route.proxyKeepalive;
+				if (known)
+					continue;
+				std::string	error;
+				if (!proxy::resolve(spec, upstream.addr, upstream.addrLen, error))	{
+					upstream.addrLen = 0;
+					std::cerr << "Warning: proxy_pass " << spec << ": " << error << std::endl;
+				}
+			}
+		}
+	}
+}
+
+void	ServerRunner::startProxy(Connection& connection)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	cgi = CgiProcess();
+	cgi.proxyPeer = connection.route->proxyPass[0];	// marks the exchange until a server is picked
+	cgi.startedUs = Metrics::nowUs();
+	cgi.lastIoMs = _nowMs;
+	cgi.timeoutMs = static_cast<long>(connection.route->proxyTimeout) * 1000;
+	cgi.streamEnabled = true;
+
+	if (!connectProxy(connection, ""))
+		finishProxy(connection);				// no server could take it: 502
+}
+
+// Hands the request to a server of the location: `pending` is what a failed
+// connection had not written yet, empty for a fresh head. False once every
+// server was tried.
+bool	ServerRunner::connectProxy(Connection& connection, const std::string& pending)	{
+
+	CgiProcess&				cgi = connection.cgi;
+	const EffectiveConfig&	route = *connection.route;
+
+	while (cgi.proxyTries <= route.proxyPass.size())	{
+		const std::string	peer = pickProxyUpstream(route);
+		if (peer.empty())
+			break;
+		++cgi.proxyTries;
+		if (assignProxyBackend(connection, peer, pending))
+			return true;
+		_proxyUpstreams[peer].downUntilMs = _nowMs + PROXY_DOWN_MS;
+	}
+	cgi.backendFd = -1;
+	cgi.exited = true;							// exitStatus stays -1 -> 502
+	return false;
+}
+
+// Servers marked down are only picked when every server is; unresolved ones never.
+std::string	ServerRunner::pickProxyUpstream(const EffectiveConfig& route)	{
+
+	const std::vector<std::string>&	peers = route.proxyPass;
+	std::size_t&					cursor = _proxyCursor[&route];
+
+	for (int pass = 0; pass < 2; ++pass)	{
+		std::size_t	best = peers.size();
+		std::size_t	bestBusy = 0;
+		for (std::size_t k = 0; k < peers.size(); ++k)	{
+			const std::size_t		i = (cursor + k) % peers.size();
+			const ProxyUpstream&	upstream = _proxyUpstreams[peers[i]];
+			if (upstream.addrLen == 0 || (pass == 0 && upstream.downUntilMs > _nowMs))
+				continue;
+			const std::size_t	busy = upstream.open - upstream.idle.size();
+			if (best == peers.size() || (route.proxyLeastConn && busy < bestBusy))	{
+				best = i;
+				bestBusy = busy;
+			}
+			if (!route.proxyLeastConn)
+				break;							// round robin: the first usable one from the cursor
+		}
+		if (best < peers.size())	{
+			cursor = best + 1;
+			return peers[best];
+		}
+	}
+	return std::string();
+}
+
+// An idle connection of the server, or a new one. False when the connect fails
+// right away (the caller moves on to another server).
+bool	ServerRunner::assignProxyBackend(Connection& connection, const std::string& peer, const std::string& pending)	{
+
+	CgiProcess&		cgi = connection.cgi;
+	ProxyUpstream&	upstream = _proxyUpstreams[peer];
+	int				fd = -1;
+	bool			reused = false;
+	bool			connecting = false;
+
+	if (!upstream.idle.empty())	{
+		fd = upstream.idle.back();				// most recently used: least likely to have timed out
+		upstream.idle.pop_back();
+		reused = true;
+		++_metrics.proxyReuses;
+	}
+	else	{
+		fd = proxy::connectTcp(upstream.addr, upstream.addrLen, connecting);
+		if (fd >= 0 && !_loop.add(fd, EV_NONE))	{
+			close(fd);
+			fd = -1;
+		}
+		if (fd < 0)	{
+			printSocketError(("proxy connect " + peer).c_str());
+			return false;
+		}
+		++upstream.open;
+		++_metrics.proxyConnects;
+		ProxyBackend&	fresh = _proxyBackends[fd];
+		fresh.fd = fd;
+		fresh.peer = peer;
+	}
+
+	ProxyBackend&	backend = _proxyBackends[fd];
+	backend.reset();
+	backend.clientFd = connection.fd;
+	backend.connecting = connecting;
+	backend.reused = reused;
+	if (pending.empty())
+		http::serialize_request_head(connection.request, ClientLimiter::addressOf(connection.clientKey), peer, backend.out);
+	else
+		backend.out = pending;
+
+	cgi.proxyPeer = peer;
+	cgi.backendFd = fd;
+	cgi.lastIoMs = _nowMs;
+	setInterest(fd, EV_READ | EV_WRITE);
+	return true;
+}
+
+// Body bytes decoded from the client go upstream, re-chunked when the client
+// sent them chunked. Past PROXY_HIGH_WATER owed bytes the client is paused
+// until writeProxy() catches up.
+void	ServerRunner::forwardProxyBody(Connection& connection, bool complete)	{
+
+	HTTP_Request&	request = connection.request;
+	ProxyBackend&	backend = _proxyBackends[connection.cgi.backendFd];
+
+	if (backend.outOffset > 0)	{
+		backend.out.erase(0, backend.outOffset);
+		backend.outOffset = 0;
+	}
+	if (!request.body.empty())	{
+		if (request.body_reader_state == BR_CHUNKED)	{
+			std::ostringstream	size;
+			size << std::hex << request.body.size() << "\r\n";
+			backend.out += size.str();
+			backend.out += request.body;
+			backend.out += "\r\n";
+		}
+		else
+			backend.out += request.body;
+		request.body.clear();
+	}
+	if (complete)	{
+		if (request.body_reader_state == BR_CHUNKED)
+			backend.out += "0\r\n\r\n";
+		connection.state = S_CGI;
+		connection.cgi.lastIoMs = _nowMs;		// proxy_timeout runs from the end of the request
+	}
+
+	backend.holdingClient = !complete && backend.out.size() >= PROXY_HIGH_WATER;
+	setInterest(connection.fd, (complete || backend.holdingClient) ? EV_NONE : EV_READ);
+	setInterest(backend.fd, proxyInterest(backend, connection.cgi));
+	if (complete)	{
+		pauseCgiOutput(connection, false);		// an early response head waited for the body
+		forwardCgiOutput(connection);
+	}
+}
+
+void	ServerRunner::handleProxyEvent(int backendFd, int events)	{
+
+	ProxyBackend&	backend = _proxyBackends[backendFd];
+
+	Connection*	owner = backend.clientFd >= 0 ? _connections.find(backend.clientFd) : NULL;
+	if (!owner || owner->cgi.backendFd != backendFd || owner->cgi.proxyPeer != backend.peer)	{
+		closeProxyBackend(backendFd);			// idle: the server closed it (or sent something unasked)
+		return;
+	}
+
+	Connection&	connection = *owner;
+	if ((events & EV_WRITE) && backend.outOffset < backend.out.size())
+		writeProxy(backend, connection);
+	if (events & (EV_READ | EV_HUP | EV_ERROR))
+		readProxy(backend, connection, events);
+}
+
+void	ServerRunner::writeProxy(ProxyBackend& backend, Connection& connection)	{
+
+	ssize_t	n = write(backend.fd, backend.out.data() + backend.outOffset, backend.out.size() - backend.outOffset);
+	if (n <= 0)
+		return;									// a refused connect shows up as EV_ERROR/EV_HUP
+
+	backend.outOffset += static_cast<std::size_t>(n);
+	backend.connecting = false;
+	connection.cgi.lastIoMs = _nowMs;
+	connection.lastActiveMs = _nowMs;			// the body timeout waits on the upstream, not the client
+	if (backend.outOffset < backend.out.size())
+		return;
+
+	backend.out.clear();
+	backend.outOffset = 0;
+	setInterest(backend.fd, proxyInterest(backend, connection.cgi));
+	if (backend.holdingClient)	{
+		backend.holdingClient = false;
+		setInterest(connection.fd, EV_READ);	// every buffered body byte was consumed: wait for more
+	}
+}
+
+void	ServerRunner::readProxy(ProxyBackend& backend, Connection& connection, int events)	{
+
+	const std::size_t	READ_BUDGET = 64 * 1024;	// per event, like the CGI pipes
+	const std::size_t	READ_CHUNK = 16 * 1024;
+	CgiProcess&			cgi = connection.cgi;
+	IoBuffer&			in = backend.exchange.readBuffer;
+	std::size_t			got = 0;
+	bool				eof = false;
+
+	while (got < READ_BUDGET)	{
+		ssize_t	n = read(backend.fd, in.prepare(READ_CHUNK), READ_CHUNK);
+		if (n > 0)	{
+			in.commit(static_cast<std::size_t>(n));
+			got += static_cast<std::size_t>(n);
+			backend.answered = true;
+			cgi.lastIoMs = _nowMs;
+			continue;
+		}
+		eof = (n == 0 || (events & (EV_ERROR | EV_HUP)));
+		break;
+	}
+
+	if (!decodeProxyResponse(backend, connection, eof) || (eof && !backend.ended))	{
+		failProxy(backend.fd, connection);
+		return;
+	}
+	if (!backend.ended)	{
+		if (proxyBodyPending(connection) && cgi.output.size() >= PROXY_HIGH_WATER)
+			pauseCgiOutput(connection, true);	// early answer: hold it until the request is sent
+		else
+			forwardCgiOutput(connection);
+		return;
+	}
+
+	// Complete. The connection goes back to the pool only when it is clean:
+	// the server keeps it open, nothing extra arrived, the request was sent whole.
+	const bool	keep = !eof && !backend.untilClose && backend.exchange.request.keep_alive
+						&& in.empty() && backend.out.empty() && !proxyBodyPending(connection);
+	const int	fd = backend.fd;
+
+	cgi.exited = true;
+	cgi.exitStatus = backend.status;
+	if (cgi.streaming)	{
+		forwardCgiOutput(connection);			// the last decoded bytes
+		cgi.backendFd = -1;
+		releaseProxyBackend(fd, keep);
+		finishProxy(connection);
+		return;
+	}
+
+	HTTP_Response	res;
+	buildProxyHead(backend, connection, res, false);
+	res.body.swap(cgi.output);
+	cgi.backendFd = -1;
+	releaseProxyBackend(fd, keep);
+
+	connection.upstreamUs = Metrics::nowUs() - cgi.startedUs;
+	_metrics.upstream.observe(connection.upstreamUs);
+	if (proxyBodyPending(connection))
+		drainProxyBody(connection);
+	connection.cgi = CgiProcess();
+	connection.lastActiveMs = _nowMs;
+	queueResponse(connection, res);
+}
+
+// Response bytes read so far through the response readers: the head (1xx
+// interim ones skipped), then the body by its framing into cgi.output.
+// False on a malformed response.
+bool	ServerRunner::decodeProxyResponse(ProxyBackend& backend, Connection& connection, bool eof)	{
+
+	const std::size_t	MAX_HEAD_BYTES = 16 * 1024;
+	Connection&			exchange = backend.exchange;
+	HTTP_Request&		response = exchange.request;
+
+	while (!backend.headParsed)	{
+		std::string	head;
+		head.swap(response.headers.raw());		// reuse the field storage's capacity
+		if (!http::extract_next_head(exchange.readBuffer, head, exchange.headScanned))	{
+			response.headers.raw().swap(head);
+			return exchange.readBuffer.size() <= MAX_HEAD_BYTES;
+		}
+		exchange.headScanned = 0;
+		if (!http::parse_response_head(head, response, backend.status, backend.reason))
+			return false;
+		if (backend.status < 200)	{
+			if (backend.status == 101)
+				return false;					// no protocol switch through the proxy
+			continue;							// interim (100 Continue): the final head follows
+		}
+		backend.headParsed = true;
+		const bool	noBody = connection.request.method == "HEAD" || backend.status == 204 || backend.status == 304;
+		if (noBody)
+			response.body_reader_state = BR_NONE;
+		backend.untilClose = !noBody && response.body_reader_state == BR_NONE
+							&& !response.headers.has(RequestHeaders::CONTENT_LENGTH);
+	}
+
+	const std::size_t	unlimited = std::numeric_limits<std::size_t>::max();
+	http::BodyResult	result = http::BODY_COMPLETE;
+	int					status = 0;
+	std::string			reason;
+
+	if (response.body_reader_state == BR_CONTENT_LENGTH)
+		result = http::consume_body_content_length(exchange, unlimited, status, reason);
+	else if (response.body_reader_state == BR_CHUNKED)
+		result = http::consume_body_chunked(exchange, unlimited, status, reason);
+	else if (backend.untilClose)	{
+		response.body.append(exchange.readBuffer.data(), exchange.readBuffer.size());
+		exchange.readBuffer.clear();
+		result = eof ? http::BODY_COMPLETE : http::BODY_INCOMPLETE;
+	}
+	if (result == http::BODY_ERROR)
+		return false;
+
+	std::string&	output = connection.cgi.output;
+	if (output.empty())
+		output.swap(response.body);
+	else	{
+		output += response.body;
+		response.body.clear();
+	}
+	backend.ended = (result == http::BODY_COMPLETE);
+	return true;
+}
+
+// The upstream's status and fields for the client. Hop-by-hop fields are
+// dropped (the client connection has its own); repeatable ones (Set-Cookie)
+// go out as they came. Content-Length stays when the body is streamed with
+// it, and for HEAD; otherwise the core frames the body itself.
+void	ServerRunner::buildProxyHead(const ProxyBackend& backend, const Connection& connection, HTTP_Response& res, bool streamed)	{
+
+	const HTTP_Request&		response = backend.exchange.request;
+	const RequestHeaders&	headers = response.headers;
+
+	res.status = backend.status;
+	res.reason = backend.reason;
+	for (std::size_t i = 0; i < headers.count(); ++i)	{
+		const RequestHeaders::Field&	f = headers.field(i);
+		const std::string				name = headers.name(f);
+
+		if (http::is_hop_by_hop(name))
+			continue;
+		if (name == "content-length")	{
+			if (streamed || connection.request.method == "HEAD")	{
+				std::ostringstream	length;
+				length << response.content_length;
+				res.headers["Content-Length"] = length.str();
+			}
+			continue;
+		}
+		if (name == "date" || name == "server")	{
+			res.headers[name == "date" ? "Date" : "Server"] = headers.value(f);
+			continue;
+		}
+		res.headerLines += name;
+		res.headerLines += ": ";
+		res.headerLines.append(headers.valueData(f), f.valueLen);
+		res.headerLines += "\r\n";
+	}
+}
+
+// Streaming starts once the request is sent and the final head is in: with the
+// upstream's Content-Length when it gave one, chunked to HTTP/1.1 clients
+// otherwise. HEAD and length-less answers to HTTP/1.0 clients are buffered.
+bool	ServerRunner::startProxyStream(Connection& connection, HTTP_Response& head)	{
+
+	CgiProcess&	cgi = connection.cgi;
+
+	if (cgi.backendFd < 0 || connection.state != S_CGI || connection.request.method == "HEAD")
+		return false;
+	const ProxyBackend&	backend = _proxyBackends[cgi.backendFd];
+	if (!backend.headParsed || backend.ended)
+		return false;
+	const bool	sized = backend.exchange.request.body_reader_state == BR_CONTENT_LENGTH;
+	if (!sized && connection.request.version != "HTTP/1.1")
+		return false;
+
+	buildProxyHead(backend, connection, head, true);
+	if (!sized)
+		head.headers["Transfer-Encoding"] = "chunked";
+	cgi.streamChunked = !sized;
+	cgi.streamRemaining = sized ? static_cast<long long>(backend.exchange.request.content_length) : 0;
+	return true;
+}
+
+// The upstream connection broke. A request it had not written yet (connect
+// refused) moves to another server; a reused connection that never answered
+// (closed by the server while idle) is retried once for a bodiless request.
+// Anything else is a 502, or a cut stream.
+void	ServerRunner::failProxy(int backendFd, Connection& connection)	{
+
+	ProxyBackend&		backend = _proxyBackends[backendFd];
+	CgiProcess&			cgi = connection.cgi;
+	const bool			holding = backend.holdingClient;
+	std::string			pending;
+	bool				retry = false;
+
+	if (backend.connecting)	{
+		retry = true;
+		pending.swap(backend.out);
+		_proxyUpstreams[backend.peer].downUntilMs = _nowMs + PROXY_DOWN_MS;
+	}
+	else if (backend.reused && !backend.answered && connection.request.body_reader_state == BR_NONE)
+		retry = true;
+
+	closeProxyBackend(backendFd);
+	cgi.backendFd = -1;
+	if (retry && connectProxy(connection, pending))	{
+		_proxyBackends[cgi.backendFd].holdingClient = holding;
+		return;
+	}
+	cgi.exited = true;
+	cgi.exitStatus = -1;
+	finishProxy(connection);
+}
+
+// The exchange is over with its backend already released: a stream gets its
+// end (or is cut short), a failure before any of the response went out
+// becomes a 502 (504 after proxy_timeout).
+void	ServerRunner::finishProxy(Connection& connection)	{
+
+	CgiProcess&	cgi = connection.cgi;
+	const bool	failed = (cgi.exitStatus < 0);
+
+	connection.upstreamUs = Metrics::nowUs() - cgi.startedUs;
+	_metrics.upstream.observe(connection.upstreamUs);
+	if (failed)
+		++_metrics.proxyErrors;
+
+	if (cgi.streaming)	{
+		if (cgi.streamChunked && !failed)
+			connection.writeBody += "0\r\n\r\n";
+		if (failed || (!cgi.streamChunked && cgi.streamRemaining > 0))
+			connection.request.keep_alive = false;	// short of its framing: only a close can end it
+		cgi.streamFinished = true;
+		setInterest(connection.fd, EV_WRITE);
+		armTimer(connection);
+		return;
+	}
+
+	const Server&	active = connection.srv ? *connection.srv : _servers[0];
+	const int		status = cgi.timedOut ? 504 : 502;
+
+	if (proxyBodyPending(connection))
+		drainProxyBody(connection);
+	if (_stopping || connection.peerClosedRead)
+		connection.request.keep_alive = false;
+	connection.cgi = CgiProcess();
+	connection.writeBuffer = http::build_error_response(active, status, status == 504 ? "Gateway Timeout" : "Bad Gateway",
+														connection.request.keep_alive);
+	connection.writeBody.clear();
+	connection.writeOffset = 0;
+	connection.logStatus = status;
+	connection.lastActiveMs = _nowMs;
+	connection.state = S_WRITE;
+	setInterest(connection.fd, EV_WRITE);
+	armTimer(connection);
+}
+
+// Back to the server's pool when the exchange left it clean and the pool has
+// room; closed otherwise.
+void	ServerRunner::releaseProxyBackend(int backendFd, bool keep)	{
+
+	ProxyBackend&	backend = _proxyBackends[backendFd];
+	ProxyUpstream&	upstream = _proxyUpstreams[backend.peer];
+
+	if (keep && !_stopping && upstream.idle.size() < upstream.keepalive)	{
+		backend.reset();
+		upstream.idle.push_back(backendFd);
+		setInterest(backendFd, EV_READ);		// only to notice the server closing it
+	}
+	else
+		closeProxyBackend(backendFd);
+}
+
+void	ServerRunner::closeProxyBackend(int backendFd)	{
+
+	std::map<int, ProxyBackend>::iterator	it = _proxyBackends.find(backendFd);
+	if (it == _proxyBackends.end())
+		return;
+
+	ProxyUpstream&	upstream = _proxyUpstreams[it->second.peer];
+	upstream.idle.erase(std::remove(upstream.idle.begin(), upstream.idle.end(), backendFd), upstream.idle.end());
+	if (upstream.open > 0)
+		--upstream.open;
+
+	_loop.remove(backendFd);
+	close(backendFd);
+	_proxyBackends.erase(it);
+}
@@ -0,0 +1,49 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SpillFile.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "SpillFile.hpp"
+
+namespace spill {
+
+    int     create(const std::string& directory, std::string& path) {
+        std::string tmpl = directory;
+        if (tmpl.empty() || tmpl[tmpl.size() - 1] != '/')
+            tmpl += '/';
+        tmpl += ".upload-XXXXXX";
+
+        std::vector<char>   name(tmpl.begin(), tmpl.end());
+        name.push_back('\0');
+
+        int fd = mkstemp(&name[0]);
+        if (fd < 0)
+            return -1;
+
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        mode_t  mask = umask(0);                // mkstemp() creates it 0600
+        umask(mask);
+        fchmod(fd, 0666 & ~mask);
+
+        path = &name[0];
+        return fd;
+    }
+
+    bool    writeAll(int fd, const char* data, std::size_t len) {
+        while (len > 0) {
+            ssize_t n = write(fd, data, len);
+            if (n <= 0)
+                return false;
+            data += n;
+            len -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+}
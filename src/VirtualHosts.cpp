@@ -0,0 +1,177 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   VirtualHosts.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "VirtualHosts.hpp"
+#include "Structs.hpp"
+
+namespace	{
+
+	// FNV-1a: cheap, and good enough spread for a few hundred host names.
+	std::size_t	hashName(const std::string& name)	{
+		uint32_t	h = 2166136261u;
+		for (std::size_t i = 0; i < name.size(); ++i)	{
+			h ^= static_cast<unsigned char>(name[i]);
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	struct EntryLess {
+		template <typename Entry>
+		bool	operator()(const Entry& a, const std::string& b) const	{ return a.name < b; }
+	};
+}
+
+std::string	normalizeHostName(const std::string& host)	{
+
+	std::string::size_type	end = host.size();
+	if (!host.empty() && host[0] == '[')	{		// "[::1]:8080": the brackets are part of the name
+		std::string::size_type	close = host.find(']');
+		if (close != std::string::npos)
+			end = close + 1;
+	}
+	else	{
+		std::string::size_type	colon = host.find(':');
+		if (colon != std::string::npos)
+			end = colon;
+	}
+	while (end > 0 && host[end - 1] == '.')
+		--end;
+
+	std::string	name(host, 0, end);
+	for (std::size_t i = 0; i < name.size(); ++i)
+		name[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+	return name;
+}
+
+VirtualHosts::VirtualHosts()
+:	_names()
+,	_buckets()
+,	_leading()
+,	_trailing()
+,	_default(NULL)
+,	_explicitDefault(false)
+{}
+
+void	VirtualHosts::add(const Server* srv, bool isDefault)	{
+
+	if (!_default || (isDefault && !_explicitDefault))	{
+		_default = srv;
+		_explicitDefault = isDefault;
+	}
+	else if (isDefault)
+		std::cerr << " Note: more than one default_server on a listen address - keeping the first" << std::endl;
+
+	for (std::size_t i = 0; i < srv->server_name.size(); ++i)	{
+		const std::string	name = normalizeHostName(srv->server_name[i]);
+		Entry				entry;
+		entry.srv = srv;
+
+		if (name.size() > 2 && name.compare(0, 2, "*.") == 0)	{
+			entry.name = name.substr(1);
+			insertSorted(_leading, entry);
+		}
+		else if (name.size() > 1 && name[0] == '.')	{	// ".example.com": itself and every subdomain
+			entry.name = name;
+			insertSorted(_leading, entry);
+			entry.name = name.substr(1);
+			_names.push_back(entry);
+		}
+		else if (name.size() > 2 && name.compare(name.size() - 2, 2, ".*") == 0)	{
+			entry.name = name.substr(0, name.size() - 1);
+			insertSorted(_trailing, entry);
+		}
+		else if (!name.empty())	{
+			entry.name = name;
+			_names.push_back(entry);
+		}
+	}
+}
+
+// A name already taken by an earlier server{} on this address keeps its first
+// owner, like the listen socket itself.
+void	VirtualHosts::insertSorted(std::vector<Entry>& table, const Entry& entry)	{
+
+	std::vector<Entry>::iterator	it = std::lower_bound(table.begin(), table.end(), entry.name, EntryLess());
+	if (it != table.end() && it->name == entry.name)	{
+		if (it->srv != entry.srv)
+			std::cerr << " Note: conflicting server_name \"" << entry.name << "\" - keeping the first" << std::endl;
+		return;
+	}
+	table.insert(it, entry);
+}
+
+void	VirtualHosts::build()	{
+
+	std::size_t	count = 1;
+	while (count < _names.size() * 2)
+		count <<= 1;
+	_buckets.assign(count, std::vector<Entry>());
+
+	for (std::size_t i = 0; i < _names.size(); ++i)	{
+		const Server*	owner = findExact(_names[i].name);
+		if (owner)	{
+			if (owner != _names[i].srv)
+				std::cerr << " Note: conflicting server_name \"" << _names[i].name << "\" - keeping the first" << std::endl;
+			continue;
+		}
+		_buckets[hashName(_names[i].name) & (count - 1)].push_back(_names[i]);
+	}
+}
+
+const Server*	VirtualHosts::findExact(const std::string& name) const	{
+
+	if (_buckets.empty())
+		return NULL;
+	const std::vector<Entry>&	bucket = _buckets[hashName(name) & (_buckets.size() - 1)];
+	for (std::size_t i = 0; i < bucket.size(); ++i)
+		if (bucket[i].name == name)
+			return bucket[i].srv;
+	return NULL;
+}
+
+const Server*	VirtualHosts::findSorted(const std::vector<Entry>& table, const std::string& key)	{
+
+	std::vector<Entry>::const_iterator	it = std::lower_bound(table.begin(), table.end(), key, EntryLess());
+	if (it != table.end() && it->name == key)
+		return it->srv;
+	return NULL;
+}
+
+// Exact name first, then the longest leading wildcard, then the longest
+// trailing one; nothing matched (or no Host at all) -> default server.
+const Server*	VirtualHosts::select(const std::string& host) const	{
+
+	if (host.empty() || (_names.empty() && _leading.empty() && _trailing.empty()))
+		return _default;
+
+	const std::string	name = normalizeHostName(host);
+	const Server*		srv = findExact(name);
+	if (srv)
+		return srv;
+
+	if (!_leading.empty())	{
+		for (std::string::size_type dot = name.find('.'); dot != std::string::npos; dot = name.find('.', dot + 1))
+			if ((srv = findSorted(_leading, name.substr(dot))) != NULL)
+				return srv;
+	}
+	if (!_trailing.empty())	{
+		for (std::string::size_type dot = name.rfind('.'); dot != std::string::npos && dot > 0; dot = name.rfind('.', dot - 1))
+			if ((srv = findSorted(_trailing, name.substr(0, dot + 1))) != NULL)
+				return srv;
+	}
+	return _default;
+}
+
+const Server*	VirtualHosts::defaultServer() const	{
+	return _default;
+}
@@ -0,0 +1,224 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   WorkerMaster.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: suroh <suroh@student.42.fr>                +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/14 10:00:00 by suroh             #+#    #+#             */
+/*   Updated: 2026/10/14 10:00:00 by suroh            ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../include/WorkerMaster.hpp"
+#include "../include/ServerRunner.hpp"
+
+// Worker exit code meaning "could not serve at all" (no listener, no event loop).
+// Respawning would only loop, so the master gives up instead.
+static const int	WORKER_STARTUP_FAILURE = 2;
+
+static volatile sig_atomic_t	g_masterStop = 0;
+static int						g_masterWakeFd = -1;
+
+static void	wakeMaster()	{
+	int	savedErrno = errno;
+	if (g_masterWakeFd >= 0)	{
+		char	c = 1;
+		ssize_t	n = write(g_masterWakeFd, &c, 1);
+		(void)n;
+	}
+	errno = savedErrno;
+}
+
+static void	onMasterStop(int)	{
+	g_masterStop = 1;
+	wakeMaster();
+}
+
+static void	onMasterChild(int)	{
+	wakeMaster();
+}
+
+//**************************************************************************************************
+
+WorkerMaster::WorkerMaster(const std::vector<Server>& servers, std::size_t workerCount, const GlobalSettings& globals)
+	:	_servers(servers), _workerCount(workerCount), _globals(globals)
+{
+	_wakePipe[0] = -1;
+	_wakePipe[1] = -1;
+}
+
+int	WorkerMaster::run()	{
+
+#ifndef SO_REUSEPORT
+	std::cerr << "Warning: SO_REUSEPORT unavailable, running a single worker\n";
+	_workerCount = 1;
+#endif
+
+	if (pipe(_wakePipe) == -1)	{
+		std::cerr << "worker master pipe: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	for (int i = 0; i < 2; ++i)	{
+		makeNonBlocking(_wakePipe[i]);
+		fcntl(_wakePipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	g_masterWakeFd = _wakePipe[1];
+	signal(SIGTERM, onMasterStop);
+	signal(SIGINT, onMasterStop);
+	signal(SIGCHLD, onMasterChild);
+
+	_workers.assign(_workerCount, -1);
+	_spawnedAt.assign(_workerCount, 0);
+
+	std::cout << "Master " << getpid() << ": starting " << _workerCount << " workers" << std::endl;
+	for (std::size_t slot = 0; slot < _workerCount; ++slot)	{
+		if (!spawnWorker(slot))	{
+			stopWorkers();
+			return 1;
+		}
+	}
+
+	int	status = 0;
+	while (!g_masterStop)	{
+		waitForWake(1000);
+		if (!reapWorkers())	{
+			status = 1;
+			break;
+		}
+
+		// Respawn dead slots, at most once per second per slot (crash-loop throttle).
+		const std::time_t	now = std::time(NULL);
+		for (std::size_t slot = 0; slot < _workerCount && !g_masterStop; ++slot)	{
+			if (_workers[slot] == -1 && now - _spawnedAt[slot] >= 1)
+				spawnWorker(slot);
+		}
+	}
+
+	stopWorkers();
+	close(_wakePipe[0]);
+	close(_wakePipe[1]);
+	g_masterWakeFd = -1;
+	return status;
+}
+
+bool	WorkerMaster::spawnWorker(std::size_t slot)	{
+
+	std::cout.flush();							// don't duplicate buffered output into the child
+	std::cerr.flush();
+
+	pid_t	pid = fork();
+	if (pid == -1)	{
+		std::cerr << "fork worker: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+	if (pid == 0)
+		runWorker();							// never returns
+
+	_workers[slot] = pid;
+	_spawnedAt[slot] = std::time(NULL);
+	std::cout << "Worker #" << slot << " started (pid " << pid << ")" << std::endl;
+	return true;
+}
+
+// Child side: drop the master's signal plumbing and run a normal event loop.
+void	WorkerMaster::runWorker()	{
+
+	ServerRunner::installStopHandlers();
+	signal(SIGCHLD, SIG_DFL);
+	close(_wakePipe[0]);
+	close(_wakePipe[1]);
+	g_masterWakeFd = -1;
+
+	int	code = 0;
+	try	{
+		ServerRunner	runner(_servers, true, _globals);
+		if (!runner.run())
+			code = WORKER_STARTUP_FAILURE;
+	}
+	catch (const std::exception& e)	{
+		std::cerr << "Worker " << getpid() << " fatal error: " << e.what() << '\n';
+		code = 1;
+	}
+	std::exit(code);
+}
+
+// Collect exited workers. Returns false when one could not even start.
+bool	WorkerMaster::reapWorkers()	{
+
+	int		st;
+	pid_t	pid;
+
+	while ((pid = waitpid(-1, &st, WNOHANG)) > 0)	{
+		for (std::size_t slot = 0; slot < _workers.size(); ++slot)	{
+			if (_workers[slot] != pid)
+				continue;
+			_workers[slot] = -1;
+
+			if (WIFEXITED(st) && WEXITSTATUS(st) == WORKER_STARTUP_FAILURE)	{
+				std::cerr << "Worker #" << slot << " failed to start, giving up\n";
+				return false;
+			}
+			if (!g_masterStop)	{
+				std::cerr << "Worker #" << slot << " (pid " << pid << ") ";
+				if (WIFSIGNALED(st))
+					std::cerr << "killed by signal " << WTERMSIG(st);
+				else
+					std::cerr << "exited with status " << WEXITSTATUS(st);
+				std::cerr << ", respawning\n";
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+// Graceful stop: SIGTERM every worker (they drain in-flight requests), then
+// SIGKILL whatever is still around after the grace period.
+void	WorkerMaster::stopWorkers()	{
+
+	const std::time_t	GRACE_SECONDS = 15;
+
+	for (std::size_t slot = 0; slot < _workers.size(); ++slot)	{
+		if (_workers[slot] > 0)
+			kill(_workers[slot], SIGTERM);
+	}
+
+	const std::time_t	deadline = std::time(NULL) + GRACE_SECONDS;
+	for (;;)	{
+		reapWorkers();
+
+		bool	alive = false;
+		for (std::size_t slot = 0; slot < _workers.size(); ++slot)
+			alive = alive || _workers[slot] > 0;
+		if (!alive)
+			return;
+
+		if (std::time(NULL) >= deadline)	{
+			for (std::size_t slot = 0; slot < _workers.size(); ++slot)	{
+				if (_workers[slot] > 0)	{
+					kill(_workers[slot], SIGKILL);
+					waitpid(_workers[slot], NULL, 0);
+					_workers[slot] = -1;
+				}
+			}
+			return;
+		}
+		waitForWake(200);
+	}
+}
+
+// Sleep until a signal pokes the self-pipe or the timeout expires.
+void	WorkerMaster::waitForWake(int timeoutMs)	{
+
+	struct pollfd	pfd;
+	pfd.fd = _wakePipe[0];
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, timeoutMs) > 0)	{
+		char	sink[64];
+		while (read(_wakePipe[0], sink, sizeof(sink)) > 0)
+			;
+	}
+}
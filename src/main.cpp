@@ -12,6 +12,8 @@
 
 #include "../include/Config.hpp"
 #include "../include/ServerRunner.hpp"
+#include "../include/WorkerMaster.hpp"
+#include "../include/App.hpp"
 
 // Print Structures Tester Function
 /*static void	printConfig(const std::vector<Server>& servers)	{
@@ -74,11 +76,21 @@ int	main(int argc, char** argv) {
 
 		Config	config(argv[1]);
 		const std::vector<Server>&	servers = config.getServers();
+		const GlobalSettings&		globals = config.getGlobals();
 
 		//printConfig(servers);
 
-		ServerRunner	runner(servers);
-		runner.run();
+		configureFileCache(globals.openFileCacheBytes, globals.openFileCacheValid);
+
+		if (globals.workerProcesses > 1)	{
+			WorkerMaster	master(servers, globals.workerProcesses, globals);
+			return master.run();
+		}
+
+		ServerRunner::installStopHandlers();
+		ServerRunner	runner(servers, false, globals);
+		if (!runner.run())
+			return 1;
 	}
 	catch(const std::exception& e)	{
 		std::cerr << "Fatal error: " << e.what() << '\n';
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Persistent FastCGI runner for CGI-style Python scripts (www/cgi-bin).
+
+    python3 tools/fcgi_runner.py /tmp/webserv-fcgi.sock [workers]
+
+Pre-forks <workers> long-lived interpreters (default 4) that accept on a Unix
+socket and execute SCRIPT_FILENAME in-process for every request, with the CGI
+variables in os.environ and the body on sys.stdin. Point webserv at it with
+"fastcgi_pass .py unix:/tmp/webserv-fcgi.sock;": the scripts stay unchanged,
+only the per-request interpreter start-up is gone.
+"""
+import io
+import os
+import signal
+import socket
+import struct
+import sys
+
+BEGIN_REQUEST, ABORT_REQUEST, END_REQUEST, PARAMS, STDIN, STDOUT = 1, 2, 3, 4, 5, 6
+KEEP_CONN = 1
+
+compiled = {}  # script path -> (mtime, code object)
+
+
+def read_exact(conn, n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+def read_record(conn):
+    version, rtype, rid, length, padding, _ = struct.unpack("!BBHHBB", read_exact(conn, 8))
+    content = read_exact(conn, length) if length else b""
+    if padding:
+        read_exact(conn, padding)
+    return rtype, rid, content
+
+
+def write_record(conn, rtype, rid, content):
+    for off in range(0, max(len(content), 1), 65528):
+        chunk = content[off:off + 65528]
+        conn.sendall(struct.pack("!BBHHBB", 1, rtype, rid, len(chunk), 0, 0) + chunk)
+
+
+class RecordWriter(io.RawIOBase):
+    """sys.stdout of a running script: every flush goes out as STDOUT records."""
+
+    def __init__(self, conn, rid):
+        self.conn, self.rid = conn, rid
+
+    def writable(self):
+        return True
+
+    def write(self, data):
+        if data:
+            write_record(self.conn, STDOUT, self.rid, bytes(data))
+        return len(data)
+
+
+def decode_params(data):
+    params, pos = {}, 0
+    while pos < len(data):
+        lengths = []
+        for _ in range(2):
+            n = data[pos]
+            if n >> 7:
+                n = struct.unpack("!I", data[pos:pos + 4])[0] & 0x7FFFFFFF
+                pos += 4
+            else:
+                pos += 1
+            lengths.append(n)
+        name = data[pos:pos + lengths[0]].decode("latin-1")
+        pos += lengths[0]
+        params[name] = data[pos:pos + lengths[1]].decode("latin-1")
+        pos += lengths[1]
+    return params
+
+
+def run_script(conn, rid, params, body):
+    path = params.get("SCRIPT_FILENAME", "")
+    mtime = os.stat(path).st_mtime
+    cached = compiled.get(path)
+    if not cached or cached[0] != mtime:
+        with open(path, "rb") as f:
+            cached = (mtime, compile(f.read(), path, "exec"))
+        compiled[path] = cached
+
+    saved = sys.stdin, sys.stdout, dict(os.environ)
+    os.environ.clear()
+    os.environ.update(params)
+    sys.stdin = io.TextIOWrapper(io.BytesIO(body), encoding="utf-8")
+    sys.stdout = io.TextIOWrapper(io.BufferedWriter(RecordWriter(conn, rid)), encoding="utf-8")
+    try:
+        exec(cached[1], {"__name__": "__main__", "__file__": path})
+    except SystemExit:
+        pass
+    finally:
+        sys.stdout.flush()
+        sys.stdin, sys.stdout = saved[0], saved[1]
+        os.environ.clear()
+        os.environ.update(saved[2])
+
+
+def serve(conn):
+    while True:
+        rtype, rid, content = read_record(conn)
+        if rtype != BEGIN_REQUEST:
+            continue
+        keep = content[2] & KEEP_CONN
+        params, body = b"", b""
+        while True:
+            rtype, _, content = read_record(conn)
+            if rtype == PARAMS:
+                params += content
+            elif rtype == STDIN:
+                if not content:
+                    break
+                body += content
+            elif rtype == ABORT_REQUEST:
+                break
+        try:
+            run_script(conn, rid, decode_params(params), body)
+            status = 0
+        except OSError:
+            raise  # webserv went away mid-response
+        except Exception as exc:  # reported like a crashing CGI script
+            status = 1
+            sys.stderr.write("fcgi_runner: %r\n" % exc)
+        write_record(conn, STDOUT, rid, b"")
+        conn.sendall(struct.pack("!BBHHBB", 1, END_REQUEST, rid, 8, 0, 0) + struct.pack("!IB3x", status, 0))
+        if not keep:
+            return
+
+
+def worker(listener):
+    signal.signal(signal.SIGINT, signal.SIG_DFL)
+    signal.signal(signal.SIGTERM, signal.SIG_DFL)
+    while True:
+        conn, _ = listener.accept()
+        try:
+            serve(conn)
+        except (EOFError, OSError):
+            pass
+        finally:
+            conn.close()
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "/tmp/webserv-fcgi.sock"
+    workers = int(sys.argv[2]) if len(sys.argv) > 2 else 4
+    if os.path.exists(path):
+        os.unlink(path)
+    listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    listener.bind(path)
+    listener.listen(128)
+
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    children = []
+    for _ in range(workers):
+        pid = os.fork()
+        if pid == 0:
+            worker(listener)
+            os._exit(0)
+        children.append(pid)
+    try:
+        for pid in children:
+            os.waitpid(pid, 0)
+    except (KeyboardInterrupt, SystemExit):
+        for pid in children:
+            os.kill(pid, signal.SIGTERM)
+    finally:
+        os.unlink(path)
+
+
+if __name__ == "__main__":
+    main()